@@ -0,0 +1,176 @@
+#include "binary.h"
+
+#include "lib/io/util.h"
+
+using namespace lib;
+using namespace lib::encoding;
+using namespace lib::encoding::binary;
+
+namespace {
+    template <std::endian Order, typename T>
+    void append(String &dst, T v) {
+        v = internal::order<Order>(v);
+        dst += str((const char*) &v, sizeof v);
+    }
+
+    // decode_fast decodes a varint of up to 8 bytes from w, the next 8 bytes
+    // of input loaded little-endian. It returns the varint's length, or 0 if
+    // it is longer.
+    inline int decode_fast(lib::uint64 w, lib::uint64 *v) {
+        // the first byte without a continuation bit ends the varint
+        lib::uint64 stops = ~w & 0x8080808080808080;
+        if (stops == 0) {
+            return 0;
+        }
+        int n = std::countr_zero(stops) / 8 + 1;
+        if (n < 8) {
+            w &= (lib::uint64(1) << (8*n)) - 1;
+        }
+
+        // gather the 7-bit groups
+        *v = (w & 0x7F)
+           | ((w >> 1) & (lib::uint64(0x7F) << 7))
+           | ((w >> 2) & (lib::uint64(0x7F) << 14))
+           | ((w >> 3) & (lib::uint64(0x7F) << 21))
+           | ((w >> 4) & (lib::uint64(0x7F) << 28))
+           | ((w >> 5) & (lib::uint64(0x7F) << 35))
+           | ((w >> 6) & (lib::uint64(0x7F) << 42))
+           | ((w >> 7) & (lib::uint64(0x7F) << 49));
+        return n;
+    }
+}
+
+void little_endian::append_uint16(String &dst, lib::uint16 v) {
+    append<std::endian::little>(dst, v);
+}
+
+void little_endian::append_uint32(String &dst, lib::uint32 v) {
+    append<std::endian::little>(dst, v);
+}
+
+void little_endian::append_uint64(String &dst, lib::uint64 v) {
+    append<std::endian::little>(dst, v);
+}
+
+void big_endian::append_uint16(String &dst, lib::uint16 v) {
+    append<std::endian::big>(dst, v);
+}
+
+void big_endian::append_uint32(String &dst, lib::uint32 v) {
+    append<std::endian::big>(dst, v);
+}
+
+void big_endian::append_uint64(String &dst, lib::uint64 v) {
+    append<std::endian::big>(dst, v);
+}
+
+int binary::put_uvarint(buf b, uint64 x) {
+    int i = 0;
+    while (x >= 0x80) {
+        b[i] = byte(x) | 0x80;
+        x >>= 7;
+        i++;
+    }
+    b[i] = byte(x);
+    return i + 1;
+}
+
+int binary::put_varint(buf b, int64 x) {
+    uint64 ux = uint64(x) << 1;
+    if (x < 0) {
+        ux = ~ux;
+    }
+    return put_uvarint(b, ux);
+}
+
+void binary::append_uvarint(String &dst, uint64 x) {
+    byte b[MaxVarintLen64];
+    int n = put_uvarint(b, x);
+    dst += str(b, n);
+}
+
+void binary::append_varint(String &dst, int64 x) {
+    byte b[MaxVarintLen64];
+    int n = put_varint(b, x);
+    dst += str(b, n);
+}
+
+uint64 binary::uvarint(str b, int &n) {
+    uint64 x = 0;
+    uint   s = 0;
+    for (int i = 0; i < len(b); i++) {
+        if (i == MaxVarintLen64) {
+            n = -(i + 1);  // overflow
+            return 0;
+        }
+        byte c = b.data[i];
+        if (c < 0x80) {
+            if (i == MaxVarintLen64 - 1 && c > 1) {
+                n = -(i + 1);  // overflow
+                return 0;
+            }
+            n = i + 1;
+            return x | uint64(c) << s;
+        }
+        x |= uint64(c & 0x7F) << s;
+        s += 7;
+    }
+    n = 0;
+    return 0;
+}
+
+int64 binary::varint(str b, int &n) {
+    uint64 ux = uvarint(b, n);
+    int64 x = int64(ux >> 1);
+    if (ux & 1) {
+        x = ~x;
+    }
+    return x;
+}
+
+int binary::uvarint_len(uint64 x) {
+    // one byte per started 7 bits, and one for zero
+    return (64 - std::countl_zero(x | 1) + 6) / 7;
+}
+
+size binary::decode_uvarints(str *b, std::span<uint64> out, error err) {
+    str in = *b;
+    size i = 0;
+    size k = 0;
+    size nout = size(out.size());
+
+    // while 8 bytes can be loaded, most varints take one load
+    while (k < nout && len(in) - i >= 8) {
+        int n = decode_fast(little_endian::uint64(in.slice(i)), &out[k]);
+        if (n == 0) {
+            out[k] = uvarint(in.slice(i), n);
+            if (n <= 0) {
+                // overflow, reported below
+                break;
+            }
+        }
+        i += n;
+        k++;
+    }
+
+    while (k < nout && i < len(in)) {
+        int n = 0;
+        out[k] = uvarint(in.slice(i), n);
+        if (n == 0) {
+            *b = in.slice(i);
+            err(io::ErrUnexpectedEOF());
+            return k;
+        }
+        if (n < 0) {
+            break;
+        }
+        i += n;
+        k++;
+    }
+
+    *b = in.slice(i);
+    if (k < nout && i < len(in)) {
+        err(ErrOverflow());
+    }
+    return k;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <bit>
+#include <cstring>
+#include <span>
+
+#include "lib/error.h"
+#include "lib/str.h"
+
+// Package binary translates between numbers and byte sequences: fixed-width
+// integers in either byte order, and varints.
+//
+// The fixed-width functions are inline and use memcpy and std::byteswap, so
+// that each compiles to a single, possibly unaligned, load or store and at
+// most a byte swap (movbe on CPUs that have it). Like indexing, they check
+// the length of the buffer unless NDEBUG is defined.
+//
+// The varints are those of Protocol Buffers and Go's encoding/binary: 7 bits
+// per byte, least significant first, the high bit set on every byte but the
+// last. Signed values are zigzag-encoded, so that small negative numbers are
+// short too.
+namespace lib::encoding::binary {
+
+    namespace internal {
+        template <typename T>
+        inline T load(str b) {
+            LIB_CHECK(usize(sizeof(T)) <= usize(len(b)), exceptions::bad_index, size(sizeof(T)) - 1, len(b) - 1);
+            T v;
+            std::memcpy(&v, b.data, sizeof(T));
+            return v;
+        }
+
+        template <typename T>
+        inline void store(buf b, T v) {
+            LIB_CHECK(usize(sizeof(T)) <= usize(len(b)), exceptions::bad_index, size(sizeof(T)) - 1, len(b) - 1);
+            std::memcpy(b.data, &v, sizeof(T));
+        }
+
+        template <std::endian Order, typename T>
+        inline T order(T v) {
+            if constexpr (std::endian::native == Order || sizeof(T) == 1) {
+                return v;
+            } else {
+                return std::byteswap(v);
+            }
+        }
+    }
+
+    // little_endian and big_endian read and write unsigned integers in
+    // their byte order. The functions are named after the type they read,
+    // as in Go: binary::big_endian::uint32(b).
+    namespace little_endian {
+        inline lib::uint16 uint16(str b) { return internal::order<std::endian::little>(internal::load<lib::uint16>(b)); }
+        inline lib::uint32 uint32(str b) { return internal::order<std::endian::little>(internal::load<lib::uint32>(b)); }
+        inline lib::uint64 uint64(str b) { return internal::order<std::endian::little>(internal::load<lib::uint64>(b)); }
+
+        inline void put_uint16(buf b, lib::uint16 v) { internal::store(b, internal::order<std::endian::little>(v)); }
+        inline void put_uint32(buf b, lib::uint32 v) { internal::store(b, internal::order<std::endian::little>(v)); }
+        inline void put_uint64(buf b, lib::uint64 v) { internal::store(b, internal::order<std::endian::little>(v)); }
+
+        void append_uint16(String &dst, lib::uint16 v);
+        void append_uint32(String &dst, lib::uint32 v);
+        void append_uint64(String &dst, lib::uint64 v);
+    }
+
+    namespace big_endian {
+        inline lib::uint16 uint16(str b) { return internal::order<std::endian::big>(internal::load<lib::uint16>(b)); }
+        inline lib::uint32 uint32(str b) { return internal::order<std::endian::big>(internal::load<lib::uint32>(b)); }
+        inline lib::uint64 uint64(str b) { return internal::order<std::endian::big>(internal::load<lib::uint64>(b)); }
+
+        inline void put_uint16(buf b, lib::uint16 v) { internal::store(b, internal::order<std::endian::big>(v)); }
+        inline void put_uint32(buf b, lib::uint32 v) { internal::store(b, internal::order<std::endian::big>(v)); }
+        inline void put_uint64(buf b, lib::uint64 v) { internal::store(b, internal::order<std::endian::big>(v)); }
+
+        void append_uint16(String &dst, lib::uint16 v);
+        void append_uint32(String &dst, lib::uint32 v);
+        void append_uint64(String &dst, lib::uint64 v);
+    }
+
+    // ErrOverflow reports a varint longer than a 64-bit value allows.
+    struct ErrOverflow : ErrorBase<ErrOverflow, "binary: varint overflows a 64-bit integer"> {};
+
+    // MaxVarintLen16, 32 and 64 are the longest varint encodings of 16-, 32-
+    // and 64-bit integers.
+    const int MaxVarintLen16 = 3;
+    const int MaxVarintLen32 = 5;
+    const int MaxVarintLen64 = 10;
+
+    // put_uvarint encodes x into b, which must be long enough, and returns
+    // the number of bytes written.
+    int put_uvarint(buf b, uint64 x);
+    int put_varint(buf b, int64 x);
+
+    void append_uvarint(String &dst, uint64 x);
+    void append_varint(String &dst, int64 x);
+
+    // uvarint decodes a varint from the start of b and stores the number of
+    // bytes read in n. If b ends before the varint does, n is 0; if the value
+    // overflows 64 bits, n is minus the number of bytes read.
+    uint64 uvarint(str b, int &n);
+    int64  varint(str b, int &n);
+
+    // uvarint_len returns the number of bytes in the encoding of x.
+    int uvarint_len(uint64 x);
+
+    // decode_uvarints decodes consecutive varints from the start of *b into
+    // out, until out is full or *b is empty, and advances *b past them. It
+    // returns the number decoded. Varints of up to 8 bytes are decoded with
+    // one load each.
+    size decode_uvarints(str *b, std::span<uint64> out, error err);
+}
@@ -0,0 +1,213 @@
+#include "binary.h"
+
+#include <vector>
+
+#include "lib/io/util.h"
+#include "lib/testing/benchmark.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+using namespace lib::encoding;
+
+void test_byte_order(T &t) {
+    const byte data[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    str b(data, 8);
+
+    if (uint16 v = binary::little_endian::uint16(b); v != 0x0201) {
+        t.errorf("little_endian::uint16 = %#x", v);
+    }
+    if (uint32 v = binary::little_endian::uint32(b); v != 0x04030201) {
+        t.errorf("little_endian::uint32 = %#x", v);
+    }
+    if (uint64 v = binary::little_endian::uint64(b); v != 0x0807060504030201) {
+        t.errorf("little_endian::uint64 = %#x", v);
+    }
+    if (uint16 v = binary::big_endian::uint16(b); v != 0x0102) {
+        t.errorf("big_endian::uint16 = %#x", v);
+    }
+    if (uint32 v = binary::big_endian::uint32(b); v != 0x01020304) {
+        t.errorf("big_endian::uint32 = %#x", v);
+    }
+    if (uint64 v = binary::big_endian::uint64(b); v != 0x0102030405060708) {
+        t.errorf("big_endian::uint64 = %#x", v);
+    }
+
+    byte out[8] = {};
+    binary::big_endian::put_uint64(out, 0x0102030405060708);
+    if (str(out, 8) != b) {
+        t.errorf("big_endian::put_uint64 = %q", str(out, 8));
+    }
+    binary::little_endian::put_uint32(out, 0x0A0B0C0D);
+    if (str(out, 4) != "\x0D\x0C\x0B\x0A") {
+        t.errorf("little_endian::put_uint32 = %q", str(out, 4));
+    }
+
+    String s;
+    binary::big_endian::append_uint16(s, 0x0102);
+    binary::little_endian::append_uint16(s, 0x0102);
+    binary::big_endian::append_uint32(s, 0x03040506);
+    if (s != "\x01\x02\x02\x01\x03\x04\x05\x06") {
+        t.errorf("append = %q", s);
+    }
+}
+
+void test_varint(T &t) {
+    const int64 tests[] = {
+        -1LL << 63,
+        (-1LL << 63) + 1,
+        -1,
+        0,
+        1,
+        2,
+        10,
+        20,
+        63,
+        64,
+        65,
+        127,
+        128,
+        129,
+        255,
+        256,
+        257,
+        (1LL << 62),
+        (int64) ((1ULL << 63) - 1),
+    };
+
+    for (int64 x : tests) {
+        byte b[binary::MaxVarintLen64];
+        int n = binary::put_varint(b, x);
+        int m = 0;
+        int64 y = binary::varint(str(b, n), m);
+        if (x != y || n != m) {
+            t.errorf("varint(%d): got %d; %d bytes, read %d", x, y, n, m);
+        }
+
+        uint64 ux = uint64(x);
+        n = binary::put_uvarint(b, ux);
+        uint64 uy = binary::uvarint(str(b, n), m);
+        if (ux != uy || n != m) {
+            t.errorf("uvarint(%d): got %d; %d bytes, read %d", ux, uy, n, m);
+        }
+        if (binary::uvarint_len(ux) != n) {
+            t.errorf("uvarint_len(%d) = %d; want %d", ux, binary::uvarint_len(ux), n);
+        }
+
+        String s;
+        binary::append_uvarint(s, ux);
+        if (s != str(b, n)) {
+            t.errorf("append_uvarint(%d) = %q; want %q", ux, s, str(b, n));
+        }
+    }
+}
+
+void test_uvarint_errors(T &t) {
+    struct {
+        str in;
+        int n;
+    } tests[] = {
+        {"", 0},
+        {"\x80", 0},
+        {"\xff\xff", 0},
+        {"\x80\x80\x80\x80\x80\x80\x80\x80\x80\x02", -10},
+        {"\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80\x01", -11},
+        {"\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01", 10},
+    };
+
+    for (auto const &tt : tests) {
+        int n = 99;
+        binary::uvarint(tt.in, n);
+        if (n != tt.n) {
+            t.errorf("uvarint(%q): n = %d; want %d", tt.in, n, tt.n);
+        }
+    }
+}
+
+void test_decode_uvarints(T &t) {
+    // a mix of lengths, so that some straddle the fast path's 8-byte loads
+    std::vector<uint64> want;
+    String in;
+    for (int i = 0; i < 200; i++) {
+        uint64 v = uint64(i) * 0x9E3779B97F4A7C15 >> (i % 64);
+        want.push_back(v);
+        binary::append_uvarint(in, v);
+    }
+
+    std::vector<uint64> got(want.size() + 5);
+    str b = in;
+    size n = binary::decode_uvarints(&b, got, error::panic);
+    if (n != size(want.size()) || len(b) != 0) {
+        t.fatalf("decoded %d of %d; %d bytes left", n, want.size(), len(b));
+    }
+    for (size i = 0; i < n; i++) {
+        if (got[i] != want[i]) {
+            t.errorf("value %d = %d; want %d", i, got[i], want[i]);
+        }
+    }
+
+    // a full out stops the decoding
+    b = in;
+    n = binary::decode_uvarints(&b, std::span(got).first(3), error::panic);
+    if (n != 3 || len(b) != len(in) - binary::uvarint_len(want[0]) - binary::uvarint_len(want[1]) - binary::uvarint_len(want[2])) {
+        t.errorf("into 3: decoded %d, %d bytes left", n, len(b));
+    }
+
+    // truncated input
+    str truncated = "\x01\x02\x03\x04\x05\x06\x07\x08\x09\x80";
+    b = truncated;
+    bool eof = false;
+    n = binary::decode_uvarints(&b, got, [&](Error &e) {
+        eof = e.is<io::ErrUnexpectedEOF>();
+    });
+    if (n != 9 || !eof || b != "\x80") {
+        t.errorf("truncated: decoded %d, eof %v, left %q", n, eof, b);
+    }
+
+    // overflow, after a value read on the fast path
+    str overflow = "\x05\xff\xff\xff\xff\xff\xff\xff\xff\xff\x7f\x01";
+    b = overflow;
+    bool overflowed = false;
+    n = binary::decode_uvarints(&b, got, [&](Error &e) {
+        overflowed = e.is<binary::ErrOverflow>();
+    });
+    if (n != 1 || got[0] != 5 || !overflowed || len(b) != len(overflow) - 1) {
+        t.errorf("overflow: decoded %d, overflowed %v, %d bytes left", n, overflowed, len(b));
+    }
+}
+
+void benchmark_put_uvarint(B &b) {
+    byte buf[binary::MaxVarintLen64];
+    for (int i = 0; i < b.n; i++) {
+        for (uint j = 0; j < 10; j++) {
+            binary::put_uvarint(buf, 1ULL << (j * 7));
+        }
+    }
+}
+
+void benchmark_uvarint(B &b) {
+    String in;
+    for (uint j = 0; j < 10; j++) {
+        binary::append_uvarint(in, 1ULL << (j * 7));
+    }
+    for (int i = 0; i < b.n; i++) {
+        str s = in;
+        while (len(s) > 0) {
+            int n = 0;
+            binary::uvarint(s, n);
+            s = s(n);
+        }
+    }
+}
+
+void benchmark_decode_uvarints(B &b) {
+    String in;
+    for (uint j = 0; j < 1000; j++) {
+        binary::append_uvarint(in, uint64(j) * j);
+    }
+    std::vector<uint64> out(1000);
+    for (int i = 0; i < b.n; i++) {
+        str s = in;
+        binary::decode_uvarints(&s, out, error::panic);
+    }
+}
@@ -2,6 +2,7 @@
 #include <limits>
 #include <type_traits>
 #include "lib/io/io.h"
+#include "lib/io/pool.h"
 #include "lib/strconv/ftoa.h"
 #include "lib/types.h"
 #include "lib/utf8/decode.h"
@@ -588,6 +589,51 @@ void Fmt::write_padded(str s){
     }
 }
 
+namespace {
+    // Scratch collects the output of a WriterTo that has to be measured
+    // before it is written. It starts in an inline buffer and moves to a
+    // pooled one if that is too small.
+    struct Scratch : io::Writer {
+        byte  small[256];
+        byte *data = small;
+        size  n    = 0;
+        size  cap  = sizeof small;
+
+        Scratch() {}
+        Scratch(Scratch const&) = delete;
+
+        ~Scratch() {
+            if (data != small) {
+                io::pool::put(data, cap);
+            }
+        }
+
+        size direct_write(str s, error) override {
+            if (len(s) > cap - n) {
+                grow(n + len(s));
+            }
+            memcpy(data + n, s.data, s.len);
+            n += len(s);
+            return len(s);
+        }
+
+        void grow(size need) {
+            size newcap = io::pool::class_size(std::max(need, cap*2));
+            byte *newdata = io::pool::get(newcap);
+            memcpy(newdata, data, n);
+            if (data != small) {
+                io::pool::put(data, cap);
+            }
+            data = newdata;
+            cap = newcap;
+        }
+
+        str bytes() const {
+            return str(data, n);
+        }
+    } ;
+}
+
 void Fmt::write_padded(io::WriterTo const& writable) {
     Fmt &f = *this;
     if (f.wid == 0) {
@@ -598,13 +644,10 @@ void Fmt::write_padded(io::WriterTo const& writable) {
     bool left = !f.minus;
 
     if (left) {
-        size runecount = utf8::rune_count(writable);
-        size padamt = f.wid - runecount;
-        if (padamt > 0) {
-            char padchar = f.zero ? '0' : ' ';
-            f.out.write_repeated(padchar, padamt, f.err);
-        }
-        writable.write_to(f.out, f.err);
+        // the padding goes first, so render once and measure the result
+        Scratch scratch;
+        writable.write_to(scratch, f.err);
+        write_padded(scratch.bytes());
     } else {
         utf8::RuneCountingForwarder counter(f.out);
         writable.write_to(counter, f.err);
@@ -1157,3 +1200,16 @@ io::ReadResult BufferedWriter::direct_read(buf bytes, error err) {
 size BufferedWriter::direct_write(str data, error err) {
     return this->out.direct_write(data, err);
 }
+
+WriterStreambuf::int_type WriterStreambuf::overflow(int_type c) {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+    out.write_byte(byte(c), err);
+    return c;
+}
+
+std::streamsize WriterStreambuf::xsputn(char const *s, std::streamsize n) {
+    out.write(str(s, n), err);
+    return n;
+}
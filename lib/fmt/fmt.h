@@ -1,6 +1,7 @@
 #pragma once
 
-#include <sstream>
+#include <ostream>
+#include <streambuf>
 #include <tuple>
 #include <utility>
 #include <variant>
@@ -49,6 +50,64 @@ namespace lib::fmt {
     // String sprintf(str format, const Args & ... args);
 
 
+    // Counter is a Writer that discards its output and counts its length.
+    struct Counter : io::Writer {
+        size n = 0;
+
+        size direct_write(str data, error) override {
+            n += len(data);
+            return len(data);
+        }
+    } ;
+
+    // BufWriter is a Writer that fills a caller's buffer. Output past the end
+    // of the buffer is dropped but still counted in n.
+    struct BufWriter : io::Writer {
+        buf  b;
+        size n = 0;
+
+        BufWriter(buf b) : b(b) {}
+
+        size direct_write(str data, error) override {
+            if (n < len(b)) {
+                copy(b.slice(n), data);
+            }
+            n += len(data);
+            return len(data);
+        }
+    } ;
+
+    // WriterStreambuf is a std::streambuf that writes to an io::Writer. It
+    // has no buffer of its own, relying on out's, so that a type with only an
+    // operator<< is printed without a stringstream or an allocation.
+    struct WriterStreambuf : std::streambuf {
+        io::Writer &out;
+        error       err;
+
+        WriterStreambuf(io::Writer &out, error err) : out(out), err(err) {}
+
+      protected:
+        int_type        overflow(int_type c) override;
+        std::streamsize xsputn(char const *s, std::streamsize n) override;
+    } ;
+
+    struct Fmt;
+
+    // Formatter can be specialized to print a type that can't be given an fmt
+    // method, nor an fmt_write function in its own namespace:
+    //
+    //     template <>
+    //     struct lib::fmt::Formatter<vendor::Point> {
+    //         static void write(Fmt &f, vendor::Point const &p) {
+    //             f.write(p.x);
+    //             ...
+    //         }
+    //     } ;
+    //
+    // The verb, width and flags of the value are in f, already parsed.
+    template <typename T>
+    struct Formatter {} ;
+
     // stringifier
     template <typename T>
     struct Stringifier final : io::WriterTo  {
@@ -57,10 +116,10 @@ namespace lib::fmt {
 
         void write_to(io::Writer &out, error) const override;
 
+        size size_hint() const override;
+
         operator String() {
-            io::Buffer buffer;
-            write_to(buffer, error::ignore);
-            return buffer.to_string();
+            return String(static_cast<io::WriterTo const&>(*this));
        }
     };
 
@@ -137,6 +196,22 @@ namespace lib::fmt {
         template <typename T>
         void fmt_integer(T n, bool is_signed, int base, char verb, str digits, bool sharp);
 
+        // write prints a value of any other type, using the first of these
+        // that T provides:
+        //
+        //   1. c_str(), printed as a C string
+        //   2. a method fmt(io::Writer&, error) const, printed with padding
+        //   3. a method fmt(Fmt&) const
+        //   4. a specialization of Formatter<T>, called as Formatter<T>::write(*this, t)
+        //   5. a function fmt_write(Fmt&, T const&), found by argument-dependent lookup
+        //   6. toUtf8()
+        //   7. begin() and end(), printed as [a, b, c]
+        //   8. operator<<(std::ostream&, T const&), streamed into out through a
+        //      WriterStreambuf and printed with padding
+        //   9. a pointer, printing what it points to
+        //  10. a std::variant, printing its value
+        //
+        // and otherwise prints the name of T in angle brackets.
         template <typename T>
         void write(T const &t, ...) {
             constexpr bool is_c_str = requires {
@@ -171,6 +246,22 @@ namespace lib::fmt {
                 return;
             }
 
+            constexpr bool has_formatter = requires {
+                Formatter<T>::write(*this, t);
+            };
+            if constexpr (has_formatter) {
+                Formatter<T>::write(*this, t);
+                return;
+            }
+
+            constexpr bool has_fmt_write = requires {
+                fmt_write(*this, t);
+            };
+            if constexpr (has_fmt_write) {
+                fmt_write(*this, t);
+                return;
+            }
+
             // constexpr bool is_describable = requires {
             //     t.describe(std::declval<io::OStream&>);
             // };
@@ -221,14 +312,22 @@ namespace lib::fmt {
                 return;
             }
             
-            constexpr bool ostream_printable = requires {
-                { std::declval<std::stringstream>() << t } -> std::same_as<std::stringstream&>;
+            constexpr bool ostream_printable = requires(std::ostream &os) {
+                { os << t } -> std::convertible_to<std::ostream&>;
             };
             if constexpr (ostream_printable) {
-                std::stringstream ss;
-                ss << t;
-                write("(ss)");
-                write(ss.str());
+                struct OstreamWriterTo : io::WriterTo {
+                    const T &obj;
+                    OstreamWriterTo(T const& t) : obj(t) {}
+
+                    void write_to(io::Writer &w, error err) const override {
+                        WriterStreambuf sb(w, err);
+                        std::ostream os(&sb);
+                        os << obj;
+                    }
+                };
+                OstreamWriterTo w(t);
+                write((io::WriterTo &) w);
                 return;
             }
 
@@ -341,6 +440,13 @@ namespace lib::fmt {
         fmt::write(out, t, err);
     }
 
+    template <typename T>
+    size Stringifier<T>::size_hint() const {
+        Counter c;
+        fmt::write(c, t, error::ignore);
+        return c.n;
+    }
+
     template <typename T>
     void write(io::Writer &out, T const &t, error err) {
         Fmt fmt(out, err);
@@ -485,6 +591,26 @@ namespace lib::fmt {
         }
     }
 
+    // formatted_size returns the number of bytes fprintf writes for format and
+    // args, without allocating.
+    template <typename... Args>
+    size formatted_size(str format, const Args & ... args) {
+        Counter c;
+        fprintf(c, error::ignore, format, args...);
+        return c.n;
+    }
+
+    // format_to formats into b and returns the length of the complete output.
+    // If that is more than len(b), b holds the first len(b) bytes of it and
+    // the call can be repeated with a buffer of the returned size, as with
+    // snprintf.
+    template <typename... Args>
+    size format_to(buf b, str format, const Args & ... args) {
+        BufWriter w(b);
+        fprintf(w, error::ignore, format, args...);
+        return w.n;
+    }
+
     template <typename... Args>
     struct FmtWriterTo : io::WriterTo {
         str format;
@@ -501,6 +627,14 @@ namespace lib::fmt {
                 std::make_index_sequence< 
                     std::tuple_size_v<std::tuple<Args...>>>());
         }
+
+        // size_hint formats once into a Counter, so that String(sprintf(...))
+        // allocates exactly once instead of growing a buffer.
+        size size_hint() const override {
+            Counter c;
+            write_to(c, error::ignore);
+            return c.n;
+        }
     } ;
 
     template<typename... Args>
@@ -622,3 +756,5 @@ namespace lib {
 
 //#include "fmt.inlines.h"
 
+#include "format_string.h"
+
@@ -1,4 +1,6 @@
+#include <ostream>
 #include <variant>
+#include <vector>
 
 #include "fmt.h"
 #include "lib/math/bits.h"
@@ -12,6 +14,55 @@
 using namespace lib;
 using namespace lib::fmt;
 
+namespace vendor {
+	// Streamed can only be printed with operator<<.
+	struct Streamed {
+		int id;
+	};
+
+	std::ostream &operator<<(std::ostream &os, Streamed const &s) {
+		return os << "streamed#" << s.id;
+	}
+
+	// Adl is printed by an fmt_write found by argument-dependent lookup.
+	struct Adl {
+		int id;
+	};
+
+	void fmt_write(Fmt &f, Adl const &a) {
+		f.write("adl#");
+		f.write(a.id);
+	}
+
+	// Ranked has every kind of hook but a member, to check their order.
+	struct Ranked {};
+
+	std::ostream &operator<<(std::ostream &os, Ranked const &) {
+		return os << "ostream";
+	}
+
+	void fmt_write(Fmt &f, Ranked const &) {
+		f.write("fmt_write");
+	}
+
+	struct Member {
+		void fmt(io::Writer &out, error err) const {
+			out.write("member", err);
+		}
+	};
+
+	void fmt_write(Fmt &f, Member const &) {
+		f.write("fmt_write");
+	}
+}
+
+template <>
+struct lib::fmt::Formatter<vendor::Ranked> {
+	static void write(Fmt &f, vendor::Ranked const &) {
+		f.write("formatter");
+	}
+};
+
 const float64 NaN = math::nan();
 const float64 posInf = math::inf(1);
 const float64 negInf = math::inf(-1);
@@ -1398,4 +1449,178 @@ void benchmark_sprintf_int_large(testing::B &b) {
 // 		buf.Reset()
 // 		Fprint(&buf, x)
 // 	}
-// }
\ No newline at end of file
+// }
+// checked_sprintf takes its format the way a logging wrapper would, so the
+// literals below are parsed and checked at compile time.
+template <typename... Args>
+static String checked_sprintf(format_string<std::type_identity_t<Args>...> format, Args const &...args) {
+	return sprintf(format, args...);
+}
+
+void test_format_string(testing::T &t) {
+	struct {
+		String got;
+		String want;
+	} tests[] = {
+		{checked_sprintf("plain"), fmt::sprintf("plain")},
+		{checked_sprintf("%d", 12345), fmt::sprintf("%d", 12345)},
+		{checked_sprintf("[%5d|%-5d|%05d]", 42, 42, 42), fmt::sprintf("[%5d|%-5d|%05d]", 42, 42, 42)},
+		{checked_sprintf("%x %X %#x %o %b", 255, 255, 255, 8, 5), fmt::sprintf("%x %X %#x %o %b", 255, 255, 255, 8, 5)},
+		{checked_sprintf("%+d % d", 7, 7), fmt::sprintf("%+d % d", 7, 7)},
+		{checked_sprintf("%s=%q;", "key", "val"), fmt::sprintf("%s=%q;", "key", "val")},
+		{checked_sprintf("%.2s|%6s|%-6s|", "abcdef", "ab", "ab"), fmt::sprintf("%.2s|%6s|%-6s|", "abcdef", "ab", "ab")},
+		{checked_sprintf("%.3f %e %g %v", 3.14159, 1234.5, 0.5, 2.5), fmt::sprintf("%.3f %e %g %v", 3.14159, 1234.5, 0.5, 2.5)},
+		{checked_sprintf("%*d|%-*d|%.*f", 6, 1, 6, 1, 2, 3.14159), fmt::sprintf("%*d|%-*d|%.*f", 6, 1, 6, 1, 2, 3.14159)},
+		{checked_sprintf("%t %v", true, false), fmt::sprintf("%t %v", true, false)},
+		{checked_sprintf("%c%c %U", 'o', 'k', 0x1F600), fmt::sprintf("%c%c %U", 'o', 'k', 0x1F600)},
+		{checked_sprintf("%v and %#v", String("a\tb"), String("a\tb")), fmt::sprintf("%v and %#v", String("a\tb"), String("a\tb"))},
+	};
+
+	int i = 0;
+	for (auto const &tt : tests) {
+		if (tt.got != tt.want) {
+			t.errorf("#%d: got %q; want %q", i, tt.got, tt.want);
+		}
+		i++;
+	}
+}
+
+void benchmark_sprintf_format_string(testing::B &b) {
+	io::Buffer buf;
+	for (int i = 0; i < b.n; i++) {
+		buf.reset();
+		fprintf(buf, format_string<int, int, int, str, str>("%2d/%2d/%2d %s %s\n"), 3, 4, 5, "hello", "world");
+	}
+}
+
+void benchmark_sprintf_runtime_format(testing::B &b) {
+	io::Buffer buf;
+	for (int i = 0; i < b.n; i++) {
+		buf.reset();
+		fprintf(buf, "%2d/%2d/%2d %s %s\n", 3, 4, 5, "hello", "world");
+	}
+}
+
+void test_format_to(testing::T &t) {
+	str want = "key:0042/label";
+
+	if (size n = formatted_size("key:%04d/%s", 42, "label"); n != len(want)) {
+		t.errorf("formatted_size = %d; want %d", n, len(want));
+	}
+	if (size n = formatted_size(format_string<int, str>("key:%04d/%s"), 42, "label"); n != len(want)) {
+		t.errorf("formatted_size(format_string) = %d; want %d", n, len(want));
+	}
+
+	byte data[32];
+	buf b(data, sizeof data);
+	size n = format_to(b, "key:%04d/%s", 42, "label");
+	if (n != len(want) || str(b[0, n]) != want) {
+		t.errorf("format_to = %d, %q; want %d, %q", n, str(b[0, min(n, len(b))]), len(want), want);
+	}
+
+	// a short buffer gets a prefix of the output and the full length
+	std::fill(data, data + sizeof data, 'x');
+	buf small(data, 5);
+	n = format_to(small, "key:%04d/%s", 42, "label");
+	if (n != len(want) || str(small) != want[0, 5] || data[5] != 'x') {
+		t.errorf("format_to(short) = %d, %q; want %d, %q", n, str(small), len(want), want[0, 5]);
+	}
+
+	n = format_to(buf(), "key:%04d/%s", 42, "label");
+	if (n != len(want)) {
+		t.errorf("format_to(empty) = %d; want %d", n, len(want));
+	}
+
+	// String(sprintf(...)) allocates size_hint bytes up front
+	auto w = sprintf("key:%04d/%s", 42, "label");
+	if (size hint = w.size_hint(); hint != len(want)) {
+		t.errorf("sprintf size_hint = %d; want %d", hint, len(want));
+	}
+	if (String s = w; s != want) {
+		t.errorf("sprintf = %q; want %q", s, want);
+	}
+
+	String appended = "a/";
+	appended += sprintf("%d", 1234);
+	if (appended != "a/1234") {
+		t.errorf("appended = %q; want %q", appended, "a/1234");
+	}
+}
+
+void benchmark_sprintf_key(testing::B &b) {
+	b.run_parallel([&](testing::PB &pb) {
+		while (pb.next()) {
+			String s = sprintf("user:%d:session:%s", 123456, "abcdefghijklmnop");
+		}
+	});
+}
+
+void benchmark_format_to_key(testing::B &b) {
+	b.run_parallel([&](testing::PB &pb) {
+		byte data[64];
+		while (pb.next()) {
+			format_to(buf(data, sizeof data), "user:%d:session:%s", 123456, "abcdefghijklmnop");
+		}
+	});
+}
+
+void test_padded_writer_to(testing::T &t) {
+	String long_value = strings::repeat("ab☺", 200);
+
+	struct {
+		String got;
+		String want;
+	} tests[] = {
+		{sprintf("[%8v]", sprint("x☺y")), "[     x☺y]"},
+		{sprintf("[%-8v]", sprint("x☺y")), "[x☺y     ]"},
+		{sprintf("[%08v]", sprint("42")), "[00000042]"},
+		{sprintf("[%2v]", sprint("toolong")), "[toolong]"},
+		{sprintf("[%601v]", sprint(long_value)), String("[ ") + long_value + "]"},
+	};
+
+	int i = 0;
+	for (auto const &tt : tests) {
+		if (tt.got != tt.want) {
+			t.errorf("#%d: got %q; want %q", i, tt.got, tt.want);
+		}
+		i++;
+	}
+}
+
+void benchmark_sprintf_padded_writer_to(testing::B &b) {
+	b.run_parallel([&](testing::PB &pb) {
+		while (pb.next()) {
+			String s = sprintf("%40v", sprint("connection refused: ", 111));
+		}
+	});
+}
+
+void test_extension_points(testing::T &t) {
+	struct {
+		String got;
+		String want;
+	} tests[] = {
+		{sprintf("%v", vendor::Streamed{7}), "streamed#7"},
+		{sprintf("[%12v]", vendor::Streamed{7}), "[  streamed#7]"},
+		{sprintf("[%-12v]", vendor::Streamed{7}), "[streamed#7  ]"},
+		{sprintf("%v", vendor::Adl{3}), "adl#3"},
+		{sprintf("%v", std::vector<vendor::Adl>{{1}, {2}}), "[adl#1, adl#2]"},
+		{sprintf("%v", vendor::Ranked{}), "formatter"},
+		{sprintf("%v", vendor::Member{}), "member"},
+	};
+
+	int i = 0;
+	for (auto const &tt : tests) {
+		if (tt.got != tt.want) {
+			t.errorf("#%d: got %q; want %q", i, tt.got, tt.want);
+		}
+		i++;
+	}
+}
+
+void benchmark_sprintf_ostream(testing::B &b) {
+	char buf[64];
+	for (int i = 0; i < b.n; i++) {
+		format_to(lib::buf((byte*) buf, sizeof buf), "%v", vendor::Streamed{i});
+	}
+}
@@ -0,0 +1,370 @@
+#pragma once
+
+#include <array>
+#include <type_traits>
+
+#include "fmt.h"
+
+// format_string is a format string parsed and checked at compile time.
+//
+// fmt::printf and friends parse their format string every time they are
+// called, and report a missing or extra argument by writing "%!v(!)" or
+// "<!>" into the output. A format_string<Args...> is built by a consteval
+// constructor instead: it splits the format into literal chunks and verb
+// specs while compiling, and a format that doesn't fit Args, by count or by
+// verb, is a compile error. Formatting then makes one Fmt::write call per
+// argument with nothing left to parse.
+//
+// It is opt-in. Functions that take a format from their callers declare the
+// parameter as a format_string, and the literals passed to them are checked:
+//
+//     template <typename... Args>
+//     void logf(fmt::format_string<std::type_identity_t<Args>...> format, Args const &...args) {
+//         fmt::fprintf(log_writer, format, args...);
+//     }
+//
+//     logf("%s %d %.3fms\n", path, status, elapsed);  // checked while compiling
+//
+// A format can also be checked in place with
+// fmt::printf(fmt::format_string<int>("%d\n"), n).
+//
+// The verbs accepted for each kind of argument are those Fmt implements:
+//
+//     integers and characters   v d b o O x X c q U, and * for a width or precision
+//     floating point            v b e E f F g G x X
+//     bool                      v t
+//     strings and WriterTo      v s q x X
+//
+// Other types are formatted by their fmt method, which may accept any verb,
+// so only the count is checked for them. "%%" is not supported, as in the
+// runtime parser.
+
+namespace lib::fmt {
+
+    namespace internal {
+
+        enum class ArgKind : uint8 {
+            Int,
+            Float,
+            Bool,
+            Str,
+            Other,
+        } ;
+
+        template <typename T>
+        consteval ArgKind arg_kind() {
+            using U = std::remove_cvref_t<T>;
+            using E = std::remove_cv_t<std::remove_pointer_t<std::decay_t<U>>>;
+            constexpr bool char_ptr = std::is_pointer_v<std::decay_t<U>> &&
+                (std::is_same_v<E, char> || std::is_same_v<E, wchar_t>);
+
+            if constexpr (std::is_same_v<U, bool>) {
+                return ArgKind::Bool;
+            } else if constexpr (std::is_integral_v<U>) {
+                return ArgKind::Int;
+            } else if constexpr (std::is_floating_point_v<U>) {
+                return ArgKind::Float;
+            } else if constexpr (char_ptr || std::is_convertible_v<U const&, str> ||
+                                 std::is_base_of_v<io::WriterTo, U>) {
+                return ArgKind::Str;
+            } else {
+                return ArgKind::Other;
+            }
+        }
+
+        // Spec is one verb of a format string, with its flags, width and
+        // precision.
+        struct Spec {
+            rune verb = 'v';
+            int  wid  = 0;
+            int  prec = 0;
+            int  base = 10;
+
+            // reset is false for the part of a directive that follows a '*',
+            // which keeps the width or precision the '*' argument set
+            bool reset = true;
+            bool flags = false;  // any of the flags below is set
+
+            bool wid_present  = false;
+            bool prec_present = false;
+            bool minus = false;
+            bool plus  = false;
+            bool zero  = false;
+            bool sharp = false;
+            bool space = false;
+        } ;
+
+        // Chunk is a literal part of a format string.
+        struct Chunk {
+            size off = 0;
+            size len = 0;
+        } ;
+
+        // Calling these while parsing makes the consteval constructor fail;
+        // the name of the function shows up in the compiler's message.
+        void format_error_too_few_arguments();
+        void format_error_too_many_arguments();
+        void format_error_missing_verb();
+        void format_error_bad_verb();
+        void format_error_verb_does_not_match_argument_type();
+        void format_error_star_needs_integer_argument();
+
+        consteval bool has_verb(const char *verbs, char c) {
+            for (; *verbs; verbs++) {
+                if (*verbs == c) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        consteval bool verb_ok(ArgKind kind, char verb) {
+            switch (kind) {
+                case ArgKind::Int:   return has_verb("vdboOxXcqU", verb);
+                case ArgKind::Float: return has_verb("vbeEfFgGxX", verb);
+                case ArgKind::Bool:  return has_verb("vt", verb);
+                case ArgKind::Str:   return has_verb("vsqxX", verb);
+                case ArgKind::Other: return true;
+            }
+            return false;
+        }
+
+        // parse splits format the way State::advance walks it: lits[i] is
+        // the literal before specs[i] and lits[nargs] is the tail.
+        consteval void parse(const char *format, size n, Spec *specs, Chunk *lits, ArgKind const *kinds, size nargs) {
+            size k = 0;
+            size start = 0;
+            size i = 0;
+
+            while (i < n) {
+                if (format[i] != '%') {
+                    i++;
+                    continue;
+                }
+
+                if (k == nargs) {
+                    format_error_too_few_arguments();
+                }
+                lits[k] = Chunk{start, i - start};
+                i++;
+
+                Spec spec;
+                for (;;) {
+                    if (i == n) {
+                        format_error_missing_verb();
+                    }
+
+                    char c = format[i];
+                    switch (c) {
+                        case '#': spec.sharp = spec.flags = true; i++; continue;
+                        case '0': spec.zero  = spec.flags = true; i++; continue;
+                        case '+': spec.plus  = spec.flags = true; i++; continue;
+                        case '-': spec.minus = spec.flags = true; i++; continue;
+                        case ' ': spec.space = spec.flags = true; i++; continue;
+
+                        case '.':
+                            spec.prec_present = true;
+                            i++;
+                            while (i < n && '0' <= format[i] && format[i] <= '9') {
+                                spec.prec = spec.prec*10 + (format[i] - '0');
+                                i++;
+                            }
+                            continue;
+
+                        case '*':
+                            if (kinds[k] != ArgKind::Int) {
+                                format_error_star_needs_integer_argument();
+                            }
+                            spec.verb = '*';
+                            specs[k++] = spec;
+                            if (k == nargs) {
+                                format_error_too_few_arguments();
+                            }
+                            lits[k] = Chunk{i + 1, 0};
+                            spec = Spec{.reset = false};
+                            i++;
+                            continue;
+                    }
+
+                    if ('1' <= c && c <= '9') {
+                        spec.wid_present = true;
+                        while (i < n && '0' <= format[i] && format[i] <= '9') {
+                            spec.wid = spec.wid*10 + (format[i] - '0');
+                            i++;
+                        }
+                        continue;
+                    }
+
+                    if (!(('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z'))) {
+                        format_error_bad_verb();
+                    }
+                    if (!verb_ok(kinds[k], c)) {
+                        format_error_verb_does_not_match_argument_type();
+                    }
+
+                    spec.verb = c;
+                    if (c == 'x') {
+                        spec.base = 16;
+                    }
+                    specs[k++] = spec;
+                    i++;
+                    break;
+                }
+
+                start = i;
+            }
+
+            if (k != nargs) {
+                format_error_too_many_arguments();
+            }
+            lits[nargs] = Chunk{start, n - start};
+        }
+
+        // apply sets up f for spec, as State::advance does for the
+        // directive it has just parsed.
+        inline void apply(Fmt &f, Spec const &spec) {
+            if (spec.reset) {
+                f.wid   = spec.wid;
+                f.prec  = spec.prec;
+                f.base  = spec.base;
+                f.flags = 0;
+                f.wid_present  = spec.wid_present;
+                f.prec_present = spec.prec_present;
+            } else {
+                if (spec.wid_present) {
+                    f.wid = spec.wid;
+                    f.wid_present = true;
+                }
+                if (spec.prec_present) {
+                    f.prec = spec.prec;
+                    f.prec_present = true;
+                }
+                if (spec.base != 10) {
+                    f.base = spec.base;
+                }
+            }
+
+            if (spec.flags) {
+                f.minus = f.minus || spec.minus;
+                f.plus  = f.plus  || spec.plus;
+                f.zero  = f.zero  || spec.zero;
+                f.sharp = f.sharp || spec.sharp;
+                f.space = f.space || spec.space;
+            }
+
+            f.verb = spec.verb;
+            if (spec.verb == 'v') {
+                f.sharp_v = f.sharp;
+                f.sharp = false;
+                f.plus_v = f.plus;
+                f.plus = false;
+            }
+        }
+    }
+
+    template <typename... Args>
+    struct format_string {
+        const char *data = nil;
+        size        length = 0;
+
+        std::array<internal::Spec, sizeof...(Args)>      specs {};
+        std::array<internal::Chunk, sizeof...(Args) + 1> lits {};
+
+        template <size N>
+        consteval format_string(const char (&format)[N]) : data(format), length(N - 1) {
+            // one extra so that the array is never empty
+            constexpr internal::ArgKind kinds[] = {internal::arg_kind<Args>()..., internal::ArgKind::Other};
+            internal::parse(format, N - 1, specs.data(), lits.data(), kinds, sizeof...(Args));
+        }
+
+        // get returns the format string itself.
+        str get() const {
+            return str(data, length);
+        }
+
+        void write(io::Writer &out, error err, Args const &...args) const {
+            Fmt f(out, err);
+            size i = 0;
+            auto arg = [&](auto const &a) {
+                internal::Chunk c = lits[i];
+                if (c.len > 0) {
+                    out.write(str(data + c.off, c.len), err);
+                }
+                internal::apply(f, specs[i]);
+                f.write(a);
+                i++;
+            };
+            (arg(args), ...);
+
+            internal::Chunk tail = lits[sizeof...(Args)];
+            if (tail.len > 0) {
+                out.write(str(data + tail.off, tail.len), err);
+            }
+        }
+    } ;
+
+    // The overloads below take a format_string by deduction, so a plain
+    // string literal never matches them and keeps going to the str
+    // overloads.
+
+    template <typename... F, typename... Args>
+        requires (sizeof...(F) == sizeof...(Args))
+    void fprintf(io::Writer &out, error err, format_string<F...> const &format, Args const &...args) {
+        format.write(out, err, args...);
+    }
+
+    template <typename... F, typename... Args>
+        requires (sizeof...(F) == sizeof...(Args))
+    void fprintf(io::Writer &out, format_string<F...> const &format, Args const &...args) {
+        format.write(out, error::ignore, args...);
+    }
+
+    template <typename... F, typename... Args>
+        requires (sizeof...(F) == sizeof...(Args))
+    void printf(format_string<F...> const &format, Args const &...args) {
+        BufferedWriter bw(os::stdout);
+        format.write(bw, error::ignore, args...);
+        bw.flush(error::ignore);
+    }
+
+    template <typename... F, typename... Args>
+        requires (sizeof...(F) == sizeof...(Args))
+    size formatted_size(format_string<F...> const &format, Args const &...args) {
+        Counter c;
+        format.write(c, error::ignore, args...);
+        return c.n;
+    }
+
+    template <typename... F, typename... Args>
+        requires (sizeof...(F) == sizeof...(Args))
+    size format_to(buf b, format_string<F...> const &format, Args const &...args) {
+        BufWriter w(b);
+        format.write(w, error::ignore, args...);
+        return w.n;
+    }
+
+    template <typename... F>
+    struct FormatWriterTo : io::WriterTo {
+        format_string<F...>      format;
+        std::tuple<const F*...>  args;
+
+        FormatWriterTo(format_string<F...> const &format, F const &...args) : format(format), args(&args...) {}
+
+        void write_to(io::Writer &out, error err) const override {
+            std::apply([&](auto const *...a) {
+                format.write(out, err, *a...);
+            }, args);
+        }
+
+        size size_hint() const override {
+            Counter c;
+            write_to(c, error::ignore);
+            return c.n;
+        }
+    } ;
+
+    template <typename... F>
+    FormatWriterTo<F...> sprintf(format_string<F...> const &format, std::type_identity_t<F> const &...args) {
+        return FormatWriterTo<F...>(format, args...);
+    }
+}
@@ -0,0 +1,748 @@
+#include "scan.h"
+
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+#include "lib/io/util.h"
+#include "lib/strconv/atoi.h"
+#include "lib/utf8/decode.h"
+#include "lib/utf8/encode.h"
+#include "lib/utf8/utf8.h"
+
+using namespace lib;
+using namespace fmt;
+using internal::ScanArg;
+using internal::Spec;
+
+void ScanError::fmt(io::Writer &out, error err) const {
+    if (arg >= 0) {
+        fmt::fprintf(out, err, "scan: %s (argument %d)", msg, arg);
+    } else {
+        fmt::fprintf(out, err, "scan: %s", msg);
+    }
+}
+
+namespace {
+    bool is_space(int c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    int lower(int c) {
+        return c | 0x20;
+    }
+
+    // Scanner reads input a byte at a time from a window of unread bytes:
+    // the whole input for a str, or the read buffer of a reader. A token is
+    // a run of the window; a token that reaches past the window is gathered
+    // into scratch while the window is refilled.
+    struct Scanner {
+        io::Reader *r = nil;
+        str         window;
+        size        pos = 0;
+        bool        eof = false;
+
+        bool        in_token = false;
+        size        tok_start = 0;
+        lib::String scratch;
+
+        error err;
+        bool  failed = false;
+        size  arg = -1;  // the argument being scanned, for errors
+
+        Scanner(internal::Input in, error err) : r(in.r), window(in.s), err(err) {
+            eof = r == nil;
+        }
+
+        ~Scanner() {
+            commit();
+        }
+
+        // fail reports a ScanError, once.
+        void fail(str msg) {
+            if (!failed) {
+                failed = true;
+                err(ScanError(msg, arg));
+            }
+        }
+
+        // fail_eof reports input that ends before the format does.
+        void fail_eof() {
+            if (!failed) {
+                failed = true;
+                err(io::ErrUnexpectedEOF());
+            }
+        }
+
+        // commit consumes what has been read from a reader.
+        void commit() {
+            if (r != nil && pos > 0) {
+                r->skip(pos, error::ignore);
+                window = window(pos);
+                pos = 0;
+                tok_start = 0;
+            }
+        }
+
+        bool refill() {
+            if (eof) {
+                return false;
+            }
+            if (in_token) {
+                scratch += window[tok_start, pos];
+            }
+            commit();
+
+            window = r->peek_buffered([&](Error &e) {
+                failed = true;
+                err(e);
+            });
+            pos = 0;
+            tok_start = 0;
+            if (len(window) == 0) {
+                eof = true;
+                return false;
+            }
+            return true;
+        }
+
+        // peek returns the next byte, or -1 at the end of the input.
+        int peek() {
+            if (pos == len(window) && !refill()) {
+                return -1;
+            }
+            return byte(window.data[pos]);
+        }
+
+        void advance() {
+            pos++;
+        }
+
+        // accept consumes the next byte if it is one of chars.
+        bool accept(str chars) {
+            int c = peek();
+            if (c < 0) {
+                return false;
+            }
+            for (char x : chars) {
+                if (byte(x) == c) {
+                    advance();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void begin_token() {
+            in_token = true;
+            tok_start = pos;
+            scratch.length = 0;
+        }
+
+        // end_token returns the bytes read since begin_token. It is valid
+        // until the next peek.
+        str end_token() {
+            in_token = false;
+            if (len(scratch) > 0) {
+                scratch += window[tok_start, pos];
+                return scratch;
+            }
+            return window[tok_start, pos];
+        }
+
+        void skip_space(bool newlines) {
+            for (;;) {
+                int c = peek();
+                if (!(is_space(c) || (newlines && c == '\n'))) {
+                    return;
+                }
+                advance();
+            }
+        }
+
+        // read_rune reads one rune, or returns -1 at the end of the input.
+        // An invalid sequence reads as one RuneError: a byte that can't
+        // start a rune, or the longest prefix of a rune that the input
+        // doesn't complete. The byte after such a prefix is left unread, so
+        // nothing is ever given back, even across a refill.
+        rune read_rune() {
+            int c = peek();
+            if (c < 0) {
+                return -1;
+            }
+            if (c < utf8::RuneSelf) {
+                advance();
+                return c;
+            }
+
+            byte b[utf8::UTFMax];
+            int n = 0;
+            for (;;) {
+                c = peek();
+                if (c < 0) {
+                    // the input ends inside the rune
+                    return utf8::RuneError;
+                }
+                b[n] = byte(c);
+                if (!utf8::full_rune(str(b, n + 1))) {
+                    advance();
+                    n++;
+                    continue;
+                }
+
+                int size = 0;
+                rune ru = utf8::decode_rune(str(b, n + 1), size);
+                if (size == n + 1) {
+                    advance();
+                    return ru;
+                }
+                // c doesn't continue the rune
+                return utf8::RuneError;
+            }
+        }
+
+        // accept_digits consumes digits of the given base, and underscores
+        // if underscore is set, up to max bytes in total. It returns whether
+        // any were consumed.
+        bool accept_digits(int base, bool underscore, size *max) {
+            bool any = false;
+            while (*max > 0) {
+                int c = peek();
+                int d = c >= '0' && c <= '9' ? c - '0' :
+                        lower(c) >= 'a' && lower(c) <= 'z' ? lower(c) - 'a' + 10 : 99;
+                if (!(d < base || (underscore && c == '_'))) {
+                    break;
+                }
+                advance();
+                (*max)--;
+                any = true;
+            }
+            return any;
+        }
+
+        bool scan_one(Spec const &spec, ScanArg const &a);
+        bool scan_int(Spec const &spec, ScanArg const &a, size max);
+        bool scan_float(ScanArg const &a, size max);
+        bool scan_bool(ScanArg const &a, size max);
+        bool scan_string(Spec const &spec, ScanArg const &a, size max);
+        bool scan_quoted(ScanArg const &a);
+
+        // match consumes input matching the literal part of a format.
+        bool match(str lit);
+    } ;
+
+    void store_int(ScanArg const &a, int64 v) {
+        switch (a.bits) {
+            case 8:  *(int8*)  a.ptr = int8(v);  break;
+            case 16: *(int16*) a.ptr = int16(v); break;
+            case 32: *(int32*) a.ptr = int32(v); break;
+            default: *(int64*) a.ptr = v;        break;
+        }
+    }
+
+    void store_uint(ScanArg const &a, uint64 v) {
+        switch (a.bits) {
+            case 8:  *(uint8*)  a.ptr = uint8(v);  break;
+            case 16: *(uint16*) a.ptr = uint16(v); break;
+            case 32: *(uint32*) a.ptr = uint32(v); break;
+            default: *(uint64*) a.ptr = v;         break;
+        }
+    }
+
+    void store_string(ScanArg const &a, str s) {
+        if (a.kind == ScanArg::Str) {
+            *(str*) a.ptr = s;
+        } else {
+            *(lib::String*) a.ptr = s;
+        }
+    }
+}
+
+bool Scanner::scan_int(Spec const &spec, ScanArg const &a, size max) {
+    if (spec.verb == 'c') {
+        rune ru = read_rune();
+        if (ru < 0) {
+            fail_eof();
+            return false;
+        }
+        if (a.kind == ScanArg::Int) {
+            store_int(a, ru);
+        } else {
+            store_uint(a, ru);
+        }
+        return true;
+    }
+
+    int base = 10;
+    switch (spec.verb) {
+        case 'd':
+        case 'v': base = 10; break;
+        case 'b': base = 2;  break;
+        case 'o': base = 8;  break;
+        case 'x':
+        case 'X': base = 16; break;
+        default:
+            fail("bad verb for integer");
+            return false;
+    }
+
+    skip_space(false);
+    begin_token();
+
+    bool sign = a.kind == ScanArg::Int ? accept("+-") : accept("+");
+    if (sign) {
+        max--;
+    }
+
+    // %v takes the base from a prefix
+    int parse_base = base;
+    if (spec.verb == 'v' && max > 0 && peek() == '0') {
+        advance();
+        max--;
+        parse_base = 0;
+        int c = lower(peek());
+        if (max > 0 && (c == 'b' || c == 'o' || c == 'x')) {
+            advance();
+            max--;
+            base = c == 'b' ? 2 : c == 'o' ? 8 : 16;
+        } else {
+            base = 8;
+        }
+        accept_digits(base, true, &max);
+    } else if (!accept_digits(base, false, &max)) {
+        end_token();
+        fail("expected integer");
+        return false;
+    }
+    str tok = end_token();
+
+    bool ok = true;
+    lib::error perr = [&](Error &e) {
+        ok = false;
+        if (!failed) {
+            failed = true;
+            err(e);
+        }
+    };
+    if (a.kind == ScanArg::Int) {
+        int64 v = strconv::parse_int(tok, parse_base, a.bits, perr);
+        if (ok) {
+            store_int(a, v);
+        }
+    } else {
+        uint64 v = strconv::parse_uint(tok, parse_base, a.bits, perr);
+        if (ok) {
+            store_uint(a, v);
+        }
+    }
+    return ok;
+}
+
+bool Scanner::scan_float(ScanArg const &a, size max) {
+    skip_space(false);
+    begin_token();
+
+    if (accept("+-")) {
+        max--;
+    }
+    size before = max;
+
+    int c = lower(peek());
+    if (c == 'i' || c == 'n') {
+        // inf, infinity or nan
+        while (max > 0 && lower(peek()) >= 'a' && lower(peek()) <= 'z') {
+            advance();
+            max--;
+        }
+    } else {
+        accept_digits(10, true, &max);
+        if (max > 0 && peek() == '.') {
+            advance();
+            max--;
+            accept_digits(10, true, &max);
+        }
+        if (max > 0 && lower(peek()) == 'e' && max != before) {
+            advance();
+            max--;
+            if (max > 0 && accept("+-")) {
+                max--;
+            }
+            accept_digits(10, false, &max);
+        }
+    }
+    str tok = end_token();
+
+    // from_chars takes neither a leading '+' nor underscores
+    char b[64];
+    size n = 0;
+    if (len(tok) > size(sizeof b)) {
+        fail("expected float");
+        return false;
+    }
+    for (size i = 0; i < len(tok); i++) {
+        if (tok[i] == '_' || (i == 0 && tok[i] == '+')) {
+            continue;
+        }
+        b[n++] = tok[i];
+    }
+
+    std::from_chars_result res;
+    if (a.kind == ScanArg::Float32) {
+        res = std::from_chars(b, b + n, *(float32*) a.ptr);
+    } else {
+        res = std::from_chars(b, b + n, *(float64*) a.ptr);
+    }
+
+    if (n == 0 || res.ec == std::errc::invalid_argument || res.ptr != b + n) {
+        fail("expected float");
+        return false;
+    }
+    if (res.ec == std::errc::result_out_of_range) {
+        if (!failed) {
+            failed = true;
+            err(strconv::NumError("parse_float", tok, strconv::ErrRange()));
+        }
+        return false;
+    }
+    return true;
+}
+
+bool Scanner::scan_bool(ScanArg const &a, size max) {
+    skip_space(false);
+    begin_token();
+    while (max > 0) {
+        int c = peek();
+        if (!(lower(c) >= 'a' && lower(c) <= 'z') && !(c >= '0' && c <= '9')) {
+            break;
+        }
+        advance();
+        max--;
+    }
+    str tok = end_token();
+
+    auto is = [&](str word) {
+        if (len(tok) != len(word)) {
+            return false;
+        }
+        for (size i = 0; i < len(tok); i++) {
+            if (lower(byte(tok[i])) != word[i]) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (is("true") || is("t") || is("1")) {
+        *(bool*) a.ptr = true;
+    } else if (is("false") || is("f") || is("0")) {
+        *(bool*) a.ptr = false;
+    } else {
+        fail("expected bool");
+        return false;
+    }
+    return true;
+}
+
+bool Scanner::scan_string(Spec const &spec, ScanArg const &a, size max) {
+    if (spec.verb == 'q') {
+        return scan_quoted(a);
+    }
+    if (spec.verb != 's' && spec.verb != 'v') {
+        fail("bad verb for string");
+        return false;
+    }
+
+    skip_space(false);
+    begin_token();
+    while (max > 0) {
+        int c = peek();
+        if (c < 0 || is_space(c) || c == '\n') {
+            break;
+        }
+        if (c < utf8::RuneSelf) {
+            advance();
+        } else {
+            read_rune();
+        }
+        max--;
+    }
+    str tok = end_token();
+    if (len(tok) == 0) {
+        fail("expected string");
+        return false;
+    }
+    store_string(a, tok);
+    return true;
+}
+
+// scan_quoted reads a backquoted string, or a double-quoted one with Go's
+// escapes.
+bool Scanner::scan_quoted(ScanArg const &a) {
+    skip_space(false);
+
+    int q = peek();
+    if (q != '"' && q != '`') {
+        fail("expected quoted string");
+        return false;
+    }
+    advance();
+
+    begin_token();
+    bool escaped = false;
+    for (;;) {
+        int c = peek();
+        if (c < 0 || (c == '\n' && q == '"')) {
+            end_token();
+            fail("unterminated quoted string");
+            return false;
+        }
+        if (c == q) {
+            break;
+        }
+        advance();
+        if (c == '\\' && q == '"') {
+            escaped = true;
+            if (peek() >= 0) {
+                advance();
+            }
+        }
+    }
+    str tok = end_token();
+    advance();  // closing quote
+
+    if (!escaped) {
+        store_string(a, tok);
+        return true;
+    }
+
+    if (a.kind == ScanArg::Str) {
+        fail("quoted string with escapes can't be scanned into a str");
+        return false;
+    }
+
+    lib::String s(len(tok));
+    for (size i = 0; i < len(tok); i++) {
+        char c = tok[i];
+        if (c != '\\') {
+            s += str(&tok.data[i], 1);
+            continue;
+        }
+
+        c = tok[++i];
+        int ndigits = 0;
+        switch (c) {
+            case 'a':  s += "\a"; continue;
+            case 'b':  s += "\b"; continue;
+            case 'f':  s += "\f"; continue;
+            case 'n':  s += "\n"; continue;
+            case 'r':  s += "\r"; continue;
+            case 't':  s += "\t"; continue;
+            case 'v':  s += "\v"; continue;
+            case '\\': s += "\\"; continue;
+            case '"':  s += "\""; continue;
+            case 'x':  ndigits = 2; break;
+            case 'u':  ndigits = 4; break;
+            case 'U':  ndigits = 8; break;
+            default:
+                fail("invalid escape in quoted string");
+                return false;
+        }
+
+        uint32 v = 0;
+        for (int k = 0; k < ndigits; k++) {
+            i++;
+            int h = i < len(tok) ? lower(byte(tok[i])) : -1;
+            int d = h >= '0' && h <= '9' ? h - '0' : h >= 'a' && h <= 'f' ? h - 'a' + 10 : -1;
+            if (d < 0) {
+                fail("invalid escape in quoted string");
+                return false;
+            }
+            v = v*16 + d;
+        }
+        if (c == 'x') {
+            char b = char(v);
+            s += str(&b, 1);
+        } else {
+            byte b[utf8::UTFMax];
+            s += utf8::encode(buf(b, sizeof b), rune(v));
+        }
+    }
+
+    *(lib::String*) a.ptr = std::move(s);
+    return true;
+}
+
+bool Scanner::scan_one(Spec const &spec, ScanArg const &a) {
+    size max = spec.wid_present ? spec.wid : std::numeric_limits<size>::max();
+    if (max == 0) {
+        fail("zero width");
+        return false;
+    }
+    if (spec.verb != 'c') {
+        skip_space(false);
+        if (peek() < 0) {
+            fail_eof();
+            return false;
+        }
+    }
+
+    switch (a.kind) {
+        case ScanArg::Int:
+        case ScanArg::Uint:
+            return scan_int(spec, a, max);
+
+        case ScanArg::Float32:
+        case ScanArg::Float64:
+            if (!strchr("veEfFgG", int(spec.verb))) {
+                fail("bad verb for float");
+                return false;
+            }
+            return scan_float(a, max);
+
+        case ScanArg::Bool:
+            if (spec.verb != 't' && spec.verb != 'v') {
+                fail("bad verb for bool");
+                return false;
+            }
+            return scan_bool(a, max);
+
+        case ScanArg::String:
+        case ScanArg::Str:
+            return scan_string(spec, a, max);
+    }
+    return false;
+}
+
+bool Scanner::match(str lit) {
+    size i = 0;
+    while (i < len(lit)) {
+        char c = lit[i];
+        if (is_space(c)) {
+            while (i < len(lit) && is_space(lit[i])) {
+                i++;
+            }
+            skip_space(false);
+            continue;
+        }
+
+        if (c == '\n') {
+            skip_space(false);
+        }
+        if (peek() != byte(c)) {
+            if (peek() < 0) {
+                fail_eof();
+            } else {
+                fail("input does not match format");
+            }
+            return false;
+        }
+        advance();
+        i++;
+    }
+    return true;
+}
+
+size internal::scan_values(Input in, ScanArg const *args, size nargs, error err) {
+    Scanner sc(in, err);
+    Spec spec;
+
+    for (size i = 0; i < nargs; i++) {
+        sc.arg = i;
+        sc.skip_space(true);
+        if (sc.peek() < 0) {
+            sc.fail_eof();
+            return i;
+        }
+        if (!sc.scan_one(spec, args[i])) {
+            return i;
+        }
+    }
+    return nargs;
+}
+
+size internal::scan_compiled(Input in, str format, Spec const *specs, Chunk const *lits,
+                             ScanArg const *args, size nargs, error err) {
+    Scanner sc(in, err);
+
+    for (size i = 0; i < nargs; i++) {
+        Chunk lit = lits[i];
+        if (!sc.match(format[lit.off, lit.off + lit.len])) {
+            return i;
+        }
+
+        sc.arg = i;
+        if (specs[i].verb == '*') {
+            sc.fail("'*' is not supported when scanning");
+            return i;
+        }
+        if (!sc.scan_one(specs[i], args[i])) {
+            return i;
+        }
+        sc.arg = -1;
+    }
+
+    Chunk tail = lits[nargs];
+    sc.match(format[tail.off, tail.off + tail.len]);
+    return nargs;
+}
+
+size internal::scan_runtime(Input in, str format, ScanArg const *args, size nargs, error err) {
+    Scanner sc(in, err);
+    size k = 0;
+    size i = 0;
+
+    while (i < len(format)) {
+        // the literal up to the next directive
+        size j = i;
+        while (j < len(format) && format[j] != '%') {
+            j++;
+        }
+        if (!sc.match(format[i, j])) {
+            return k;
+        }
+        if (j == len(format)) {
+            break;
+        }
+
+        i = j + 1;
+        if (i < len(format) && format[i] == '%') {
+            if (!sc.match("%")) {
+                return k;
+            }
+            i++;
+            continue;
+        }
+
+        Spec spec;
+        while (i < len(format) && strchr("#0+- ", format[i])) {
+            i++;
+        }
+        while (i < len(format) && format[i] >= '0' && format[i] <= '9') {
+            spec.wid_present = true;
+            spec.wid = spec.wid*10 + (format[i] - '0');
+            i++;
+        }
+        if (i == len(format)) {
+            sc.fail("missing verb in format");
+            return k;
+        }
+        spec.verb = byte(format[i]);
+        i++;
+
+        if (k == nargs) {
+            sc.fail("too few arguments for format");
+            return k;
+        }
+        sc.arg = k;
+        if (!sc.scan_one(spec, args[k])) {
+            return k;
+        }
+        sc.arg = -1;
+        k++;
+    }
+
+    if (k < nargs) {
+        sc.fail("too many arguments for format");
+    }
+    return k;
+}
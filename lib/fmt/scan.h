@@ -0,0 +1,163 @@
+#pragma once
+
+#include <type_traits>
+
+#include "fmt.h"
+
+// Scanning is the counterpart of printing. The functions below read
+// space-separated values, or values laid out by a format string, into the
+// variables their arguments point to:
+//
+//     int id; float64 temp; String name;
+//     fmt::sscanf(line, err, "%d,%f,%s", &id, &temp, &name);
+//
+// The format uses the verbs of printf, with the same meaning for each type:
+//
+//     integers        v d b o x X c   (%v accepts the 0b, 0o and 0x prefixes;
+//                                      %c reads a single rune)
+//     floating point  v e E f F g G
+//     bool            v t             (true, false, t, f, 1 or 0, in any case)
+//     String, str     v s q           (%q reads a double-quoted or
+//                                      backquoted string)
+//
+// A width, as in %5d, limits how many runes the value may take. Except for %c,
+// each verb skips spaces before its value. A run of spaces in the format
+// matches any run of spaces, tabs or carriage returns in the input, including
+// none; a newline must match a newline; any other character must match
+// itself. In a runtime format "%%" matches a single '%'.
+//
+// A literal format is parsed and checked against the argument types while
+// compiling, as a format_string; a format built at run time is passed through
+// runtime_format. Reading stops at the first error, which is reported through
+// err, and the number of values scanned is returned.
+//
+// Values are parsed directly from the input: sscanf never copies
+// the text of a value, and fscanf parses from the reader's buffer and copies
+// only a value that straddles two reads. A str argument of sscanf refers into
+// the input.
+namespace lib::fmt {
+
+    // ScanError reports input that doesn't match the format, or a value that
+    // can't be read into its argument.
+    struct ScanError : ErrorBase<ScanError> {
+        str  msg;      // such as "expected integer"
+        size arg = -1; // index of the argument being scanned, or -1
+
+        ScanError(str msg, size arg) : msg(msg), arg(arg) {}
+        void fmt(io::Writer &out, error err) const override;
+    } ;
+
+    struct RuntimeFormat {
+        str format;
+    } ;
+
+    // runtime_format marks a format that isn't a literal, so it is parsed
+    // while scanning instead of while compiling.
+    inline RuntimeFormat runtime_format(str format) {
+        return RuntimeFormat{format};
+    }
+
+    namespace internal {
+
+        struct ScanArg {
+            enum Kind : uint8 {
+                Int,
+                Uint,
+                Float32,
+                Float64,
+                Bool,
+                String,
+                Str,
+            } ;
+
+            Kind  kind;
+            uint8 bits = 0;  // of an Int or Uint
+            void *ptr  = nil;
+        } ;
+
+        template <typename T, bool AllowStr>
+        ScanArg scan_arg(T *p) {
+            using U = std::remove_cv_t<T>;
+            static_assert(!std::is_const_v<T>, "fmt: scan argument points to const");
+
+            if constexpr (std::is_same_v<U, bool>) {
+                return {ScanArg::Bool, 0, p};
+            } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+                return {ScanArg::Int, uint8(sizeof(U) * 8), p};
+            } else if constexpr (std::is_integral_v<U>) {
+                return {ScanArg::Uint, uint8(sizeof(U) * 8), p};
+            } else if constexpr (std::is_same_v<U, float32>) {
+                return {ScanArg::Float32, 0, p};
+            } else if constexpr (std::is_same_v<U, float64>) {
+                return {ScanArg::Float64, 0, p};
+            } else if constexpr (std::is_same_v<U, lib::String>) {
+                return {ScanArg::String, 0, p};
+            } else if constexpr (std::is_same_v<U, str>) {
+                static_assert(AllowStr, "fmt: scanning from a reader into a str would leave it dangling; use String");
+                return {ScanArg::Str, 0, p};
+            } else {
+                static_assert(sizeof(U) == 0, "fmt: unsupported scan argument type");
+            }
+        }
+
+        // Input is where scanning reads from: a str, or an io::Reader when r
+        // is set.
+        struct Input {
+            str         s;
+            io::Reader *r = nil;
+        } ;
+
+        size scan_values(Input in, ScanArg const *args, size nargs, error err);
+        size scan_runtime(Input in, str format, ScanArg const *args, size nargs, error err);
+        size scan_compiled(Input in, str format, Spec const *specs, Chunk const *lits,
+                           ScanArg const *args, size nargs, error err);
+
+        template <typename... Args>
+        size scan_compiled(Input in, format_string<Args...> const &format, ScanArg const *args, error err) {
+            return scan_compiled(in, format.get(), format.specs.data(), format.lits.data(),
+                                 args, sizeof...(Args), err);
+        }
+    }
+
+    // sscan scans space-separated values from input, newlines counting as
+    // space, into args.
+    template <typename... Args>
+    size sscan(str input, error err, Args *...args) {
+        internal::ScanArg a[] = {internal::scan_arg<Args, true>(args)..., {}};
+        return internal::scan_values({input}, a, sizeof...(Args), err);
+    }
+
+    // fscan is sscan reading from in. Only the input making up the values is
+    // consumed. in should be buffered, as an io::Buffered is; a reader
+    // without a read buffer looks empty.
+    template <typename... Args>
+    size fscan(io::Reader &in, error err, Args *...args) {
+        internal::ScanArg a[] = {internal::scan_arg<Args, false>(args)..., {}};
+        return internal::scan_values({{}, &in}, a, sizeof...(Args), err);
+    }
+
+    template <typename... Args>
+    size sscanf(str input, error err, format_string<std::type_identity_t<Args>...> const &format, Args *...args) {
+        internal::ScanArg a[] = {internal::scan_arg<Args, true>(args)..., {}};
+        return internal::scan_compiled({input}, format, a, err);
+    }
+
+    template <typename... Args>
+    size sscanf(str input, error err, RuntimeFormat format, Args *...args) {
+        internal::ScanArg a[] = {internal::scan_arg<Args, true>(args)..., {}};
+        return internal::scan_runtime({input}, format.format, a, sizeof...(Args), err);
+    }
+
+    // fscanf is sscanf reading from in, under the same conditions as fscan.
+    template <typename... Args>
+    size fscanf(io::Reader &in, error err, format_string<std::type_identity_t<Args>...> const &format, Args *...args) {
+        internal::ScanArg a[] = {internal::scan_arg<Args, false>(args)..., {}};
+        return internal::scan_compiled({{}, &in}, format, a, err);
+    }
+
+    template <typename... Args>
+    size fscanf(io::Reader &in, error err, RuntimeFormat format, Args *...args) {
+        internal::ScanArg a[] = {internal::scan_arg<Args, false>(args)..., {}};
+        return internal::scan_runtime({{}, &in}, format.format, a, sizeof...(Args), err);
+    }
+}
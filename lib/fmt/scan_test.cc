@@ -0,0 +1,205 @@
+#include "scan.h"
+
+#include <algorithm>
+
+#include "lib/io/util.h"
+#include "lib/utf8/utf8.h"
+#include "lib/testing/benchmark.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+namespace {
+    // Trickle is a buffered reader that returns at most three bytes per
+    // read, so that values straddle refills of its read buffer.
+    struct Trickle : io::Buffered {
+        str data;
+
+        Trickle(str data) : data(data) {
+            resize_readbuf(16);
+        }
+
+        io::ReadResult direct_read(buf b, error) override {
+            size n = copy(b.slice(0, std::min<size>(3, len(b))), data);
+            data = data(n);
+            return {n, len(data) == 0};
+        }
+
+        size direct_write(str, error) override {
+            return 0;
+        }
+    } ;
+}
+
+void test_sscanf(T &t) {
+    int id = 0;
+    float64 temp = 0;
+    String name;
+    bool ok = false;
+
+    size n = fmt::sscanf("17, -2.5e1 ,  kitchen true", error::panic, "%d,%f , %s %t", &id, &temp, &name, &ok);
+    if (n != 4 || id != 17 || temp != -25 || name != "kitchen" || !ok) {
+        t.errorf("got %d: %d %v %q %v", n, id, temp, name, ok);
+    }
+
+    uint8 b = 0;
+    int16 o = 0;
+    uint32 x = 0;
+    int64 v = 0;
+    n = fmt::sscanf("101 -17 fF 0x1_000", error::panic, "%b %o %x %v", &b, &o, &x, &v);
+    if (n != 4 || b != 5 || o != -15 || x != 255 || v != 4096) {
+        t.errorf("got %d: %d %d %d %d", n, b, o, x, v);
+    }
+
+    // a width limits the runes a value takes
+    int year = 0, month = 0, day = 0;
+    n = fmt::sscanf("20240315", error::panic, "%4d%2d%2d", &year, &month, &day);
+    if (n != 3 || year != 2024 || month != 3 || day != 15) {
+        t.errorf("got %d: %d %d %d", n, year, month, day);
+    }
+
+    int32 r = 0;
+    String q;
+    n = fmt::sscanf("é \"a\\tb\\u00e9\"", error::panic, "%c %q", &r, &q);
+    if (n != 2 || r != U'é' || q != "a\tbé") {
+        t.errorf("got %d: %d %q", n, r, q);
+    }
+}
+
+void test_sscanf_str(T &t) {
+    str input = "key=`raw value` next";
+    str key, val, next;
+
+    size n = fmt::sscanf(input, error::panic, "key=%q %s", &val, &next);
+    if (n != 2 || val != "raw value" || next != "next") {
+        t.errorf("got %d: %q %q", n, val, next);
+    }
+    // str values refer into the input
+    if (val.data != input.data + 5 || next.data != input.data + 16) {
+        t.errorf("str values were copied");
+    }
+
+    n = fmt::sscan("  one\ntwo ", error::panic, &key, &val);
+    if (n != 2 || key != "one" || val != "two") {
+        t.errorf("sscan got %d: %q %q", n, key, val);
+    }
+}
+
+void test_sscanf_runtime(T &t) {
+    String format = "%d%%, %5s";
+    int pct = 0;
+    String s;
+
+    size n = fmt::sscanf("42%, abcdefgh", error::panic, fmt::runtime_format(format), &pct, &s);
+    if (n != 2 || pct != 42 || s != "abcde") {
+        t.errorf("got %d: %d %q", n, pct, s);
+    }
+
+    bool failed = false;
+    n = fmt::sscanf("1 2", [&](Error &e) {
+        failed = true;
+        if (!dynamic_cast<fmt::ScanError*>(&e)) {
+            t.errorf("got error %v; want a ScanError", e);
+        }
+    }, fmt::runtime_format("%d %d"), &pct);
+    if (n != 1 || !failed) {
+        t.errorf("too few arguments: got %d, failed %v", n, failed);
+    }
+}
+
+void test_sscanf_errors(T &t) {
+    struct {
+        str  input;
+        str  format;
+        size want;
+        str  err;
+    } tests[] = {
+        {"12 x", "%d %d", 1, "scan: expected integer (argument 1)"},
+        {"12", "%d,%d", 1, "unexpected EOF"},
+        {"12;13", "%d,%d", 1, "scan: input does not match format"},
+        {"99999999999 1", "%d %d", 0, "strconv::parse_int: parsing \"99999999999\": value out of range"},
+        {"1 2", "%d %t", 1, "scan: bad verb for integer (argument 1)"},
+    };
+
+    for (auto const &tt : tests) {
+        int32 a = 0, b = 0;
+        String got;
+        size n = fmt::sscanf(tt.input, [&](Error &e) {
+            got = fmt::sprintf("%v", e);
+        }, fmt::runtime_format(tt.format), &a, &b);
+
+        if (n != tt.want || got != tt.err) {
+            t.errorf("sscanf(%q, %q) = %d, %q; want %d, %q", tt.input, tt.format, n, got, tt.want, tt.err);
+        }
+    }
+}
+
+void test_fscanf(T &t) {
+    Trickle in("point 123456,-7.25\nname \"a long quoted name\"\nrest");
+
+    int x = 0;
+    float64 y = 0;
+    String name;
+    size n = fmt::fscanf(in, error::panic, "point %d,%f\n", &x, &y);
+    n += fmt::fscanf(in, error::panic, "name %q\n", &name);
+    if (n != 3 || x != 123456 || y != -7.25 || name != "a long quoted name") {
+        t.errorf("got %d: %d %v %q", n, x, y, name);
+    }
+
+    // fscanf consumed only what it matched
+    byte rest[8];
+    n = io::read_at_least(in, buf(rest, sizeof rest), 4, error::ignore);
+    if (str(rest, n) != "rest") {
+        t.errorf("rest = %q", str(rest, n));
+    }
+}
+
+void test_fscan(T &t) {
+    Trickle in("1 22\n333 4444 x");
+    int v[4] = {};
+    size n = fmt::fscan(in, error::panic, &v[0], &v[1], &v[2], &v[3]);
+    if (n != 4 || v[0] != 1 || v[1] != 22 || v[2] != 333 || v[3] != 4444) {
+        t.errorf("got %d: %v", n, v);
+    }
+}
+
+void test_fscanf_invalid_utf8(T &t) {
+    // the reader's first window ends in the first two bytes of a four-byte
+    // rune, and the next one starts with a byte that doesn't continue it
+    str input = "a\xf0\x9f" "b\xff" "c";
+    rune want[] = {'a', utf8::RuneError, 'b', utf8::RuneError, 'c'};
+
+    rune got[5] = {};
+    Trickle in(input);
+    size n = fmt::fscanf(in, error::panic, "%c%c%c%c%c", &got[0], &got[1], &got[2], &got[3], &got[4]);
+    if (n != 5 || !std::equal(got, got + 5, want)) {
+        t.errorf("fscanf got %d: %v", n, got);
+    }
+
+    rune sgot[5] = {};
+    n = fmt::sscanf(input, error::panic, "%c%c%c%c%c", &sgot[0], &sgot[1], &sgot[2], &sgot[3], &sgot[4]);
+    if (n != 5 || !std::equal(sgot, sgot + 5, want)) {
+        t.errorf("sscanf got %d: %v", n, sgot);
+    }
+}
+
+void benchmark_sscanf(B &b) {
+    str line = "1234567, -12.5, sensor-17";
+    int id = 0;
+    float64 temp = 0;
+    str name;
+    for (int i = 0; i < b.n; i++) {
+        fmt::sscanf(line, error::panic, "%d, %f, %s", &id, &temp, &name);
+    }
+}
+
+void benchmark_libc_sscanf(B &b) {
+    char const *line = "1234567, -12.5, sensor-17";
+    int id = 0;
+    double temp = 0;
+    char name[32];
+    for (int i = 0; i < b.n; i++) {
+        ::sscanf(line, "%d, %lf, %31s", &id, &temp, name);
+    }
+}
@@ -0,0 +1,255 @@
+#include "cache.h"
+
+#include "memfs.h"
+#include "lib/filepath/path.h"
+#include "lib/strings/strings.h"
+#include "lib/sync/lock.h"
+
+using namespace lib;
+using namespace fs;
+
+fs::CachedFS::CachedFS(FS &base, error err) : CachedFS(base, CacheOptions{}, err) {}
+
+fs::CachedFS::CachedFS(FS &base, CacheOptions const &opts, error err) : base(base), opts(opts), root(opts.watch) {
+    this->opts.watch = root;
+    if (len(root) == 0) {
+        return;
+    }
+
+    // changes are applied as they are seen rather than debounced, so the
+    // cache is stale for as short a time as possible
+    bool failed = false;
+    auto fail = [&](Error &e) {
+        failed = true;
+        err(e);
+    };
+    watcher = std::make_unique<Watcher>(WatchOptions{.recursive = true, .debounce = {}}, fail);
+    if (!failed) {
+        watcher->add(root, fail);
+    }
+    if (failed) {
+        // fall back to revalidating
+        watcher.reset();
+        return;
+    }
+
+    watch_thread = sync::go([this] { watch_loop(); });
+}
+
+fs::CachedFS::~CachedFS() {
+    if (watcher) {
+        watcher->close();
+        watch_thread.join();
+    }
+}
+
+void fs::CachedFS::watch_loop() {
+    String prefix = root;
+    if (prefix[len(prefix)-1] != '/') {
+        prefix += '/';
+    }
+
+    for (;;) {
+        bool ok = true;
+        Event ev = watcher->events.recv(&ok);
+        if (!ok) {
+            return;
+        }
+
+        if ((ev.op & OpRescan).value || !strings::has_prefix(ev.path, prefix)) {
+            invalidate(".");
+        } else {
+            invalidate(str(ev.path)(len(prefix)));
+        }
+    }
+}
+
+void fs::CachedFS::invalidate(str name) {
+    sync::Lock lock(mtx);
+    generation++;
+
+    if (name == ".") {
+        entries.clear();
+        lru.clear();
+        bytes = 0;
+        return;
+    }
+
+    auto it = entries.find(String(name));
+    if (it != entries.end()) {
+        drop(it);
+    }
+
+    String prefix = name;
+    prefix += '/';
+    it = entries.lower_bound(prefix);
+    while (it != entries.end() && strings::has_prefix(it->first, prefix)) {
+        auto next = std::next(it);
+        drop(it);
+        it = next;
+    }
+}
+
+int64 fs::CachedFS::used() {
+    sync::Lock lock(mtx);
+    return bytes;
+}
+
+// drop removes an entry. mtx is held.
+void fs::CachedFS::drop(std::map<String, Entry>::iterator it) {
+    bytes -= len(*it->second.data);
+    lru.erase(it->second.lru);
+    entries.erase(it);
+}
+
+static FileInfo file_info(str name, str data, FileMode mode, time::time mod_time) {
+    return FileInfo{
+        .name     = filepath::base(name),
+        .size     = len(data),
+        .mode     = mode,
+        .mod_time = mod_time,
+        .is_dir   = false,
+    };
+}
+
+fs::CachedFS::Lookup fs::CachedFS::get(str name, std::shared_ptr<String const> *data, FileInfo *fi, error err) {
+    int64 now = time::clock().nsecs;
+    uint64 gen;
+    {
+        sync::Lock lock(mtx);
+        auto it = entries.find(String(name));
+        if (it != entries.end()) {
+            Entry &e = it->second;
+            if (watcher || now - e.checked < opts.revalidate.nsecs) {
+                lru.splice(lru.begin(), lru, e.lru);
+                *data = e.data;
+                *fi = file_info(name, *e.data, e.mode, e.mod_time);
+                return Hit;
+            }
+        }
+        gen = generation;
+    }
+
+    // stat before reading: if the file changes in between, the cached
+    // contents are newer than the recorded time and the next check reloads
+    // them, never the other way around
+    bool failed = false;
+    FileInfo st = base.stat(name, [&](Error &e) {
+        failed = true;
+        err(e);
+    });
+    if (failed) {
+        invalidate(name);
+        return Failed;
+    }
+    if (st.is_dir || st.size > opts.max_file) {
+        return Uncached;
+    }
+
+    {
+        sync::Lock lock(mtx);
+        auto it = entries.find(String(name));
+        if (it != entries.end() && generation == gen) {
+            Entry &e = it->second;
+            if (e.mod_time.nsecs == st.mod_time.nsecs && len(*e.data) == st.size) {
+                e.checked = now;
+                lru.splice(lru.begin(), lru, e.lru);
+                *data = e.data;
+                *fi = file_info(name, *e.data, e.mode, e.mod_time);
+                return Hit;
+            }
+        }
+    }
+
+    auto contents = std::make_shared<String const>(base.read_file(name, [&](Error &e) {
+        failed = true;
+        err(e);
+    }));
+    if (failed) {
+        return Failed;
+    }
+    *data = contents;
+    *fi = file_info(name, *contents, st.mode, st.mod_time);
+
+    if (len(*contents) > opts.max_file) {
+        return Hit;
+    }
+
+    sync::Lock lock(mtx);
+    if (generation != gen) {
+        // invalidated while loading; what was read may already be stale
+        return Hit;
+    }
+
+    auto it = entries.find(String(name));
+    if (it != entries.end()) {
+        drop(it);
+    }
+
+    lru.push_front(String(name));
+    Entry &e = entries[String(name)];
+    e.data = contents;
+    e.mode = st.mode;
+    e.mod_time = st.mod_time;
+    e.checked = now;
+    e.lru = lru.begin();
+    bytes += len(*contents);
+
+    while (bytes > opts.max_bytes && !lru.empty()) {
+        drop(entries.find(lru.back()));
+    }
+    return Hit;
+}
+
+std::unique_ptr<File> fs::CachedFS::open(str name, error err) {
+    std::shared_ptr<String const> data;
+    FileInfo fi;
+    switch (get(name, &data, &fi, err)) {
+        case Failed:
+            return nil;
+        case Uncached:
+            return base.open(name, err);
+        case Hit:
+            break;
+    }
+
+    auto f = std::make_unique<internal::DataFile>();
+    f->data = std::move(data);
+    f->name = name;
+    f->info = fi;
+    f->info.name = filepath::base(f->name);
+    return f;
+}
+
+FileInfo fs::CachedFS::stat(str name, error err) {
+    {
+        sync::Lock lock(mtx);
+        auto it = entries.find(String(name));
+        if (it != entries.end()) {
+            Entry &e = it->second;
+            if (watcher || time::clock().nsecs - e.checked < opts.revalidate.nsecs) {
+                return file_info(name, *e.data, e.mode, e.mod_time);
+            }
+        }
+    }
+
+    return base.stat(name, err);
+}
+
+std::vector<DirEntry> fs::CachedFS::read_dir(str name, error err) {
+    return base.read_dir(name, err);
+}
+
+String fs::CachedFS::read_file(str name, error err) {
+    std::shared_ptr<String const> data;
+    FileInfo fi;
+    switch (get(name, &data, &fi, err)) {
+        case Failed:
+            return "";
+        case Uncached:
+            return base.read_file(name, err);
+        case Hit:
+            break;
+    }
+    return *data;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+
+#include "fs.h"
+#include "watch.h"
+#include "lib/sync/go.h"
+#include "lib/sync/mutex.h"
+
+namespace lib::fs {
+
+    struct CacheOptions {
+        // max_bytes bounds the total size of the cached file contents. When
+        // it is exceeded, the least recently used files are evicted.
+        int64 max_bytes = 64 << 20;
+
+        // files larger than max_file are never cached
+        int64 max_file = 1 << 20;
+
+        // revalidate is how long a cached file is served before its
+        // modification time and size are compared with the base FS again.
+        // Zero checks on every access, which still saves reading the file.
+        time::duration revalidate = time::second;
+
+        // watch, if set, is the OS directory that the base FS serves, such as
+        // the root of an os::DirFS. Cached files are then invalidated by
+        // inotify events instead of being revalidated.
+        str watch;
+    } ;
+
+    // CachedFS is a read-through cache in front of another FS. It keeps the
+    // contents of recently read files in memory, so open and read_file of a
+    // hot file cost no system calls, and stat of a cached file is answered
+    // from the cache. read_dir is passed through.
+    //
+    // A cached file is kept fresh either by comparing its modification time
+    // and size with the base every opts.revalidate, or, with opts.watch, by
+    // an fs::Watcher that drops files as they change. It is safe for
+    // concurrent use.
+    struct CachedFS : FS {
+        CachedFS(FS &base, error err);
+        CachedFS(FS &base, CacheOptions const &opts, error err);
+        CachedFS(CachedFS const&) = delete;
+        ~CachedFS();
+
+        std::unique_ptr<File> open(str name, error err) override;
+        FileInfo stat(str name, error err) override;
+        std::vector<DirEntry> read_dir(str name, error err) override;
+        String read_file(str name, error err) override;
+
+        // invalidate drops name, and any cached file below it, from the
+        // cache.
+        void invalidate(str name);
+
+        // used returns the total size of the cached file contents.
+        int64 used();
+
+      private:
+        struct Entry {
+            std::shared_ptr<String const> data;
+            FileMode   mode;
+            time::time mod_time;
+            int64      checked = 0;  // time::clock() of the last validation
+
+            std::list<String>::iterator lru;
+        } ;
+
+        FS          &base;
+        CacheOptions opts;
+        String       root;  // opts.watch
+
+        sync::Mutex                  mtx;
+        std::map<String, Entry>      entries;  // ordered, so a directory is a range
+        std::list<String>            lru;      // most recently used first
+        int64                        bytes = 0;
+        uint64                       generation = 0;  // bumped by every invalidation
+
+        std::unique_ptr<Watcher> watcher;
+        sync::go                 watch_thread;
+
+        enum Lookup {
+            Hit,       // data and fi are set
+            Uncached,  // a directory or a file too large to cache
+            Failed,    // an error was reported
+        } ;
+
+        // get returns the current contents and info of the file name, from
+        // the cache if it is still fresh.
+        Lookup get(str name, std::shared_ptr<String const> *data, FileInfo *fi, error err);
+
+        void drop(std::map<String, Entry>::iterator it);
+        void watch_loop();
+    } ;
+}
@@ -0,0 +1,132 @@
+#include "cache.h"
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "memfs.h"
+#include "lib/os/dir.h"
+#include "lib/os/file.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+namespace {
+    // CountingFS counts the files read from a MemFS.
+    struct CountingFS : fs::MemFS {
+        int reads = 0;
+
+        String read_file(str name, error err) override {
+            reads++;
+            return MemFS::read_file(name, err);
+        }
+    } ;
+}
+
+static int remove_entry(const char *path, const struct stat *, int, struct FTW *) {
+    return ::remove(path);
+}
+
+void test_cached_fs(T &t) {
+    CountingFS base;
+    base.write_file("index.html", "<html>", error::panic);
+
+    fs::CachedFS c(base, {.revalidate = time::duration(0)}, error::panic);
+
+    ErrorRecorder err;
+    for (int i = 0; i < 3; i++) {
+        String data = c.read_file("index.html", err);
+        if (err || data != "<html>") {
+            t.fatalf("read_file = %q, %v", data, err);
+        }
+    }
+    if (base.reads != 1) {
+        t.errorf("base read %d times; want 1", base.reads);
+    }
+
+    // a change in the base is seen on the next access
+    base.write_file("index.html", "<html><body>", error::panic);
+    String data = c.read_file("index.html", err);
+    if (err || data != "<html><body>") {
+        t.errorf("read_file after change = %q, %v", data, err);
+    }
+
+    std::unique_ptr<fs::File> f = c.open("index.html", err);
+    fs::FileInfo fi = f->stat(err);
+    if (err || fi.size != 12 || fi.name != "index.html") {
+        t.errorf("stat of cached file = {%q %d}, %v", fi.name, fi.size, err);
+    }
+
+    base.remove("index.html", error::panic);
+    bool missing = false;
+    c.read_file("index.html", [&](Error &e) {
+        missing = e.is<fs::ErrNotExist>();
+    });
+    if (!missing || c.used() != 0) {
+        t.errorf("removed file still served; used = %d", c.used());
+    }
+}
+
+void test_cached_fs_eviction(T &t) {
+    CountingFS base;
+    String block(100);
+    for (int i = 0; i < 100; i++) {
+        block += 'x';
+    }
+    base.write_file("a", block, error::panic);
+    base.write_file("b", block, error::panic);
+    base.write_file("c", block, error::panic);
+
+    fs::CachedFS c(base, {.max_bytes = 250, .revalidate = time::minute}, error::panic);
+    c.read_file("a", error::panic);
+    c.read_file("b", error::panic);
+    c.read_file("a", error::panic);  // b is now the least recently used
+    c.read_file("c", error::panic);
+    if (c.used() != 200) {
+        t.errorf("used = %d; want 200", c.used());
+    }
+
+    base.reads = 0;
+    c.read_file("a", error::panic);
+    c.read_file("c", error::panic);
+    if (base.reads != 0) {
+        t.errorf("recently used files were evicted");
+    }
+    c.read_file("b", error::panic);
+    if (base.reads != 1) {
+        t.errorf("b was not evicted");
+    }
+}
+
+void test_cached_fs_watch(T &t) {
+    char tmpl[] = "/tmp/baselib-cache-test-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        t.fatalf("mkdtemp failed");
+    }
+    String dir = str(tmpl, strlen(tmpl));
+    String file = dir;
+    file += "/page.tmpl";
+    os::write_file(file, "v1", error::panic);
+
+    os::DirFS base = os::dir_fs(dir);
+    fs::CachedFS c(base, {.revalidate = time::minute, .watch = dir}, error::panic);
+
+    ErrorRecorder err;
+    String data = c.read_file("page.tmpl", err);
+    if (err || data != "v1") {
+        t.fatalf("read_file = %q, %v", data, err);
+    }
+
+    // without the watcher, v1 would be served for another minute
+    os::write_file(file, "v2", error::panic);
+    for (int i = 0; i < 200 && data != "v2"; i++) {
+        time::sleep(5 * time::millisecond);
+        data = c.read_file("page.tmpl", err);
+    }
+    if (err || data != "v2") {
+        t.errorf("read_file after change = %q, %v; want %q", data, err, "v2");
+    }
+
+    nftw(tmpl, remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+}
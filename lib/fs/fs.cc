@@ -1,4 +1,8 @@
 #include "fs.h"
+
+#include <algorithm>
+
+#include "lib/filepath/path.h"
 #include "lib/io/io.h"
 
 using namespace lib;
@@ -10,4 +14,65 @@ FileMode FileMode::perm(this FileMode m) {
 
 void PathError::fmt(io::Writer &out, error err) const {
     fmt::fprintf(out, err, "%s %s: %s", this->op, this->path, this->err);
-}
\ No newline at end of file
+}
+bool fs::valid_path(str name) {
+    if (name == ".") {
+        return true;
+    }
+
+    // iterate over elements in name, checking each
+    for (;;) {
+        size i = 0;
+        while (i < len(name) && name[i] != '/') {
+            i++;
+        }
+        str elem = name[0, i];
+        if (elem == "" || elem == "." || elem == "..") {
+            return false;
+        }
+        if (i == len(name)) {
+            return true;  // reached clean ending
+        }
+        name = name[i+1, len(name)];
+    }
+}
+
+FileInfo FS::stat(str name, error err) {
+    FileInfo fi;
+    std::unique_ptr<File> f = open(name, err);
+    if (!f) {
+        return fi;
+    }
+
+    fi = f->stat(err);
+    fi.name = filepath::base(name);
+    return fi;
+}
+
+String FS::read_file(str name, error err) {
+    std::unique_ptr<File> f = open(name, err);
+    if (!f) {
+        return "";
+    }
+
+    FileInfo fi = f->stat(err);
+    if (err) {
+        return "";
+    }
+
+    // as in os::read_file, one byte more than the size lets a single read
+    // fill the String and see the end of the file
+    String s(std::max(size(fi.size) + 1, size(512)));
+    for (;;) {
+        if (s.length == s.cap()) {
+            s.ensure(s.cap() + 1);
+        }
+
+        io::ReadResult r = f->read(buf(s.buffer.data + s.length, s.cap() - s.length), err);
+        s.length += r.nbytes;
+        if (r.eof || r.nbytes == 0 || err) {
+            break;
+        }
+    }
+    return s;
+}
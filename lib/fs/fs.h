@@ -1,5 +1,8 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include "../base.h"
 #include "lib/io/io.h"
 #include "lib/time/time.h"
@@ -54,10 +57,58 @@ namespace lib::fs {
     } ;
 
     struct FileInfo {
-        String     name;
+        str        name;  // base name, a view into the path that was stat'ed
         int64      size {};
         FileMode   mode;
         time::time mod_time;
         bool       is_dir {};
     } ;
-}
\ No newline at end of file
+
+    // A DirEntry is an entry read from a directory.
+    struct DirEntry {
+        String   name;
+        FileMode type;  // the type bits of the mode, see ModeType
+
+        bool is_dir() const {
+            return uint32(type & ModeDir) != 0;
+        }
+    } ;
+
+    // A File provides access to a single file opened from an FS. It is read
+    // with the io::Reader methods and released by close or by destroying it.
+    struct File : io::Reader {
+        // stat returns a FileInfo describing the file. The name in the
+        // result stays valid as long as the File.
+        virtual FileInfo stat(error err) = 0;
+    } ;
+
+    // An FS provides access to a hierarchical file system.
+    //
+    // Names passed to its methods are unrooted, slash-separated paths such as
+    // "x/y/z", as accepted by valid_path; "." names the root. Errors are
+    // reported as a PathError.
+    struct FS {
+        // open opens the named file for reading.
+        virtual std::unique_ptr<File> open(str name, error err) = 0;
+
+        // stat returns a FileInfo describing the named file. The name in the
+        // result is a view into name. The default opens the file and stats
+        // it.
+        virtual FileInfo stat(str name, error err);
+
+        // read_dir reads the named directory and returns its entries sorted
+        // by name.
+        virtual std::vector<DirEntry> read_dir(str name, error err) = 0;
+
+        // read_file reads the named file and returns its contents. The
+        // default opens the file and reads it to the end.
+        virtual String read_file(str name, error err);
+
+        virtual ~FS() {}
+    } ;
+
+    // valid_path reports whether name is a valid path name for an FS: an
+    // unrooted, slash-separated sequence of elements, none of which is
+    // empty, "." or "..". The root itself is named ".".
+    bool valid_path(str name);
+}
@@ -0,0 +1,203 @@
+#include "memfs.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include "lib/filepath/path.h"
+#include "lib/strings/strings.h"
+#include "lib/sync/lock.h"
+
+using namespace lib;
+using namespace fs;
+
+io::ReadResult internal::DataFile::direct_read(buf b, error err) {
+    io::ReadResult r;
+    if (!data) {
+        err(PathError("read", name, ErrInvalid()));
+        return r;
+    }
+
+    str s = *data;
+    if (off >= len(s)) {
+        r.eof = len(b) > 0;
+        return r;
+    }
+
+    size n = std::min(len(b), len(s) - off);
+    memcpy(b.data, s.data + off, n);
+    off += n;
+    r.nbytes = n;
+    return r;
+}
+
+FileInfo internal::DataFile::stat(error) {
+    return info;
+}
+
+MemFS::Node const* MemFS::find(str name) const {
+    static const Node root = {nil, ModeDir | FileMode(0755), {}};
+    if (name == ".") {
+        return &root;
+    }
+
+    auto it = nodes.find(String(name));
+    return it == nodes.end() ? nil : &it->second;
+}
+
+void MemFS::write_file(str name, str data, error err) {
+    write_file(name, data, 0644, err);
+}
+
+void MemFS::write_file(str name, str data, FileMode perm, error err) {
+    if (!valid_path(name) || name == ".") {
+        return err(PathError("write", name, ErrInvalid()));
+    }
+
+    time::time now = time::now();
+    auto contents = std::make_shared<String const>(data);
+
+    sync::WLock lock(mtx);
+
+    // every parent must be a directory or not exist yet
+    for (size i = 0; i < len(name); i++) {
+        if (name[i] != '/') {
+            continue;
+        }
+        Node const *parent = find(name[0, i]);
+        if (parent && parent->data) {
+            return err(PathError("write", name, ErrInvalid()));
+        }
+    }
+    if (Node const *n = find(name); n && !n->data) {
+        return err(PathError("write", name, ErrInvalid()));
+    }
+
+    for (size i = 0; i < len(name); i++) {
+        if (name[i] == '/') {
+            nodes.try_emplace(String(name[0, i]), Node{nil, ModeDir | FileMode(0755), now});
+        }
+    }
+    nodes[String(name)] = Node{std::move(contents), perm.perm(), now};
+}
+
+void MemFS::remove(str name, error err) {
+    if (!valid_path(name) || name == ".") {
+        return err(PathError("remove", name, ErrInvalid()));
+    }
+
+    sync::WLock lock(mtx);
+    auto it = nodes.find(String(name));
+    if (it == nodes.end()) {
+        return err(PathError("remove", name, ErrNotExist()));
+    }
+    it = nodes.erase(it);
+
+    String prefix = name;
+    prefix += '/';
+    while (it != nodes.end() && strings::has_prefix(it->first, prefix)) {
+        it = nodes.erase(it);
+    }
+}
+
+std::unique_ptr<File> MemFS::open(str name, error err) {
+    if (!valid_path(name)) {
+        err(PathError("open", name, ErrInvalid()));
+        return nil;
+    }
+
+    sync::RLock lock(mtx);
+    Node const *n = find(name);
+    if (!n) {
+        err(PathError("open", name, ErrNotExist()));
+        return nil;
+    }
+
+    auto f = std::make_unique<internal::DataFile>();
+    f->data = n->data;
+    f->name = name;
+    f->info = FileInfo{
+        .name     = filepath::base(f->name),
+        .size     = n->data ? len(*n->data) : 0,
+        .mode     = n->mode,
+        .mod_time = n->mod_time,
+        .is_dir   = !n->data,
+    };
+    return f;
+}
+
+FileInfo MemFS::stat(str name, error err) {
+    if (!valid_path(name)) {
+        err(PathError("stat", name, ErrInvalid()));
+        return {};
+    }
+
+    sync::RLock lock(mtx);
+    Node const *n = find(name);
+    if (!n) {
+        err(PathError("stat", name, ErrNotExist()));
+        return {};
+    }
+
+    return FileInfo{
+        .name     = filepath::base(name),
+        .size     = n->data ? len(*n->data) : 0,
+        .mode     = n->mode,
+        .mod_time = n->mod_time,
+        .is_dir   = !n->data,
+    };
+}
+
+std::vector<DirEntry> MemFS::read_dir(str name, error err) {
+    std::vector<DirEntry> entries;
+    if (!valid_path(name)) {
+        err(PathError("readdir", name, ErrInvalid()));
+        return entries;
+    }
+
+    sync::RLock lock(mtx);
+    Node const *n = find(name);
+    if (!n) {
+        err(PathError("readdir", name, ErrNotExist()));
+        return entries;
+    }
+    if (n->data) {
+        err(PathError("readdir", name, ErrInvalid()));
+        return entries;
+    }
+
+    String prefix;
+    if (name != ".") {
+        prefix = name;
+        prefix += '/';
+    }
+
+    // the keys of a directory's entries sort in the same order as their
+    // names, so the result needs no sorting
+    for (auto it = nodes.lower_bound(prefix); it != nodes.end() && strings::has_prefix(it->first, prefix); ++it) {
+        str rest = str(it->first)(len(prefix));
+        if (strings::index_byte(rest, '/') >= 0) {
+            continue;
+        }
+        entries.push_back(DirEntry{rest, it->second.mode & ModeType});
+    }
+    return entries;
+}
+
+String MemFS::read_file(str name, error err) {
+    if (!valid_path(name)) {
+        err(PathError("readfile", name, ErrInvalid()));
+        return "";
+    }
+
+    sync::RLock lock(mtx);
+    Node const *n = find(name);
+    if (!n) {
+        err(PathError("readfile", name, ErrNotExist()));
+        return "";
+    }
+    if (!n->data) {
+        err(PathError("readfile", name, ErrInvalid()));
+        return "";
+    }
+    return *n->data;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <map>
+#include <memory>
+
+#include "fs.h"
+#include "lib/sync/rwmutex.h"
+
+namespace lib::fs {
+
+    namespace internal {
+        // DataFile is a File reading from a shared, immutable copy of a
+        // file's contents, so it stays valid if the file is replaced.
+        struct DataFile : File {
+            std::shared_ptr<String const> data;
+            String   name;
+            FileInfo info;
+            size     off = 0;
+
+            io::ReadResult direct_read(buf b, error err) override;
+            FileInfo stat(error err) override;
+        } ;
+    }
+
+    // MemFS is an FS held in memory, for tests and for serving generated
+    // content. Directories are created implicitly by write_file. It is safe
+    // for concurrent use; files that are open keep the contents they had
+    // when they were opened.
+    struct MemFS : FS {
+        // write_file creates or replaces the named file, creating its parent
+        // directories as needed.
+        void write_file(str name, str data, FileMode perm, error err);
+        void write_file(str name, str data, error err);
+
+        // remove removes the named file or directory, with everything below
+        // it.
+        void remove(str name, error err);
+
+        std::unique_ptr<File> open(str name, error err) override;
+        FileInfo stat(str name, error err) override;
+        std::vector<DirEntry> read_dir(str name, error err) override;
+        String read_file(str name, error err) override;
+
+      private:
+        struct Node {
+            std::shared_ptr<String const> data;  // nil for a directory
+            FileMode   mode;
+            time::time mod_time;
+        } ;
+
+        sync::RWMutex mtx;
+        std::map<String, Node> nodes;  // ordered, so a directory is a range
+
+        // find returns the node for name, or nil. The root always exists.
+        Node const* find(str name) const;
+    } ;
+}
@@ -0,0 +1,87 @@
+#include "memfs.h"
+
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+void test_valid_path(T &t) {
+    struct {
+        str  name;
+        bool valid;
+    } tests[] = {
+        {".", true},
+        {"x", true},
+        {"x/y/z", true},
+        {"", false},
+        {"/x", false},
+        {"x/", false},
+        {"x//y", false},
+        {"x/./y", false},
+        {"x/../y", false},
+        {"..", false},
+    };
+
+    for (auto &test : tests) {
+        if (fs::valid_path(test.name) != test.valid) {
+            t.errorf("valid_path(%q) = %v; want %v", test.name, !test.valid, test.valid);
+        }
+    }
+}
+
+void test_memfs(T &t) {
+    fs::MemFS m;
+    ErrorRecorder err;
+    m.write_file("a.txt", "hello", err);
+    m.write_file("dir/b.txt", "bee", err);
+    m.write_file("dir/sub/c.txt", "sea", err);
+    m.write_file("dir-x", "x", err);
+    if (err) {
+        t.fatalf("write_file: %v", err);
+    }
+
+    String data = m.read_file("dir/b.txt", err);
+    if (err || data != "bee") {
+        t.errorf("read_file = %q, %v; want %q", data, err, "bee");
+    }
+
+    std::vector<fs::DirEntry> entries = m.read_dir("dir", err);
+    if (err || entries.size() != 2 || entries[0].name != "b.txt" || entries[1].name != "sub" || !entries[1].is_dir()) {
+        t.errorf("read_dir(dir) returned %d entries, err %v", entries.size(), err);
+    }
+    entries = m.read_dir(".", err);
+    if (err || entries.size() != 3) {
+        t.errorf("read_dir(.) returned %d entries, err %v; want 3", entries.size(), err);
+    }
+
+    fs::FileInfo fi = m.stat("dir/sub/c.txt", err);
+    if (err || fi.name != "c.txt" || fi.size != 3 || fi.is_dir) {
+        t.errorf("stat = {%q %d %v}, err %v", fi.name, fi.size, fi.is_dir, err);
+    }
+
+    // an open file keeps the contents it was opened with
+    std::unique_ptr<fs::File> f = m.open("a.txt", err);
+    m.write_file("a.txt", "replaced", err);
+    byte b[16];
+    io::ReadResult r = f->read(b, err);
+    if (err || str(b, r.nbytes) != "hello") {
+        t.errorf("read from open file = %q, %v; want %q", str(b, r.nbytes), err, "hello");
+    }
+
+    bool invalid = false;
+    m.write_file("a.txt/x", "", [&](Error &e) {
+        invalid = e.is<fs::ErrInvalid>();
+    });
+    if (!invalid) {
+        t.errorf("writing below a file did not fail with ErrInvalid");
+    }
+
+    m.remove("dir", err);
+    bool missing = false;
+    m.stat("dir/sub/c.txt", [&](Error &e) {
+        missing = e.is<fs::ErrNotExist>();
+    });
+    if (err || !missing) {
+        t.errorf("remove(dir) left dir/sub/c.txt behind, err %v", err);
+    }
+}
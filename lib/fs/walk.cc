@@ -0,0 +1,179 @@
+#include "walk.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <fcntl.h>
+#include <memory>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+#include "lib/os/dir.h"
+#include "lib/os/error.h"
+#include "lib/sync/cond.h"
+#include "lib/sync/go.h"
+#include "lib/sync/lock.h"
+#include "lib/sync/mutex.h"
+
+using namespace lib;
+using namespace fs;
+
+namespace {
+    // A directory waiting to be read. The parent stays open until its last
+    // queued child has been opened from it.
+    struct Task {
+        std::shared_ptr<os::Dir> parent;
+        String path;
+        size   name_offset = 0;
+    } ;
+
+    struct Walker {
+        WalkDirFunc const &fn;
+        error err;
+
+        sync::Mutex mtx;
+        sync::Cond  cond;
+        // LIFO, so the walk goes depth first and the number of open parent
+        // directories stays proportional to the depth of the tree
+        std::vector<Task> tasks;
+        int  pending = 0;   // queued plus running tasks
+        std::atomic<bool> stop = false;
+
+        sync::Mutex err_mtx;
+
+        Walker(WalkDirFunc const &fn, error err) : fn(fn), err(err) {}
+
+        void push(Task &&t);
+        void work();
+        void read(Task &t);
+        void report(Error &e);
+    } ;
+}
+
+void Walker::push(Task &&t) {
+    sync::Lock lock(mtx);
+    tasks.push_back(std::move(t));
+    pending++;
+    cond.signal();
+}
+
+void Walker::report(Error &e) {
+    sync::Lock lock(err_mtx);
+    err(e);
+}
+
+void Walker::work() {
+    sync::Lock lock(mtx);
+    for (;;) {
+        while (tasks.empty() && pending > 0) {
+            cond.wait(mtx);
+        }
+        if (pending == 0) {
+            // everyone is idle: wake the other workers so they exit too
+            cond.broadcast();
+            return;
+        }
+
+        Task t = std::move(tasks.back());
+        tasks.pop_back();
+        bool skip = stop;
+        lock.unlock();
+
+        if (!skip) {
+            read(t);
+        }
+        t.parent.reset();
+
+        lock.relock();
+        pending--;
+    }
+}
+
+void Walker::read(Task &t) {
+    int dirfd = t.parent ? t.parent->fd : AT_FDCWD;
+    str name = str(t.path)(t.name_offset);
+
+    auto d = std::make_shared<os::Dir>(os::open_dir_at(dirfd, name, [&](Error &e) {
+        // report the full path rather than the name relative to the parent
+        const PathError *pe = e.as<PathError>();
+        PathError full("open", t.path, pe ? *pe->err : e);
+        report(full);
+    }));
+    if (d->fd == -1) {
+        return;
+    }
+    t.parent.reset();
+    d->name = t.path;
+
+    String path = t.path;
+    if (len(path) == 0 || path[len(path)-1] != '/') {
+        path += '/';
+    }
+    size prefix = len(path);
+
+    str entry;
+    FileMode type;
+    while (d->next(&entry, &type, [&](Error &e) { report(e); })) {
+        path.length = prefix;
+        path += entry;
+
+        Walk w = fn(path, type);
+        if (w == Walk::SkipAll) {
+            stop = true;
+            return;
+        }
+
+        if (uint32(type & ModeDir) && w != Walk::SkipDir) {
+            push(Task{d, path, prefix});
+        }
+
+        if (stop) {
+            return;
+        }
+    }
+}
+
+void fs::walk_dir(str root, WalkDirFunc fn, error err) {
+    walk_dir(root, WalkOptions{}, std::move(fn), err);
+}
+
+void fs::walk_dir(str root, WalkOptions const &opts, WalkDirFunc fn, error err) {
+    struct stat st;
+    CString croot = root;
+    if (fstatat(AT_FDCWD, croot, &st, AT_SYMLINK_NOFOLLOW) == -1) {
+        return err(PathError("lstat", root, os::Errno(errno)));
+    }
+
+    FileMode type;
+    switch (st.st_mode & S_IFMT) {
+        case S_IFREG: break;
+        case S_IFDIR: type = ModeDir; break;
+        case S_IFLNK: type = ModeSymlink; break;
+        default:      type = ModeIrregular; break;
+    }
+
+    Walk w = fn(root, type);
+    if (!S_ISDIR(st.st_mode) || w != Walk::Continue) {
+        return;
+    }
+
+    int workers = opts.workers;
+    if (workers <= 0) {
+        workers = int(std::thread::hardware_concurrency());
+    }
+    workers = std::max(workers, 1);
+
+    Walker walker(fn, err);
+    walker.push(Task{nil, root, 0});
+
+    std::deque<sync::go> threads;
+    for (int i = 1; i < workers; i++) {
+        threads.emplace_back([&walker] { walker.work(); });
+    }
+    walker.work();
+
+    for (sync::go &g : threads) {
+        g.join();
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <functional>
+
+#include "fs.h"
+
+namespace lib::fs {
+
+    // Walk is returned by a WalkDirFunc to control the traversal.
+    enum class Walk {
+        Continue,
+        SkipDir,   // don't descend into this directory; ignored for other entries
+        SkipAll,   // stop the walk; calls already in progress on other threads finish
+    } ;
+
+    // WalkDirFunc is called for each file or directory visited by walk_dir.
+    // path is root joined with the entry's name; type holds the type bits of
+    // the entry's mode, as reported by the directory listing.
+    using WalkDirFunc = std::function<Walk(str path, FileMode type)>;
+
+    struct WalkOptions {
+        // number of threads reading directories, including the caller's;
+        // 0 means one per CPU
+        int workers = 0;
+    } ;
+
+    // walk_dir walks the file tree rooted at root, calling fn for each file
+    // or directory in the tree, including root.
+    //
+    // Directories are read with getdents64 and opened relative to their
+    // parent with openat, so no entry is stat'ed and no full path is
+    // resolved by the kernel. Subdirectories are handed to a pool of
+    // opts.workers threads: fn may be called concurrently and entries are
+    // visited in no particular order. A directory's entries are all visited
+    // after the directory itself.
+    //
+    // walk_dir does not follow symbolic links.
+    //
+    // If a directory cannot be opened or read, the error is passed to err,
+    // that directory is skipped and the walk goes on. err is never called
+    // concurrently.
+    void walk_dir(str root, WalkDirFunc fn, error err);
+    void walk_dir(str root, WalkOptions const &opts, WalkDirFunc fn, error err);
+}
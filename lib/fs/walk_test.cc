@@ -0,0 +1,168 @@
+#include "walk.h"
+
+#include <ftw.h>
+#include <set>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lib/fmt/fmt.h"
+#include "lib/os/file.h"
+#include "lib/sync/mutex.h"
+#include "lib/sync/lock.h"
+#include "lib/testing/benchmark.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+static int remove_entry(const char *path, const struct stat *, int, struct FTW *) {
+    return ::remove(path);
+}
+
+static String join(str dir, str name) {
+    String p = dir;
+    p += '/';
+    p += name;
+    return p;
+}
+
+// make_tree creates depth levels of width directories, each holding files
+// regular files, and returns the paths created relative to root.
+static std::set<String> make_tree(str root, int depth, int width, int files) {
+    std::set<String> paths;
+    std::vector<String> level = {String()};
+
+    for (int d = 0; d < depth; d++) {
+        std::vector<String> next;
+        for (String const &parent : level) {
+            for (int i = 0; i < files; i++) {
+                String rel = fmt::sprintf("%sf%d", parent, i);
+                os::write_file(join(root, rel), "x", error::panic);
+                paths.insert(rel);
+            }
+            for (int i = 0; i < width; i++) {
+                String rel = fmt::sprintf("%sd%d", parent, i);
+                mkdir(CString(join(root, rel)), 0755);
+                paths.insert(rel);
+                next.push_back(String(rel + "/"));
+            }
+        }
+        level = std::move(next);
+    }
+
+    return paths;
+}
+
+static String temp_dir() {
+    char tmpl[] = "/tmp/baselib-walk-test-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        panic("mkdtemp failed");
+    }
+    return str(tmpl, strlen(tmpl));
+}
+
+void test_walk_dir(T &t) {
+    String root = temp_dir();
+    std::set<String> want = make_tree(root, 4, 3, 5);
+    symlink("d0", CString(join(root, "link")));
+    want.insert("link");
+
+    for (int workers : {1, 4}) {
+        sync::Mutex mtx;
+        std::set<String> got;
+        bool saw_root = false;
+
+        ErrorRecorder err;
+        fs::walk_dir(root, {.workers = workers}, [&](str path, fs::FileMode type) {
+            sync::Lock lock(mtx);
+            if (path == root) {
+                saw_root = true;
+                return fs::Walk::Continue;
+            }
+
+            str rel = path(len(root) + 1);
+            if (!got.insert(rel).second) {
+                t.errorf("workers=%d: %s visited twice", workers, path);
+            }
+            if (rel == "link" && type.value != fs::ModeSymlink.value) {
+                t.errorf("workers=%d: link has type %#x", workers, type.value);
+            }
+            return fs::Walk::Continue;
+        }, err);
+
+        if (err) {
+            t.errorf("workers=%d: walk_dir: %v", workers, err);
+        }
+        if (!saw_root) {
+            t.errorf("workers=%d: root not visited", workers);
+        }
+        if (got != want) {
+            t.errorf("workers=%d: visited %d entries; want %d", workers, int(got.size()), int(want.size()));
+        }
+    }
+
+    nftw(CString(root), remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+}
+
+void test_walk_dir_skip(T &t) {
+    String root = temp_dir();
+    make_tree(root, 3, 2, 2);
+
+    // pruning d0 hides everything below it
+    sync::Mutex mtx;
+    int below = 0;
+    fs::walk_dir(root, {.workers = 4}, [&](str path, fs::FileMode) {
+        str rel = len(path) > len(root) ? path(len(root) + 1) : str();
+        if (rel == "d0") {
+            return fs::Walk::SkipDir;
+        }
+        if (len(rel) > 3 && rel[0, 3] == "d0/") {
+            sync::Lock lock(mtx);
+            below++;
+        }
+        return fs::Walk::Continue;
+    }, error::panic);
+    if (below != 0) {
+        t.errorf("walk descended into skipped directory: %d entries", below);
+    }
+
+    // SkipAll stops the walk
+    std::atomic<int> calls = 0;
+    fs::walk_dir(root, {.workers = 1}, [&](str, fs::FileMode) {
+        calls++;
+        return calls == 2 ? fs::Walk::SkipAll : fs::Walk::Continue;
+    }, error::panic);
+    if (calls != 2) {
+        t.errorf("walk continued after SkipAll: %d calls", calls.load());
+    }
+
+    ErrorRecorder err;
+    fs::walk_dir(join(root, "missing"), [&](str, fs::FileMode) {
+        t.errorf("callback called for missing root");
+        return fs::Walk::Continue;
+    }, err);
+    if (!err) {
+        t.errorf("walk_dir of missing root succeeded");
+    }
+
+    nftw(CString(root), remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+}
+
+void benchmark_walk_dir(B &b) {
+    String root = temp_dir();
+    std::set<String> paths = make_tree(root, 4, 6, 10);
+
+    for (int i = 0; i < b.n; i++) {
+        std::atomic<int> n = 0;
+        fs::walk_dir(root, [&](str, fs::FileMode) {
+            n++;
+            return fs::Walk::Continue;
+        }, error::panic);
+        if (n != int(paths.size()) + 1) {
+            b.fatalf("walked %d entries; want %d", n.load(), int(paths.size()) + 1);
+        }
+    }
+
+    nftw(CString(root), remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+}
@@ -0,0 +1,381 @@
+#include "watch.h"
+
+#include <algorithm>
+#include <map>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "walk.h"
+#include "lib/fmt/fmt.h"
+#include "lib/os/error.h"
+#include "lib/strings/strings.h"
+#include "lib/sync/go.h"
+#include "lib/sync/lock.h"
+#include "lib/sync/mutex.h"
+
+using namespace lib;
+using namespace fs;
+
+static const uint32 DirMask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                              IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+                              IN_EXCL_UNLINK;
+
+namespace {
+    struct Pending {
+        String path;
+        Op     op;
+        int64  last = 0;  // time::clock() of the latest change
+    } ;
+}
+
+struct fs::internal::WatcherState {
+    Watcher     &w;
+    WatchOptions opts;
+
+    int inotify = -1;
+    int wake    = -1;  // eventfd written by close
+
+    sync::Mutex mtx;
+    std::unordered_map<int, String> paths;  // wd -> path
+    std::map<String, int>           wds;    // path -> wd, ordered so a subtree is a range
+    std::vector<String>             roots;
+
+    // only used by the thread
+    std::vector<Pending>         pending;
+    std::map<String, size>       pending_index;
+
+    sync::go        thread;
+    sync::Chan<int> done;  // closed by close, to abandon a blocked send
+
+    WatcherState(Watcher &w, WatchOptions const &opts) : w(w), opts(opts) {}
+
+    bool add_watch(str path, bool root, error err);
+    void add_tree(str path, bool report);
+    void remove_tree(str path);
+    void rescan();
+
+    void run();
+    void handle(struct inotify_event const *ev);
+    void note(str path, Op op);
+    void flush(bool all);
+    void report(str msg);
+} ;
+
+static String join(str dir, str name) {
+    String p = dir;
+    if (len(p) == 0 || p[len(p)-1] != '/') {
+        p += '/';
+    }
+    p += name;
+    return p;
+}
+
+// add_watch adds or refreshes the watch on path. mtx is held.
+bool internal::WatcherState::add_watch(str path, bool root, error err) {
+    // the root may be a plain file; everything below it is a directory
+    uint32 mask = root ? DirMask : DirMask | IN_ONLYDIR;
+    int wd = inotify_add_watch(inotify, CString(path), mask);
+    if (wd == -1) {
+        err(PathError("inotify_add_watch", path, os::Errno(errno)));
+        return false;
+    }
+
+    auto it = paths.find(wd);
+    if (it != paths.end() && it->second != path) {
+        wds.erase(it->second);
+    }
+    paths[wd] = path;
+    wds[path] = wd;
+    return true;
+}
+
+// add_tree watches every directory below path. With report, the entries
+// found are reported as created: they may have appeared before the watch
+// was in place. mtx is held.
+void internal::WatcherState::add_tree(str path, bool report) {
+    walk_dir(path, {.workers = 1}, [&](str p, FileMode type) {
+        if (uint32(type & ModeDir)) {
+            bool ok = add_watch(p, false, [&](Error &e) {
+                this->report(String(fmt::sprintf("%v", e)));
+            });
+            if (!ok) {
+                return Walk::SkipDir;
+            }
+        }
+        if (report && p != path) {
+            note(p, OpCreate);
+        }
+        return Walk::Continue;
+    }, [&](Error &e) {
+        this->report(String(fmt::sprintf("%v", e)));
+    });
+}
+
+// remove_tree drops the watches on path and below. mtx is held.
+void internal::WatcherState::remove_tree(str path) {
+    String prefix = join(path, "");
+    auto it = wds.lower_bound(String(path));
+    while (it != wds.end() && (it->first == path || strings::has_prefix(it->first, prefix))) {
+        inotify_rm_watch(inotify, it->second);
+        paths.erase(it->second);
+        it = wds.erase(it);
+    }
+}
+
+// rescan re-establishes all watches after the kernel dropped events.
+void internal::WatcherState::rescan() {
+    sync::Lock lock(mtx);
+    for (String const &root : roots) {
+        add_watch(root, true, [&](Error &e) {
+            report(String(fmt::sprintf("%v", e)));
+        });
+        if (opts.recursive) {
+            add_tree(root, false);
+        }
+        note(root, OpRescan);
+    }
+}
+
+void internal::WatcherState::report(str msg) {
+    sync::poll(sync::Send(w.errors, String(msg)));
+}
+
+void internal::WatcherState::note(str path, Op op) {
+    int64 now = time::clock().nsecs;
+
+    auto it = pending_index.find(String(path));
+    if (it != pending_index.end()) {
+        Pending &p = pending[it->second];
+        p.op = p.op | op;
+        p.last = now;
+        return;
+    }
+
+    pending_index[String(path)] = pending.size();
+    pending.push_back(Pending{path, op, now});
+}
+
+// flush delivers the events whose path has been quiet for the debounce
+// window, or all of them.
+void internal::WatcherState::flush(bool all) {
+    int64 cutoff = time::clock().nsecs - opts.debounce.nsecs;
+
+    std::vector<Pending> keep;
+    std::vector<Event> ready;
+    for (Pending &p : pending) {
+        if (all || p.last <= cutoff) {
+            ready.push_back(Event{std::move(p.path), p.op});
+        } else {
+            keep.push_back(std::move(p));
+        }
+    }
+
+    pending = std::move(keep);
+    pending_index.clear();
+    for (size i = 0; i < size(pending.size()); i++) {
+        pending_index[pending[i].path] = i;
+    }
+
+    for (Event &e : ready) {
+        if (sync::select(sync::Send(w.events, std::move(e)), sync::Recv(done)) == 1) {
+            return;
+        }
+    }
+}
+
+void internal::WatcherState::handle(struct inotify_event const *ev) {
+    if (ev->mask & IN_Q_OVERFLOW) {
+        rescan();
+        return;
+    }
+
+    sync::Lock lock(mtx);
+
+    auto it = paths.find(ev->wd);
+    if (it == paths.end()) {
+        return;
+    }
+    String dir = it->second;
+
+    if (ev->mask & IN_IGNORED) {
+        // the watch is gone: removed explicitly or its directory was deleted
+        wds.erase(dir);
+        paths.erase(ev->wd);
+        return;
+    }
+
+    if (ev->len == 0) {
+        // an event on the watched path itself
+        if (ev->mask & IN_DELETE_SELF) {
+            note(dir, OpRemove);
+        } else if (ev->mask & IN_MOVE_SELF) {
+            note(dir, OpRename);
+        } else if (ev->mask & (IN_MODIFY | IN_CLOSE_WRITE)) {
+            note(dir, OpWrite);
+        } else if (ev->mask & IN_ATTRIB) {
+            note(dir, OpChmod);
+        }
+        return;
+    }
+
+    String path = join(dir, str::from_c_str(ev->name));
+    bool is_dir = ev->mask & IN_ISDIR;
+
+    if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+        note(path, OpCreate);
+        if (is_dir && opts.recursive) {
+            add_tree(path, true);
+        }
+    }
+    if (ev->mask & IN_DELETE) {
+        note(path, OpRemove);
+    }
+    if (ev->mask & IN_MOVED_FROM) {
+        note(path, OpRename);
+        // a directory moved elsewhere in the tree is watched again under
+        // its new name when IN_MOVED_TO arrives
+        if (is_dir) {
+            remove_tree(path);
+        }
+    }
+    if (ev->mask & (IN_MODIFY | IN_CLOSE_WRITE)) {
+        note(path, OpWrite);
+    }
+    if (ev->mask & IN_ATTRIB) {
+        note(path, OpChmod);
+    }
+}
+
+void internal::WatcherState::run() {
+    alignas(struct inotify_event) byte b[64 * 1024];
+
+    for (;;) {
+        int timeout = -1;
+        if (!pending.empty()) {
+            int64 oldest = pending[0].last;
+            for (Pending const &p : pending) {
+                oldest = std::min(oldest, p.last);
+            }
+            int64 wait = oldest + opts.debounce.nsecs - time::clock().nsecs;
+            timeout = wait <= 0 ? 0 : int((wait + 999'999) / 1'000'000);
+        }
+
+        struct pollfd fds[2] = {
+            {.fd = inotify, .events = POLLIN, .revents = 0},
+            {.fd = wake,    .events = POLLIN, .revents = 0},
+        };
+        int r = ::poll(fds, 2, timeout);
+        if (r == -1 && errno != EINTR) {
+            report(String(fmt::sprintf("poll: %v", os::Errno(errno))));
+            return;
+        }
+
+        if (fds[1].revents) {
+            return;
+        }
+
+        if (fds[0].revents) {
+            for (;;) {
+                ssize_t n = ::read(inotify, b, sizeof b);
+                if (n <= 0) {
+                    break;
+                }
+                for (ssize_t off = 0; off < n; ) {
+                    struct inotify_event const *ev = (struct inotify_event const *) (b + off);
+                    handle(ev);
+                    off += sizeof(struct inotify_event) + ev->len;
+                }
+            }
+        }
+
+        flush(false);
+    }
+}
+
+fs::Watcher::Watcher(error err) : Watcher(WatchOptions{}, err) {}
+
+fs::Watcher::Watcher(WatchOptions const &opts, error err) :
+        events(opts.buffer),
+        errors(16),
+        state(std::make_unique<internal::WatcherState>(*this, opts)) {
+
+    state->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (state->inotify == -1) {
+        err(os::SyscallError("inotify_init1", errno));
+        return;
+    }
+    state->wake = eventfd(0, EFD_CLOEXEC);
+    if (state->wake == -1) {
+        err(os::SyscallError("eventfd", errno));
+        return;
+    }
+
+    internal::WatcherState *s = state.get();
+    state->thread = sync::go([s] { s->run(); });
+}
+
+void fs::Watcher::add(str path, error err) {
+    if (!state || state->wake == -1) {
+        return err(PathError("watch", path, ErrClosed()));
+    }
+
+    sync::Lock lock(state->mtx);
+    if (!state->add_watch(path, true, err)) {
+        return;
+    }
+    state->roots.push_back(path);
+
+    if (state->opts.recursive) {
+        state->add_tree(path, false);
+    }
+}
+
+void fs::Watcher::remove(str path, error err) {
+    if (!state || state->wake == -1) {
+        return err(PathError("watch", path, ErrClosed()));
+    }
+
+    sync::Lock lock(state->mtx);
+    auto it = std::find(state->roots.begin(), state->roots.end(), path);
+    if (it == state->roots.end()) {
+        return err(PathError("unwatch", path, ErrNotExist()));
+    }
+    state->roots.erase(it);
+
+    if (state->opts.recursive) {
+        state->remove_tree(path);
+    } else if (auto wd = state->wds.find(String(path)); wd != state->wds.end()) {
+        inotify_rm_watch(state->inotify, wd->second);
+        state->paths.erase(wd->second);
+        state->wds.erase(wd);
+    }
+}
+
+void fs::Watcher::close() {
+    if (!state) {
+        return;
+    }
+
+    if (state->wake != -1) {
+        state->done.close();
+        uint64 one = 1;
+        (void) !::write(state->wake, &one, sizeof one);
+        state->thread.join();
+        ::close(state->wake);
+    }
+    if (state->inotify != -1) {
+        ::close(state->inotify);
+    }
+    state.reset();
+
+    events.close();
+    errors.close();
+}
+
+fs::Watcher::~Watcher() {
+    close();
+}
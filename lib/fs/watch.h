@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+
+#include "fs.h"
+#include "lib/sync/chan.h"
+#include "lib/time/time.h"
+
+namespace lib::fs {
+
+    // Op describes a set of file operations.
+    struct Op : bitflag<uint32> {
+        using bitflag::bitflag;
+    } const
+        OpCreate = 1 << 0,  // a file or directory was created or moved in
+        OpWrite  = 1 << 1,  // a file was written to
+        OpRemove = 1 << 2,  // a file or directory was removed
+        OpRename = 1 << 3,  // a file or directory was moved away
+        OpChmod  = 1 << 4,  // attributes such as permissions changed
+
+        // Events were lost because the kernel queue overflowed. Anything
+        // under the path may have changed; the watches below it have been
+        // re-established.
+        OpRescan = 1 << 5;
+
+    // Event is a change to a watched file. Changes to one path within the
+    // debounce window are delivered as a single event whose op holds every
+    // kind of change seen.
+    struct Event {
+        String path;
+        Op     op;
+    } ;
+
+    struct WatchOptions {
+        // watch directories created below a watched directory too
+        bool recursive = true;
+
+        // how long a path must stay quiet before its event is delivered
+        time::duration debounce = 50 * time::millisecond;
+
+        // capacity of the events channel
+        int buffer = 256;
+    } ;
+
+    namespace internal {
+        struct WatcherState;
+    }
+
+    // Watcher reports changes to files and directories using inotify. Events
+    // are delivered on the events channel from a background thread, so a
+    // Watcher fits into a sync::select loop. Errors that happen in the
+    // background, such as running out of inotify watches, are delivered as
+    // messages on errors; if nobody receives them, they are dropped.
+    struct Watcher {
+        sync::Chan<Event>  events;
+        sync::Chan<String> errors;
+
+        Watcher(error err);
+        Watcher(WatchOptions const &opts, error err);
+        Watcher(Watcher const&) = delete;
+
+        // add starts watching path, a file or a directory. For a directory,
+        // changes to its entries are reported, and with opts.recursive those
+        // of every directory below it as well.
+        void add(str path, error err);
+
+        // remove stops watching path and, for a recursive watch, the
+        // directories below it.
+        void remove(str path, error err);
+
+        // close stops the watcher and closes the events and errors channels.
+        // Events still waiting out the debounce window are dropped.
+        void close();
+
+        ~Watcher();
+
+      private:
+        std::unique_ptr<internal::WatcherState> state;
+    } ;
+}
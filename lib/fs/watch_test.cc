@@ -0,0 +1,95 @@
+#include "watch.h"
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lib/os/file.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+static int remove_entry(const char *path, const struct stat *, int, struct FTW *) {
+    return ::remove(path);
+}
+
+static String join(str dir, str name) {
+    String p = dir;
+    p += '/';
+    p += name;
+    return p;
+}
+
+// wait_for receives events until one for path includes op, or a second has
+// passed. It returns the ops seen for path.
+static fs::Op wait_for(fs::Watcher &w, str path, fs::Op op) {
+    fs::Op seen;
+    for (int i = 0; i < 200; i++) {
+        fs::Event ev;
+        while (sync::poll(sync::Recv(w.events, &ev)) == 0) {
+            if (ev.path == path) {
+                seen = seen | ev.op;
+            }
+        }
+        if (seen.value & op.value) {
+            break;
+        }
+        time::sleep(5 * time::millisecond);
+    }
+    return seen;
+}
+
+void test_watcher(T &t) {
+    char tmpl[] = "/tmp/baselib-watch-test-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        t.fatalf("mkdtemp failed");
+    }
+    String dir = str(tmpl, strlen(tmpl));
+
+    fs::Watcher w({.debounce = 20 * time::millisecond}, error::panic);
+    w.add(dir, error::panic);
+
+    // a create followed by writes is coalesced into one event
+    String file = join(dir, "config");
+    os::write_file(file, "a", error::panic);
+    os::write_file(file, "b", error::panic);
+    fs::Op op = wait_for(w, file, fs::OpCreate);
+    if (!(op.value & fs::OpCreate.value) || !(op.value & fs::OpWrite.value)) {
+        t.errorf("%s: op = %#x; want create|write", file, op.value);
+    }
+
+    // directories created later are watched too
+    String sub = join(dir, "sub");
+    mkdir(CString(sub), 0755);
+    wait_for(w, sub, fs::OpCreate);
+    String nested = join(sub, "data");
+    os::write_file(nested, "x", error::panic);
+    op = wait_for(w, nested, fs::OpWrite);
+    if (!(op.value & fs::OpWrite.value)) {
+        t.errorf("%s: op = %#x; want write in new subdirectory", nested, op.value);
+    }
+
+    String moved = join(dir, "moved");
+    rename(CString(file), CString(moved));
+    op = wait_for(w, file, fs::OpRename);
+    if (!(op.value & fs::OpRename.value)) {
+        t.errorf("%s: op = %#x; want rename", file, op.value);
+    }
+
+    unlink(CString(moved));
+    op = wait_for(w, moved, fs::OpRemove);
+    if (!(op.value & fs::OpRemove.value)) {
+        t.errorf("%s: op = %#x; want remove", moved, op.value);
+    }
+
+    w.close();
+    bool ok = true;
+    w.events.recv(&ok);
+    if (ok) {
+        t.errorf("events channel still open after close");
+    }
+
+    nftw(tmpl, remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+}
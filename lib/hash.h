@@ -0,0 +1,4 @@
+#pragma once
+#include "hash/hash.h"
+#include "hash/crc32c.h"
+#include "hash/xxhash.h"
@@ -0,0 +1,145 @@
+#include "crc32c.h"
+
+#include <array>
+#include <bit>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+using namespace lib;
+using namespace lib::hash;
+
+// reversed Castagnoli polynomial
+static constexpr uint32 Castagnoli = 0x82f63b78;
+
+// tables[k][b] is the CRC of byte b followed by k zero bytes.
+static constexpr std::array<std::array<uint32, 256>, 8> make_tables() {
+    std::array<std::array<uint32, 256>, 8> t {};
+    for (uint32 i = 0; i < 256; i++) {
+        uint32 crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc & 1) ? (crc >> 1) ^ Castagnoli : crc >> 1;
+        }
+        t[0][i] = crc;
+    }
+    for (uint32 i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            t[k][i] = (t[k-1][i] >> 8) ^ t[0][t[k-1][i] & 0xff];
+        }
+    }
+    return t;
+}
+
+static constexpr auto tables = make_tables();
+
+static uint64 load64(const byte *p) {
+    uint64 v;
+    memcpy(&v, p, 8);
+    if constexpr (std::endian::native == std::endian::big) {
+        v = __builtin_bswap64(v);
+    }
+    return v;
+}
+
+// Slicing-by-8. Works on the inverted crc.
+static uint32 update_generic(uint32 crc, const byte *p, usize n) {
+    while (n >= 8) {
+        uint64 v = load64(p) ^ crc;
+        crc = tables[7][v & 0xff] ^
+              tables[6][(v >> 8) & 0xff] ^
+              tables[5][(v >> 16) & 0xff] ^
+              tables[4][(v >> 24) & 0xff] ^
+              tables[3][(v >> 32) & 0xff] ^
+              tables[2][(v >> 40) & 0xff] ^
+              tables[1][(v >> 48) & 0xff] ^
+              tables[0][v >> 56];
+        p += 8;
+        n -= 8;
+    }
+    while (n > 0) {
+        crc = tables[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+        p++;
+        n--;
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.2")))
+static uint32 update_sse42(uint32 crc, const byte *p, usize n) {
+    uint64 c = crc;
+    while (n >= 32) {
+        c = _mm_crc32_u64(c, load64(p));
+        c = _mm_crc32_u64(c, load64(p + 8));
+        c = _mm_crc32_u64(c, load64(p + 16));
+        c = _mm_crc32_u64(c, load64(p + 24));
+        p += 32;
+        n -= 32;
+    }
+    while (n >= 8) {
+        c = _mm_crc32_u64(c, load64(p));
+        p += 8;
+        n -= 8;
+    }
+
+    uint32 c32 = uint32(c);
+    while (n > 0) {
+        c32 = _mm_crc32_u8(c32, *p);
+        p++;
+        n--;
+    }
+    return c32;
+}
+
+static bool has_sse42 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}();
+
+static uint32 update_impl(uint32 crc, const byte *p, usize n) {
+    if (has_sse42) {
+        return update_sse42(crc, p, n);
+    }
+    return update_generic(crc, p, n);
+}
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+
+static uint32 update_arm(uint32 crc, const byte *p, usize n) {
+    while (n >= 8) {
+        crc = __crc32cd(crc, load64(p));
+        p += 8;
+        n -= 8;
+    }
+    while (n > 0) {
+        crc = __crc32cb(crc, *p);
+        p++;
+        n--;
+    }
+    return crc;
+}
+
+static uint32 update_impl(uint32 crc, const byte *p, usize n) {
+    return update_arm(crc, p, n);
+}
+
+#else
+
+static uint32 update_impl(uint32 crc, const byte *p, usize n) {
+    return update_generic(crc, p, n);
+}
+
+#endif
+
+uint32 hash::crc32c_update(uint32 crc, str data) {
+    return ~update_impl(~crc, (const byte*) data.data, usize(len(data)));
+}
+
+uint32 hash::crc32c(str data) {
+    return crc32c_update(0, data);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "hash.h"
+
+namespace lib::hash {
+
+    // crc32c returns the CRC-32 checksum of data using the Castagnoli
+    // polynomial, as used by iSCSI, ext4 and many storage formats.
+    //
+    // The SSE4.2 crc32 instruction (or the ARMv8 CRC extension) is used when
+    // the CPU has it; otherwise a slicing-by-8 table.
+    uint32 crc32c(str data);
+
+    // crc32c_update returns the result of adding data to crc.
+    uint32 crc32c_update(uint32 crc, str data);
+
+    struct CRC32C : Hash32 {
+        uint32 crc = 0;
+
+        void   update(str data) override { crc = crc32c_update(crc, data); }
+        void   reset() override          { crc = 0; }
+        uint32 sum32() const override    { return crc; }
+    } ;
+}
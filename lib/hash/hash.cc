@@ -0,0 +1,18 @@
+#include "hash.h"
+
+using namespace lib;
+using namespace lib::hash;
+
+void Hash32::sum(buf out) const {
+    uint32 s = sum32();
+    for (int i = 0; i < 4; i++) {
+        out[i] = byte(s >> (24 - 8*i));
+    }
+}
+
+void Hash64::sum(buf out) const {
+    uint64 s = sum64();
+    for (int i = 0; i < 8; i++) {
+        out[i] = byte(s >> (56 - 8*i));
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "lib/str.h"
+#include "lib/types.h"
+
+namespace lib::hash {
+
+    // Hash is the common interface implemented by all hash functions.
+    struct Hash {
+        // update adds more data to the running hash.
+        virtual void update(str data) = 0;
+
+        // reset resets the hash to its initial state.
+        virtual void reset() = 0;
+
+        // sum_size returns the number of bytes sum will produce.
+        virtual int sum_size() const = 0;
+
+        // sum writes the current hash, big-endian, into the first sum_size()
+        // bytes of out. It does not change the underlying hash state.
+        virtual void sum(buf out) const = 0;
+
+        virtual ~Hash() {}
+    } ;
+
+    struct Hash32 : Hash {
+        virtual uint32 sum32() const = 0;
+
+        int  sum_size() const override { return 4; }
+        void sum(buf out) const override;
+    } ;
+
+    struct Hash64 : Hash {
+        virtual uint64 sum64() const = 0;
+
+        int  sum_size() const override { return 8; }
+        void sum(buf out) const override;
+    } ;
+
+    struct Hash128 {
+        uint64 low  = 0;
+        uint64 high = 0;
+
+        constexpr bool operator==(Hash128 const&) const = default;
+    } ;
+}
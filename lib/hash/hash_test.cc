@@ -0,0 +1,133 @@
+#include "crc32c.h"
+#include "xxhash.h"
+
+#include "lib/testing/testing.h"
+#include "lib/testing/benchmark.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+static String long_input() {
+    String s;
+    for (int i = 0; i < 3000; i++) {
+        s += char((i * 7 + i / 13) % 251);
+    }
+    return s;
+}
+
+// The XXH64 and XXH3 values were produced with python-xxhash 4.0.1, which
+// wraps the reference xxHash C library. The CRC32C values are from a
+// bitwise implementation of the Castagnoli polynomial; 0xe3069283 for
+// "123456789" is the standard check value.
+struct golden {
+    str     in;
+    uint32  crc32c;
+    uint64  xxh64;
+    uint64  xxh3;
+    hash::Hash128 xxh3_128;
+} ;
+
+static golden goldens[] = {
+    {"", 0, 0xef46db3751d8e999, 0x2d06800538d394c2, {0x6001c324468d497f, 0x99aa06d3014798d8}},
+    {"a", 0xc1d04330, 0xd24ec4f1a98c6e5b, 0xe6c632b61e964e1f, {0xe6c632b61e964e1f, 0xa96faf705af16834}},
+    {"123456789", 0xe3069283, 0x8cb841db40e6ae83, 0x72dcb18b67a17dff, {0xe9716427681d5860, 0x33119477ede5dcd5}},
+    {"hello, world", 0x6999a41f, 0xb33a384e6d1b1242, 0x302cd5fba73d006c, {0x4c0abe17b55db69c, 0x11c83d9c1ee36816}},
+    {"The quick brown fox jumps over the lazy dog", 0x22620404, 0x0b242d361fda71bc, 0xce7d19a5418fb365, {0x24a1cc2e3a8a7651, 0xddd650205ca3e7fa}},
+};
+
+void test_hash_golden(T &t) {
+    String big = long_input();
+
+    for (golden g : goldens) {
+        if (uint32 got = hash::crc32c(g.in); got != g.crc32c) {
+            t.errorf("crc32c(%q) = %#x; want %#x", g.in, got, g.crc32c);
+        }
+        if (uint64 got = hash::xxh64(g.in); got != g.xxh64) {
+            t.errorf("xxh64(%q) = %#x; want %#x", g.in, got, g.xxh64);
+        }
+        if (uint64 got = hash::xxh3(g.in); got != g.xxh3) {
+            t.errorf("xxh3(%q) = %#x; want %#x", g.in, got, g.xxh3);
+        }
+        if (hash::Hash128 got = hash::xxh3_128(g.in); got != g.xxh3_128) {
+            t.errorf("xxh3_128(%q) = %#x %#x; want %#x %#x", g.in, got.high, got.low, g.xxh3_128.high, g.xxh3_128.low);
+        }
+    }
+
+    if (uint32 got = hash::crc32c(big); got != 0x08624aa1) {
+        t.errorf("crc32c(long) = %#x; want %#x", got, 0x08624aa1);
+    }
+    if (uint64 got = hash::xxh64(big); got != 0x50b37ec7aee6df86) {
+        t.errorf("xxh64(long) = %#x; want %#x", got, 0x50b37ec7aee6df86);
+    }
+    if (uint64 got = hash::xxh3(big); got != 0x22a86398becec0c0) {
+        t.errorf("xxh3(long) = %#x; want %#x", got, 0x22a86398becec0c0);
+    }
+    if (hash::Hash128 got = hash::xxh3_128(big); got != hash::Hash128{0x22a86398becec0c0, 0xa3ce0420d3989c01}) {
+        t.errorf("xxh3_128(long) = %#x %#x", got.high, got.low);
+    }
+}
+
+// Streaming in uneven pieces must agree with the one-shot functions at every
+// length, in particular around the 240-byte and block boundaries.
+void test_hash_streaming(T &t) {
+    String big = long_input();
+
+    for (size n = 0; n <= len(big); n += (n < 300 ? 1 : 97)) {
+        str in = big[0, n];
+
+        hash::CRC32C crc;
+        hash::XXH64  x64;
+        hash::XXH3   x3;
+
+        size step = 1;
+        for (size i = 0; i < n; ) {
+            size m = std::min(step, n - i);
+            crc.update(in[i, i+m]);
+            x64.update(in[i, i+m]);
+            x3.update(in[i, i+m]);
+            i += m;
+            step = step * 3 + 1;
+            if (step > 700) {
+                step = 5;
+            }
+        }
+
+        if (crc.sum32() != hash::crc32c(in)) {
+            t.errorf("len %d: streaming crc32c mismatch", n);
+        }
+        if (x64.sum64() != hash::xxh64(in)) {
+            t.errorf("len %d: streaming xxh64 mismatch", n);
+        }
+        if (x3.sum64() != hash::xxh3(in)) {
+            t.errorf("len %d: streaming xxh3 mismatch", n);
+        }
+        if (x3.sum128() != hash::xxh3_128(in)) {
+            t.errorf("len %d: streaming xxh3_128 mismatch", n);
+        }
+    }
+}
+
+static String benchmark_input() {
+    String chunk = long_input();
+    String data(1 << 20);
+    while (len(data) < (1 << 20)) {
+        data.append(chunk);
+    }
+    return data;
+}
+
+void benchmark_crc32c(testing::B &b) {
+    String data = benchmark_input();
+    b.bytes = int(len(data));
+    for (int i = 0; i < b.n; i++) {
+        hash::crc32c(data);
+    }
+}
+
+void benchmark_xxh3(testing::B &b) {
+    String data = benchmark_input();
+    b.bytes = int(len(data));
+    for (int i = 0; i < b.n; i++) {
+        hash::xxh3(data);
+    }
+}
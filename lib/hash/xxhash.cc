@@ -0,0 +1,708 @@
+#include "xxhash.h"
+
+#include <bit>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace lib;
+using namespace lib::hash;
+
+// Implementation of XXH64 and XXH3 following the xxHash specification
+// (https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md).
+
+static constexpr uint32 Prime32_1 = 0x9E3779B1U;
+static constexpr uint32 Prime32_2 = 0x85EBCA77U;
+static constexpr uint32 Prime32_3 = 0xC2B2AE3DU;
+
+static constexpr uint64 Prime64_1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64 Prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64 Prime64_3 = 0x165667B19E3779F9ULL;
+static constexpr uint64 Prime64_4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr uint64 Prime64_5 = 0x27D4EB2F165667C5ULL;
+
+static constexpr uint64 PrimeMx1 = 0x165667919E3779F9ULL;
+static constexpr uint64 PrimeMx2 = 0x9FB21C651E98DF25ULL;
+
+static uint64 read64(const byte *p) {
+    uint64 v;
+    memcpy(&v, p, 8);
+    if constexpr (std::endian::native == std::endian::big) {
+        v = __builtin_bswap64(v);
+    }
+    return v;
+}
+
+static uint32 read32(const byte *p) {
+    uint32 v;
+    memcpy(&v, p, 4);
+    if constexpr (std::endian::native == std::endian::big) {
+        v = __builtin_bswap32(v);
+    }
+    return v;
+}
+
+static uint64 rotl64(uint64 x, int r) {
+    return std::rotl(x, r);
+}
+
+// XXH64
+
+static uint64 xxh64_round(uint64 acc, uint64 input) {
+    acc += input * Prime64_2;
+    acc  = rotl64(acc, 31);
+    acc *= Prime64_1;
+    return acc;
+}
+
+static uint64 xxh64_merge_round(uint64 acc, uint64 val) {
+    val  = xxh64_round(0, val);
+    acc ^= val;
+    acc  = acc * Prime64_1 + Prime64_4;
+    return acc;
+}
+
+static uint64 xxh64_avalanche(uint64 h) {
+    h ^= h >> 33;
+    h *= Prime64_2;
+    h ^= h >> 29;
+    h *= Prime64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+// xxh64_finalize consumes the last len (< 32) bytes of input.
+static uint64 xxh64_finalize(uint64 h, const byte *p, usize len) {
+    while (len >= 8) {
+        h ^= xxh64_round(0, read64(p));
+        h  = rotl64(h, 27) * Prime64_1 + Prime64_4;
+        p += 8;
+        len -= 8;
+    }
+    if (len >= 4) {
+        h ^= uint64(read32(p)) * Prime64_1;
+        h  = rotl64(h, 23) * Prime64_2 + Prime64_3;
+        p += 4;
+        len -= 4;
+    }
+    while (len > 0) {
+        h ^= (*p) * Prime64_5;
+        h  = rotl64(h, 11) * Prime64_1;
+        p++;
+        len--;
+    }
+    return xxh64_avalanche(h);
+}
+
+static uint64 xxh64_merge(uint64 const v[4]) {
+    uint64 h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18);
+    for (int i = 0; i < 4; i++) {
+        h = xxh64_merge_round(h, v[i]);
+    }
+    return h;
+}
+
+static void xxh64_init(uint64 v[4], uint64 seed) {
+    v[0] = seed + Prime64_1 + Prime64_2;
+    v[1] = seed + Prime64_2;
+    v[2] = seed;
+    v[3] = seed - Prime64_1;
+}
+
+// xxh64_stripes consumes whole 32-byte stripes and returns the number of
+// bytes consumed.
+static usize xxh64_stripes(uint64 v[4], const byte *p, usize len) {
+    usize n = 0;
+    while (len - n >= 32) {
+        v[0] = xxh64_round(v[0], read64(p + n));
+        v[1] = xxh64_round(v[1], read64(p + n + 8));
+        v[2] = xxh64_round(v[2], read64(p + n + 16));
+        v[3] = xxh64_round(v[3], read64(p + n + 24));
+        n += 32;
+    }
+    return n;
+}
+
+uint64 hash::xxh64(str data, uint64 seed) {
+    const byte *p = (const byte*) data.data;
+    usize len = usize(data.len);
+
+    uint64 h;
+    usize n = 0;
+    if (len >= 32) {
+        uint64 v[4];
+        xxh64_init(v, seed);
+        n = xxh64_stripes(v, p, len);
+        h = xxh64_merge(v);
+    } else {
+        h = seed + Prime64_5;
+    }
+
+    h += len;
+    return xxh64_finalize(h, p + n, len - n);
+}
+
+hash::XXH64::XXH64(uint64 seed) : seed(seed) {
+    reset();
+}
+
+void hash::XXH64::reset() {
+    xxh64_init(this->v, this->seed);
+    this->total   = 0;
+    this->memsize = 0;
+}
+
+void hash::XXH64::update(str data) {
+    XXH64 &h = *this;
+    const byte *p = (const byte*) data.data;
+    usize len = usize(data.len);
+    h.total += len;
+
+    if (h.memsize + len < 32) {
+        memcpy(h.mem + h.memsize, p, len);
+        h.memsize += int(len);
+        return;
+    }
+
+    if (h.memsize > 0) {
+        usize fill = 32 - usize(h.memsize);
+        memcpy(h.mem + h.memsize, p, fill);
+        xxh64_stripes(h.v, h.mem, 32);
+        p   += fill;
+        len -= fill;
+        h.memsize = 0;
+    }
+
+    usize n = xxh64_stripes(h.v, p, len);
+    memcpy(h.mem, p + n, len - n);
+    h.memsize = int(len - n);
+}
+
+uint64 hash::XXH64::sum64() const {
+    XXH64 const &h = *this;
+
+    uint64 r;
+    if (h.total >= 32) {
+        r = xxh64_merge(h.v);
+    } else {
+        r = h.seed + Prime64_5;
+    }
+
+    r += h.total;
+    return xxh64_finalize(r, h.mem, usize(h.memsize));
+}
+
+// XXH3
+
+static constexpr int StripeLen       = 64;
+static constexpr int SecretSize      = 192;
+static constexpr int ConsumeRate     = 8;
+static constexpr int StripesPerBlock = (SecretSize - StripeLen) / ConsumeRate;
+static constexpr int BlockLen        = StripeLen * StripesPerBlock;
+static constexpr int MidsizeMax      = 240;
+
+alignas(64) static constexpr byte secret[SecretSize] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static Hash128 mul64to128(uint64 a, uint64 b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 p = (unsigned __int128) a * b;
+    return Hash128{uint64(p), uint64(p >> 64)};
+#else
+    uint64 lo_lo = (a & 0xffffffff) * (b & 0xffffffff);
+    uint64 hi_lo = (a >> 32) * (b & 0xffffffff);
+    uint64 lo_hi = (a & 0xffffffff) * (b >> 32);
+    uint64 hi_hi = (a >> 32) * (b >> 32);
+
+    uint64 cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    uint64 upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    uint64 lower = (cross << 32) | (lo_lo & 0xffffffff);
+    return Hash128{lower, upper};
+#endif
+}
+
+static uint64 mul128_fold64(uint64 a, uint64 b) {
+    Hash128 p = mul64to128(a, b);
+    return p.low ^ p.high;
+}
+
+static uint64 xxh3_avalanche(uint64 h) {
+    h ^= h >> 37;
+    h *= PrimeMx1;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint64 rrmxmx(uint64 h, uint64 len) {
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= PrimeMx2;
+    h ^= (h >> 35) + len;
+    h *= PrimeMx2;
+    h ^= h >> 28;
+    return h;
+}
+
+static uint64 mix16(const byte *p, const byte *s) {
+    return mul128_fold64(read64(p) ^ read64(s), read64(p + 8) ^ read64(s + 8));
+}
+
+static Hash128 mix32(Hash128 acc, const byte *p1, const byte *p2, const byte *s) {
+    acc.low  += mix16(p1, s);
+    acc.low  ^= read64(p2) + read64(p2 + 8);
+    acc.high += mix16(p2, s + 16);
+    acc.high ^= read64(p1) + read64(p1 + 8);
+    return acc;
+}
+
+// long input kernels
+
+static void accumulate512_scalar(uint64 *acc, const byte *p, const byte *s) {
+    for (int i = 0; i < 8; i++) {
+        uint64 v = read64(p + 8*i);
+        uint64 k = v ^ read64(s + 8*i);
+        acc[i ^ 1] += v;
+        acc[i]     += uint64(uint32(k)) * (k >> 32);
+    }
+}
+
+static void accumulate_scalar(uint64 *acc, const byte *p, const byte *s, int stripes) {
+    for (int n = 0; n < stripes; n++) {
+        accumulate512_scalar(acc, p + n*StripeLen, s + n*ConsumeRate);
+    }
+}
+
+static void scramble_scalar(uint64 *acc, const byte *s) {
+    for (int i = 0; i < 8; i++) {
+        uint64 a = acc[i];
+        a ^= a >> 47;
+        a ^= read64(s + 8*i);
+        a *= Prime32_1;
+        acc[i] = a;
+    }
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx2")))
+static void accumulate_avx2(uint64 *acc, const byte *p, const byte *s, int stripes) {
+    __m256i a0 = _mm256_load_si256((const __m256i*) acc);
+    __m256i a1 = _mm256_load_si256((const __m256i*) (acc + 4));
+
+    for (int n = 0; n < stripes; n++) {
+        const byte *in  = p + n*StripeLen;
+        const byte *key = s + n*ConsumeRate;
+
+        __m256i d0 = _mm256_loadu_si256((const __m256i*) in);
+        __m256i d1 = _mm256_loadu_si256((const __m256i*) (in + 32));
+        __m256i k0 = _mm256_xor_si256(d0, _mm256_loadu_si256((const __m256i*) key));
+        __m256i k1 = _mm256_xor_si256(d1, _mm256_loadu_si256((const __m256i*) (key + 32)));
+
+        // low 32 bits of each lane times its high 32 bits
+        __m256i p0 = _mm256_mul_epu32(k0, _mm256_srli_epi64(k0, 32));
+        __m256i p1 = _mm256_mul_epu32(k1, _mm256_srli_epi64(k1, 32));
+
+        // swap adjacent lanes: acc[i ^ 1] += data[i]
+        a0 = _mm256_add_epi64(a0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2)));
+        a1 = _mm256_add_epi64(a1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2)));
+        a0 = _mm256_add_epi64(a0, p0);
+        a1 = _mm256_add_epi64(a1, p1);
+    }
+
+    _mm256_store_si256((__m256i*) acc, a0);
+    _mm256_store_si256((__m256i*) (acc + 4), a1);
+}
+
+__attribute__((target("avx2")))
+static void scramble_avx2(uint64 *acc, const byte *s) {
+    const __m256i prime = _mm256_set1_epi32(int(Prime32_1));
+
+    for (int i = 0; i < 2; i++) {
+        __m256i a = _mm256_load_si256((const __m256i*) (acc + 4*i));
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i*) (s + 32*i)));
+
+        // 64x32-bit multiply from two 32x32 products
+        __m256i lo = _mm256_mul_epu32(a, prime);
+        __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+        a = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+
+        _mm256_store_si256((__m256i*) (acc + 4*i), a);
+    }
+}
+
+static bool has_avx2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}();
+
+static void accumulate(uint64 *acc, const byte *p, const byte *s, int stripes) {
+    if (has_avx2) {
+        accumulate_avx2(acc, p, s, stripes);
+    } else {
+        accumulate_scalar(acc, p, s, stripes);
+    }
+}
+
+static void scramble(uint64 *acc, const byte *s) {
+    if (has_avx2) {
+        scramble_avx2(acc, s);
+    } else {
+        scramble_scalar(acc, s);
+    }
+}
+
+#else
+
+static void accumulate(uint64 *acc, const byte *p, const byte *s, int stripes) {
+    accumulate_scalar(acc, p, s, stripes);
+}
+
+static void scramble(uint64 *acc, const byte *s) {
+    scramble_scalar(acc, s);
+}
+
+#endif
+
+static void init_acc(uint64 *acc) {
+    acc[0] = Prime32_3;
+    acc[1] = Prime64_1;
+    acc[2] = Prime64_2;
+    acc[3] = Prime64_3;
+    acc[4] = Prime64_4;
+    acc[5] = Prime32_2;
+    acc[6] = Prime64_5;
+    acc[7] = Prime32_1;
+}
+
+// hash_long accumulates all of p (len > MidsizeMax) into acc.
+static void hash_long(uint64 *acc, const byte *p, usize len) {
+    usize blocks = (len - 1) / BlockLen;
+    for (usize n = 0; n < blocks; n++) {
+        accumulate(acc, p + n*BlockLen, secret, StripesPerBlock);
+        scramble(acc, secret + SecretSize - StripeLen);
+    }
+
+    // last partial block
+    int stripes = int(((len - 1) - BlockLen*blocks) / StripeLen);
+    accumulate(acc, p + blocks*BlockLen, secret, stripes);
+
+    // last stripe
+    accumulate512_scalar(acc, p + len - StripeLen, secret + SecretSize - StripeLen - 7);
+}
+
+static uint64 merge_accs(uint64 const *acc, const byte *s, uint64 start) {
+    uint64 r = start;
+    for (int i = 0; i < 4; i++) {
+        r += mul128_fold64(acc[2*i] ^ read64(s + 16*i), acc[2*i + 1] ^ read64(s + 16*i + 8));
+    }
+    return xxh3_avalanche(r);
+}
+
+static uint64 xxh3_short(const byte *p, usize len) {
+    const byte *s = secret;
+
+    if (len > 16) {
+        uint64 acc = len * Prime64_1;
+        if (len > 128) {
+            for (int i = 0; i < 8; i++) {
+                acc += mix16(p + 16*i, s + 16*i);
+            }
+            acc = xxh3_avalanche(acc);
+
+            int rounds = int(len / 16);
+            for (int i = 8; i < rounds; i++) {
+                acc += mix16(p + 16*i, s + 16*(i - 8) + 3);
+            }
+            acc += mix16(p + len - 16, s + 136 - 17);
+            return xxh3_avalanche(acc);
+        }
+
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    acc += mix16(p + 48, s + 96);
+                    acc += mix16(p + len - 64, s + 112);
+                }
+                acc += mix16(p + 32, s + 64);
+                acc += mix16(p + len - 48, s + 80);
+            }
+            acc += mix16(p + 16, s + 32);
+            acc += mix16(p + len - 32, s + 48);
+        }
+        acc += mix16(p, s);
+        acc += mix16(p + len - 16, s + 16);
+        return xxh3_avalanche(acc);
+    }
+
+    if (len > 8) {
+        uint64 lo = read64(p) ^ (read64(s + 24) ^ read64(s + 32));
+        uint64 hi = read64(p + len - 8) ^ (read64(s + 40) ^ read64(s + 48));
+        uint64 acc = len + __builtin_bswap64(lo) + hi + mul128_fold64(lo, hi);
+        return xxh3_avalanche(acc);
+    }
+
+    if (len >= 4) {
+        uint64 in = read32(p + len - 4) + (uint64(read32(p)) << 32);
+        uint64 bitflip = read64(s + 8) ^ read64(s + 16);
+        return rrmxmx(in ^ bitflip, len);
+    }
+
+    if (len > 0) {
+        uint32 combined = (uint32(p[0]) << 16) | (uint32(p[len >> 1]) << 24) | uint32(p[len - 1]) | (uint32(len) << 8);
+        uint64 bitflip = read32(s) ^ read32(s + 4);
+        return xxh64_avalanche(combined ^ bitflip);
+    }
+
+    return xxh64_avalanche(read64(s + 56) ^ read64(s + 64));
+}
+
+static Hash128 xxh3_128_short(const byte *p, usize len) {
+    const byte *s = secret;
+
+    if (len > 16) {
+        Hash128 acc { len * Prime64_1, 0 };
+        if (len > 128) {
+            for (int i = 0; i < 4; i++) {
+                acc = mix32(acc, p + 32*i, p + 32*i + 16, s + 32*i);
+            }
+            acc.low  = xxh3_avalanche(acc.low);
+            acc.high = xxh3_avalanche(acc.high);
+
+            int rounds = int(len / 32);
+            for (int i = 4; i < rounds; i++) {
+                acc = mix32(acc, p + 32*i, p + 32*i + 16, s + 3 + 32*(i - 4));
+            }
+            acc = mix32(acc, p + len - 16, p + len - 32, s + 136 - 17 - 16);
+        } else {
+            if (len > 32) {
+                if (len > 64) {
+                    if (len > 96) {
+                        acc = mix32(acc, p + 48, p + len - 64, s + 96);
+                    }
+                    acc = mix32(acc, p + 32, p + len - 48, s + 64);
+                }
+                acc = mix32(acc, p + 16, p + len - 32, s + 32);
+            }
+            acc = mix32(acc, p, p + len - 16, s);
+        }
+
+        Hash128 h;
+        h.low  = acc.low + acc.high;
+        h.high = acc.low * Prime64_1 + acc.high * Prime64_4 + len * Prime64_2;
+        h.low  = xxh3_avalanche(h.low);
+        h.high = 0 - xxh3_avalanche(h.high);
+        return h;
+    }
+
+    if (len > 8) {
+        uint64 bitflipl = read64(s + 32) ^ read64(s + 40);
+        uint64 bitfliph = read64(s + 48) ^ read64(s + 56);
+        uint64 lo = read64(p);
+        uint64 hi = read64(p + len - 8);
+
+        Hash128 m = mul64to128(lo ^ hi ^ bitflipl, Prime64_1);
+        m.low += uint64(len - 1) << 54;
+        hi ^= bitfliph;
+        m.high += hi + uint64(uint32(hi)) * (Prime32_2 - 1);
+        m.low ^= __builtin_bswap64(m.high);
+
+        Hash128 h = mul64to128(m.low, Prime64_2);
+        h.high += m.high * Prime64_2;
+        h.low  = xxh3_avalanche(h.low);
+        h.high = xxh3_avalanche(h.high);
+        return h;
+    }
+
+    if (len >= 4) {
+        uint64 in = read32(p) + (uint64(read32(p + len - 4)) << 32);
+        uint64 bitflip = read64(s + 16) ^ read64(s + 24);
+
+        Hash128 m = mul64to128(in ^ bitflip, Prime64_1 + (len << 2));
+        m.high += m.low << 1;
+        m.low  ^= m.high >> 3;
+        m.low  ^= m.low >> 35;
+        m.low  *= PrimeMx2;
+        m.low  ^= m.low >> 28;
+        m.high  = xxh3_avalanche(m.high);
+        return m;
+    }
+
+    if (len > 0) {
+        uint32 lo = (uint32(p[0]) << 16) | (uint32(p[len >> 1]) << 24) | uint32(p[len - 1]) | (uint32(len) << 8);
+        uint32 hi = std::rotl(__builtin_bswap32(lo), 13);
+        uint64 bitflipl = read32(s) ^ read32(s + 4);
+        uint64 bitfliph = read32(s + 8) ^ read32(s + 12);
+        return Hash128{xxh64_avalanche(lo ^ bitflipl), xxh64_avalanche(hi ^ bitfliph)};
+    }
+
+    return Hash128{
+        xxh64_avalanche(read64(s + 64) ^ read64(s + 72)),
+        xxh64_avalanche(read64(s + 80) ^ read64(s + 88)),
+    };
+}
+
+static uint64 merge64(uint64 const *acc, uint64 len) {
+    return merge_accs(acc, secret + 11, len * Prime64_1);
+}
+
+static Hash128 merge128(uint64 const *acc, uint64 len) {
+    return Hash128{
+        merge_accs(acc, secret + 11, len * Prime64_1),
+        merge_accs(acc, secret + SecretSize - StripeLen - 11, ~(len * Prime64_2)),
+    };
+}
+
+uint64 hash::xxh3(str data) {
+    const byte *p = (const byte*) data.data;
+    usize len = usize(data.len);
+
+    if (len <= MidsizeMax) {
+        return xxh3_short(p, len);
+    }
+
+    alignas(32) uint64 acc[8];
+    init_acc(acc);
+    hash_long(acc, p, len);
+    return merge64(acc, len);
+}
+
+Hash128 hash::xxh3_128(str data) {
+    const byte *p = (const byte*) data.data;
+    usize len = usize(data.len);
+
+    if (len <= MidsizeMax) {
+        return xxh3_128_short(p, len);
+    }
+
+    alignas(32) uint64 acc[8];
+    init_acc(acc);
+    hash_long(acc, p, len);
+    return merge128(acc, len);
+}
+
+// streaming
+
+// consume_stripes accumulates whole stripes, scrambling at block boundaries.
+static void consume_stripes(uint64 *acc, int *so_far, const byte *p, int stripes) {
+    if (StripesPerBlock - *so_far <= stripes) {
+        int to_end = StripesPerBlock - *so_far;
+        int after  = stripes - to_end;
+        accumulate(acc, p, secret + *so_far * ConsumeRate, to_end);
+        scramble(acc, secret + SecretSize - StripeLen);
+        accumulate(acc, p + to_end*StripeLen, secret, after);
+        *so_far = after;
+    } else {
+        accumulate(acc, p, secret + *so_far * ConsumeRate, stripes);
+        *so_far += stripes;
+    }
+}
+
+static constexpr int BufferSize    = 256;
+static constexpr int BufferStripes = BufferSize / StripeLen;
+
+hash::XXH3::XXH3() {
+    reset();
+}
+
+void hash::XXH3::reset() {
+    init_acc(this->acc);
+    this->buffered = 0;
+    this->stripes  = 0;
+    this->total    = 0;
+}
+
+void hash::XXH3::update(str data) {
+    XXH3 &h = *this;
+    const byte *p = (const byte*) data.data;
+    usize len = usize(data.len);
+    h.total += len;
+
+    // The buffer is only consumed once more input arrives, so that the
+    // final stripe is always available to the digest.
+    if (len <= usize(BufferSize - h.buffered)) {
+        memcpy(h.buffer + h.buffered, p, len);
+        h.buffered += int(len);
+        return;
+    }
+
+    if (h.buffered > 0) {
+        usize fill = usize(BufferSize - h.buffered);
+        memcpy(h.buffer + h.buffered, p, fill);
+        p   += fill;
+        len -= fill;
+        consume_stripes(h.acc, &h.stripes, h.buffer, BufferStripes);
+        h.buffered = 0;
+    }
+
+    if (len > usize(BufferSize)) {
+        do {
+            consume_stripes(h.acc, &h.stripes, p, BufferStripes);
+            p   += BufferSize;
+            len -= BufferSize;
+        } while (len > usize(BufferSize));
+
+        // keep the last consumed stripe for the digest
+        memcpy(h.buffer + BufferSize - StripeLen, p - StripeLen, StripeLen);
+    }
+
+    memcpy(h.buffer, p, len);
+    h.buffered = int(len);
+}
+
+void hash::XXH3::digest(uint64 out[8]) const {
+    XXH3 const &h = *this;
+    memcpy(out, h.acc, sizeof h.acc);
+
+    const byte *last;
+    alignas(32) byte tmp[StripeLen];
+    if (h.buffered >= StripeLen) {
+        int stripes = (h.buffered - 1) / StripeLen;
+        int so_far  = h.stripes;
+        consume_stripes(out, &so_far, h.buffer, stripes);
+        last = h.buffer + h.buffered - StripeLen;
+    } else {
+        // the last stripe straddles the previous buffer contents
+        int prev = StripeLen - h.buffered;
+        memcpy(tmp, h.buffer + BufferSize - prev, usize(prev));
+        memcpy(tmp + prev, h.buffer, usize(h.buffered));
+        last = tmp;
+    }
+
+    accumulate512_scalar(out, last, secret + SecretSize - StripeLen - 7);
+}
+
+uint64 hash::XXH3::sum64() const {
+    XXH3 const &h = *this;
+    if (h.total <= MidsizeMax) {
+        return xxh3_short(h.buffer, usize(h.total));
+    }
+
+    alignas(32) uint64 acc[8];
+    h.digest(acc);
+    return merge64(acc, h.total);
+}
+
+Hash128 hash::XXH3::sum128() const {
+    XXH3 const &h = *this;
+    if (h.total <= MidsizeMax) {
+        return xxh3_128_short(h.buffer, usize(h.total));
+    }
+
+    alignas(32) uint64 acc[8];
+    h.digest(acc);
+    return merge128(acc, h.total);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "hash.h"
+
+namespace lib::hash {
+
+    // xxh64 returns the XXH64 hash of data.
+    uint64 xxh64(str data, uint64 seed = 0);
+
+    // xxh3 returns the 64-bit XXH3 hash of data.
+    uint64 xxh3(str data);
+
+    // xxh3_128 returns the 128-bit XXH3 hash of data.
+    Hash128 xxh3_128(str data);
+
+    // XXH64 is the streaming form of xxh64.
+    struct XXH64 : Hash64 {
+        XXH64(uint64 seed = 0);
+
+        void   update(str data) override;
+        void   reset() override;
+        uint64 sum64() const override;
+
+      private:
+        uint64 seed;
+        uint64 v[4];
+        uint64 total = 0;
+        byte   mem[32];
+        int    memsize = 0;
+    } ;
+
+    // XXH3 is the streaming form of xxh3 and xxh3_128. Long inputs are
+    // accumulated with AVX2 when the CPU has it.
+    struct XXH3 : Hash64 {
+        XXH3();
+
+        void    update(str data) override;
+        void    reset() override;
+        uint64  sum64() const override;
+        Hash128 sum128() const;
+
+      private:
+        alignas(32) uint64 acc[8];
+        alignas(32) byte   buffer[256];
+        int    buffered = 0;
+        int    stripes  = 0;   // stripes consumed in the current block
+        uint64 total    = 0;
+
+        void digest(uint64 out[8]) const;
+    } ;
+}
@@ -0,0 +1,251 @@
+#include "chain.h"
+
+#include <string.h>
+
+#include "lib/io/pool.h"
+
+using namespace lib;
+using namespace lib::io;
+
+// Invariants, once the first segment exists:
+//   - writebuf is the first uncommitted byte of the last segment, writeptr the
+//     current write position and writeend the end of that segment.
+//     writeend > writebuf always holds, so the base class never mistakes a
+//     full segment for an empty write buffer.
+//   - readptr points into the first segment; readptr - front.data is the
+//     number of bytes of that segment that have been read.
+
+// placeholder so the base class never allocates a read buffer of its own
+static byte empty;
+
+ChainBuffer::ChainBuffer() {
+    readbuf = buf(&empty, 0);
+    readptr = &empty;
+    readend = &empty;
+}
+
+void ChainBuffer::add_segment() {
+    ChainBuffer &b = *this;
+
+    Segment seg { .data = pool::get(SegmentSize), .len = 0 };
+    b.segs.push_back(seg);
+
+    b.writebuf = seg.data;
+    b.writeptr = seg.data;
+    b.writeend = seg.data + SegmentSize;
+
+    if (b.segs.size() == 1) {
+        b.readbuf = buf(seg.data, SegmentSize);
+        b.readptr = seg.data;
+        b.readend = seg.data;
+    }
+}
+
+void ChainBuffer::commit() {
+    ChainBuffer &b = *this;
+    if (b.segs.empty()) {
+        return;
+    }
+
+    b.segs.back().len += b.writeptr - b.writebuf;
+    b.writebuf = b.writeptr;
+
+    if (b.writeptr == b.writeend) {
+        b.add_segment();
+    }
+}
+
+void ChainBuffer::advance() {
+    ChainBuffer &b = *this;
+
+    while (!b.segs.empty()) {
+        Segment &front = b.segs.front();
+        if (b.readptr - front.data < front.len) {
+            return;
+        }
+
+        if (b.segs.size() == 1) {
+            // everything has been read: rewind the last segment for reuse
+            if (b.writeptr == b.writebuf) {
+                front.len = 0;
+                b.writebuf = front.data;
+                b.writeptr = front.data;
+                b.readptr  = front.data;
+                b.readend  = front.data;
+            }
+            return;
+        }
+
+        pool::put(front.data, SegmentSize);
+        b.segs.pop_front();
+
+        b.readptr = b.segs.front().data;
+        b.readend = b.readptr;
+    }
+}
+
+ReadResult ChainBuffer::direct_read(buf bytes, error) {
+    ChainBuffer &b = *this;
+    if (b.segs.empty()) {
+        return {0, true};
+    }
+
+    bool refill = bytes.data == b.readbuf.data;
+
+    b.commit();
+    b.advance();
+
+    Segment &front = b.segs.front();
+    size off = b.readptr - front.data;
+
+    if (refill) {
+        // Expose the unread run of the first segment in place. readbuf's
+        // length is only a capacity hint for the base class (reads smaller
+        // than a segment are served from here); it is never dereferenced
+        // past readend.
+        size n = front.len - off;
+        b.readbuf = buf(front.data + off, SegmentSize);
+        return {n, n == 0};
+    }
+
+    // large read: copy out across segments
+    size n = 0;
+    while (n < len(bytes)) {
+        Segment &seg = b.segs.front();
+        size avail = seg.len - (b.readptr - seg.data);
+        if (avail == 0) {
+            break;
+        }
+
+        size m = std::min(avail, len(bytes) - n);
+        memcpy(bytes.data + n, b.readptr, usize(m));
+        b.readptr += m;
+        n += m;
+
+        b.advance();
+    }
+
+    b.readend = b.readptr;
+    b.readbuf = buf(const_cast<byte*>(b.readptr), SegmentSize);
+    return {n, n == 0};
+}
+
+size ChainBuffer::direct_write(str data, error) {
+    ChainBuffer &b = *this;
+
+    if (b.writebuf != nil && data.data == (const char*) b.writebuf) {
+        // The base class is flushing the bytes written in place. They are
+        // already where they belong: commit them and report them as written.
+        // flush() rewinds writeptr by the returned count, so leave it that
+        // far past the new writebuf.
+        size n = len(data);
+        b.commit();
+        b.writeptr = b.writebuf + n;
+        return n;
+    }
+
+    if (b.segs.empty()) {
+        b.add_segment();
+    }
+    b.commit();
+
+    str p = data;
+    while (len(p) > 0) {
+        size m = std::min(size(b.writeend - b.writeptr), len(p));
+        memcpy(b.writeptr, p.data, usize(m));
+        b.writeptr += m;
+        p += m;
+
+        b.commit();
+    }
+
+    return len(data);
+}
+
+size ChainBuffer::write(str s) {
+    return write(s, error::ignore);
+}
+
+size ChainBuffer::write(char c) {
+    return write_byte(c, error::ignore);
+}
+
+size ChainBuffer::length() const {
+    ChainBuffer const &b = *this;
+    if (b.segs.empty()) {
+        return 0;
+    }
+
+    size n = b.writeptr - b.writebuf;
+    for (Segment const &seg : b.segs) {
+        n += seg.len;
+    }
+
+    return n - (b.readptr - b.segs.front().data);
+}
+
+view<str> ChainBuffer::segments() {
+    ChainBuffer &b = *this;
+    b.iov.clear();
+    if (b.segs.empty()) {
+        return {};
+    }
+
+    b.commit();
+    b.advance();
+
+    bool first = true;
+    for (Segment const &seg : b.segs) {
+        const byte *begin = first ? b.readptr : seg.data;
+        first = false;
+
+        size n = seg.len - (begin - seg.data);
+        if (n > 0) {
+            b.iov.push_back(str(begin, n));
+        }
+    }
+
+    return view<str>(b.iov.data(), b.iov.size());
+}
+
+void ChainBuffer::consume(size n) {
+    ChainBuffer &b = *this;
+    if (b.segs.empty()) {
+        return;
+    }
+
+    b.commit();
+    while (n > 0) {
+        b.advance();
+
+        Segment &front = b.segs.front();
+        size avail = front.len - (b.readptr - front.data);
+        if (avail == 0) {
+            break;
+        }
+
+        size m = std::min(avail, n);
+        b.readptr += m;
+        n -= m;
+    }
+    b.advance();
+
+    if (b.readend < b.readptr) {
+        b.readend = b.readptr;
+    }
+}
+
+String ChainBuffer::to_string() {
+    String s(length());
+    for (str seg : segments()) {
+        s.append(seg);
+    }
+    return s;
+}
+
+ChainBuffer::~ChainBuffer() {
+    for (Segment const &seg : this->segs) {
+        pool::put(seg.data, SegmentSize);
+    }
+    this->segs.clear();
+}
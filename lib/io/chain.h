@@ -0,0 +1,69 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "lib/io/io.h"
+#include "lib/io/pool.h"
+
+namespace lib::io {
+
+    // ChainBuffer is a byte buffer made of fixed-size segments drawn from
+    // io::pool. Unlike io::Buffer it never reallocates: appending only ever
+    // copies the appended bytes, and a segment that has been fully read is
+    // returned to the pool.
+    //
+    // Writes go straight into the free space of the last segment through the
+    // ReaderWriter write buffer, so fmt and strings writers work unchanged.
+    // Reads are served in place from the first segment.
+    //
+    // The unread contents can be exposed without copying with segments(),
+    // e.g. for writev, followed by consume() for the bytes actually sent.
+    struct ChainBuffer : ReaderWriter {
+        static constexpr size SegmentSize = 16 << 10;
+
+        ChainBuffer();
+        ChainBuffer(ChainBuffer const&) = delete;
+        ChainBuffer(ChainBuffer &&) = default;
+        ChainBuffer& operator=(ChainBuffer &&) = delete;
+
+        ReadResult direct_read(buf bytes, error err) override;
+        size       direct_write(str data, error err) override;
+
+        using ReaderWriter::write;
+        size write(str data);
+        size write(char c);
+
+        // length returns the number of unread bytes.
+        size length() const;
+
+        // segments returns the unread contents as a list of contiguous runs.
+        // The view is valid until the next call to a method of the buffer.
+        view<str> segments();
+
+        // consume discards the first n unread bytes.
+        void consume(size n);
+
+        // to_string returns a copy of the unread contents.
+        String to_string();
+
+        ~ChainBuffer();
+
+      private:
+        struct Segment {
+            byte *data = nil;
+            size  len  = 0;   // committed bytes
+        } ;
+
+        std::deque<Segment> segs;
+        std::vector<str>    iov;
+
+        // The last segment's bytes between writebuf and writeptr have been
+        // written through the fast path but not yet added to its len.
+        void commit();
+        void add_segment();
+
+        // advance releases fully consumed leading segments.
+        void advance();
+    } ;
+}
@@ -0,0 +1,106 @@
+#include "chain.h"
+
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+static String pattern(size n) {
+    String s;
+    for (size i = 0; i < n; i++) {
+        s += char('a' + i % 26);
+    }
+    return s;
+}
+
+void test_chain_buffer_write_read(T &t) {
+    io::ChainBuffer b;
+    String want = pattern(3 * io::ChainBuffer::SegmentSize + 123);
+
+    // mix small and large writes so both the in-place and copy paths are used
+    size i = 0;
+    while (i < len(want)) {
+        size n = std::min(i % 3 == 0 ? size(5000) : size(7), len(want) - i);
+        b.write(want[i, i+n]);
+        i += n;
+    }
+
+    if (b.length() != len(want)) {
+        t.fatalf("length() = %d; want %d", b.length(), len(want));
+    }
+    if (b.to_string() != want) {
+        t.errorf("to_string() does not match written data");
+    }
+
+    String got(len(want));
+    ErrorRecorder err;
+    while (true) {
+        byte chunk[1000];
+        io::ReadResult r = b.read(chunk, err);
+        got.append(str(chunk, r.nbytes));
+        if (r.eof || r.nbytes == 0) {
+            break;
+        }
+    }
+    if (err) {
+        t.fatalf("read: %v", err);
+    }
+    if (got != want) {
+        t.errorf("read back %d bytes, mismatched with %d written", len(got), len(want));
+    }
+    if (b.length() != 0) {
+        t.errorf("length() = %d after draining; want 0", b.length());
+    }
+}
+
+void test_chain_buffer_segments(T &t) {
+    io::ChainBuffer b;
+    String want = pattern(2 * io::ChainBuffer::SegmentSize + 10);
+    b.write(want);
+
+    view<str> segs = b.segments();
+    if (len(segs) != 3) {
+        t.errorf("len(segments()) = %d; want 3", len(segs));
+    }
+
+    String joined;
+    for (str s : segs) {
+        joined += s;
+    }
+    if (joined != want) {
+        t.errorf("segments do not concatenate to the written data");
+    }
+
+    b.consume(io::ChainBuffer::SegmentSize + 5);
+    segs = b.segments();
+    if (len(segs) != 2 || segs[0] != want[io::ChainBuffer::SegmentSize + 5, 2 * io::ChainBuffer::SegmentSize]) {
+        t.errorf("segments() after consume does not start at the read position");
+    }
+    if (b.length() != len(want) - io::ChainBuffer::SegmentSize - 5) {
+        t.errorf("length() = %d after consume", b.length());
+    }
+}
+
+void test_chain_buffer_byte_io(T &t) {
+    io::ChainBuffer b;
+    for (int i = 0; i < 40000; i++) {
+        b.write(char('0' + i % 10));
+    }
+
+    ErrorRecorder err;
+    for (int i = 0; i < 40000; i++) {
+        byte c = b.read_byte(err);
+        if (err) {
+            t.fatalf("read_byte %d: %v", i, err);
+        }
+        if (c != '0' + i % 10) {
+            t.fatalf("read_byte %d = %c; want %c", i, c, '0' + i % 10);
+        }
+    }
+
+    // the buffer is empty again and its last segment is reused
+    b.write("again");
+    if (b.to_string() != "again") {
+        t.errorf("to_string() = %q; want %q", b.to_string(), "again");
+    }
+}
@@ -0,0 +1,529 @@
+#include "gzip.h"
+
+#include <atomic>
+#include <deque>
+#include <string.h>
+
+#include <zlib.h>
+
+#include "lib/io/pool.h"
+#include "lib/io/util.h"
+#include "lib/sync/chan.h"
+#include "lib/sync/go.h"
+
+using namespace lib;
+using namespace lib::io;
+
+static constexpr size InSize  = 64 << 10;
+static constexpr size OutSize = 64 << 10;
+
+// zlib counts in uInt; larger inputs are fed in pieces of this size
+static constexpr size MaxChunk = 1 << 30;
+
+static void report(z_stream const &z, int ret, error err) {
+    if (ret == Z_DATA_ERROR && z.msg) {
+        str msg = str::from_c_str(z.msg);
+        if (msg == "incorrect data check" || msg == "incorrect length check") {
+            err(ErrGzipChecksum());
+            return;
+        }
+        if (msg == "incorrect header check" || msg == "unknown compression method" ||
+                msg == "unknown header flags set" || msg == "invalid window size") {
+            err(ErrGzipHeader());
+            return;
+        }
+        err(ErrGzipData());
+        return;
+    }
+
+    if (ret == Z_MEM_ERROR) {
+        panic("out of memory");
+    }
+
+    err("gzip: zlib error %d", ret);
+}
+
+// GzipReader
+
+io::GzipReader::GzipReader(Reader &in) : in(in), z(new z_stream{}) {
+    // 15+32: accept gzip and zlib headers
+    if (inflateInit2(z.get(), 15 + 32) != Z_OK) {
+        panic("inflateInit2 failed");
+    }
+    resize_readbuf(32 << 10);
+}
+
+// fill points the inflater at more input, in place in in's read buffer when
+// it has one. It returns false at EOF or on error.
+bool io::GzipReader::fill(error err) {
+    GzipReader &r = *this;
+
+    str s = r.in.peek_buffered(err);
+    if (err) {
+        return false;
+    }
+    if (len(s) > 0) {
+        r.z->next_in  = (Bytef*) s.data;
+        r.z->avail_in = uInt(std::min(len(s), MaxChunk));
+        r.borrowed    = r.z->avail_in;
+        return true;
+    }
+
+    // unbuffered source, or EOF
+    if (!r.inbuf) {
+        r.inbuf = pool::get(InSize);
+    }
+    ReadResult res = r.in.read(buf(r.inbuf, InSize), err);
+    if (res.nbytes == 0) {
+        return false;
+    }
+
+    r.z->next_in  = r.inbuf;
+    r.z->avail_in = uInt(res.nbytes);
+    r.borrowed    = 0;
+    return true;
+}
+
+// release consumes the input inflate has used from in's read buffer.
+void io::GzipReader::release() {
+    GzipReader &r = *this;
+    if (r.borrowed == 0) {
+        return;
+    }
+
+    size used = r.borrowed - r.z->avail_in;
+    if (used > 0) {
+        r.in.skip(used, error::ignore);
+    }
+    r.borrowed = r.z->avail_in;
+}
+
+ReadResult io::GzipReader::direct_read(buf bytes, error err) {
+    GzipReader &r = *this;
+    if (r.done) {
+        return {0, true};
+    }
+
+    z_stream &z = *r.z;
+    uInt want = uInt(std::min(len(bytes), MaxChunk));
+    z.next_out  = bytes.data;
+    z.avail_out = want;
+
+    for (;;) {
+        size n = want - z.avail_out;
+
+        if (r.member_end) {
+            // another gzip member may follow
+            if (z.avail_in == 0 && !r.fill(err)) {
+                if (err) {
+                    return {n, false};
+                }
+                r.done = true;
+                return {n, true};
+            }
+            inflateReset(&z);
+            r.member_end = false;
+        }
+
+        if (z.avail_in == 0 && !r.more_out && !r.fill(err)) {
+            if (!err) {
+                err(ErrUnexpectedEOF());
+            }
+            return {n, false};
+        }
+
+        int ret = inflate(&z, Z_NO_FLUSH);
+        r.release();
+
+        n = want - z.avail_out;
+        // a full output buffer means inflate may be holding more output
+        r.more_out = z.avail_out == 0;
+        if (ret == Z_STREAM_END) {
+            r.member_end = true;
+            r.more_out   = false;
+            if (n > 0) {
+                return {n, false};
+            }
+            continue;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            report(z, ret, err);
+            return {n, false};
+        }
+        if (n > 0) {
+            return {n, false};
+        }
+    }
+}
+
+size io::GzipReader::direct_write(str, error) {
+    panic("unimplemented");
+    return 0;
+}
+
+io::GzipReader::~GzipReader() {
+    inflateEnd(this->z.get());
+    if (this->inbuf) {
+        pool::put(this->inbuf, InSize);
+    }
+}
+
+// ParallelDeflate
+
+namespace {
+    struct Job {
+        byte       *in      = nil;
+        size        incap   = 0;
+        size        n       = 0;
+        const byte *dict    = nil;
+        size        dictlen = 0;
+
+        byte *out    = nil;
+        size  outcap = 0;
+        size  outlen = 0;
+        uLong crc    = 0;
+        bool  failed = false;
+
+        std::atomic<bool> done = false;
+    } ;
+}
+
+struct io::internal::ParallelDeflate {
+    int level;
+
+    sync::Chan<Job*>     jobs;
+    std::deque<sync::go> workers;
+
+    std::deque<Job*> pending;
+    size             max_pending;
+
+    bool started = false;
+
+    // input of the most recently written job; the next job's dictionary
+    byte *retained     = nil;
+    size  retained_cap = 0;
+    size  retained_len = 0;
+
+    uLong  crc   = crc32(0, nil, 0);
+    uint64 isize = 0;
+
+    ParallelDeflate(int level, int threads);
+    ~ParallelDeflate();
+
+    void start(Writer &out, error err);
+    void submit(byte *in, size incap, size n);
+    void drain(Writer &out, bool all, error err);
+};
+
+static void compress_job(z_stream &z, Job &j) {
+    deflateReset(&z);
+    if (j.dictlen > 0) {
+        deflateSetDictionary(&z, j.dict, uInt(j.dictlen));
+    }
+
+    // room for the sync flush marker on top of deflate's own bound
+    j.outcap = pool::class_size(size(deflateBound(&z, uLong(j.n))) + 16);
+    j.out    = pool::get(j.outcap);
+
+    z.next_in   = j.in;
+    z.avail_in  = uInt(j.n);
+    z.next_out  = j.out;
+    z.avail_out = uInt(j.outcap);
+
+    // a sync flush ends the block on a byte boundary so blocks can be joined
+    int ret = deflate(&z, Z_SYNC_FLUSH);
+    j.failed = ret != Z_OK || z.avail_in != 0;
+    j.outlen = j.outcap - z.avail_out;
+    j.crc    = crc32(0, j.in, uInt(j.n));
+}
+
+io::internal::ParallelDeflate::ParallelDeflate(int level, int threads) :
+    level(level), jobs(threads), max_pending(2 * threads) {
+
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back([this] {
+            z_stream z {};
+            if (deflateInit2(&z, this->level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                panic("deflateInit2 failed");
+            }
+
+            for (;;) {
+                Job *j = this->jobs.recv();
+                if (j == nil) {
+                    break;
+                }
+
+                compress_job(z, *j);
+                j->done.store(true, std::memory_order_release);
+                j->done.notify_one();
+            }
+
+            deflateEnd(&z);
+        });
+    }
+}
+
+void io::internal::ParallelDeflate::start(Writer &out, error err) {
+    if (this->started) {
+        return;
+    }
+    this->started = true;
+
+    // gzip header: no name, no mtime, unix
+    static const byte header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3};
+    out.write(str(header, 10), err);
+}
+
+void io::internal::ParallelDeflate::submit(byte *in, size incap, size n) {
+    ParallelDeflate &p = *this;
+
+    Job *j = new Job;
+    j->in    = in;
+    j->incap = incap;
+    j->n     = n;
+
+    byte *prev = nil;
+    size prevlen = 0;
+    if (!p.pending.empty()) {
+        prev    = p.pending.back()->in;
+        prevlen = p.pending.back()->n;
+    } else if (p.retained) {
+        prev    = p.retained;
+        prevlen = p.retained_len;
+    }
+    if (prev) {
+        j->dictlen = std::min(prevlen, size(32 << 10));
+        j->dict    = prev + prevlen - j->dictlen;
+    }
+
+    p.pending.push_back(j);
+    p.jobs.send(j);
+}
+
+// drain writes finished blocks to out in order, waiting for them if there are
+// too many in flight (or for all of them).
+void io::internal::ParallelDeflate::drain(Writer &out, bool all, error err) {
+    ParallelDeflate &p = *this;
+
+    while (!p.pending.empty() && (all || size(p.pending.size()) > p.max_pending)) {
+        Job *j = p.pending.front();
+        j->done.wait(false, std::memory_order_acquire);
+
+        if (j->failed) {
+            err(ErrGzipData());
+            return;
+        }
+
+        out.write(str(j->out, j->outlen), err);
+        if (err) {
+            return;
+        }
+
+        p.crc    = crc32_combine(p.crc, j->crc, z_off_t(j->n));
+        p.isize += uint64(j->n);
+
+        // this job's input is the next job's dictionary; the one before it
+        // is no longer referenced
+        if (p.retained) {
+            pool::put(p.retained, p.retained_cap);
+        }
+        p.retained     = j->in;
+        p.retained_cap = j->incap;
+        p.retained_len = j->n;
+
+        pool::put(j->out, j->outcap);
+        p.pending.pop_front();
+        delete j;
+    }
+}
+
+io::internal::ParallelDeflate::~ParallelDeflate() {
+    ParallelDeflate &p = *this;
+
+    p.jobs.close();
+    for (sync::go &w : p.workers) {
+        w.join();
+    }
+
+    for (Job *j : p.pending) {
+        pool::put(j->in, j->incap);
+        if (j->out) {
+            pool::put(j->out, j->outcap);
+        }
+        delete j;
+    }
+    if (p.retained) {
+        pool::put(p.retained, p.retained_cap);
+    }
+}
+
+// GzipWriter
+
+io::GzipWriter::GzipWriter(Writer &out, int level, int threads) : out(out) {
+    if (threads > 1) {
+        par.reset(new internal::ParallelDeflate(level, threads));
+    } else {
+        z.reset(new z_stream{});
+        // 15+16: gzip header and trailer
+        if (deflateInit2(z.get(), level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            panic("deflateInit2 failed");
+        }
+    }
+    resize_writebuf(BlockSize);
+}
+
+// deflate compresses data into out's write buffer, or through outbuf if out
+// has none.
+void io::GzipWriter::deflate(str data, int flush, error err) {
+    GzipWriter &w = *this;
+    z_stream &z = *w.z;
+
+    do {
+        size chunk = std::min(len(data), MaxChunk);
+        z.next_in  = (Bytef*) data.data;
+        z.avail_in = uInt(chunk);
+        data = data + chunk;
+
+        int mode = len(data) > 0 ? Z_NO_FLUSH : flush;
+        for (;;) {
+            buf space = w.out.write_space(64, err);
+            if (err) {
+                return;
+            }
+
+            bool direct = len(space) > 0;
+            if (!direct) {
+                if (!w.outbuf) {
+                    w.outbuf = pool::get(OutSize);
+                }
+                space = buf(w.outbuf, OutSize);
+            }
+
+            z.next_out  = space.data;
+            z.avail_out = uInt(std::min(len(space), MaxChunk));
+            size avail  = z.avail_out;
+
+            int ret = ::deflate(&z, mode);
+            if (ret == Z_STREAM_ERROR) {
+                report(z, ret, err);
+                return;
+            }
+
+            size n = avail - z.avail_out;
+            if (direct) {
+                w.out.write_commit(n);
+            } else {
+                w.out.write(str(w.outbuf, n), err);
+                if (err) {
+                    return;
+                }
+            }
+
+            if (mode == Z_FINISH ? ret == Z_STREAM_END : z.avail_out != 0) {
+                break;
+            }
+        }
+    } while (len(data) > 0);
+}
+
+ReadResult io::GzipWriter::direct_read(buf, error) {
+    panic("unimplemented");
+    return {};
+}
+
+size io::GzipWriter::direct_write(str data, error err) {
+    GzipWriter &w = *this;
+    if (w.closed) {
+        err("gzip: write after close");
+        return 0;
+    }
+
+    if (!w.par) {
+        w.deflate(data, Z_NO_FLUSH, err);
+        return err ? 0 : len(data);
+    }
+
+    w.par->start(w.out, err);
+    if (err) {
+        return 0;
+    }
+
+    if (data.data == (const char*) w.writebuf) {
+        // Hand the buffered block to the workers and give the writer a fresh
+        // buffer. flush() rewinds writeptr by the returned count, so leave it
+        // that far past the new writebuf.
+        size n = len(data);
+        size cap = w.writeend - w.writebuf;
+
+        w.par->submit(w.writebuf, cap, n);
+
+        w.writebuf = pool::get(cap);
+        w.writeend = w.writebuf + cap;
+        w.writeptr = w.writebuf + n;
+    } else {
+        str p = data;
+        while (len(p) > 0) {
+            size n = std::min(len(p), BlockSize);
+            byte *block = pool::get(BlockSize);
+            memcpy(block, p.data, usize(n));
+
+            w.par->submit(block, BlockSize, n);
+            p = p + n;
+
+            w.par->drain(w.out, false, err);
+            if (err) {
+                return 0;
+            }
+        }
+    }
+
+    w.par->drain(w.out, false, err);
+    return err ? 0 : len(data);
+}
+
+void io::GzipWriter::close(error err) {
+    GzipWriter &w = *this;
+    if (w.closed) {
+        return;
+    }
+
+    flush(err);
+    if (err) {
+        return;
+    }
+    w.closed = true;
+
+    if (!w.par) {
+        w.deflate("", Z_FINISH, err);
+        return;
+    }
+
+    w.par->start(w.out, err);
+    if (err) {
+        return;
+    }
+
+    w.par->drain(w.out, true, err);
+    if (err) {
+        return;
+    }
+
+    uint32 crc   = uint32(w.par->crc);
+    uint32 isize = uint32(w.par->isize);
+    byte trailer[10] = {
+        // empty final block
+        0x03, 0x00,
+        byte(crc), byte(crc >> 8), byte(crc >> 16), byte(crc >> 24),
+        byte(isize), byte(isize >> 8), byte(isize >> 16), byte(isize >> 24),
+    };
+    w.out.write(str(trailer, 10), err);
+}
+
+io::GzipWriter::~GzipWriter() {
+    if (this->z) {
+        deflateEnd(this->z.get());
+    }
+    if (this->outbuf) {
+        pool::put(this->outbuf, OutSize);
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <memory>
+
+#include "lib/io/io.h"
+
+struct z_stream_s;
+
+namespace lib::io {
+
+    struct ErrGzipHeader   : ErrorBase<ErrGzipHeader, "gzip: invalid header"> {};
+    struct ErrGzipChecksum : ErrorBase<ErrGzipChecksum, "gzip: invalid checksum"> {};
+    struct ErrGzipData     : ErrorBase<ErrGzipData, "gzip: corrupt data"> {};
+
+    namespace internal {
+        struct ParallelDeflate;
+    }
+
+    // GzipReader decompresses a gzip stream read from in. Concatenated gzip
+    // members are read as a single stream.
+    //
+    // Compressed input is consumed in place from in's read buffer, and
+    // decompressed output is written straight into the caller's buffer for
+    // large reads or into the reader's own buffer for small ones.
+    struct GzipReader : Buffered {
+        GzipReader(Reader &in);
+
+        ReadResult direct_read(buf bytes, error err) override;
+        size       direct_write(str data, error err) override;
+
+        ~GzipReader();
+
+      private:
+        Reader &in;
+        std::unique_ptr<z_stream_s> z;
+        size  borrowed   = 0;     // bytes of z->next_in that live in in's buffer
+        byte *inbuf      = nil;   // input buffer for an unbuffered source
+        bool  member_end = false;
+        bool  more_out   = false;
+        bool  done       = false;
+
+        bool fill(error err);
+        void release();
+    } ;
+
+    // GzipWriter compresses everything written to it as a gzip stream into
+    // out. Close must be called to write the gzip trailer; it does not close
+    // or flush out.
+    //
+    // Input is compressed in place from the writer's buffer, and compressed
+    // output is produced directly in out's write buffer when it has one.
+    //
+    // With threads > 1 the input is split into blocks that are compressed
+    // concurrently, each primed with the last 32 KiB of the block before it,
+    // and joined into a single deflate stream. Buffered blocks are handed to
+    // the workers without being copied.
+    struct GzipWriter : Buffered {
+        static constexpr int NoCompression      = 0;
+        static constexpr int BestSpeed          = 1;
+        static constexpr int BestCompression    = 9;
+        static constexpr int DefaultCompression = -1;
+
+        static constexpr size BlockSize = 128 << 10;
+
+        GzipWriter(Writer &out, int level = DefaultCompression, int threads = 1);
+
+        ReadResult direct_read(buf bytes, error err) override;
+        size       direct_write(str data, error err) override;
+
+        void close(error err) override;
+
+        ~GzipWriter();
+
+      private:
+        Writer &out;
+        std::unique_ptr<z_stream_s> z;
+        std::unique_ptr<internal::ParallelDeflate> par;
+        byte *outbuf = nil;   // output buffer for an unbuffered destination
+        bool  closed = false;
+
+        void deflate(str data, int flush, error err);
+    } ;
+}
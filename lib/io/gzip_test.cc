@@ -0,0 +1,112 @@
+#include "gzip.h"
+
+#include "lib/io/util.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+static String sample(size n) {
+    String s;
+    for (size i = 0; i < n; i++) {
+        // compressible, but not trivially so
+        s += char('a' + (i * 7 + i / 13) % 26);
+    }
+    return s;
+}
+
+static String gunzip(str compressed, error err) {
+    io::Str in(compressed);
+    io::GzipReader r(in);
+
+    String out;
+    byte chunk[4096];
+    for (;;) {
+        io::ReadResult res = r.read(chunk, err);
+        out.append(str(chunk, res.nbytes));
+        if (err || res.eof || res.nbytes == 0) {
+            return out;
+        }
+    }
+}
+
+static void test_round_trip(T &t, int threads) {
+    String want = sample(3 * io::GzipWriter::BlockSize + 1000);
+
+    io::Buffer compressed;
+    ErrorRecorder err;
+    {
+        io::GzipWriter w(compressed, io::GzipWriter::DefaultCompression, threads);
+        w.write(want[0, 10], err);
+        w.write(want[10, 200'000], err);
+        w.write(want[200'000, len(want)], err);
+        w.close(err);
+    }
+    if (err) {
+        t.fatalf("threads=%d: write: %v", threads, err);
+    }
+    if (compressed.length() >= len(want)) {
+        t.errorf("threads=%d: compressed size %d >= input size %d", threads, compressed.length(), len(want));
+    }
+
+    String got = gunzip(compressed.str(), err);
+    if (err) {
+        t.fatalf("threads=%d: read: %v", threads, err);
+    }
+    if (got != want) {
+        t.errorf("threads=%d: round trip mismatch: got %d bytes, want %d", threads, len(got), len(want));
+    }
+}
+
+void test_gzip_round_trip(T &t) {
+    test_round_trip(t, 1);
+}
+
+void test_gzip_round_trip_parallel(T &t) {
+    test_round_trip(t, 4);
+}
+
+void test_gzip_multistream(T &t) {
+    io::Buffer compressed;
+    ErrorRecorder err;
+    for (str part : {str("hello, "), str("world")}) {
+        io::GzipWriter w(compressed);
+        w.write(part, err);
+        w.close(err);
+    }
+
+    String got = gunzip(compressed.str(), err);
+    if (err) {
+        t.fatalf("read: %v", err);
+    }
+    if (got != "hello, world") {
+        t.errorf("got %q; want %q", got, "hello, world");
+    }
+}
+
+void test_gzip_corrupt(T &t) {
+    io::Buffer compressed;
+    ErrorRecorder err;
+    {
+        io::GzipWriter w(compressed);
+        w.write(sample(1000), err);
+        w.close(err);
+    }
+
+    String data = compressed.str();
+
+    // flip a bit in the CRC32 trailer
+    String bad = data;
+    bad[len(bad) - 8] ^= 1;
+    gunzip(bad, err);
+    if (!err) {
+        t.errorf("corrupt checksum: no error");
+    }
+
+    // truncated stream
+    ErrorRecorder err2;
+    gunzip(data[0, len(data) - 20], err2);
+    if (!err2) {
+        t.errorf("truncated stream: no error");
+    }
+}
@@ -0,0 +1,16 @@
+#include "hash.h"
+
+using namespace lib;
+using namespace lib::io;
+
+size io::HashWriter::direct_write(str data, error err) {
+    size n = this->out.write(data, err);
+    this->h.update(data[0, n]);
+    return n;
+}
+
+ReadResult io::HashReader::direct_read(buf bytes, error err) {
+    ReadResult r = this->in.read(bytes, err);
+    this->h.update(str(bytes.data, r.nbytes));
+    return r;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "lib/hash/hash.h"
+#include "lib/io/io.h"
+
+namespace lib::io {
+
+    // HashWriter writes to out and adds everything written to h on the way
+    // through, so data is hashed while it is still in cache rather than in a
+    // second pass. It has no buffer of its own.
+    struct HashWriter : Writer {
+        Writer     &out;
+        hash::Hash &h;
+
+        HashWriter(Writer &out, hash::Hash &h) : out(out), h(h) {}
+
+        size direct_write(str data, error err) override;
+    } ;
+
+    // HashReader reads from in and adds everything read to h. It has no
+    // buffer of its own, so reads go straight into the caller's buffer.
+    struct HashReader : Reader {
+        Reader     &in;
+        hash::Hash &h;
+
+        HashReader(Reader &in, hash::Hash &h) : in(in), h(h) {}
+
+        ReadResult direct_read(buf bytes, error err) override;
+    } ;
+}
@@ -0,0 +1,51 @@
+#include "hash.h"
+
+#include "lib/hash/crc32c.h"
+#include "lib/hash/xxhash.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+void test_hash_writer_reader(T &t) {
+    String data;
+    for (int i = 0; i < 10000; i++) {
+        data += char('a' + i % 23);
+    }
+
+    io::Buffer b;
+    hash::XXH3 wh;
+    io::HashWriter w(b, wh);
+
+    ErrorRecorder err;
+    w.write(data[0, 1], err);
+    w.write_byte(data[1], err);
+    w.write(data[2, len(data)], err);
+    if (err) {
+        t.fatalf("write: %v", err);
+    }
+
+    if (b.str() != data) {
+        t.errorf("HashWriter did not pass data through unchanged");
+    }
+    if (wh.sum64() != hash::xxh3(data)) {
+        t.errorf("HashWriter xxh3 = %#x; want %#x", wh.sum64(), hash::xxh3(data));
+    }
+
+    io::Str in(data);
+    hash::CRC32C rh;
+    io::HashReader r(in, rh);
+    for (;;) {
+        byte chunk[777];
+        io::ReadResult res = r.read(chunk, err);
+        if (err || res.eof || res.nbytes == 0) {
+            break;
+        }
+    }
+    if (err) {
+        t.fatalf("read: %v", err);
+    }
+    if (rh.sum32() != hash::crc32c(data)) {
+        t.errorf("HashReader crc32c = %#x; want %#x", rh.sum32(), hash::crc32c(data));
+    }
+}
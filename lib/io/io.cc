@@ -5,6 +5,7 @@
 #include "io.h"
 #include "lib/mem.h"
 #include "lib/str.h"
+#include "pool.h"
 #include "util.h"
 
 #include "lib/base.h"
@@ -122,6 +123,22 @@ str io::ReaderWriter::skip(size length, error err) {
     return s;
 }
 
+str io::ReaderWriter::peek_buffered(error err) {
+    if (readptr == readend) {
+        if (!check_readbuf(1)) {
+            return {};
+        }
+
+        ReadResult r = direct_read(readbuf, err);
+
+        LIB_CHECK(usize(r.nbytes) <= usize(len(readbuf)), exceptions::assertion);
+        readptr = readbuf.data;
+        readend = readptr + r.nbytes;
+    }
+
+    return str(readptr, readend - readptr);
+}
+
 str io::ReaderWriter::peek(size length, error err) {
     if (readptr == readend) [[unlikely]] {
         // buffer is empty
@@ -188,7 +205,7 @@ bool ReaderWriter::check_readbuf(size nbytes) {
         return false;
     }
     // print "io:L132";
-    readbuf.data = mem::alloc(newsize);
+    readbuf.data = pool::get(newsize);
     readbuf.len = newsize;
 
     readptr = readbuf.begin();
@@ -318,7 +335,7 @@ bool ReaderWriter::check_writebuf(size nbytes) {
         return false;
     }
 
-    writebuf = mem::alloc(newsize);
+    writebuf = pool::get(newsize);
     writeend = writebuf + newsize;
     writeptr = writebuf;
 
@@ -348,6 +365,28 @@ size io::ReaderWriter::write_repeated(char c, size cnt, error err) {
 }
 
 
+buf io::ReaderWriter::write_space(size min, error err) {
+    if (writeend - writeptr < min) {
+        if (!check_writebuf(min)) {
+            return {};
+        }
+
+        if (writeend - writeptr < min) {
+            flush(err);
+            if (err) {
+                return {};
+            }
+        }
+    }
+
+    return buf(writeptr, writeend - writeptr);
+}
+
+void io::ReaderWriter::write_commit(size n) {
+    LIB_CHECK(usize(n) <= usize(writeend - writeptr), exceptions::bad_index, n, writeend - writeptr);
+    writeptr += n;
+}
+
 size io::ReaderWriter::flush(error err) {
     LOGF("io::Stream::flush %p\n", this);
     // printf("<flush>");
@@ -477,7 +516,11 @@ void Buffered::resize_readbuf(size newsize) {
     size readptr_idx = std::min(uintptr(readptr - readbuf.data), uintptr(newsize));
     size readend_idx = std::min(uintptr(readend - readbuf.data), uintptr(newsize));
 
-    readbuf.data = mem::realloc(readbuf.data, newsize);
+    byte *data = pool::get(newsize);
+    memcpy(data, readbuf.data, usize(readend_idx));
+    pool::put(readbuf.data, readbuf.len);
+
+    readbuf.data = data;
     readbuf.len = newsize;
     readptr = readbuf.begin() + readptr_idx;
     readend = readbuf.begin() + readend_idx;
@@ -502,10 +545,14 @@ void Buffered::resize_writebuf(size newsize) {
     }
 
     // printf("<resize_writebuf %ld/%lx>", newsize, this);
-    size writeidx = writeptr - writebuf;
+    size writeidx = std::min(size(writeptr - writebuf), newsize);
     // printf("writeidx=%d\n", int(writeidx));
 
-    writebuf = mem::realloc(writebuf, newsize);
+    byte *data = pool::get(newsize);
+    memcpy(data, writebuf, usize(writeidx));
+    pool::put(writebuf, writeend - writebuf);
+
+    writebuf = data;
     writeptr = writebuf + writeidx;
     writeend = writebuf + newsize;
     // print "resize_writebuf\n";
@@ -513,12 +560,12 @@ void Buffered::resize_writebuf(size newsize) {
 
 Buffered::~Buffered() {
     if (uintptr(readbuf.data) != 0) {
-        ::free(readbuf.data);
+        pool::put(readbuf.data, readbuf.len);
         readbuf.data = nil;
     }
 
     if (uintptr(writebuf) > 1) {
-        ::free(writebuf);
+        pool::put(writebuf, writeend - writebuf);
         writebuf = nil;
     }
 //     print "destructed";
@@ -601,9 +648,18 @@ void io::Buffer::grow(size n) {
         newcap = 32;
     }
 
-    this->data = (byte*) ::realloc(this->data, newcap);
-    if (this->data == nil) {
-        exceptions::out_of_memory();
+    if (newcap < pool::MinSize) {
+        this->data = mem::realloc(this->data, newcap);
+    } else {
+        // round up to a pool size class so the buffer can be recycled
+        newcap = pool::class_size(newcap);
+
+        byte *newdata = pool::get(newcap);
+        if (this->data) {
+            memcpy(newdata, this->data, usize(used()));
+            pool::put(this->data, curcap);
+        }
+        this->data = newdata;
     }
     LOGF("io::Buffer::grow allocated %p %ld\n", data, newcap);
 
@@ -661,7 +717,7 @@ buf io::Buffer::buf() {
 
 io::Buffer::~Buffer() {
     if (this->data) {
-        ::free(this->data);
+        pool::put(this->data, capacity());
         this->data = nil;
     }
 }
@@ -65,6 +65,12 @@ namespace lib::io {
         // the advanced bytes
         str skip(size cnt, error err);
 
+        // peek_buffered returns the unread bytes of the read buffer, refilling
+        // it first if it is empty, so that adapters can consume input in place
+        // (followed by skip). It returns an empty str at EOF or if the reader
+        // has no read buffer.
+        str peek_buffered(error err);
+
         // read_string reads until the first occurrence of delim in the input,
         // returning a string containing the data up to and including the delimiter.
         // If ReadString encounters an error before finding a delimiter,
@@ -81,6 +87,14 @@ namespace lib::io {
         size write_repeated(char c, size cnt, error err);
 
         size write_available();
+
+        // write_space returns the free space of the write buffer, flushing it
+        // first if fewer than min bytes are free, so that adapters can produce
+        // output in place. Bytes stored into it are added to the output with
+        // write_commit. It returns an empty buf if the writer has no write
+        // buffer.
+        buf  write_space(size min, error err);
+        void write_commit(size n);
         size flush(error err);
 
         virtual void close(error) {}
@@ -108,6 +122,27 @@ namespace lib::io {
         ReadResult direct_read(buf, error) override final;
     };
 
+    // ReaderAt reads at an explicit offset of the underlying input. It does
+    // not use or move any stream position or buffer, so unlike read, read_at
+    // may be called on the same object from several threads at once.
+    struct ReaderAt {
+        // read_at reads len(bytes) bytes starting at offset off. It returns
+        // fewer bytes only at end of input, in which case eof is set, or on
+        // error.
+        virtual ReadResult read_at(buf bytes, int64 off, error err) = 0;
+        virtual ~ReaderAt() {}
+    } ;
+
+    // WriterAt writes at an explicit offset of the underlying output. Like
+    // ReaderAt, it does not use or move any stream position.
+    struct WriterAt {
+        // write_at writes all of data starting at offset off and returns the
+        // number of bytes written, which is less than len(data) only on
+        // error.
+        virtual size write_at(str data, int64 off, error err) = 0;
+        virtual ~WriterAt() {}
+    } ;
+
     ReaderWriter::operator Writer&() {
         return static_cast<Writer&>(*this);
     }
@@ -209,6 +244,12 @@ namespace lib::io {
         virtual void write_to(io::Writer &out, error) const = 0;
         virtual ~WriterTo() {}
 
+        // size_hint returns the number of bytes write_to will write, or -1 if
+        // that isn't known in advance. String uses it to allocate once.
+        virtual size size_hint() const {
+            return -1;
+        }
+
         void fmt(io::Writer &w, error) const;
     };
 
@@ -1,6 +1,8 @@
 #include "pipe.h"
 #include <memory>
 
+#include "lib/mem.h"
+
 using namespace lib;
 using namespace lib::io;
 using namespace lib::io::internal;
@@ -15,12 +17,27 @@ PipePair io::pipe() {
 
     return p;
  };
+
+PipePair io::pipe(size capacity) {
+    PipePair p = io::pipe();
+    if (capacity > 0) {
+        p.r->ring = std::make_unique<Ring>(capacity);
+    }
+
+    return p;
+ }
  
  ReadResult PipeReader::direct_read(buf bytes, error err) {
+    if (this->ring) {
+        return this->ring->read(bytes, err);
+    }
     return this->pipe.read(bytes, err);
  }
 
  size PipeWriter::direct_write(str data, error err) {
+    if (this->r->ring) {
+        return this->r->ring->write(data, err);
+    }
     return this->r->pipe.write(data, err);
  }
  
@@ -114,18 +131,30 @@ PipePair io::pipe() {
 
 
  void PipeReader::close(error) {
+    if (this->ring) {
+        return this->ring->close_read(nil);
+    }
     return this->pipe.close_read(nil);
  }
 
  void PipeReader::close_with_error(Error const &e) {
+    if (this->ring) {
+        return this->ring->close_read(&e);
+    }
     return this->pipe.close_read(&e);
  }
 
  void PipeWriter::close(error) {
+    if (this->r->ring) {
+        return this->r->ring->close_write(nil);
+    }
     return this->r->pipe.close_write(nil);
  }
 
  void PipeWriter::close_with_error(Error const &e) {
+    if (this->r->ring) {
+        return this->r->ring->close_write(&e);
+    }
     return this->r->pipe.close_write(&e);
  }
 
@@ -156,3 +185,200 @@ PipePair io::pipe() {
 
     p.once.run([&] { p.done.close(); });
  }
+
+
+ // Ring
+
+ internal::Ring::Ring(size capacity) {
+    uint64 cap = 1;
+    while (cap < uint64(capacity)) {
+        cap <<= 1;
+    }
+
+    this->data = mem::alloc(size(cap));
+    this->mask = cap - 1;
+ }
+
+ internal::Ring::~Ring() {
+    ::free(this->data);
+ }
+
+ void internal::Ring::wake() {
+    // order the preceding head/tail store before the sleepers load
+    std::atomic_thread_fence(std::memory_order::seq_cst);
+    if (this->sleepers.load() == 0) {
+        return;
+    }
+
+    this->seq.fetch_add(1);
+    this->seq.notify_all();
+ }
+
+ template <typename Cond>
+ void internal::Ring::sleep(Cond ready) {
+    uint32 s = this->seq.load();
+    this->sleepers.fetch_add(1);
+
+    // ready() must be re-checked after announcing ourselves as a sleeper:
+    // either the other side sees sleepers > 0 and bumps seq, or we see its
+    // update here.
+    if (!ready()) {
+        this->seq.wait(s);
+    }
+
+    this->sleepers.fetch_sub(1);
+ }
+
+ ReadResult internal::Ring::read(buf bytes, error err) {
+    Ring &p = *this;
+    sync::Lock lock(p.rd_mu);
+
+    for (;;) {
+        if (p.rd_done.load()) {
+            p.read_close_error(err);
+            return {0, true};
+        }
+
+        uint64 h = p.head.load(std::memory_order::relaxed);
+        uint64 t = p.tail.load(std::memory_order::acquire);
+
+        if (t != h) {
+            size n = std::min(len(bytes), size(t - h));
+            size off = size(h & p.mask);
+            size n1 = std::min(n, size(p.mask + 1) - off);
+
+            memcpy(bytes.data, p.data + off, usize(n1));
+            memcpy(bytes.data + n1, p.data, usize(n - n1));
+
+            p.head.store(h + uint64(n), std::memory_order::release);
+            p.wake();
+            return {n, false};
+        }
+
+        if (p.wr_done.load()) {
+            // the writer may have written its final bytes just before closing
+            if (p.tail.load(std::memory_order::acquire) != h) {
+                continue;
+            }
+
+            p.read_close_error(err);
+            return {0, true};
+        }
+
+        p.sleep([&] {
+            return p.tail.load() != h || p.rd_done.load() || p.wr_done.load();
+        });
+    }
+ }
+
+ size internal::Ring::write(str data, error err) {
+    Ring &p = *this;
+
+    if (p.rd_done.load() || p.wr_done.load()) {
+        p.write_close_error(err);
+        return 0;
+    }
+
+    sync::Lock lock(p.wr_mu);
+    size n = 0;
+    uint64 cap = p.mask + 1;
+
+    while (len(data) > 0) {
+        if (p.rd_done.load() || p.wr_done.load()) {
+            p.write_close_error(err);
+            return n;
+        }
+
+        uint64 t = p.tail.load(std::memory_order::relaxed);
+        uint64 h = p.head.load(std::memory_order::acquire);
+        size avail = size(cap - (t - h));
+
+        if (avail == 0) {
+            p.sleep([&] {
+                return p.head.load() != h || p.rd_done.load() || p.wr_done.load();
+            });
+            continue;
+        }
+
+        size m = std::min(avail, len(data));
+        size off = size(t & p.mask);
+        size m1 = std::min(m, size(cap) - off);
+
+        memcpy(p.data + off, data.data, usize(m1));
+        memcpy(p.data, data.data + m1, usize(m - m1));
+
+        p.tail.store(t + uint64(m), std::memory_order::release);
+        p.wake();
+
+        data = data + m;
+        n += m;
+    }
+
+    return n;
+ }
+
+ void internal::Ring::read_close_error(error err) {
+    Ring &p = *this;
+    sync::Lock lock(p.err_mu);
+
+    if (!p.rd_err) {
+        if (p.wr_err) {
+            err(p.wr_err.to_error());
+            return;
+        }
+
+        if (p.wr_closed) {
+            return;
+        }
+    }
+
+    err(ErrClosedPipe());
+ }
+
+ void internal::Ring::write_close_error(error err) {
+    Ring &p = *this;
+    sync::Lock lock(p.err_mu);
+
+    if (!p.wr_err && p.rd_err) {
+        err(p.rd_err.to_error());
+        return;
+    }
+
+    err(ErrClosedPipe());
+ }
+
+ void internal::Ring::close_read(Error const *e) {
+    Ring &p = *this;
+    {
+        sync::Lock lock(p.err_mu);
+
+        if (e != nil) {
+            p.rd_err.report(*e);
+        }
+
+        p.rd_done.store(true);
+    }
+
+    p.wake();
+ }
+
+ void internal::Ring::close_write(Error const *e) {
+    Ring &p = *this;
+    {
+        sync::Lock lock(p.err_mu);
+
+        if (p.wr_err.has_error || p.wr_closed) {
+            return;
+        }
+
+        if (e != nil) {
+            p.wr_err.report(*e);
+        } else {
+            p.wr_closed = true;
+        }
+
+        p.wr_done.store(true);
+    }
+
+    p.wake();
+ }
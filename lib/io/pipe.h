@@ -6,6 +6,7 @@
 #include "lib/sync/mutex.h"
 #include "lib/sync/once.h"
 
+#include <atomic>
 #include <memory>
 
 namespace lib::io {
@@ -31,9 +32,54 @@ namespace lib::io {
             void close_read(Error const *e);
             void close_write(Error const *e);
         } ;
+
+        // Ring is the backing store of a buffered pipe: a single-producer,
+        // single-consumer byte ring. Concurrent writers (and readers) are
+        // serialized by wr_mu (rd_mu) so that the ring itself only ever sees
+        // one producer and one consumer.
+        struct Ring {
+            byte  *data = nil;
+            uint64 mask = 0;   // capacity - 1; capacity is a power of two
+
+            alignas(64) std::atomic<uint64> head = 0;  // read position; advanced by the reader
+            alignas(64) std::atomic<uint64> tail = 0;  // write position; advanced by the writer
+
+            // Sleepers wait on seq; it is only bumped when sleepers > 0 so the
+            // fast path never makes a syscall.
+            alignas(64) std::atomic<uint32> seq = 0;
+            std::atomic<int>    sleepers = 0;
+
+            std::atomic<bool> rd_done = false;  // reader closed
+            std::atomic<bool> wr_done = false;  // writer closed
+
+            sync::Mutex rd_mu;  // Serializes read operations
+            sync::Mutex wr_mu;  // Serializes write operations
+
+            sync::Mutex err_mu;
+            ErrorRecorder wr_err;
+            ErrorRecorder rd_err;
+            bool wr_closed = false;
+
+            explicit Ring(size capacity);
+            ~Ring();
+
+            ReadResult read(buf bytes, error err);
+            size write(str data, error err);
+            void read_close_error(error err);
+            void write_close_error(error err);
+
+            void close_read(Error const *e);
+            void close_write(Error const *e);
+
+          private:
+            void wake();
+            template <typename Cond>
+            void sleep(Cond ready);
+        } ;
     };
     struct PipePair;
     PipePair pipe();
+    PipePair pipe(size capacity);
     struct PipeWriter;
 
     struct ErrClosedPipe : ErrorBase<ErrClosedPipe, "io: read/write on closed pipe"> {};
@@ -51,7 +97,9 @@ namespace lib::io {
 
       private:
         internal::Pipe pipe;
+        std::unique_ptr<internal::Ring> ring;  // non-nil for buffered pipes
         friend PipeWriter;
+        friend PipePair pipe(size);
     } ;
 
     struct PipeWriter : io::Writer {
@@ -86,4 +134,17 @@ namespace lib::io {
     // Parallel calls to Read and parallel calls to Write are also safe:
     // the individual calls will be gated sequentially.
     PipePair pipe();
+
+    // pipe(capacity) creates a buffered in-memory pipe backed by a ring of
+    // at least capacity bytes (rounded up to a power of two).
+    //
+    // Unlike the synchronous pipe, a Write returns as soon as its bytes have
+    // been copied into the ring; it blocks only while the ring is full. A Read
+    // blocks only while the ring is empty and returns whatever is buffered.
+    // After the write end is closed, Reads drain the remaining buffered data
+    // before reporting EOF (or the error passed to close_with_error).
+    //
+    // Close and error semantics are otherwise the same as for pipe().
+    // A capacity <= 0 returns a synchronous pipe.
+    PipePair pipe(size capacity);
 }
\ No newline at end of file
@@ -439,3 +439,90 @@ void test_pipe_cconcurrent(T &t) {
 		}
 	});
 }
+
+// Test that writes to a buffered pipe complete without a reader.
+void test_buffered_pipe(T &t) {
+	auto [r, w] = pipe(64);
+
+	for (int i = 0; i < 4; i++) {
+		ErrorRecorder err;
+		size n = w->write("hello, world", err);
+		if (n != 12 || err) {
+			t.fatalf("write %d: %d, %v", i, n, err);
+		}
+	}
+	w->close(error::ignore);
+
+	String got;
+	Array<byte, 16> b;
+	for (;;) {
+		ErrorRecorder err;
+		auto [n, eof] = r->read(b, err);
+		if (err) {
+			t.fatalf("read: %v", err);
+		}
+		got += b[0, n];
+		if (eof) {
+			break;
+		}
+	}
+
+	String want = strings::repeat("hello, world", 4);
+	if (got != want) {
+		t.errorf("got %q; want %q", got, want);
+	}
+}
+
+// Test a write larger than the ring, which must wrap around while a reader drains it.
+void test_buffered_pipe_large_write(T &t) {
+	sync::Chan<PipeReturn> c;
+	auto [r, w] = pipe(16);
+	lib::Buffer wdat(1000);
+	for (int i = 0; i < len(wdat); i++) {
+		wdat[i] = byte(i);
+	}
+	sync::go g1 = [&] { writer(*w, wdat, c); };
+
+	lib::Buffer rdat(1000);
+	size n = read_full(*r, rdat, [&](Error &err) {
+		t.fatalf("read: %v", err);
+	});
+	PipeReturn pr = c.recv();
+	if (pr.n != 1000 || pr.err) {
+		t.fatalf("write 1000: %d, %v", pr.n, pr.err);
+	}
+	if (n != 1000) {
+		t.fatalf("total read %d != 1000", n);
+	}
+	for (int i = 0; i < 1000; i++) {
+		if (rdat[i] != byte(i)) {
+			t.fatalf("rdat[%d] = %d", i, rdat[i]);
+		}
+	}
+}
+
+void test_buffered_pipe_close(T &t) {
+	struct TestError1 : ErrorBase<TestError1, "TestError1"> {};
+
+	PipePair p = pipe(8);
+	p.w->write("abc", error::ignore);
+	p.w->close_with_error(TestError1{});
+
+	// buffered data is drained before the close error is reported
+	Array<byte, 8> b;
+	if (ErrorRecorder err; p.r->read(b, err).nbytes != 3 || err) {
+		t.errorf("read: got err %v, want 3 bytes", err);
+	}
+	if (ErrorRecorder err; p.r->read(b, err), !err.is(TestError1{})) {
+		t.errorf("read error: got %v, want TestError1", err);
+	}
+
+	p = pipe(8);
+	p.r->close(error::ignore);
+	if (ErrorRecorder err; p.w->write("x", err), !err.is(ErrClosedPipe())) {
+		t.errorf("write error: got %v, want %v", err, ErrClosedPipe());
+	}
+	if (ErrorRecorder err; p.r->read(b, err), !err.is(ErrClosedPipe())) {
+		t.errorf("read error: got %v, want %v", err, ErrClosedPipe());
+	}
+}
@@ -0,0 +1,165 @@
+#include "pool.h"
+
+#include <atomic>
+#include <stdlib.h>
+
+#include "lib/mem.h"
+#include "lib/sync/lock.h"
+#include "lib/sync/mutex.h"
+
+using namespace lib;
+using namespace lib::io;
+
+namespace {
+    const int NumClasses  = 9;  // 4K, 8K, ..., 1M
+    const int MinShift    = 12;
+    const int ThreadSlots = 8;  // per size class
+
+    // Free blocks are chained through their first word so the pool never
+    // allocates bookkeeping of its own.
+    struct Block {
+        Block *next;
+    } ;
+
+    struct Central {
+        sync::Mutex mtx;
+        Block *head = nil;
+    } ;
+
+    Central central[NumClasses];
+
+    std::atomic<size> cached_bytes = 0;
+    std::atomic<size> limit_bytes  = 64 << 20;
+
+    int class_index(size n) {
+        if (n < pool::MinSize || n > pool::MaxSize || (n & (n - 1)) != 0) {
+            return -1;
+        }
+        return __builtin_ctzl(usize(n)) - MinShift;
+    }
+
+    struct ThreadCache {
+        Block *head[NumClasses] = {};
+        int    count[NumClasses] = {};
+
+        Block *pop(int c) {
+            Block *b = head[c];
+            if (b) {
+                head[c] = b->next;
+                count[c]--;
+            }
+            return b;
+        }
+
+        void push(int c, Block *b) {
+            b->next = head[c];
+            head[c] = b;
+            count[c]++;
+        }
+
+        // refill moves up to half a cache's worth of blocks from the
+        // central list in one locked operation.
+        void refill(int c) {
+            Central &ctl = central[c];
+            sync::Lock lock(ctl.mtx);
+            while (ctl.head && count[c] < ThreadSlots/2) {
+                Block *b = ctl.head;
+                ctl.head = b->next;
+                push(c, b);
+            }
+        }
+
+        // spill returns half of a full cache to the central list.
+        void spill(int c) {
+            Central &ctl = central[c];
+            sync::Lock lock(ctl.mtx);
+            while (count[c] > ThreadSlots/2) {
+                Block *b = pop(c);
+                b->next = ctl.head;
+                ctl.head = b;
+            }
+        }
+
+        ~ThreadCache() {
+            for (int c = 0; c < NumClasses; c++) {
+                if (!head[c]) {
+                    continue;
+                }
+
+                Central &ctl = central[c];
+                sync::Lock lock(ctl.mtx);
+                while (Block *b = pop(c)) {
+                    b->next = ctl.head;
+                    ctl.head = b;
+                }
+            }
+        }
+    } ;
+
+    thread_local ThreadCache cache;
+}
+
+size pool::class_size(size n) {
+    if (n <= 0 || n > MaxSize) {
+        return n;
+    }
+    if (n <= MinSize) {
+        return MinSize;
+    }
+    return size(1) << (64 - __builtin_clzl(usize(n - 1)));
+}
+
+byte *pool::get(size n) {
+    int c = class_index(n);
+    if (c < 0) {
+        return mem::alloc(n);
+    }
+
+    ThreadCache &tc = cache;
+    if (!tc.head[c]) {
+        tc.refill(c);
+    }
+
+    if (Block *b = tc.pop(c)) {
+        cached_bytes.fetch_sub(n, std::memory_order::relaxed);
+        return (byte*) b;
+    }
+
+    return mem::alloc(n);
+}
+
+void pool::put(byte *p, size n) {
+    if (p == nil) {
+        return;
+    }
+
+    int c = class_index(n);
+    if (c < 0) {
+        ::free(p);
+        return;
+    }
+
+    if (cached_bytes.fetch_add(n, std::memory_order::relaxed) + n > limit_bytes.load(std::memory_order::relaxed)) {
+        cached_bytes.fetch_sub(n, std::memory_order::relaxed);
+        ::free(p);
+        return;
+    }
+
+    ThreadCache &tc = cache;
+    if (tc.count[c] >= ThreadSlots) {
+        tc.spill(c);
+    }
+    tc.push(c, (Block*) p);
+}
+
+void pool::set_limit(size nbytes) {
+    limit_bytes.store(nbytes);
+}
+
+size pool::limit() {
+    return limit_bytes.load();
+}
+
+size pool::cached() {
+    return cached_bytes.load();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "lib/types.h"
+
+// pool is a process-wide cache of I/O buffers.
+//
+// Buffers whose size is a power of two between MinSize and MaxSize are
+// recycled through a small per-thread cache backed by a shared free list
+// per size class. Buffers of any other size go straight to malloc/free.
+//
+// Pooled buffers are ordinary malloc blocks, so a buffer obtained from get()
+// may be handed off to code that releases it with ::free (e.g. a String
+// built by io::Buffer::to_string); it simply leaves the pool.
+//
+// The pool is bounded: a buffer put() while the pool already holds limit()
+// bytes, across all threads, is freed instead of cached.
+namespace lib::io::pool {
+    const size MinSize = 4 << 10;
+    const size MaxSize = 1 << 20;
+
+    // class_size returns the capacity get() would use for a request of n
+    // bytes: n rounded up to a power of two if it falls in the pooled range,
+    // otherwise n itself.
+    size class_size(size n);
+
+    // get returns a buffer of exactly n bytes. If n is a pooled size class
+    // the buffer is taken from the pool when one is available.
+    byte *get(size n);
+
+    // put releases a buffer of n bytes obtained from get (or malloc).
+    // p may be nil.
+    void put(byte *p, size n);
+
+    // set_limit sets the maximum number of bytes cached by the pool.
+    // The default is 64 MiB.
+    void set_limit(size nbytes);
+    size limit();
+
+    // cached returns the number of bytes currently held by the pool.
+    size cached();
+}
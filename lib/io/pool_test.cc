@@ -0,0 +1,69 @@
+#include "pool.h"
+
+#include "lib/io/io.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+void test_pool_class_size(T &t) {
+    struct {
+        size n;
+        size want;
+    } tests[] = {
+        {1, io::pool::MinSize},
+        {4096, 4096},
+        {4097, 8192},
+        {100'000, 131072},
+        {1 << 20, 1 << 20},
+        {(1 << 20) + 1, (1 << 20) + 1},
+    };
+
+    for (auto &tt : tests) {
+        if (size got = io::pool::class_size(tt.n); got != tt.want) {
+            t.errorf("class_size(%d) = %d; want %d", tt.n, got, tt.want);
+        }
+    }
+}
+
+void test_pool_reuse(T &t) {
+    byte *p = io::pool::get(8192);
+    size before = io::pool::cached();
+
+    io::pool::put(p, 8192);
+    if (io::pool::cached() != before + 8192) {
+        t.errorf("cached() = %d after put; want %d", io::pool::cached(), before + 8192);
+    }
+
+    byte *q = io::pool::get(8192);
+    if (q != p) {
+        t.errorf("get after put did not return the recycled buffer");
+    }
+    io::pool::put(q, 8192);
+}
+
+void test_pool_limit(T &t) {
+    size old = io::pool::limit();
+    io::pool::set_limit(0);
+
+    size before = io::pool::cached();
+    io::pool::put(io::pool::get(4096), 4096);
+    if (io::pool::cached() != before) {
+        t.errorf("cached() = %d; want %d with zero limit", io::pool::cached(), before);
+    }
+
+    io::pool::set_limit(old);
+}
+
+void test_buffer_grow_pooled(T &t) {
+    io::Buffer b;
+    String want;
+    for (int i = 0; i < 10'000; i++) {
+        b.write("0123456789");
+        want += "0123456789";
+    }
+
+    if (b.str() != want) {
+        t.errorf("Buffer contents mismatch after growing to %d bytes", len(want));
+    }
+}
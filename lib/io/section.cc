@@ -0,0 +1,53 @@
+#include "section.h"
+
+#include <limits>
+
+using namespace lib;
+using namespace lib::io;
+
+io::SectionReader::SectionReader(ReaderAt &r, int64 off, int64 n) : r(r), base(off), off(off) {
+    if (off <= std::numeric_limits<int64>::max() - n) {
+        limit = off + n;
+    } else {
+        // overflow: read to the end of r
+        limit = std::numeric_limits<int64>::max();
+    }
+}
+
+ReadResult io::SectionReader::direct_read(buf bytes, error err) {
+    if (this->off >= this->limit) {
+        return {0, true};
+    }
+
+    int64 max = this->limit - this->off;
+    if (len(bytes) > max) {
+        bytes = bytes[0, size(max)];
+    }
+
+    ReadResult r = this->r.read_at(bytes, this->off, err);
+    this->off += r.nbytes;
+    if (this->off == this->limit) {
+        r.eof = true;
+    }
+    return r;
+}
+
+ReadResult io::SectionReader::read_at(buf bytes, int64 off, error err) {
+    if (off < 0 || off >= this->length()) {
+        return {0, true};
+    }
+
+    off += this->base;
+    int64 max = this->limit - off;
+    if (len(bytes) > max) {
+        bool failed = false;
+        ReadResult r = this->r.read_at(bytes[0, size(max)], off, [&](Error &e) {
+            failed = true;
+            err(e);
+        });
+        r.eof = !failed;
+        return r;
+    }
+
+    return this->r.read_at(bytes, off, err);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "lib/io/io.h"
+
+namespace lib::io {
+
+    // SectionReader reads the n bytes of r starting at offset off, as a
+    // stream and with read_at. Each SectionReader has its own position, so
+    // threads sharing one ReaderAt should each use their own SectionReader.
+    // It has no buffer of its own.
+    struct SectionReader : Reader, ReaderAt {
+        ReaderAt &r;
+        int64     base  = 0;
+        int64     off   = 0;
+        int64     limit = 0;
+
+        SectionReader(ReaderAt &r, int64 off, int64 n);
+
+        ReadResult direct_read(buf bytes, error err) override;
+
+        // read_at reads at offset off relative to the start of the section.
+        ReadResult read_at(buf bytes, int64 off, error err) override;
+
+        // length returns the size of the section in bytes.
+        int64 length() const { return limit - base; }
+    } ;
+}
@@ -0,0 +1,91 @@
+#include "section.h"
+
+#include "lib/io/util.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+namespace {
+    // StrAt is a ReaderAt over a string.
+    struct StrAt : io::ReaderAt {
+        str data;
+
+        StrAt(str data) : data(data) {}
+
+        io::ReadResult read_at(buf bytes, int64 off, error) override {
+            if (off >= len(data)) {
+                return {0, true};
+            }
+            size n = copy(bytes, data(size(off)));
+            return {n, n < len(bytes)};
+        }
+    } ;
+
+    struct FailAt : io::ReaderAt {
+        io::ReadResult read_at(buf, int64, error err) override {
+            err("read_at failed");
+            return {};
+        }
+    } ;
+}
+
+void test_section_reader(T &t) {
+    StrAt src = str("0123456789");
+
+    struct {
+        int64 off, n;
+        str   want;
+    } tests[] = {
+        {0, 10, "0123456789"},
+        {3, 4,  "3456"},
+        {8, 10, "89"},
+        {10, 5, ""},
+        {20, 5, ""},
+        {0, 0,  ""},
+    };
+
+    for (auto const &tt : tests) {
+        io::SectionReader s(src, tt.off, tt.n);
+
+        Array<byte, 16> b;
+        size n = io::read_full(s, b, error::ignore);
+        if (str(b)[0, n] != tt.want) {
+            t.errorf("SectionReader(%d, %d) read %q; want %q", tt.off, tt.n, str(b)[0, n], tt.want);
+        }
+    }
+
+    io::SectionReader s(src, 2, 5);
+    if (s.length() != 5) {
+        t.errorf("length() = %d; want 5", s.length());
+    }
+
+    Array<byte, 3> b;
+    io::ReadResult r = s.read_at(b, 1, error::panic);
+    if (str(b)[0, r.nbytes] != "345" || r.eof) {
+        t.errorf("read_at(1) = %q, eof %v; want \"345\", false", str(b)[0, r.nbytes], r.eof);
+    }
+    // exactly the rest of the section, which is not cut short
+    r = s.read_at(b, 2, error::panic);
+    if (str(b)[0, r.nbytes] != "456" || r.eof) {
+        t.errorf("read_at(2) = %q, eof %v; want \"456\", false", str(b)[0, r.nbytes], r.eof);
+    }
+    r = s.read_at(b, 3, error::panic);
+    if (str(b)[0, r.nbytes] != "56" || !r.eof) {
+        t.errorf("read_at(3) = %q, eof %v; want \"56\", true", str(b)[0, r.nbytes], r.eof);
+    }
+    r = s.read_at(b, 5, error::panic);
+    if (r.nbytes != 0 || !r.eof) {
+        t.errorf("read_at(5) = %d bytes, eof %v; want 0, true", r.nbytes, r.eof);
+    }
+
+    FailAt bad;
+    io::SectionReader sf(bad, 0, 2);
+    bool failed = false;
+    r = sf.read_at(b, 0, [&](Error &) {
+        failed = true;
+    });
+    if (!failed || r.eof) {
+        t.errorf("cut-short read_at from a failing reader: error %v, eof %v; want error, no eof", failed, r.eof);
+    }
+}
@@ -0,0 +1,199 @@
+#include "zstd.h"
+
+#include <zstd.h>
+
+#include "lib/io/pool.h"
+#include "lib/io/util.h"
+
+using namespace lib;
+using namespace lib::io;
+
+static constexpr size InSize  = 64 << 10;
+static constexpr size OutSize = 64 << 10;
+
+// ZstdReader
+
+io::ZstdReader::ZstdReader(Reader &in) : in(in), ctx(ZSTD_createDCtx()) {
+    if (!ctx) {
+        panic("out of memory");
+    }
+    resize_readbuf(32 << 10);
+}
+
+bool io::ZstdReader::fill(error err) {
+    ZstdReader &r = *this;
+
+    str s = r.in.peek_buffered(err);
+    if (err) {
+        return false;
+    }
+    if (len(s) > 0) {
+        r.input    = s;
+        r.borrowed = true;
+        return true;
+    }
+
+    // unbuffered source, or EOF
+    if (!r.inbuf) {
+        r.inbuf = pool::get(InSize);
+    }
+    ReadResult res = r.in.read(buf(r.inbuf, InSize), err);
+    if (res.nbytes == 0) {
+        return false;
+    }
+
+    r.input    = str(r.inbuf, res.nbytes);
+    r.borrowed = false;
+    return true;
+}
+
+void io::ZstdReader::release(size used) {
+    ZstdReader &r = *this;
+
+    r.input = r.input + used;
+    if (r.borrowed && used > 0) {
+        r.in.skip(used, error::ignore);
+    }
+}
+
+ReadResult io::ZstdReader::direct_read(buf bytes, error err) {
+    ZstdReader &r = *this;
+
+    ZSTD_outBuffer out = { bytes.data, usize(len(bytes)), 0 };
+    for (;;) {
+        if (len(r.input) == 0 && !r.more_out && !r.fill(err)) {
+            if (!err && !r.frame_end) {
+                err(ErrUnexpectedEOF());
+            }
+            return {size(out.pos), !err && r.frame_end};
+        }
+
+        ZSTD_inBuffer in = { r.input.data, usize(len(r.input)), 0 };
+        usize ret = ZSTD_decompressStream(r.ctx, &out, &in);
+        r.release(size(in.pos));
+
+        if (ZSTD_isError(ret)) {
+            err("zstd: %s", str::from_c_str(ZSTD_getErrorName(ret)));
+            return {size(out.pos), false};
+        }
+
+        // 0 means a frame was fully decoded and flushed; a full output buffer
+        // means the decoder may be holding more output
+        r.frame_end = ret == 0;
+        r.more_out  = out.pos == out.size;
+        if (out.pos > 0) {
+            return {size(out.pos), false};
+        }
+    }
+}
+
+size io::ZstdReader::direct_write(str, error) {
+    panic("unimplemented");
+    return 0;
+}
+
+io::ZstdReader::~ZstdReader() {
+    ZSTD_freeDCtx(this->ctx);
+    if (this->inbuf) {
+        pool::put(this->inbuf, InSize);
+    }
+}
+
+// ZstdWriter
+
+io::ZstdWriter::ZstdWriter(Writer &out, int level, int threads) : out(out), ctx(ZSTD_createCCtx()) {
+    if (!ctx) {
+        panic("out of memory");
+    }
+
+    ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, level);
+    if (threads > 0) {
+        // ignored by a libzstd built without multithreading support
+        ZSTD_CCtx_setParameter(ctx, ZSTD_c_nbWorkers, threads);
+    }
+
+    resize_writebuf(size(ZSTD_CStreamInSize()));
+}
+
+// compress feeds data to the compressor, producing output directly in out's
+// write buffer, or through outbuf if out has none.
+void io::ZstdWriter::compress(str data, bool end, error err) {
+    ZstdWriter &w = *this;
+
+    ZSTD_inBuffer in = { data.data, usize(len(data)), 0 };
+    ZSTD_EndDirective mode = end ? ZSTD_e_end : ZSTD_e_continue;
+
+    for (;;) {
+        buf space = w.out.write_space(64, err);
+        if (err) {
+            return;
+        }
+
+        bool direct = len(space) > 0;
+        if (!direct) {
+            if (!w.outbuf) {
+                w.outbuf = pool::get(OutSize);
+            }
+            space = buf(w.outbuf, OutSize);
+        }
+
+        ZSTD_outBuffer out = { space.data, usize(len(space)), 0 };
+        usize ret = ZSTD_compressStream2(w.ctx, &out, &in, mode);
+        if (ZSTD_isError(ret)) {
+            err("zstd: %s", str::from_c_str(ZSTD_getErrorName(ret)));
+            return;
+        }
+
+        if (direct) {
+            w.out.write_commit(size(out.pos));
+        } else {
+            w.out.write(str(w.outbuf, size(out.pos)), err);
+            if (err) {
+                return;
+            }
+        }
+
+        // with e_end, ret is the amount still to be flushed
+        if (end ? ret == 0 : in.pos == in.size) {
+            return;
+        }
+    }
+}
+
+ReadResult io::ZstdWriter::direct_read(buf, error) {
+    panic("unimplemented");
+    return {};
+}
+
+size io::ZstdWriter::direct_write(str data, error err) {
+    ZstdWriter &w = *this;
+    if (w.closed) {
+        err("zstd: write after close");
+        return 0;
+    }
+
+    w.compress(data, false, err);
+    return err ? 0 : len(data);
+}
+
+void io::ZstdWriter::close(error err) {
+    ZstdWriter &w = *this;
+    if (w.closed) {
+        return;
+    }
+
+    flush(err);
+    if (err) {
+        return;
+    }
+    w.closed = true;
+
+    w.compress("", true, err);
+}
+
+io::ZstdWriter::~ZstdWriter() {
+    ZSTD_freeCCtx(this->ctx);
+    if (this->outbuf) {
+        pool::put(this->outbuf, OutSize);
+    }
+}
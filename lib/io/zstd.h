@@ -0,0 +1,62 @@
+#pragma once
+
+#include "lib/io/io.h"
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
+namespace lib::io {
+
+    // ZstdReader decompresses a zstd stream read from in. Concatenated frames
+    // are read as a single stream.
+    //
+    // Like GzipReader, compressed input is consumed in place from in's read
+    // buffer and output is written straight into the destination buffer.
+    struct ZstdReader : Buffered {
+        ZstdReader(Reader &in);
+
+        ReadResult direct_read(buf bytes, error err) override;
+        size       direct_write(str data, error err) override;
+
+        ~ZstdReader();
+
+      private:
+        Reader      &in;
+        ZSTD_DCtx_s *ctx;
+        str          input;              // unconsumed input
+        bool         borrowed  = false;  // input lives in in's read buffer
+        bool         frame_end = true;
+        bool         more_out  = false;
+        byte        *inbuf     = nil;
+
+        bool fill(error err);
+        void release(size used);
+    } ;
+
+    // ZstdWriter compresses everything written to it as a zstd frame into
+    // out. Close must be called to end the frame; it does not close or flush
+    // out.
+    //
+    // With threads > 0 compression runs on that many zstd worker threads
+    // while the caller keeps writing.
+    struct ZstdWriter : Buffered {
+        static constexpr int DefaultCompression = 3;
+
+        ZstdWriter(Writer &out, int level = DefaultCompression, int threads = 0);
+
+        ReadResult direct_read(buf bytes, error err) override;
+        size       direct_write(str data, error err) override;
+
+        void close(error err) override;
+
+        ~ZstdWriter();
+
+      private:
+        Writer      &out;
+        ZSTD_CCtx_s *ctx;
+        byte        *outbuf = nil;
+        bool         closed = false;
+
+        void compress(str data, bool end, error err);
+    } ;
+}
@@ -0,0 +1,154 @@
+// zstd.cc is left out of the library when libzstd isn't installed; see
+// CMakeLists.txt
+#if __has_include(<zstd.h>)
+
+#include "zstd.h"
+
+#include <algorithm>
+
+#include "lib/io/util.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+static String sample(size n) {
+    String s;
+    for (size i = 0; i < n; i++) {
+        // compressible, but not trivially so
+        s += char('a' + (i * 7 + i / 13) % 26);
+    }
+    return s;
+}
+
+namespace {
+    // Unbuffered returns at most n bytes per read and has no read buffer, so
+    // a ZstdReader reading from it can't consume its input in place.
+    struct Unbuffered : io::Reader {
+        str  data;
+        size n;
+
+        Unbuffered(str data, size n) : data(data), n(n) {}
+
+        io::ReadResult direct_read(buf b, error) override {
+            size m = copy(b.slice(0, std::min(n, len(b))), data);
+            data = data(m);
+            return {m, len(data) == 0};
+        }
+    } ;
+}
+
+static String unzstd(io::Reader &in, error err) {
+    io::ZstdReader r(in);
+
+    String out;
+    byte chunk[4096];
+    for (;;) {
+        io::ReadResult res = r.read(chunk, err);
+        out.append(str(chunk, res.nbytes));
+        if (err || res.eof || res.nbytes == 0) {
+            return out;
+        }
+    }
+}
+
+static String zstd(str data, int threads, error err) {
+    io::Buffer compressed;
+    io::ZstdWriter w(compressed, io::ZstdWriter::DefaultCompression, threads);
+    w.write(data[0, 10], err);
+    w.write(data[10, len(data)], err);
+    w.close(err);
+    return compressed.to_string();
+}
+
+static void test_round_trip(T &t, int threads) {
+    String want = sample(3 << 20);
+
+    ErrorRecorder err;
+    String compressed = zstd(want, threads, err);
+    if (err) {
+        t.fatalf("threads=%d: write: %v", threads, err);
+    }
+    if (len(compressed) >= len(want)) {
+        t.errorf("threads=%d: compressed size %d >= input size %d", threads, len(compressed), len(want));
+    }
+
+    io::Str in(compressed);
+    String got = unzstd(in, err);
+    if (err) {
+        t.fatalf("threads=%d: read: %v", threads, err);
+    }
+    if (got != want) {
+        t.errorf("threads=%d: round trip mismatch: got %d bytes, want %d", threads, len(got), len(want));
+    }
+}
+
+void test_zstd_round_trip(T &t) {
+    test_round_trip(t, 0);
+}
+
+void test_zstd_round_trip_parallel(T &t) {
+    test_round_trip(t, 4);
+}
+
+void test_zstd_concatenated(T &t) {
+    io::Buffer compressed;
+    ErrorRecorder err;
+    for (str part : {str("hello, "), str("world")}) {
+        io::ZstdWriter w(compressed);
+        w.write(part, err);
+        w.close(err);
+    }
+
+    io::Str in(compressed.str());
+    String got = unzstd(in, err);
+    if (err) {
+        t.fatalf("read: %v", err);
+    }
+    if (got != "hello, world") {
+        t.errorf("got %q; want %q", got, "hello, world");
+    }
+}
+
+void test_zstd_unbuffered_source(T &t) {
+    String want = sample(200'000);
+
+    ErrorRecorder err;
+    String compressed = zstd(want, 0, err);
+    if (err) {
+        t.fatalf("write: %v", err);
+    }
+
+    Unbuffered in(compressed, 1000);
+    String got = unzstd(in, err);
+    if (err) {
+        t.fatalf("read: %v", err);
+    }
+    if (got != want) {
+        t.errorf("round trip mismatch: got %d bytes, want %d", len(got), len(want));
+    }
+}
+
+void test_zstd_truncated(T &t) {
+    ErrorRecorder err;
+    String compressed = zstd(sample(100'000), 0, err);
+    if (err) {
+        t.fatalf("write: %v", err);
+    }
+
+    for (size cut : {size(1), size(20), len(compressed) / 2}) {
+        io::Str in(compressed[0, len(compressed) - cut]);
+        bool eof = false;
+        unzstd(in, [&](Error &e) {
+            eof = e.is<io::ErrUnexpectedEOF>();
+            if (!eof) {
+                t.errorf("cut %d: %v; want unexpected EOF", cut, e);
+            }
+        });
+        if (!eof) {
+            t.errorf("cut %d: truncated stream read without error", cut);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <concepts>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+
+#include "decode.h"
+#include "encode.h"
+#include "lib/strconv/atoi.h"
+
+// Binding maps C++ values to JSON and back without reflection. Numbers,
+// bools, strings, std::optional, sequences, maps with String keys and structs
+// are supported. A struct lists its members, and their JSON names, in a fields()
+// method:
+//
+//     struct User {
+//         int64       id = 0;
+//         String      name;
+//         std::vector<String> tags;
+//
+//         auto fields() {
+//             return std::tuple(json::field("id", id), json::field("name", name), json::field("tags", tags));
+//         }
+//     } ;
+//
+//     json::marshal(out, user, err);    // {"id":1,"name":"ann","tags":[]}
+//     json::unmarshal(body, user, err);
+//
+// When decoding, members missing from the input keep their values and
+// unknown members are skipped. Decoding into a map adds to it, replacing
+// the values of keys it already has.
+namespace lib::json {
+
+    template <typename T>
+    struct Field {
+        str name;
+        T  *ptr;
+    } ;
+
+    template <typename T>
+    Field<T> field(str name, T &v) {
+        return {name, &v};
+    }
+
+    template <typename T>
+    concept HasFields = requires(T &t) {
+        t.fields();
+    };
+
+    template <typename T>
+    void encode(Encoder &e, T const &v);
+
+    // decode reads the value whose first token is t into v.
+    template <typename T>
+    void decode(Decoder &d, Token t, T &v, error err);
+
+    template <typename T>
+    void decode(Decoder &d, T &v, error err) {
+        decode(d, d.next(err), v, err);
+    }
+
+    // marshal writes v to out as JSON.
+    template <typename T>
+    void marshal(io::Writer &out, T const &v, error err) {
+        Encoder e(out, err);
+        encode(e, v);
+    }
+
+    // unmarshal reads the JSON value in data into v.
+    template <typename T>
+    void unmarshal(str data, T &v, error err) {
+        Decoder d(data);
+        decode(d, v, err);
+        if (d.next(err).kind != Kind::End) {
+            err(SyntaxError("invalid character after top-level value", d.offset()));
+        }
+    }
+
+    template <typename T>
+    void encode(Encoder &e, T const &v) {
+        if constexpr (std::is_same_v<T, bool> || std::is_arithmetic_v<T>) {
+            e.value(v);
+        } else if constexpr (std::is_convertible_v<T const&, str>) {
+            e.value(str(v));
+        } else if constexpr (requires { v.has_value(); *v; }) {
+            if (v.has_value()) {
+                encode(e, *v);
+            } else {
+                e.null();
+            }
+        } else if constexpr (HasFields<T>) {
+            e.begin_object();
+            std::apply([&](auto const &...f) {
+                ((e.key(f.name), encode(e, *f.ptr)), ...);
+            }, const_cast<T&>(v).fields());
+            e.end_object();
+        } else if constexpr (requires { v.begin(); v.end(); v.begin()->first; v.begin()->second; }) {
+            e.begin_object();
+            for (auto const &[k, val] : v) {
+                e.key(k);
+                encode(e, val);
+            }
+            e.end_object();
+        } else if constexpr (requires { v.begin(); v.end(); }) {
+            e.begin_array();
+            for (auto const &x : v) {
+                encode(e, x);
+            }
+            e.end_array();
+        } else {
+            static_assert(sizeof(T) == 0, "json: type can't be encoded");
+        }
+    }
+
+    template <typename T>
+    void decode(Decoder &d, Token t, T &v, error err) {
+        auto mismatch = [&](str want) {
+            err(TypeError(want, kind_name(t.kind)));
+            d.skip(t, err);
+        };
+
+        if (t.kind == Kind::End) {
+            // the decoder failed, or the input ended before the value
+            return;
+        }
+
+        if constexpr (std::is_same_v<T, bool>) {
+            if (t.kind == Kind::True || t.kind == Kind::False) {
+                v = t.kind == Kind::True;
+            } else {
+                mismatch("bool");
+            }
+        } else if constexpr (std::is_integral_v<T>) {
+            if (t.kind != Kind::Number) {
+                mismatch("number");
+            } else if constexpr (std::is_signed_v<T>) {
+                v = T(strconv::parse_int(t.text, 10, sizeof(T) * 8, err));
+            } else {
+                v = T(strconv::parse_uint(t.text, 10, sizeof(T) * 8, err));
+            }
+        } else if constexpr (std::is_floating_point_v<T>) {
+            if (t.kind != Kind::Number) {
+                mismatch("number");
+            } else {
+                v = T(t.to_float(err));
+            }
+        } else if constexpr (std::is_same_v<T, lib::String>) {
+            if (t.kind == Kind::String) {
+                v = t.text;
+            } else {
+                mismatch("string");
+            }
+        } else if constexpr (std::is_same_v<T, str>) {
+            static_assert(sizeof(T) == 0, "json: decoding into a str would leave it dangling; use String");
+        } else if constexpr (requires { v.reset(); v.emplace(); *v; }) {
+            if (t.kind == Kind::Null) {
+                v.reset();
+            } else {
+                v.emplace();
+                decode(d, t, *v, err);
+            }
+        } else if constexpr (HasFields<T>) {
+            if (t.kind != Kind::BeginObject) {
+                mismatch("object");
+                return;
+            }
+            auto fs = v.fields();
+            for (Token k = d.next(err); k.kind == Kind::Key; k = d.next(err)) {
+                // the key's text is compared before anything more is read
+                bool found = false;
+                std::apply([&](auto &...f) {
+                    ((!found && f.name == k.text ? (found = true, decode(d, *f.ptr, err)) : void()), ...);
+                }, fs);
+                if (!found) {
+                    d.skip(d.next(err), err);
+                }
+            }
+        } else if constexpr (requires { typename T::key_type; typename T::mapped_type; v.begin()->second; }) {
+            static_assert(!std::is_same_v<typename T::key_type, str>, "json: decoding into str keys would leave them dangling; use String");
+            if (t.kind != Kind::BeginObject) {
+                mismatch("object");
+                return;
+            }
+            for (Token k = d.next(err); k.kind == Kind::Key; k = d.next(err)) {
+                // the key's text is only valid until the next token
+                decode(d, v[typename T::key_type(k.text)], err);
+            }
+        } else if constexpr (requires { v.clear(); v.emplace_back(); }) {
+            if (t.kind != Kind::BeginArray) {
+                mismatch("array");
+                return;
+            }
+            v.clear();
+            for (Token x = d.next(err); x.kind != Kind::EndArray && x.kind != Kind::End; x = d.next(err)) {
+                decode(d, x, v.emplace_back(), err);
+            }
+        } else {
+            static_assert(sizeof(T) == 0, "json: type can't be decoded");
+        }
+    }
+}
@@ -0,0 +1,153 @@
+#include "bind.h"
+
+#include <map>
+#include <vector>
+
+#include "lib/fmt/fmt.h"
+#include "lib/testing/benchmark.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+namespace {
+    struct Address {
+        String city;
+        int32  zip = 0;
+
+        auto fields() {
+            return std::tuple(json::field("city", city), json::field("zip", zip));
+        }
+    } ;
+
+    struct User {
+        int64                   id = 0;
+        String                  name;
+        bool                    admin = false;
+        float64                 score = 0;
+        std::vector<String>     tags;
+        std::optional<Address>  address;
+
+        auto fields() {
+            return std::tuple(
+                json::field("id", id),
+                json::field("name", name),
+                json::field("admin", admin),
+                json::field("score", score),
+                json::field("tags", tags),
+                json::field("address", address));
+        }
+    } ;
+}
+
+void test_marshal(T &t) {
+    User u;
+    u.id = 7;
+    u.name = "ann";
+    u.score = 1.5;
+    u.tags = {"a", "b"};
+
+    io::Buffer out;
+    json::marshal(out, u, error::panic);
+    str want = R"({"id":7,"name":"ann","admin":false,"score":1.5,"tags":["a","b"],"address":null})";
+    if (String got = out.to_string(); got != want) {
+        t.errorf("got  %s\nwant %s", got, want);
+    }
+
+    std::map<String, int> m = {{"x", 1}, {"y", 2}};
+    io::Buffer mout;
+    json::marshal(mout, m, error::panic);
+    if (String got = mout.to_string(); got != R"({"x":1,"y":2})") {
+        t.errorf("map: got %s", got);
+    }
+}
+
+void test_unmarshal(T &t) {
+    str input = R"({
+        "name": "bob é",
+        "unknown": {"deep": [1, 2, {"x": null}]},
+        "id": 42,
+        "tags": ["x"],
+        "address": {"zip": 12345, "city": "Oslo"},
+        "admin": true,
+        "score": -0.5e1
+    })";
+
+    User u;
+    json::unmarshal(input, u, error::panic);
+    if (u.id != 42 || u.name != "bob é" || !u.admin || u.score != -5 || u.tags.size() != 1 || u.tags[0] != "x") {
+        t.errorf("got %d %q %v %v %d", u.id, u.name, u.admin, u.score, u.tags.size());
+    }
+    if (!u.address || u.address->city != "Oslo" || u.address->zip != 12345) {
+        t.errorf("address not decoded");
+    }
+
+    // round trip
+    io::Buffer out;
+    json::marshal(out, u, error::panic);
+    User v;
+    json::unmarshal(out.str(), v, error::panic);
+    if (v.id != u.id || v.name != u.name || !v.address || v.address->zip != u.address->zip) {
+        t.errorf("round trip of %s failed", out.str());
+    }
+}
+
+void test_unmarshal_map(T &t) {
+    std::map<String, std::vector<int>> m = {{"kept", {0}}, {"b", {9}}};
+    json::unmarshal(R"({"a": [1, 2], "b": [], "c\u00e9": [3]})", m, error::panic);
+
+    std::map<String, std::vector<int>> want = {{"kept", {0}}, {"a", {1, 2}}, {"b", {}}, {"cé", {3}}};
+    if (m != want) {
+        t.errorf("got %d entries; want %d", m.size(), want.size());
+    }
+
+    // round trip
+    io::Buffer out;
+    json::marshal(out, m, error::panic);
+    std::map<String, std::vector<int>> back;
+    json::unmarshal(out.str(), back, error::panic);
+    if (back != m) {
+        t.errorf("round trip of %s failed", out.str());
+    }
+
+    String got;
+    json::unmarshal("[1]", m, [&](Error &e) {
+        got = fmt::sprintf("%v", e);
+    });
+    if (got != "json: expected object, got array") {
+        t.errorf("array into map: got error %q", got);
+    }
+}
+
+void test_unmarshal_errors(T &t) {
+    struct {
+        str in;
+        str err;
+    } tests[] = {
+        {R"({"id": "7"})", "json: expected number, got string"},
+        {R"({"address": {"zip": 99999999999}})", "strconv::parse_int: parsing \"99999999999\": value out of range"},
+        {R"({"tags": {}})", "json: expected array, got object"},
+        {R"({"id": 1} 2)", "json: invalid character after top-level value at offset 11"},
+        {R"({"id": 1,})", "json: expected string for object key at offset 9"},
+    };
+
+    for (auto const &tt : tests) {
+        User u;
+        String got;
+        json::unmarshal(tt.in, u, [&](Error &e) {
+            got = fmt::sprintf("%v", e);
+        });
+        if (got != tt.err) {
+            t.errorf("%s: got error %q; want %q", tt.in, got, tt.err);
+        }
+    }
+}
+
+void benchmark_unmarshal(B &b) {
+    str input = R"({"id": 42, "name": "bob", "admin": true, "score": 12.5,
+        "tags": ["x", "y", "z"], "address": {"city": "Oslo", "zip": 12345}})";
+    for (int i = 0; i < b.n; i++) {
+        User u;
+        json::unmarshal(input, u, error::panic);
+    }
+}
@@ -0,0 +1,578 @@
+#include "decode.h"
+
+#include <charconv>
+
+#include "lib/fmt/fmt.h"
+#include "lib/strconv/atoi.h"
+#include "lib/utf8/encode.h"
+#include "lib/utf8/utf8.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace lib;
+using namespace lib::json;
+
+namespace {
+    // MaxDepth bounds the nesting of objects and arrays.
+    const size MaxDepth = 10000;
+
+    bool is_space(int c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    bool is_digit(int c) {
+        return c >= '0' && c <= '9';
+    }
+
+    // is_delimiter reports whether c may follow a number or a literal.
+    bool is_delimiter(int c) {
+        return c < 0 || is_space(c) || c == ',' || c == ']' || c == '}';
+    }
+
+    // string_run returns the length of the prefix of s that is neither a
+    // quote, a backslash nor a control character, all of which end a run of
+    // a string's bytes. It looks at 16 bytes at a time.
+    size string_run(str s) {
+        size i = 0;
+    #if defined(__x86_64__)
+        const __m128i quote  = _mm_set1_epi8('"');
+        const __m128i bslash = _mm_set1_epi8('\\');
+        const __m128i ctl    = _mm_set1_epi8(0x1F);
+        for (; i + 16 <= len(s); i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (s.data + i));
+            __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash));
+            // v <= 0x1F, unsigned
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_max_epu8(v, ctl), ctl));
+            if (int mask = _mm_movemask_epi8(m); mask != 0) {
+                return i + __builtin_ctz(mask);
+            }
+        }
+    #endif
+        for (; i < len(s); i++) {
+            byte c = s.data[i];
+            if (c == '"' || c == '\\' || c < 0x20) {
+                break;
+            }
+        }
+        return i;
+    }
+
+    int unhex(byte c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        c |= 0x20;
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        return -1;
+    }
+
+    // read_hex4 decodes the four hex digits of a \u escape at s[i:], or
+    // returns -1.
+    int read_hex4(str s, size i) {
+        if (len(s) - i < 4) {
+            return -1;
+        }
+        int v = 0;
+        for (size k = i; k < i + 4; k++) {
+            int d = unhex(s.data[k]);
+            if (d < 0) {
+                return -1;
+            }
+            v = v*16 + d;
+        }
+        return v;
+    }
+}
+
+void SyntaxError::fmt(io::Writer &out, error err) const {
+    fmt::fprintf(out, err, "json: %s at offset %d", msg, offset);
+}
+
+void TypeError::fmt(io::Writer &out, error err) const {
+    fmt::fprintf(out, err, "json: expected %s, got %s", want, got);
+}
+
+str json::kind_name(Kind k) {
+    switch (k) {
+        case Kind::End:         return "end of input";
+        case Kind::BeginObject: return "object";
+        case Kind::EndObject:   return "end of object";
+        case Kind::BeginArray:  return "array";
+        case Kind::EndArray:    return "end of array";
+        case Kind::Key:         return "key";
+        case Kind::String:      return "string";
+        case Kind::Number:      return "number";
+        case Kind::True:        return "true";
+        case Kind::False:       return "false";
+        case Kind::Null:        return "null";
+    }
+    return "?";
+}
+
+int64 Token::to_int(error err) const {
+    if (kind != Kind::Number) {
+        err(TypeError("number", kind_name(kind)));
+        return 0;
+    }
+    return strconv::parse_int(text, 10, 64, err);
+}
+
+uint64 Token::to_uint(error err) const {
+    if (kind != Kind::Number) {
+        err(TypeError("number", kind_name(kind)));
+        return 0;
+    }
+    return strconv::parse_uint(text, 10, 64, err);
+}
+
+float64 Token::to_float(error err) const {
+    if (kind != Kind::Number) {
+        err(TypeError("number", kind_name(kind)));
+        return 0;
+    }
+    // the syntax was checked while decoding, so only the range can be wrong
+    float64 f = 0;
+    std::from_chars_result res = std::from_chars(text.data, text.data + len(text), f);
+    if (res.ec == std::errc::result_out_of_range) {
+        err(strconv::NumError("parse_float", text, strconv::ErrRange()));
+    }
+    return f;
+}
+
+Decoder::Decoder(str input) : window(input), eof(true) {}
+
+Decoder::Decoder(io::Reader &in) : r(&in) {}
+
+Decoder::~Decoder() {
+    commit();
+}
+
+size Decoder::depth() const {
+    return size(stack.size());
+}
+
+int64 Decoder::offset() const {
+    return consumed + pos;
+}
+
+void Decoder::fail(str msg) {
+    if (!failed) {
+        failed = true;
+        (*err)(SyntaxError(msg, offset()));
+    }
+}
+
+void Decoder::commit() {
+    if (r != nil && pos > 0) {
+        r->skip(pos, error::ignore);
+        consumed += pos;
+        window = window.slice(pos);
+        pos = 0;
+        tok_start = 0;
+    }
+}
+
+bool Decoder::refill() {
+    if (eof || failed) {
+        return false;
+    }
+    if (in_token) {
+        scratch += window[tok_start, pos];
+    }
+    commit();
+
+    window = r->peek_buffered([&](Error &e) {
+        failed = true;
+        (*err)(e);
+    });
+    pos = 0;
+    tok_start = 0;
+    if (len(window) == 0) {
+        eof = true;
+        return false;
+    }
+    return true;
+}
+
+int Decoder::peek_byte() {
+    if (pos == len(window) && !refill()) {
+        return -1;
+    }
+    return byte(window.data[pos]);
+}
+
+void Decoder::skip_space() {
+    for (;;) {
+        while (pos < len(window) && is_space(byte(window.data[pos]))) {
+            pos++;
+        }
+        if (pos < len(window) || !refill()) {
+            return;
+        }
+    }
+}
+
+void Decoder::begin_token() {
+    in_token = true;
+    tok_start = pos;
+    scratch.length = 0;
+}
+
+str Decoder::end_token() {
+    in_token = false;
+    if (len(scratch) > 0) {
+        scratch += window[tok_start, pos];
+        return scratch;
+    }
+    return window[tok_start, pos];
+}
+
+void Decoder::end_value() {
+    state = stack.empty() ? Top : Comma;
+}
+
+// prepare reads up to the first byte of the next token, past a ':' or ','
+// separating it from the last one, and returns that byte or -1.
+int Decoder::prepare() {
+    if (failed) {
+        return -1;
+    }
+
+    skip_space();
+    int c = peek_byte();
+
+    if (state == Colon) {
+        if (c != ':') {
+            fail("expected ':' after object key");
+            return -1;
+        }
+        pos++;
+        state = Value;
+    } else if (state == Comma && c == ',') {
+        pos++;
+        state = stack.back() == Kind::BeginObject ? Key : Value;
+    } else {
+        return c;
+    }
+
+    skip_space();
+    return peek_byte();
+}
+
+Kind Decoder::peek(error err) {
+    this->err = &err;
+    int c = prepare();
+    if (failed) {
+        return Kind::End;
+    }
+
+    switch (c) {
+        case -1:  return Kind::End;
+        case '{': return Kind::BeginObject;
+        case '}': return Kind::EndObject;
+        case '[': return Kind::BeginArray;
+        case ']': return Kind::EndArray;
+        case 't': return Kind::True;
+        case 'f': return Kind::False;
+        case 'n': return Kind::Null;
+        case '"': return state == Key || state == KeyOrEnd ? Kind::Key : Kind::String;
+    }
+    return Kind::Number;
+}
+
+Token Decoder::next(error err) {
+    this->err = &err;
+    int c = prepare();
+    if (failed) {
+        return {};
+    }
+
+    switch (state) {
+        case Comma:
+        case KeyOrEnd:
+        case ValueOrEnd: {
+            Kind open = stack.back();
+            if ((c == '}' && open == Kind::BeginObject) || (c == ']' && open == Kind::BeginArray)) {
+                pos++;
+                stack.pop_back();
+                end_value();
+                return {open == Kind::BeginObject ? Kind::EndObject : Kind::EndArray};
+            }
+            if (state == Comma) {
+                fail(c < 0 ? str("unexpected end of input") : str("invalid character after value"));
+                return {};
+            }
+            state = state == KeyOrEnd ? Key : Value;
+            break;
+        }
+
+        case Top:
+            if (c < 0) {
+                return {};
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    if (c < 0) {
+        fail("unexpected end of input");
+        return {};
+    }
+    if (state == Key) {
+        if (c != '"') {
+            fail("expected string for object key");
+            return {};
+        }
+        return read_string(Kind::Key);
+    }
+    return read_value(c);
+}
+
+Token Decoder::read_value(int c) {
+    switch (c) {
+        case '{':
+        case '[':
+            if (depth() >= MaxDepth) {
+                fail("exceeded max depth");
+                return {};
+            }
+            pos++;
+            stack.push_back(c == '{' ? Kind::BeginObject : Kind::BeginArray);
+            state = c == '{' ? KeyOrEnd : ValueOrEnd;
+            return {stack.back()};
+
+        case '"':
+            return read_string(Kind::String);
+
+        case 't':
+            return read_literal("true", Kind::True);
+        case 'f':
+            return read_literal("false", Kind::False);
+        case 'n':
+            return read_literal("null", Kind::Null);
+    }
+
+    if (c == '-' || is_digit(c)) {
+        return read_number();
+    }
+    fail("invalid character looking for beginning of value");
+    return {};
+}
+
+Token Decoder::read_string(Kind kind) {
+    pos++;  // opening quote
+    begin_token();
+
+    bool escaped = false;
+    for (;;) {
+        pos += string_run(window.slice(pos));
+        if (pos == len(window)) {
+            if (!refill()) {
+                in_token = false;
+                fail("unexpected end of input in string");
+                return {};
+            }
+            continue;
+        }
+
+        byte c = window.data[pos];
+        if (c == '"') {
+            break;
+        }
+        if (c != '\\') {
+            in_token = false;
+            fail("invalid control character in string");
+            return {};
+        }
+        escaped = true;
+        pos++;
+        if (peek_byte() < 0) {
+            in_token = false;
+            fail("unexpected end of input in string");
+            return {};
+        }
+        pos++;
+    }
+
+    str raw = end_token();
+    pos++;  // closing quote
+
+    if (!utf8::valid(raw)) {
+        fail("invalid UTF-8 in string");
+        return {};
+    }
+    if (escaped) {
+        if (!unescape(raw)) {
+            return {};
+        }
+        raw = unescaped;
+    }
+
+    if (kind == Kind::Key) {
+        state = Colon;
+    } else {
+        end_value();
+    }
+    return {kind, raw};
+}
+
+bool Decoder::unescape(str raw) {
+    unescaped.length = 0;
+    unescaped.ensure(len(raw));
+
+    size start = 0;
+    size i = 0;
+    while (i < len(raw)) {
+        if (raw.data[i] != '\\') {
+            i++;
+            continue;
+        }
+        unescaped += raw[start, i];
+
+        char c = raw.data[i + 1];
+        i += 2;
+        switch (c) {
+            case '"':  unescaped += "\""; break;
+            case '\\': unescaped += "\\"; break;
+            case '/':  unescaped += "/"; break;
+            case 'b':  unescaped += "\b"; break;
+            case 'f':  unescaped += "\f"; break;
+            case 'n':  unescaped += "\n"; break;
+            case 'r':  unescaped += "\r"; break;
+            case 't':  unescaped += "\t"; break;
+
+            case 'u': {
+                int r = read_hex4(raw, i);
+                if (r < 0) {
+                    fail("invalid \\u escape in string");
+                    return false;
+                }
+                i += 4;
+
+                if (r >= 0xD800 && r < 0xDC00) {
+                    // a high surrogate; a low one should follow
+                    int r2 = -1;
+                    if (len(raw) - i >= 6 && raw.data[i] == '\\' && raw.data[i+1] == 'u') {
+                        r2 = read_hex4(raw, i + 2);
+                    }
+                    if (r2 >= 0xDC00 && r2 < 0xE000) {
+                        r = 0x10000 + ((r - 0xD800) << 10) + (r2 - 0xDC00);
+                        i += 6;
+                    } else {
+                        r = utf8::RuneError;
+                    }
+                } else if (r >= 0xDC00 && r < 0xE000) {
+                    r = utf8::RuneError;
+                }
+
+                byte b[utf8::UTFMax];
+                unescaped += utf8::encode(buf(b, sizeof b), r);
+                break;
+            }
+
+            default:
+                fail("invalid escape in string");
+                return false;
+        }
+        start = i;
+    }
+    unescaped += raw[start, len(raw)];
+    return true;
+}
+
+Token Decoder::read_number() {
+    begin_token();
+
+    auto digits = [&] {
+        bool any = false;
+        while (is_digit(peek_byte())) {
+            pos++;
+            any = true;
+        }
+        return any;
+    };
+
+    if (peek_byte() == '-') {
+        pos++;
+    }
+
+    int c = peek_byte();
+    if (c == '0') {
+        pos++;
+    } else if (!digits()) {
+        in_token = false;
+        fail("invalid character in number");
+        return {};
+    }
+
+    if (peek_byte() == '.') {
+        pos++;
+        if (!digits()) {
+            in_token = false;
+            fail("invalid character after decimal point in number");
+            return {};
+        }
+    }
+
+    c = peek_byte();
+    if (c == 'e' || c == 'E') {
+        pos++;
+        c = peek_byte();
+        if (c == '+' || c == '-') {
+            pos++;
+        }
+        if (!digits()) {
+            in_token = false;
+            fail("invalid character in exponent of number");
+            return {};
+        }
+    }
+
+    // the byte after the number is looked at before ending the token,
+    // since a refill would move the token's bytes
+    if (!is_delimiter(peek_byte())) {
+        in_token = false;
+        fail("invalid character after number");
+        return {};
+    }
+
+    str text = end_token();
+    end_value();
+    return {Kind::Number, text};
+}
+
+Token Decoder::read_literal(str word, Kind kind) {
+    for (char w : word) {
+        if (peek_byte() != byte(w)) {
+            fail("invalid literal");
+            return {};
+        }
+        pos++;
+    }
+    if (!is_delimiter(peek_byte())) {
+        fail("invalid character after literal");
+        return {};
+    }
+    end_value();
+    return {kind, word};
+}
+
+void Decoder::skip(Token t, error err) {
+    if (t.kind != Kind::BeginObject && t.kind != Kind::BeginArray) {
+        return;
+    }
+
+    size d = depth();
+    while (depth() >= d) {
+        Token u = next(err);
+        if (failed || u.kind == Kind::End) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <vector>
+
+#include "lib/io/io.h"
+#include "lib/str.h"
+
+namespace lib::json {
+
+    // SyntaxError reports input that isn't valid JSON.
+    struct SyntaxError : ErrorBase<SyntaxError> {
+        str   msg;     // such as "invalid character in number"
+        int64 offset;  // of the byte where the error was found
+
+        SyntaxError(str msg, int64 offset) : msg(msg), offset(offset) {}
+        void fmt(io::Writer &out, error err) const override;
+    } ;
+
+    // TypeError reports a value of the wrong type for what it is read into.
+    struct TypeError : ErrorBase<TypeError> {
+        str want;  // such as "number"
+        str got;
+
+        TypeError(str want, str got) : want(want), got(got) {}
+        void fmt(io::Writer &out, error err) const override;
+    } ;
+
+    enum class Kind : uint8 {
+        End,          // the end of the input
+        BeginObject,
+        EndObject,
+        BeginArray,
+        EndArray,
+        Key,          // the name of an object member
+        String,
+        Number,
+        True,
+        False,
+        Null,
+    } ;
+
+    str kind_name(Kind k);
+
+    struct Token {
+        Kind kind = Kind::End;
+
+        // text is the unescaped value of a Key or String and the literal text
+        // of a Number. It is valid until the next call to the Decoder.
+        str text;
+
+        int64   to_int(error err) const;
+        uint64  to_uint(error err) const;
+        float64 to_float(error err) const;
+    } ;
+
+    // Decoder reads JSON a token at a time, from a str or from the read
+    // buffer of an io::Reader:
+    //
+    //     json::Decoder d(body);
+    //     for (json::Token t = d.next(err); t.kind != json::Kind::End; t = d.next(err)) {
+    //         ...
+    //     }
+    //
+    // It checks the syntax of the input as it goes, including that strings
+    // are valid UTF-8, and stops at the first error, after which next returns
+    // End. A sequence of values, such as JSON lines, is read as such.
+    //
+    // The text of a token refers into the input when it can: a Number, or a
+    // string without escapes that lies within one read of the reader. Only
+    // strings with escapes, and tokens that straddle two reads, are copied.
+    struct Decoder {
+        Decoder(str input);
+
+        // in should be buffered, as an io::Buffered is; a reader without a
+        // read buffer looks empty.
+        Decoder(io::Reader &in);
+        Decoder(Decoder const&) = delete;
+
+        // The destructor consumes from the reader the input that was read.
+        ~Decoder();
+
+        Token next(error err);
+
+        // peek returns the kind of the next token without reading it. It
+        // ends the validity of the text of the last token, as next does.
+        Kind peek(error err);
+
+        // skip reads the rest of the value whose first token was t: nothing
+        // for a scalar, and up to the matching end for BeginObject or
+        // BeginArray.
+        void skip(Token t, error err);
+
+        // depth returns the number of objects and arrays that are open.
+        size depth() const;
+
+        // offset returns the number of bytes of input read.
+        int64 offset() const;
+
+      private:
+        enum State : uint8 {
+            Top,            // a value, or the end
+            Value,          // a value, after a ':' or ','
+            ValueOrEnd,     // a value, or ']', after '['
+            Key,            // a key, after ','
+            KeyOrEnd,       // a key, or '}', after '{'
+            Colon,          // ':', after a key
+            Comma,          // ',' or the end of the object or array
+        } ;
+
+        io::Reader *r = nil;
+        str         window;     // unread input
+        size        pos = 0;
+        int64       consumed = 0;
+        bool        eof = false;
+        bool        failed = false;
+        State       state = Top;
+
+        std::vector<Kind> stack;  // BeginObject or BeginArray, for each open one
+
+        bool        in_token = false;
+        size        tok_start = 0;
+        lib::String scratch;    // a token that straddled reads
+        lib::String unescaped;
+
+        error *err = nil;  // that of the call in progress
+
+        void fail(str msg);
+        int  prepare();
+        void commit();
+        bool refill();
+        int  peek_byte();
+        void skip_space();
+        void end_value();
+
+        Token read_value(int c);
+        Token read_string(Kind kind);
+        Token read_number();
+        Token read_literal(str word, Kind kind);
+        void  begin_token();
+        str   end_token();
+        bool  unescape(str raw);
+    } ;
+}
@@ -0,0 +1,193 @@
+#include "decode.h"
+
+#include "lib/fmt/fmt.h"
+#include "lib/testing/benchmark.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+namespace {
+    // Trickle is a buffered reader that returns at most n bytes per read, so
+    // that tokens straddle refills of its read buffer.
+    struct Trickle : io::Buffered {
+        str  data;
+        size n;
+
+        Trickle(str data, size n) : data(data), n(n) {
+            resize_readbuf(16);
+        }
+
+        io::ReadResult direct_read(buf b, error) override {
+            size m = copy(b.slice(0, std::min(n, len(b))), data);
+            data = data(m);
+            return {m, len(data) == 0};
+        }
+
+        size direct_write(str, error) override {
+            return 0;
+        }
+    } ;
+
+    // dump renders the tokens of d, one per line, as kind or kind:text.
+    String dump(json::Decoder &d, error err) {
+        String out;
+        for (json::Token t = d.next(err); t.kind != json::Kind::End; t = d.next(err)) {
+            out += json::kind_name(t.kind);
+            if (len(t.text) > 0 && t.kind != json::Kind::True && t.kind != json::Kind::False && t.kind != json::Kind::Null) {
+                out += ":";
+                out += t.text;
+            }
+            out += "\n";
+        }
+        return out;
+    }
+
+    const str document = R"({"id": 12345, "name": "a somewhat long name", "esc": "tab\tquote\"",
+        "list": [1, -2.5e3, true, false, null, {}, []], "nested": {"k": ["v"]}})";
+
+    const str document_tokens =
+        "object\nkey:id\nnumber:12345\nkey:name\nstring:a somewhat long name\n"
+        "key:esc\nstring:tab\tquote\"\nkey:list\narray\nnumber:1\nnumber:-2.5e3\n"
+        "true\nfalse\nnull\nobject\nend of object\narray\nend of array\nend of array\n"
+        "key:nested\nobject\nkey:k\narray\nstring:v\nend of array\nend of object\n"
+        "end of object\n";
+}
+
+void test_decoder(T &t) {
+    json::Decoder d(document);
+    String got = dump(d, error::panic);
+    if (got != document_tokens) {
+        t.errorf("got:\n%s\nwant:\n%s", got, document_tokens);
+    }
+}
+
+void test_decoder_reader(T &t) {
+    for (size n : {1, 2, 3, 7, 16}) {
+        Trickle in(document, n);
+        String got;
+        {
+            json::Decoder d(in);
+            got = dump(d, error::panic);
+        }
+        if (got != document_tokens) {
+            t.errorf("reads of %d bytes: got:\n%s", n, got);
+        }
+    }
+}
+
+void test_decoder_zero_copy(T &t) {
+    str input = R"(["plain", "esc\n", 125])";
+    json::Decoder d(input);
+
+    d.next(error::panic);
+    json::Token s = d.next(error::panic);
+    if (s.text != "plain" || s.text.data != input.data + 2) {
+        t.errorf("plain string %q was copied", s.text);
+    }
+
+    s = d.next(error::panic);
+    if (s.text != "esc\n") {
+        t.errorf("escaped string = %q", s.text);
+    }
+
+    json::Token n = d.next(error::panic);
+    if (n.text.data != input.data + 19 || n.to_int(error::panic) != 125) {
+        t.errorf("number %q was copied", n.text);
+    }
+}
+
+void test_decoder_unescape(T &t) {
+    struct {
+        str in;
+        str want;
+    } tests[] = {
+        {R"("\"\\\/\b\f\n\r\t")", "\"\\/\b\f\n\r\t"},
+        {R"("caf\u00e9")", "café"},
+        {R"("\ud83d\ude00!")", "😀!"},
+        {R"("lone \ud83d")", "lone \uFFFD"},
+        {R"("\uDE00")", "\uFFFD"},
+        {R"("☺ raw")", "☺ raw"},
+    };
+
+    for (auto const &tt : tests) {
+        json::Decoder d(tt.in);
+        json::Token tok = d.next(error::panic);
+        if (tok.kind != json::Kind::String || tok.text != tt.want) {
+            t.errorf("%s: got %q; want %q", tt.in, tok.text, tt.want);
+        }
+    }
+}
+
+void test_decoder_errors(T &t) {
+    struct {
+        str in;
+        str err;
+    } tests[] = {
+        {"", ""},
+        {"[1, 2", "json: unexpected end of input at offset 5"},
+        {"[1 2]", "json: invalid character after value at offset 3"},
+        {"{\"a\" 1}", "json: expected ':' after object key at offset 5"},
+        {"{1: 2}", "json: expected string for object key at offset 1"},
+        {"[1,]", "json: invalid character looking for beginning of value at offset 3"},
+        {"01", "json: invalid character after number at offset 1"},
+        {"-", "json: invalid character in number at offset 1"},
+        {"1.", "json: invalid character after decimal point in number at offset 2"},
+        {"1e+", "json: invalid character in exponent of number at offset 3"},
+        {"tru", "json: invalid literal at offset 3"},
+        {"nulls", "json: invalid character after literal at offset 4"},
+        {"\"a\nb\"", "json: invalid control character in string at offset 2"},
+        {"\"\xff\"", "json: invalid UTF-8 in string at offset 3"},
+        {"\"\\x\"", "json: invalid escape in string at offset 4"},
+        {"\"abc", "json: unexpected end of input in string at offset 4"},
+        {"[}", "json: invalid character looking for beginning of value at offset 1"},
+        {"1 2 {}", ""},
+    };
+
+    for (auto const &tt : tests) {
+        json::Decoder d(tt.in);
+        String got;
+        dump(d, [&](Error &e) {
+            got = fmt::sprintf("%v", e);
+        });
+        if (got != tt.err) {
+            t.errorf("%q: got error %q; want %q", tt.in, got, tt.err);
+        }
+    }
+}
+
+void test_decoder_skip(T &t) {
+    json::Decoder d(R"([{"a": [1, {"b": 2}], "c": "d"}, "next"])");
+    d.next(error::panic);
+
+    json::Token obj = d.next(error::panic);
+    d.skip(obj, error::panic);
+
+    json::Token next = d.next(error::panic);
+    if (next.kind != json::Kind::String || next.text != "next" || d.depth() != 1) {
+        t.errorf("after skip: got %s %q at depth %d", json::kind_name(next.kind), next.text, d.depth());
+    }
+
+    if (json::Kind k = d.peek(error::panic); k != json::Kind::EndArray) {
+        t.errorf("peek = %s; want end of array", json::kind_name(k));
+    }
+    if (json::Kind k = d.next(error::panic).kind; k != json::Kind::EndArray) {
+        t.errorf("next = %s after peek; want end of array", json::kind_name(k));
+    }
+}
+
+void benchmark_decode(B &b) {
+    String input = "[";
+    for (int i = 0; i < 100; i++) {
+        if (i > 0) {
+            input += ",";
+        }
+        input += document;
+    }
+    input += "]";
+
+    for (int i = 0; i < b.n; i++) {
+        json::Decoder d(input);
+        while (d.next(error::panic).kind != json::Kind::End) {}
+    }
+}
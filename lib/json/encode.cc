@@ -0,0 +1,195 @@
+#include "encode.h"
+
+#include "lib/fmt/fmt.h"
+#include "lib/strconv/ftoa.h"
+#include "lib/strconv/itoa.h"
+#include "lib/utf8/decode.h"
+#include "lib/utf8/utf8.h"
+
+using namespace lib;
+using namespace lib::json;
+
+namespace {
+    const char hex[] = "0123456789abcdef";
+
+    // safe[c] is set for the ASCII bytes that appear in a JSON string as
+    // themselves.
+    const struct SafeSet {
+        bool safe[256] = {};
+
+        constexpr SafeSet() {
+            for (int c = 0x20; c < 0x80; c++) {
+                safe[c] = c != '"' && c != '\\';
+            }
+        }
+    } safe_set;
+
+    template <typename F>
+    void write_float(io::Writer &out, F f, int bits, error err) {
+        if (f != f || f - f != 0) {
+            err(UnsupportedValueError());
+            return;
+        }
+
+        // as ECMAScript does, use an exponent only for very large and very
+        // small magnitudes
+        F abs = f < 0 ? -f : f;
+        char verb = 'f';
+        if (abs != 0) {
+            if ((bits == 64 && (abs < 1e-6 || abs >= 1e21)) ||
+                (bits == 32 && (float32(abs) < 1e-6f || float32(abs) >= 1e21f))) {
+                verb = 'e';
+            }
+        }
+
+        char b[64];
+        fmt::BufWriter w(buf((byte*) b, sizeof b));
+        strconv::format_float(f, verb, -1).write_to(w, err);
+        size n = w.n;
+
+        if (verb == 'e') {
+            // clean up e-09 to e-9
+            if (n >= 4 && b[n-4] == 'e' && b[n-3] == '-' && b[n-2] == '0') {
+                b[n-2] = b[n-1];
+                n--;
+            }
+        }
+        out.write(str(b, n), err);
+    }
+}
+
+void json::write_string(io::Writer &out, str s, error err) {
+    out.write_byte('"', err);
+
+    size start = 0;
+    size i = 0;
+    while (i < len(s)) {
+        byte c = s.data[i];
+        if (safe_set.safe[c]) {
+            i++;
+            continue;
+        }
+
+        if (c < utf8::RuneSelf) {
+            out.write(s[start, i], err);
+            switch (c) {
+                case '"':  out.write("\\\"", err); break;
+                case '\\': out.write("\\\\", err); break;
+                case '\b': out.write("\\b", err); break;
+                case '\f': out.write("\\f", err); break;
+                case '\n': out.write("\\n", err); break;
+                case '\r': out.write("\\r", err); break;
+                case '\t': out.write("\\t", err); break;
+                default: {
+                    char u[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                    out.write(str(u, sizeof u), err);
+                }
+            }
+            i++;
+            start = i;
+            continue;
+        }
+
+        int n = 0;
+        rune r = utf8::decode_rune(s.slice(i), n);
+        if (r == utf8::RuneError && n == 1) {
+            out.write(s[start, i], err);
+            out.write("\\ufffd", err);
+            i++;
+            start = i;
+            continue;
+        }
+
+        // U+2028 and U+2029 are valid JSON but end lines in JavaScript
+        if (r == 0x2028 || r == 0x2029) {
+            out.write(s[start, i], err);
+            out.write(r == 0x2028 ? str("\\u2028") : str("\\u2029"), err);
+            i += n;
+            start = i;
+            continue;
+        }
+        i += n;
+    }
+    out.write(s[start, len(s)], err);
+
+    out.write_byte('"', err);
+}
+
+void Encoder::begin_value() {
+    if (need_comma) {
+        out.write_byte(',', err);
+    }
+}
+
+void Encoder::begin_object() {
+    begin_value();
+    out.write_byte('{', err);
+    need_comma = false;
+}
+
+void Encoder::end_object() {
+    out.write_byte('}', err);
+    need_comma = true;
+}
+
+void Encoder::begin_array() {
+    begin_value();
+    out.write_byte('[', err);
+    need_comma = false;
+}
+
+void Encoder::end_array() {
+    out.write_byte(']', err);
+    need_comma = true;
+}
+
+void Encoder::key(str name) {
+    begin_value();
+    write_string(out, name, err);
+    out.write_byte(':', err);
+    need_comma = false;
+}
+
+void Encoder::null() {
+    raw("null");
+}
+
+void Encoder::value(bool b) {
+    raw(b ? str("true") : str("false"));
+}
+
+void Encoder::value(int64 i) {
+    begin_value();
+    strconv::format_int(i, 10).write_to(out, err);
+    need_comma = true;
+}
+
+void Encoder::value(uint64 u) {
+    begin_value();
+    strconv::format_uint(u, 10).write_to(out, err);
+    need_comma = true;
+}
+
+void Encoder::value(float64 f) {
+    begin_value();
+    write_float(out, f, 64, err);
+    need_comma = true;
+}
+
+void Encoder::value(float32 f) {
+    begin_value();
+    write_float(out, f, 32, err);
+    need_comma = true;
+}
+
+void Encoder::value(str s) {
+    begin_value();
+    write_string(out, s, err);
+    need_comma = true;
+}
+
+void Encoder::raw(str text) {
+    begin_value();
+    out.write(text, err);
+    need_comma = true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <concepts>
+
+#include "lib/io/io.h"
+
+// Package json encodes and decodes JSON, as defined by RFC 8259.
+//
+// An Encoder writes a document a token at a time:
+//
+//     json::Encoder e(out, err);
+//     e.begin_object();
+//     e.key("id");    e.value(42);
+//     e.key("tags");  e.begin_array(); e.value("a"); e.value("b"); e.end_array();
+//     e.end_object();
+//
+// writes {"id":42,"tags":["a","b"]}. A Decoder reads one back, a token at a
+// time; see decode.h. bind.h maps structs to objects, and back, through a
+// fields() method.
+namespace lib::json {
+
+    // UnsupportedValueError reports a value that JSON can't represent: NaN or
+    // an infinity.
+    struct UnsupportedValueError : ErrorBase<UnsupportedValueError, "json: unsupported value: NaN or infinity"> {};
+
+    // Encoder writes JSON to out. It places the commas and colons between
+    // the tokens it is given, but doesn't check that they make up a valid
+    // document: that keys and values alternate in objects, and that every
+    // object and array is ended.
+    //
+    // Errors are reported through err, which must outlive the Encoder, as
+    // the error passed to the enclosing function does.
+    struct Encoder {
+        io::Writer &out;
+        error       err;
+
+        Encoder(io::Writer &out, error err) : out(out), err(err) {}
+
+        void begin_object();
+        void end_object();
+        void begin_array();
+        void end_array();
+
+        // key writes the name of an object member; its value comes next.
+        void key(str name);
+
+        void null();
+        void value(bool b);
+        void value(int64 i);
+        void value(uint64 u);
+        void value(float64 f);
+        void value(str s);
+
+        template <std::signed_integral T>
+        void value(T i) {
+            value(int64(i));
+        }
+
+        template <std::unsigned_integral T>
+        void value(T u) {
+            value(uint64(u));
+        }
+
+        void value(float32 f);
+
+        // a string literal would otherwise convert to bool
+        template <size N>
+        void value(char const (&s)[N]) {
+            value(str(s));
+        }
+
+        // raw writes text, which must be valid JSON, as a value.
+        void raw(str text);
+
+      private:
+        // need_comma is set after a value, so that the next one in the same
+        // object or array is preceded by a comma.
+        bool need_comma = false;
+
+        void begin_value();
+    } ;
+
+    // write_string writes s as a quoted JSON string. Invalid UTF-8 is
+    // replaced by U+FFFD.
+    void write_string(io::Writer &out, str s, error err);
+}
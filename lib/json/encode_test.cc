@@ -0,0 +1,116 @@
+#include "encode.h"
+
+#include "lib/testing/benchmark.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+namespace {
+    void write_document(io::Writer &out, error err) {
+        json::Encoder e(out, err);
+        e.begin_object();
+        e.key("id");
+        e.value(42);
+        e.key("name");
+        e.value("Zoë \"Z\" <z@example.com>");
+        e.key("ratio");
+        e.value(0.25);
+        e.key("tags");
+        e.begin_array();
+        e.value("a");
+        e.begin_object();
+        e.end_object();
+        e.begin_array();
+        e.end_array();
+        e.value(true);
+        e.null();
+        e.end_array();
+        e.key("big");
+        e.value(uint64(18446744073709551615ull));
+        e.end_object();
+    }
+
+    void write_float(io::Writer &out, float64 f, error err) {
+        json::Encoder e(out, err);
+        e.value(f);
+    }
+}
+
+void test_encoder(T &t) {
+    io::Buffer out;
+    write_document(out, error::panic);
+
+    String got = out.to_string();
+    str want = "{\"id\":42,\"name\":\"Zoë \\\"Z\\\" <z@example.com>\",\"ratio\":0.25,"
+               "\"tags\":[\"a\",{},[],true,null],\"big\":18446744073709551615}";
+    if (got != want) {
+        t.errorf("got  %s\nwant %s", got, want);
+    }
+}
+
+void test_write_string(T &t) {
+    struct {
+        str in;
+        str want;
+    } tests[] = {
+        {"", "\"\""},
+        {"plain", "\"plain\""},
+        {"tab\there\nnewline\r\b\f", "\"tab\\there\\nnewline\\r\\b\\f\""},
+        {"\x01\x1f", "\"\\u0001\\u001f\""},
+        {"back\\slash", "\"back\\\\slash\""},
+        {"bad \xff byte", "\"bad \\ufffd byte\""},
+        {"line\u2028sep\u2029", "\"line\\u2028sep\\u2029\""},
+        {"☺", "\"☺\""},
+    };
+
+    for (auto const &tt : tests) {
+        io::Buffer out;
+        json::write_string(out, tt.in, error::panic);
+        if (String got = out.to_string(); got != tt.want) {
+            t.errorf("write_string(%q) = %s; want %s", tt.in, got, tt.want);
+        }
+    }
+}
+
+void test_encode_float(T &t) {
+    struct {
+        float64 f;
+        str     want;
+    } tests[] = {
+        {0, "0"},
+        {1, "1"},
+        {-2.5, "-2.5"},
+        {1e20, "100000000000000000000"},
+        {1e21, "1e+21"},
+        {1e-6, "0.000001"},
+        {1e-7, "1e-7"},
+        {123456789.125, "123456789.125"},
+    };
+
+    for (auto const &tt : tests) {
+        io::Buffer out;
+        write_float(out, tt.f, error::panic);
+        if (String got = out.to_string(); got != tt.want) {
+            t.errorf("value(%v) = %s; want %s", tt.f, got, tt.want);
+        }
+    }
+
+    // JSON has no NaN
+    bool failed = false;
+    io::Buffer out;
+    write_float(out, 0.0 / 0.0, [&](Error &e) {
+        failed = dynamic_cast<json::UnsupportedValueError*>(&e) != nil;
+    });
+    if (!failed) {
+        t.errorf("NaN: no UnsupportedValueError");
+    }
+}
+
+void benchmark_encode(B &b) {
+    io::Buffer out;
+    for (int i = 0; i < b.n; i++) {
+        out.reset();
+        write_document(out, error::ignore);
+    }
+}
@@ -0,0 +1,169 @@
+#include "async.h"
+
+#include <cstring>
+#include <thread>
+
+using namespace lib;
+
+static size round_pow2(size n) {
+    size p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+log::AsyncSink::AsyncSink(io::Writer &out) : AsyncSink(out, AsyncOptions()) {}
+
+log::AsyncSink::AsyncSink(io::Writer &out, AsyncOptions const &opts) : out(out), opts(opts) {
+    this->opts.slots = round_pow2(std::max(opts.slots, size(2)));
+    this->opts.slot_size = std::max(opts.slot_size, size(16));
+    mask = this->opts.slots - 1;
+
+    slots = std::make_unique<Slot[]>(this->opts.slots);
+    data = std::make_unique<byte[]>(this->opts.slots * this->opts.slot_size);
+    for (size i = 0; i < this->opts.slots; i++) {
+        slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    thread = sync::go([this] {
+        run();
+    });
+}
+
+log::AsyncSink::~AsyncSink() {
+    stopping.store(true, std::memory_order_release);
+    thread.join();
+}
+
+// The queue is Dmitry Vyukov's bounded MPMC queue, with a single consumer. A
+// slot is free for position pos when its seq is pos and holds the line
+// fragment for pos when its seq is pos+1. A line longer than a slot claims
+// several consecutive positions with one CAS, so its fragments are read back
+// in order. Because the consumer frees slots in order, the last of the
+// positions being free means all of them are.
+void log::AsyncSink::write_line(str line) {
+    size nslots = opts.slots;
+    size slot_size = opts.slot_size;
+
+    if (len(line) > nslots * slot_size) {
+        line = line[0, nslots * slot_size];
+    }
+    uint64 k = std::max<uint64>(1, (len(line) + slot_size - 1) / slot_size);
+
+    uint64 pos;
+    for (int spin = 0;; spin++) {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+        uint64 last = pos + k - 1;
+        uint64 seq = slots[last & mask].seq.load(std::memory_order_acquire);
+        int64 dif = int64(seq - last);
+
+        if (dif == 0) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            // full
+            if (opts.policy == FullPolicy::Drop) {
+                ndropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    for (uint64 j = 0; j < k; j++) {
+        uint64 p = pos + j;
+        Slot &s = slots[p & mask];
+        str frag = line[j*slot_size, std::min<size>(len(line), (j + 1)*slot_size)];
+
+        memcpy(data.get() + (p & mask)*slot_size, frag.data, frag.len);
+        s.len = uint32(len(frag));
+        s.seq.store(p + 1, std::memory_order_release);
+    }
+}
+
+bool log::AsyncSink::drain(byte *batch, size batch_size, uint64 *reported) {
+    uint64 pos = dequeue_pos.load(std::memory_order_relaxed);
+    uint64 start = pos;
+    size n = 0;
+
+    for (;;) {
+        Slot &s = slots[pos & mask];
+        if (s.seq.load(std::memory_order_acquire) != pos + 1) {
+            break;
+        }
+
+        if (n + s.len > batch_size) {
+            out.write(str(batch, n), error::ignore);
+            n = 0;
+        }
+        memcpy(batch + n, data.get() + (pos & mask)*opts.slot_size, s.len);
+        n += s.len;
+
+        s.seq.store(pos + opts.slots, std::memory_order_release);
+        pos++;
+    }
+    dequeue_pos.store(pos, std::memory_order_relaxed);
+
+    uint64 d = ndropped.load(std::memory_order_relaxed);
+    if (d != *reported) {
+        // written with the batch, after the lines queued before the drop
+        fmt::BufWriter w(buf(batch + n, batch_size - n));
+        fmt::fprintf(w, "log: %d lines dropped, queue full\n", d - *reported);
+        if (w.n <= batch_size - n) {
+            n += w.n;
+            *reported = d;
+        }
+    }
+
+    if (n > 0) {
+        out.write(str(batch, n), error::ignore);
+        out.flush(error::ignore);
+    }
+    written.store(pos, std::memory_order_release);
+    return pos != start;
+}
+
+void log::AsyncSink::run() {
+    size batch_size = std::max(size(64 << 10), opts.slot_size);
+    std::unique_ptr<byte[]> batch = std::make_unique<byte[]>(batch_size);
+    uint64 reported = 0;
+
+    time::duration min_sleep = 50 * time::microsecond;
+    time::duration sleep = min_sleep;
+    int idle = 0;
+
+    for (;;) {
+        if (drain(batch.get(), batch_size, &reported)) {
+            idle = 0;
+            sleep = min_sleep;
+            continue;
+        }
+
+        if (stopping.load(std::memory_order_acquire)) {
+            // producers have finished; pick up anything they left
+            drain(batch.get(), batch_size, &reported);
+            return;
+        }
+
+        // spin briefly, then sleep for longer and longer up to opts.poll
+        if (++idle < 64) {
+            std::this_thread::yield();
+            continue;
+        }
+        time::sleep(sleep);
+        sleep = std::min(sleep.nsecs * 2, opts.poll.nsecs);
+    }
+}
+
+void log::AsyncSink::flush() {
+    uint64 target = enqueue_pos.load(std::memory_order_acquire);
+    while (written.load(std::memory_order_acquire) < target) {
+        time::sleep(50 * time::microsecond);
+    }
+}
+
+uint64 log::AsyncSink::dropped() const {
+    return ndropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "log.h"
+#include "lib/sync/go.h"
+
+namespace lib::log {
+
+    // FullPolicy says what an AsyncSink does with a line when its queue is
+    // full.
+    enum class FullPolicy {
+        Drop,   // discard the line; the writer thread reports how many were lost
+        Block,  // wait for the writer thread to make room
+    } ;
+
+    struct AsyncOptions {
+        // slots is the number of queue slots, rounded up to a power of two.
+        // A line takes one slot per slot_size bytes; a line longer than the
+        // whole queue is truncated.
+        size slots     = 4096;
+        size slot_size = 256;
+
+        FullPolicy policy = FullPolicy::Drop;
+
+        // poll is the longest the writer thread sleeps when the queue is
+        // empty, which bounds how late a line is written.
+        time::duration poll = 10 * time::millisecond;
+    } ;
+
+    // AsyncSink passes lines to a background thread that writes them to out,
+    // so that logging threads never make system calls. Lines are copied into
+    // a bounded, preallocated, lock-free queue with one consumer; the writer
+    // thread drains it in batches, writing many lines with each call.
+    //
+    // The writer thread polls the queue rather than being woken, so that
+    // producers need not make a system call to wake it. It spins briefly when
+    // the queue empties and then sleeps, for at most opts.poll.
+    struct AsyncSink : Sink {
+        AsyncSink(io::Writer &out);
+        AsyncSink(io::Writer &out, AsyncOptions const &opts);
+        AsyncSink(AsyncSink const&) = delete;
+
+        // The destructor writes out the queued lines and stops the writer
+        // thread.
+        ~AsyncSink();
+
+        void write_line(str line) override;
+
+        // flush waits until every line queued before the call has been
+        // written to out.
+        void flush();
+
+        // dropped returns the number of lines discarded because the queue was
+        // full.
+        uint64 dropped() const;
+
+      private:
+        struct Slot {
+            std::atomic<uint64> seq;
+            uint32              len = 0;
+        } ;
+
+        io::Writer   &out;
+        AsyncOptions  opts;
+        uint64        mask = 0;
+
+        std::unique_ptr<Slot[]> slots;
+        std::unique_ptr<byte[]> data;  // slot i's bytes are at i*slot_size
+
+        alignas(64) std::atomic<uint64> enqueue_pos = 0;
+        alignas(64) std::atomic<uint64> dequeue_pos = 0;  // written by the writer thread only
+        alignas(64) std::atomic<uint64> written     = 0;  // position up to which lines are written out
+        std::atomic<uint64> ndropped  = 0;
+        std::atomic<bool>   stopping  = false;
+
+        sync::go thread;
+
+        void run();
+
+        // drain writes out everything in the queue. It returns false if the
+        // queue was empty.
+        bool drain(byte *batch, size batch_size, uint64 *reported);
+    } ;
+}
@@ -0,0 +1,144 @@
+#include "async.h"
+
+#include <atomic>
+#include <vector>
+
+#include "lib/strings/strings.h"
+#include "lib/sync/go.h"
+#include "lib/testing/benchmark.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+namespace {
+    // Gate is a Writer that collects its output and can be made to block,
+    // to fill an AsyncSink's queue.
+    struct Gate : io::Writer {
+        io::Buffer             out;
+        std::atomic<bool>      closed = false;
+        std::atomic<int>       blocked = 0;
+
+        size direct_write(str data, error err) override {
+            if (closed.load()) {
+                blocked++;
+                while (closed.load()) {
+                    time::sleep(100 * time::microsecond);
+                }
+            }
+            return out.write(data, err);
+        }
+    } ;
+}
+
+void test_async_lines(T &t) {
+    Gate g;
+    const int nthreads = 4;
+    const int nlines = 2000;
+
+    {
+        // small slots, so that long lines span several of them
+        log::AsyncSink sink(g, {.slots = 64, .slot_size = 32, .policy = log::FullPolicy::Block});
+
+        std::vector<sync::go> threads;
+        for (int i = 0; i < nthreads; i++) {
+            threads.push_back(sync::go([&sink, i] {
+                for (int j = 0; j < nlines; j++) {
+                    // "t<i> <j> " followed by j%100 x's
+                    String line = fmt::sprintf("t%d %d %s\n", i, j, strings::repeat("x", j % 100));
+                    sink.write_line(line);
+                }
+            }));
+        }
+        for (auto &th : threads) {
+            th.join();
+        }
+        sink.flush();
+
+        if (sink.dropped() != 0) {
+            t.errorf("dropped %d lines with the Block policy", sink.dropped());
+        }
+    }
+
+    // every line arrives whole, and each thread's lines arrive in order
+    String all = g.out.to_string();
+    int next[nthreads] = {};
+    int count = 0;
+    for (str line : strings::split(all, "\n")) {
+        if (len(line) == 0) {
+            continue;
+        }
+        count++;
+
+        int i = -1, j = -1;
+        if (sscanf(String(line).c_str(), "t%d %d ", &i, &j) != 2 || i < 0 || i >= nthreads) {
+            t.fatalf("bad line %q", line);
+        }
+        String want = fmt::sprintf("t%d %d %s", i, j, strings::repeat("x", j % 100));
+        if (line != want || j != next[i]) {
+            t.fatalf("got line %q; want %q", line, fmt::sprintf("t%d %d ...", i, next[i]));
+        }
+        next[i]++;
+    }
+    if (count != nthreads*nlines) {
+        t.errorf("got %d lines; want %d", count, nthreads*nlines);
+    }
+}
+
+void test_async_drop(T &t) {
+    Gate g;
+    g.closed = true;
+
+    log::AsyncSink sink(g, {.slots = 8, .slot_size = 16, .policy = log::FullPolicy::Drop});
+
+    // the first line is taken by the writer thread, which then blocks in
+    // write; the next 8 fill the queue and the rest are dropped
+    sink.write_line("first\n");
+    while (g.blocked.load() == 0) {
+        time::sleep(100 * time::microsecond);
+    }
+    for (int i = 0; i < 20; i++) {
+        sink.write_line("line\n");
+    }
+
+    if (sink.dropped() != 12) {
+        t.errorf("dropped = %d; want 12", sink.dropped());
+    }
+
+    g.closed = false;
+    sink.flush();
+
+    String got = g.out.to_string();
+    str want = "first\nline\nline\nline\nline\nline\nline\nline\nline\nlog: 12 lines dropped, queue full\n";
+    if (got != want) {
+        t.errorf("got %q; want %q", got, want);
+    }
+}
+
+void test_async_logger(T &t) {
+    Gate g;
+    {
+        log::AsyncSink sink(g);
+        log::Logger l(sink, log::json_encoder);
+        l.info("hello", "n", 1);
+        // the destructor writes out what is queued
+    }
+
+    String got = g.out.to_string();
+    if (!strings::has_suffix(got, ",\"level\":\"INFO\",\"msg\":\"hello\",\"n\":1}\n")) {
+        t.errorf("got %q", got);
+    }
+}
+
+void benchmark_async_log(B &b) {
+    Gate g;
+    log::AsyncSink sink(g, {.policy = log::FullPolicy::Block});
+    log::Logger l(sink);
+
+    b.run_parallel([&](PB &pb) {
+        while (pb.next()) {
+            l.info("request done", "path", "/index.html", "status", 200);
+        }
+    });
+    sink.flush();
+}
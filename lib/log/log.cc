@@ -0,0 +1,499 @@
+#include "log.h"
+
+#include <cstring>
+#include <ctime>
+
+#include "lib/os.h"
+#include "lib/strconv/quote.h"
+#include "lib/sync/lock.h"
+#include "lib/utf8/decode.h"
+#include "lib/utf8/utf8.h"
+
+using namespace lib;
+
+log::TextEncoder log::text_encoder;
+log::JSONEncoder log::json_encoder;
+
+namespace {
+    // LineBuffer is a Writer appending to memory that is kept between uses,
+    // so that a thread encoding records allocates only when a record is
+    // longer than any before it.
+    struct LineBuffer : io::Writer {
+        byte *data = nil;
+        size  n    = 0;
+        size  cap  = 0;
+        bool  busy = false;  // in use further up the stack
+
+        LineBuffer(size initial = 0) {
+            if (initial > 0) {
+                grow(initial);
+            }
+        }
+        LineBuffer(LineBuffer const&) = delete;
+
+        ~LineBuffer() {
+            ::free(data);
+        }
+
+        size direct_write(str s, error) override {
+            if (len(s) > cap - n) {
+                grow(n + len(s));
+            }
+            memcpy(data + n, s.data, s.len);
+            n += len(s);
+            return len(s);
+        }
+
+        void grow(size need) {
+            size newcap = std::max(need, std::max(cap*2, size(256)));
+            byte *newdata = (byte*) ::realloc(data, newcap);
+            if (newdata == nil) {
+                exceptions::out_of_memory();
+            }
+            data = newdata;
+            cap = newcap;
+        }
+
+        str bytes() const {
+            return str(data, n);
+        }
+    } ;
+
+    // one buffer for the line and one for a value that must be inspected
+    // before it is written, such as a text value that may need quoting
+    thread_local LineBuffer line_buffer(1024);
+    thread_local LineBuffer value_buffer;
+
+    // Acquire takes a thread's buffer, or a fresh one if a record is encoded
+    // while another is being encoded on the same thread, as when formatting
+    // a value logs.
+    struct Acquire {
+        LineBuffer *b;
+        LineBuffer  spare;
+
+        Acquire(LineBuffer &tl) {
+            b = tl.busy ? &spare : &tl;
+            b->busy = true;
+            b->n = 0;
+        }
+
+        ~Acquire() {
+            b->busy = false;
+        }
+    } ;
+
+    void write_digits(char *p, int64 v, int width) {
+        for (int i = width - 1; i >= 0; i--) {
+            p[i] = char('0' + v%10);
+            v /= 10;
+        }
+    }
+
+    int64 floor_div(int64 a, int64 b) {
+        int64 q = a / b;
+        return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+    }
+
+    // write_time writes t, in nanoseconds since the Unix epoch, in RFC 3339
+    // format in UTC with milliseconds.
+    void write_time(io::Writer &out, int64 t) {
+        int64 secs = floor_div(t, 1'000'000'000);
+        int64 ms = (t - secs*1'000'000'000) / 1'000'000;
+        int64 days = floor_div(secs, 86'400);
+        int64 rem = secs - days*86'400;
+
+        // civil_from_days, from Howard Hinnant's date algorithms
+        days += 719'468;
+        int64 era = floor_div(days, 146'097);
+        int64 doe = days - era*146'097;
+        int64 yoe = (doe - doe/1'460 + doe/36'524 - doe/146'096) / 365;
+        int64 doy = doe - (365*yoe + yoe/4 - yoe/100);
+        int64 mp = (5*doy + 2) / 153;
+        int64 day = doy - (153*mp + 2)/5 + 1;
+        int64 month = mp < 10 ? mp + 3 : mp - 9;
+        int64 year = yoe + era*400 + (month <= 2);
+
+        char b[] = "0000-00-00T00:00:00.000Z";
+        write_digits(b, std::clamp<int64>(year, 0, 9999), 4);
+        write_digits(b + 5, month, 2);
+        write_digits(b + 8, day, 2);
+        write_digits(b + 11, rem / 3600, 2);
+        write_digits(b + 14, rem / 60 % 60, 2);
+        write_digits(b + 17, rem % 60, 2);
+        write_digits(b + 20, ms, 3);
+        out.write(str(b, sizeof b - 1), error::ignore);
+    }
+
+    // fmt_frac formats the fraction of *v/10**prec (e.g., ".12345") into the
+    // tail of b, omitting trailing zeros, and leaves *v/10**prec in *v. It
+    // omits the decimal point when the fraction is 0 and returns the index
+    // where the output begins. This and write_duration follow Go's
+    // time.Duration.String.
+    int fmt_frac(char *b, int w, uint64 *v, int prec) {
+        bool print = false;
+        for (int i = 0; i < prec; i++) {
+            int digit = int(*v % 10);
+            print = print || digit != 0;
+            if (print) {
+                b[--w] = char(digit + '0');
+            }
+            *v /= 10;
+        }
+        if (print) {
+            b[--w] = '.';
+        }
+        return w;
+    }
+
+    int fmt_int(char *b, int w, uint64 v) {
+        if (v == 0) {
+            b[--w] = '0';
+            return w;
+        }
+        while (v > 0) {
+            b[--w] = char(v%10 + '0');
+            v /= 10;
+        }
+        return w;
+    }
+
+    void write_duration(io::Writer &out, int64 d) {
+        char b[32];
+        int w = sizeof b;
+
+        uint64 u = d < 0 ? -uint64(d) : uint64(d);
+        if (u < 1'000'000'000) {
+            // less than a second: use a smaller unit, as in "1.2ms"
+            int prec = 0;
+            str unit;
+            if (u == 0) {
+                out.write("0s", error::ignore);
+                return;
+            } else if (u < 1'000) {
+                unit = "ns";
+            } else if (u < 1'000'000) {
+                prec = 3;
+                unit = "µs";
+            } else {
+                prec = 6;
+                unit = "ms";
+            }
+            w -= int(len(unit));
+            memcpy(b + w, unit.data, unit.len);
+            w = fmt_frac(b, w, &u, prec);
+            w = fmt_int(b, w, u);
+        } else {
+            b[--w] = 's';
+            w = fmt_frac(b, w, &u, 9);
+
+            // u is now whole seconds
+            w = fmt_int(b, w, u % 60);
+            u /= 60;
+            if (u > 0) {
+                b[--w] = 'm';
+                w = fmt_int(b, w, u % 60);
+                u /= 60;
+                if (u > 0) {
+                    b[--w] = 'h';
+                    w = fmt_int(b, w, u);
+                }
+            }
+        }
+
+        if (d < 0) {
+            b[--w] = '-';
+        }
+        out.write(str(b + w, sizeof b - w), error::ignore);
+    }
+
+    // needs_quoting reports whether a text value must be quoted to be read
+    // back unambiguously.
+    bool needs_quoting(str s) {
+        if (len(s) == 0) {
+            return true;
+        }
+        for (size i = 0; i < len(s);) {
+            byte c = s.data[i];
+            if (c < utf8::RuneSelf) {
+                if (c == ' ' || c == '=' || c == '"' || c < 0x20 || c == 0x7f) {
+                    return true;
+                }
+                i++;
+                continue;
+            }
+            int n = 0;
+            rune r = utf8::decode_rune(s.slice(i), n);
+            if (r == utf8::RuneError || !strconv::is_print(r)) {
+                return true;
+            }
+            i += n;
+        }
+        return false;
+    }
+
+    void write_text_value(io::Writer &out, str s) {
+        if (needs_quoting(s)) {
+            strconv::quote(s).write_to(out, error::ignore);
+        } else {
+            out.write(s, error::ignore);
+        }
+    }
+
+    const char hex[] = "0123456789abcdef";
+
+    // write_json_string writes s as a JSON string. Invalid UTF-8 is replaced
+    // by U+FFFD.
+    void write_json_string(io::Writer &out, str s) {
+        out.write_byte('"', error::ignore);
+
+        size start = 0;
+        size i = 0;
+        while (i < len(s)) {
+            byte c = s.data[i];
+            if (c < utf8::RuneSelf) {
+                if (c >= 0x20 && c != '"' && c != '\\') {
+                    i++;
+                    continue;
+                }
+                out.write(s[start, i], error::ignore);
+                switch (c) {
+                    case '"':  out.write("\\\"", error::ignore); break;
+                    case '\\': out.write("\\\\", error::ignore); break;
+                    case '\n': out.write("\\n", error::ignore); break;
+                    case '\r': out.write("\\r", error::ignore); break;
+                    case '\t': out.write("\\t", error::ignore); break;
+                    default: {
+                        char u[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                        out.write(str(u, sizeof u), error::ignore);
+                    }
+                }
+                i++;
+                start = i;
+                continue;
+            }
+
+            int n = 0;
+            rune r = utf8::decode_rune(s.slice(i), n);
+            if (r == utf8::RuneError && n == 1) {
+                out.write(s[start, i], error::ignore);
+                out.write("\\ufffd", error::ignore);
+                i++;
+                start = i;
+                continue;
+            }
+            i += n;
+        }
+        out.write(s[start, len(s)], error::ignore);
+
+        out.write_byte('"', error::ignore);
+    }
+
+    int64 wall_clock() {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return int64(ts.tv_sec)*1'000'000'000 + ts.tv_nsec;
+    }
+
+    log::Logger *default_log = nil;
+}
+
+String log::level_name(Level l) {
+    struct {
+        Level level;
+        str   name;
+    } names[] = {
+        {Level::Error, "ERROR"},
+        {Level::Warn,  "WARN"},
+        {Level::Info,  "INFO"},
+        {Level::Debug, "DEBUG"},
+    };
+
+    for (auto const &n : names) {
+        if (l == n.level) {
+            return n.name;
+        }
+        if (l > n.level) {
+            return fmt::sprintf("%s+%d", n.name, int(l) - int(n.level));
+        }
+    }
+    return fmt::sprintf("DEBUG%d", int(l) - int(Level::Debug));
+}
+
+static str level_str(log::Level l, char (&b)[16]) {
+    switch (l) {
+        case log::Level::Debug: return "DEBUG";
+        case log::Level::Info:  return "INFO";
+        case log::Level::Warn:  return "WARN";
+        case log::Level::Error: return "ERROR";
+    }
+    // rare, so allocating here is fine
+    String name = log::level_name(l);
+    return str(b, copy(buf(b, sizeof b), name));
+}
+
+void log::Attr::write_value(io::Writer &out) const {
+    fmt::Fmt f(out, error::ignore);
+    switch (kind) {
+        case Int:      f.write(i); break;
+        case Uint:     f.write(u); break;
+        case Float:    f.write(this->f); break;
+        case Bool:     f.write(b); break;
+        case Str:      out.write(s, error::ignore); break;
+        case Duration: write_duration(out, i); break;
+        case Time:     write_time(out, time::time{i}.unix_nano()); break;
+        case Err:      f.write(*err); break;
+        case Any:      any.write(f, any.ptr); break;
+    }
+}
+
+void log::TextEncoder::encode_attrs(io::Writer &out, std::span<Attr const> attrs) const {
+    for (Attr const &a : attrs) {
+        out.write_byte(' ', error::ignore);
+        write_text_value(out, a.key);
+        out.write_byte('=', error::ignore);
+
+        switch (a.kind) {
+            case Attr::Int:
+            case Attr::Uint:
+            case Attr::Float:
+            case Attr::Bool:
+            case Attr::Duration:
+            case Attr::Time:
+                // never need quoting
+                a.write_value(out);
+                break;
+
+            case Attr::Str:
+                write_text_value(out, a.s);
+                break;
+
+            case Attr::Err:
+            case Attr::Any: {
+                Acquire v(value_buffer);
+                a.write_value(*v.b);
+                write_text_value(out, v.b->bytes());
+                break;
+            }
+        }
+    }
+}
+
+void log::TextEncoder::encode(io::Writer &out, Record const &r, str prefix) const {
+    char lb[16];
+    out.write("time=", error::ignore);
+    write_time(out, r.unix_nano);
+    out.write(" level=", error::ignore);
+    out.write(level_str(r.level, lb), error::ignore);
+    out.write(" msg=", error::ignore);
+    write_text_value(out, r.msg);
+    out.write(prefix, error::ignore);
+    encode_attrs(out, r.attrs);
+    out.write_byte('\n', error::ignore);
+}
+
+void log::JSONEncoder::encode_attrs(io::Writer &out, std::span<Attr const> attrs) const {
+    for (Attr const &a : attrs) {
+        out.write_byte(',', error::ignore);
+        write_json_string(out, a.key);
+        out.write_byte(':', error::ignore);
+
+        switch (a.kind) {
+            case Attr::Int:
+            case Attr::Uint:
+            case Attr::Bool:
+                a.write_value(out);
+                break;
+
+            case Attr::Float:
+                // JSON has no NaN or infinities
+                if (a.f != a.f || a.f - a.f != 0) {
+                    out.write_byte('"', error::ignore);
+                    a.write_value(out);
+                    out.write_byte('"', error::ignore);
+                } else {
+                    a.write_value(out);
+                }
+                break;
+
+            case Attr::Duration:
+                fmt::Fmt(out, error::ignore).write(a.i);
+                break;
+
+            case Attr::Str:
+                write_json_string(out, a.s);
+                break;
+
+            case Attr::Time:
+                out.write_byte('"', error::ignore);
+                a.write_value(out);
+                out.write_byte('"', error::ignore);
+                break;
+
+            case Attr::Err:
+            case Attr::Any: {
+                Acquire v(value_buffer);
+                a.write_value(*v.b);
+                write_json_string(out, v.b->bytes());
+                break;
+            }
+        }
+    }
+}
+
+void log::JSONEncoder::encode(io::Writer &out, Record const &r, str prefix) const {
+    char lb[16];
+    out.write("{\"time\":\"", error::ignore);
+    write_time(out, r.unix_nano);
+    out.write("\",\"level\":\"", error::ignore);
+    out.write(level_str(r.level, lb), error::ignore);
+    out.write("\",\"msg\":", error::ignore);
+    write_json_string(out, r.msg);
+    out.write(prefix, error::ignore);
+    encode_attrs(out, r.attrs);
+    out.write("}\n", error::ignore);
+}
+
+void log::WriterSink::write_line(str line) {
+    sync::Lock lock(mtx);
+    out.write(line, error::ignore);
+}
+
+log::Logger::Logger(Sink &sink, Encoder const &encoder, Level level) :
+    sink(sink), encoder(encoder), level(int8(level)) {}
+
+log::Logger::Logger(Logger const &other) :
+    sink(other.sink), encoder(other.encoder), level(other.level.load()), prefix(other.prefix) {}
+
+log::Logger log::Logger::with_attrs(std::span<Attr const> attrs) const {
+    Logger l(*this);
+
+    LineBuffer b;
+    encoder.encode_attrs(b, attrs);
+    l.prefix += b.bytes();
+    return l;
+}
+
+void log::Logger::log_attrs(Level l, str msg, std::span<Attr const> attrs) {
+    Record r = {
+        .unix_nano = wall_clock(),
+        .level = l,
+        .msg = msg,
+        .attrs = attrs,
+    };
+
+    Acquire line(line_buffer);
+    encoder.encode(*line.b, r, prefix);
+    sink.write_line(line.b->bytes());
+}
+
+log::Logger& log::default_logger() {
+    static WriterSink stderr_sink(os::stderr);
+    static Logger stderr_logger(stderr_sink);
+
+    Logger *l = __atomic_load_n(&default_log, __ATOMIC_ACQUIRE);
+    return l ? *l : stderr_logger;
+}
+
+void log::set_default(Logger &l) {
+    __atomic_store_n(&default_log, &l, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <span>
+#include <tuple>
+#include <type_traits>
+
+#include "lib/error.h"
+#include "lib/fmt/fmt.h"
+#include "lib/io/io.h"
+#include "lib/sync/mutex.h"
+#include "lib/time/time.h"
+
+// Package log implements structured, leveled logging.
+//
+// A record has a time, a level, a message and a list of key/value
+// attributes:
+//
+//     log::info("request done", "path", path, "status", status, "elapsed", d);
+//
+// Keys and values alternate, as in Go's log/slog. Integers, floats, bools,
+// strings, durations, times and errors are stored as typed attributes; any
+// other value is stored by reference and written with fmt.
+//
+// A Logger encodes each record, with a TextEncoder or a JSONEncoder, into a
+// buffer owned by the calling thread and passes the finished line to its
+// Sink. Logging below the logger's level costs a load and a branch, and
+// logging at an enabled level doesn't allocate once the thread's buffer has
+// grown to fit its longest record. A WriterSink writes each line to an
+// io::Writer under a mutex; an AsyncSink (async.h) hands lines to a
+// background thread through a lock-free queue, so the logging thread makes
+// no system calls.
+namespace lib::log {
+
+    enum class Level : int8 {
+        Debug = -4,
+        Info  = 0,
+        Warn  = 4,
+        Error = 8,
+    } ;
+
+    // level_name returns the name of l, such as "INFO". Levels between the
+    // named ones are written relative to the one below, as "WARN+2".
+    String level_name(Level l);
+
+    // Attr is a key/value pair of a record. It refers to, rather than copies,
+    // string and formatted values, so it must not outlive them.
+    struct Attr {
+        enum Kind : uint8 {
+            Int,
+            Uint,
+            Float,
+            Bool,
+            Str,
+            Duration,
+            Time,
+            Err,
+            Any,
+        } ;
+
+        str  key;
+        Kind kind = Any;
+
+        union {
+            int64           i;
+            uint64          u;
+            float64         f;
+            bool            b;
+            str             s;
+            Error const    *err;
+            struct {
+                void const *ptr;
+                void      (*write)(fmt::Fmt &f, void const *ptr);
+            } any;
+        } ;
+
+        Attr() : i(0) {}
+        Attr(str key, Kind kind) : key(key), kind(kind), i(0) {}
+
+        // write writes the value of the attribute as fmt's %v would, except
+        // that durations and times are written as in Go.
+        void write_value(io::Writer &out) const;
+    } ;
+
+    namespace internal {
+        template <typename T>
+        void write_any(fmt::Fmt &f, void const *ptr) {
+            f.write(*(T const*) ptr);
+        }
+    }
+
+    // attr returns the attribute for a key and a value of any type.
+    template <typename T>
+    Attr attr(str key, T const &v) {
+        using U = std::remove_cvref_t<T>;
+        Attr a;
+        a.key = key;
+
+        if constexpr (std::is_same_v<U, bool>) {
+            a.kind = Attr::Bool;
+            a.b = v;
+        } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+            a.kind = Attr::Int;
+            a.i = v;
+        } else if constexpr (std::is_integral_v<U>) {
+            a.kind = Attr::Uint;
+            a.u = v;
+        } else if constexpr (std::is_floating_point_v<U>) {
+            a.kind = Attr::Float;
+            a.f = v;
+        } else if constexpr (std::is_same_v<U, time::duration>) {
+            a.kind = Attr::Duration;
+            a.i = v.nsecs;
+        } else if constexpr (std::is_same_v<U, time::time>) {
+            a.kind = Attr::Time;
+            a.i = v.nsecs;
+        } else if constexpr (std::is_base_of_v<Error, U>) {
+            a.kind = Attr::Err;
+            a.err = &v;
+        } else if constexpr (std::is_convertible_v<U const&, str>) {
+            a.kind = Attr::Str;
+            a.s = v;
+        } else {
+            a.kind = Attr::Any;
+            a.any.ptr = &v;
+            a.any.write = internal::write_any<U>;
+        }
+        return a;
+    }
+
+    struct Record {
+        int64                  unix_nano = 0;  // wall clock time
+        Level                  level = Level::Info;
+        str                    msg;
+        std::span<Attr const>  attrs;
+    } ;
+
+    // Encoder turns a record into a line of output, including the trailing
+    // newline. prefix holds attributes already encoded by the same encoder
+    // with encode_attrs, as added by Logger::with.
+    struct Encoder {
+        virtual void encode(io::Writer &out, Record const &r, str prefix) const = 0;
+        virtual void encode_attrs(io::Writer &out, std::span<Attr const> attrs) const = 0;
+        virtual ~Encoder() {}
+    } ;
+
+    // TextEncoder writes records as key=value pairs:
+    //
+    //     time=2024-03-01T12:00:00.000Z level=INFO msg="request done" status=200
+    //
+    // Values containing spaces, quotes, '=' or unprintable characters are
+    // quoted.
+    struct TextEncoder : Encoder {
+        void encode(io::Writer &out, Record const &r, str prefix) const override;
+        void encode_attrs(io::Writer &out, std::span<Attr const> attrs) const override;
+    } ;
+
+    // JSONEncoder writes each record as a JSON object on a line of its own.
+    // Durations are written in nanoseconds and values of other types as
+    // strings.
+    struct JSONEncoder : Encoder {
+        void encode(io::Writer &out, Record const &r, str prefix) const override;
+        void encode_attrs(io::Writer &out, std::span<Attr const> attrs) const override;
+    } ;
+
+    extern TextEncoder text_encoder;
+    extern JSONEncoder json_encoder;
+
+    // Sink receives encoded lines. It must be safe for concurrent use.
+    struct Sink {
+        virtual void write_line(str line) = 0;
+        virtual ~Sink() {}
+    } ;
+
+    // WriterSink writes each line to out with one write call, holding a mutex
+    // so that lines from different threads don't interleave.
+    struct WriterSink : Sink {
+        io::Writer &out;
+        sync::Mutex mtx;
+
+        WriterSink(io::Writer &out) : out(out) {}
+
+        void write_line(str line) override;
+    } ;
+
+    struct Logger {
+        Logger(Sink &sink, Encoder const &encoder = text_encoder, Level level = Level::Info);
+        Logger(Logger const &other);
+
+        // with returns a logger that adds the given key/value pairs to every
+        // record. They are encoded once, here.
+        template <typename... Args>
+        Logger with(Args const &...kv) const {
+            static_assert(sizeof...(Args) % 2 == 0, "log: keys and values must come in pairs");
+            auto attrs = pairs(kv...);
+            return with_attrs(attrs);
+        }
+        Logger with_attrs(std::span<Attr const> attrs) const;
+
+        bool enabled(Level l) const {
+            return int8(l) >= level.load(std::memory_order_relaxed);
+        }
+
+        void set_level(Level l) {
+            level.store(int8(l), std::memory_order_relaxed);
+        }
+
+        template <typename... Args>
+        void log(Level l, str msg, Args const &...kv) {
+            static_assert(sizeof...(Args) % 2 == 0, "log: keys and values must come in pairs");
+            if (!enabled(l)) {
+                return;
+            }
+            auto attrs = pairs(kv...);
+            log_attrs(l, msg, attrs);
+        }
+
+        template <typename... Args>
+        void debug(str msg, Args const &...kv) {
+            log(Level::Debug, msg, kv...);
+        }
+
+        template <typename... Args>
+        void info(str msg, Args const &...kv) {
+            log(Level::Info, msg, kv...);
+        }
+
+        template <typename... Args>
+        void warn(str msg, Args const &...kv) {
+            log(Level::Warn, msg, kv...);
+        }
+
+        template <typename... Args>
+        void error(str msg, Args const &...kv) {
+            log(Level::Error, msg, kv...);
+        }
+
+        // log_attrs logs a record with attributes built by the caller. It
+        // does not check the level.
+        void log_attrs(Level l, str msg, std::span<Attr const> attrs);
+
+      private:
+        Sink              &sink;
+        Encoder const     &encoder;
+        std::atomic<int8>  level;
+        String             prefix;  // attributes added by with, encoded
+
+        template <typename... Args>
+        static std::array<Attr, sizeof...(Args) / 2> pairs(Args const &...kv) {
+            return pairs_of(std::forward_as_tuple(kv...), std::make_index_sequence<sizeof...(Args) / 2>());
+        }
+
+        template <typename Tuple, usize... I>
+        static std::array<Attr, sizeof...(I)> pairs_of(Tuple const &kv, std::index_sequence<I...>) {
+            static_assert((std::is_convertible_v<std::tuple_element_t<2*I, Tuple>, str> && ...),
+                          "log: keys must be strings");
+            return {attr(std::get<2*I>(kv), std::get<2*I + 1>(kv))...};
+        }
+    } ;
+
+    // default_logger returns the logger used by the functions below. It
+    // writes text to os::stderr at level Info until replaced by set_default.
+    Logger& default_logger();
+
+    // set_default makes l the default logger. l must outlive its use.
+    void set_default(Logger &l);
+
+    template <typename... Args>
+    void debug(str msg, Args const &...kv) {
+        default_logger().debug(msg, kv...);
+    }
+
+    template <typename... Args>
+    void info(str msg, Args const &...kv) {
+        default_logger().info(msg, kv...);
+    }
+
+    template <typename... Args>
+    void warn(str msg, Args const &...kv) {
+        default_logger().warn(msg, kv...);
+    }
+
+    template <typename... Args>
+    void error(str msg, Args const &...kv) {
+        default_logger().error(msg, kv...);
+    }
+}
@@ -0,0 +1,201 @@
+#include "log.h"
+
+#include "lib/os/error.h"
+#include "lib/strings/strings.h"
+#include "lib/testing/benchmark.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+namespace {
+    struct Point {
+        int x = 0, y = 0;
+
+        void fmt(io::Writer &out, error err) const {
+            fmt::fprintf(out, err, "(%d, %d)", x, y);
+        }
+    } ;
+
+    // strip_time removes the timestamp, which starts every record, after
+    // checking its shape.
+    str strip_time(T &t, str line, str prefix) {
+        // 2006-01-02T15:04:05.000Z
+        size n = len(prefix) + 24;
+        if (!strings::has_prefix(line, prefix) || len(line) < n || line[n - 1] != 'Z') {
+            t.errorf("line %q doesn't start with a time", line);
+            return line;
+        }
+        return line(n);
+    }
+}
+
+void test_text(T &t) {
+    io::Buffer out;
+    log::WriterSink sink(out);
+    log::Logger l(sink);
+
+    Point p = {1, 2};
+    l.info("request done",
+        "path", "/index.html",
+        "status", 200,
+        "bytes", uint64(1234),
+        "ratio", 0.5,
+        "cached", true,
+        "elapsed", 1500 * time::microsecond,
+        "note", "two words",
+        "empty", "",
+        "point", p,
+        "err", os::ErrClosed());
+
+    String got = out.to_string();
+    str want = " level=INFO msg=\"request done\" path=/index.html status=200 bytes=1234"
+               " ratio=0.5 cached=true elapsed=1.5ms note=\"two words\" empty=\"\""
+               " point=\"(1, 2)\" err=\"file already closed\"\n";
+    if (str rest = strip_time(t, got, "time="); rest != want) {
+        t.errorf("got  %q\nwant %q", rest, want);
+    }
+}
+
+void test_json(T &t) {
+    io::Buffer out;
+    log::WriterSink sink(out);
+    log::Logger l(sink, log::json_encoder);
+
+    Point p = {3, 4};
+    l.warn("quote \" and\nnewline",
+        "n", -7,
+        "elapsed", 2 * time::second,
+        "point", p,
+        "bad", "\xff");
+
+    String got = out.to_string();
+    str want = "\",\"level\":\"WARN\",\"msg\":\"quote \\\" and\\nnewline\",\"n\":-7,"
+               "\"elapsed\":2000000000,\"point\":\"(3, 4)\",\"bad\":\"\\ufffd\"}\n";
+    if (str rest = strip_time(t, got, "{\"time\":\""); rest != want) {
+        t.errorf("got  %q\nwant %q", rest, want);
+    }
+}
+
+void test_levels(T &t) {
+    io::Buffer out;
+    log::WriterSink sink(out);
+    log::Logger l(sink, log::text_encoder, log::Level::Warn);
+
+    int formatted = 0;
+    struct Counted {
+        int *n;
+        void fmt(io::Writer &out, error) const {
+            (*n)++;
+            out.write("x", error::ignore);
+        }
+    } counted = {&formatted};
+
+    l.debug("no", "v", counted);
+    l.info("no", "v", counted);
+    if (out.length() != 0 || formatted != 0) {
+        t.errorf("disabled levels wrote %q and formatted %d values", out.to_string(), formatted);
+    }
+
+    l.error("yes", "v", counted);
+    if (formatted != 1) {
+        t.errorf("formatted = %d; want 1", formatted);
+    }
+
+    l.set_level(log::Level::Debug);
+    if (!l.enabled(log::Level::Debug)) {
+        t.errorf("Debug not enabled after set_level");
+    }
+
+    struct {
+        log::Level level;
+        str        name;
+    } names[] = {
+        {log::Level::Debug, "DEBUG"},
+        {log::Level::Info, "INFO"},
+        {log::Level::Warn, "WARN"},
+        {log::Level::Error, "ERROR"},
+        {log::Level(2), "INFO+2"},
+        {log::Level(10), "ERROR+2"},
+        {log::Level(-6), "DEBUG-2"},
+    };
+    for (auto const &n : names) {
+        if (String got = log::level_name(n.level); got != n.name) {
+            t.errorf("level_name(%d) = %q; want %q", int(n.level), got, n.name);
+        }
+    }
+}
+
+void test_with(T &t) {
+    io::Buffer out;
+    log::WriterSink sink(out);
+    log::Logger base(sink);
+
+    String id = "abc";
+    log::Logger l = base.with("request", id, "attempt", 2);
+    id = "changed";  // with encodes its attributes immediately
+
+    l.info("hello", "k", "v");
+    String got = out.to_string();
+    str want = " level=INFO msg=hello request=abc attempt=2 k=v\n";
+    if (str rest = strip_time(t, got, "time="); rest != want) {
+        t.errorf("got  %q\nwant %q", rest, want);
+    }
+}
+
+void test_durations(T &t) {
+    struct {
+        time::duration d;
+        str            want;
+    } tests[] = {
+        {0, "0s"},
+        {1, "1ns"},
+        {1100, "1.1µs"},
+        {2200 * time::microsecond, "2.2ms"},
+        {3300 * time::millisecond, "3.3s"},
+        {4 * time::minute + 5 * time::second, "4m5s"},
+        {4 * time::minute + 5001 * time::millisecond, "4m5.001s"},
+        {5 * time::hour + 6 * time::minute + 7001 * time::millisecond, "5h6m7.001s"},
+        {-1100, "-1.1µs"},
+    };
+
+    for (auto const &tt : tests) {
+        io::Buffer b;
+        log::attr("d", tt.d).write_value(b);
+        if (String got = b.to_string(); got != tt.want) {
+            t.errorf("duration %d: got %q; want %q", tt.d.nsecs, got, tt.want);
+        }
+    }
+}
+
+void benchmark_log_disabled(B &b) {
+    io::Buffer out;
+    log::WriterSink sink(out);
+    log::Logger l(sink);
+
+    for (int i = 0; i < b.n; i++) {
+        l.debug("request done", "path", "/index.html", "status", 200);
+    }
+}
+
+void benchmark_log_text(B &b) {
+    io::Buffer out;
+    log::WriterSink sink(out);
+    log::Logger l(sink);
+
+    for (int i = 0; i < b.n; i++) {
+        out.reset();
+        l.info("request done", "path", "/index.html", "status", 200, "elapsed", 1500 * time::microsecond);
+    }
+}
+
+void benchmark_log_json(B &b) {
+    io::Buffer out;
+    log::WriterSink sink(out);
+    log::Logger l(sink, log::json_encoder);
+
+    for (int i = 0; i < b.n; i++) {
+        out.reset();
+        l.info("request done", "path", "/index.html", "status", 200, "elapsed", 1500 * time::microsecond);
+    }
+}
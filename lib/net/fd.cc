@@ -0,0 +1,436 @@
+#include "fd.h"
+
+#include <algorithm>
+#include <climits>
+#include <errno.h>
+#include <set>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "net.h"
+#include "lib/os/error.h"
+#include "lib/sync/go.h"
+#include "lib/sync/lock.h"
+#include "lib/sync/mutex.h"
+
+using namespace lib;
+using namespace lib::net;
+using namespace lib::net::internal;
+
+// The netpoller: one thread blocked in epoll_wait for every registered socket.
+// Sockets are registered edge-triggered for both directions once, at creation,
+// so the poller never has to re-arm anything; it just turns edges and expired
+// deadlines into tokens on the waiting side's channel.
+//
+// Events carry the FD's id rather than its address. An event for a socket
+// that was closed after epoll_wait returned finds no entry in fds and is
+// dropped.
+namespace {
+    struct Poller {
+        int epfd = -1;
+        int evfd = -1;
+
+        sync::Mutex mtx;
+        std::unordered_map<uint64, FD*> fds;
+        std::set<std::pair<int64, Waiter*>> timers;
+        uint64 next_id = 1;
+
+        Poller();
+        void run();
+        void wake();
+        void disarm(Waiter &w);
+    } ;
+}
+
+static Poller &poller() {
+    // never destroyed: the poller thread outlives static destructors
+    static Poller *p = new Poller();
+    return *p;
+}
+
+Poller::Poller() {
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd == -1) {
+        panic(os::SyscallError("epoll_create1", errno));
+    }
+
+    evfd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+    if (evfd == -1) {
+        panic(os::SyscallError("eventfd", errno));
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, evfd, &ev) == -1) {
+        panic(os::SyscallError("epoll_ctl", errno));
+    }
+
+    sync::go([this] { run(); }).detach();
+}
+
+void Poller::wake() {
+    uint64 one = 1;
+    ssize_t n = ::write(evfd, &one, sizeof one);
+    (void) n; // EAGAIN means a wakeup is already pending
+}
+
+void Poller::run() {
+    constexpr int MaxEvents = 128;
+    epoll_event events[MaxEvents];
+
+    for (;;) {
+        int timeout = -1;
+        {
+            sync::Lock lock(mtx);
+            if (!timers.empty()) {
+                int64 d = timers.begin()->first - time::now().nsecs;
+                // round up so we never wake just before the deadline
+                timeout = d <= 0 ? 0 : int(std::min<int64>((d + 999'999) / 1'000'000, INT_MAX));
+            }
+        }
+
+        int n = epoll_wait(epfd, events, MaxEvents, timeout);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            panic(os::SyscallError("epoll_wait", errno));
+        }
+
+        sync::Lock lock(mtx);
+        for (int i = 0; i < n; i++) {
+            uint64 id = events[i].data.u64;
+            if (id == 0) {
+                uint64 v;
+                ssize_t r = ::read(evfd, &v, sizeof v);
+                (void) r;
+                continue;
+            }
+
+            auto it = fds.find(id);
+            if (it == fds.end()) {
+                continue;
+            }
+
+            FD *fd = it->second;
+            uint32 ev = events[i].events;
+            if (ev & (EPOLLIN|EPOLLRDHUP|EPOLLHUP|EPOLLERR)) {
+                fd->rd.notify();
+            }
+            if (ev & (EPOLLOUT|EPOLLHUP|EPOLLERR)) {
+                fd->wr.notify();
+            }
+        }
+
+        int64 now = time::now().nsecs;
+        while (!timers.empty() && timers.begin()->first <= now) {
+            Waiter *w = timers.begin()->second;
+            timers.erase(timers.begin());
+            w->when = 0;
+            w->notify();
+        }
+    }
+}
+
+// disarm removes w's pending deadline, if any. Called with mtx held.
+void Poller::disarm(Waiter &w) {
+    if (w.when != 0) {
+        timers.erase({w.when, &w});
+        w.when = 0;
+    }
+}
+
+void Waiter::notify() {
+    // never blocks: if a token is already queued the waiter will see it
+    sync::poll(sync::Send(ready, 1));
+}
+
+void FD::init(error err) {
+    Poller &p = poller();
+    {
+        sync::Lock lock(p.mtx);
+        id = p.next_id++;
+        p.fds[id] = this;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN|EPOLLOUT|EPOLLRDHUP|EPOLLET;
+    ev.data.u64 = id;
+    if (epoll_ctl(p.epfd, EPOLL_CTL_ADD, sysfd, &ev) == -1) {
+        int code = errno;
+        {
+            sync::Lock lock(p.mtx);
+            p.fds.erase(id);
+        }
+        id = 0;
+        return err(os::SyscallError("epoll_ctl", code));
+    }
+}
+
+void FD::deregister() {
+    if (id == 0) {
+        return;
+    }
+
+    Poller &p = poller();
+    {
+        sync::Lock lock(p.mtx);
+        p.fds.erase(id);
+        p.disarm(rd);
+        p.disarm(wr);
+        id = 0;
+    }
+
+    epoll_ctl(p.epfd, EPOLL_CTL_DEL, sysfd, nil);
+}
+
+void FD::set_deadline(Waiter &w, time::time t) {
+    w.deadline.store(t.nsecs);
+
+    Poller &p = poller();
+    {
+        sync::Lock lock(p.mtx);
+        p.disarm(w);
+        if (t.nsecs > 0 && id != 0) {
+            p.timers.insert({t.nsecs, &w});
+            w.when = t.nsecs;
+        }
+    }
+
+    // let the poller recompute its timeout, and fire the timer right away if
+    // the deadline is already in the past
+    p.wake();
+}
+
+bool FD::incref() {
+    uint32 s = state.fetch_add(1);
+    if (s & Closing) {
+        decref();
+        return false;
+    }
+    return true;
+}
+
+void FD::decref() {
+    uint32 s = state.fetch_sub(1) - 1;
+    if (s == Closing) {
+        release();
+    }
+}
+
+void FD::release() {
+    if (released.exchange(true)) {
+        return;
+    }
+
+    // Linux releases the descriptor even when close fails, so never retry
+    ::close(sysfd);
+}
+
+void FD::close(error err) {
+    // hold a reference so the descriptor outlives deregistration
+    if (!incref()) {
+        return err(ErrClosed());
+    }
+
+    uint32 s = state.fetch_or(Closing);
+    if (s & Closing) {
+        decref();
+        return err(ErrClosed());
+    }
+
+    deregister();
+    rd.notify();
+    wr.notify();
+
+    decref();
+}
+
+FD::~FD() {
+    if (!released.load()) {
+        close(error::ignore);
+    }
+}
+
+bool FD::check(Waiter &w, error err) {
+    if (state.load() & Closing) {
+        err(ErrClosed());
+        return false;
+    }
+
+    int64 d = w.deadline.load();
+    if (d > 0 && d <= time::now().nsecs) {
+        err(ErrDeadlineExceeded());
+        return false;
+    }
+
+    return true;
+}
+
+bool FD::wait(Waiter &w, error err) {
+    w.ready.recv();
+    if (!check(w, err)) {
+        // close and deadlines send a single token; pass it on to the next
+        // thread parked on w, which has to return too
+        w.notify();
+        return false;
+    }
+    return true;
+}
+
+io::ReadResult FD::read(buf b, error err) {
+    io::ReadResult r;
+    if (!incref()) {
+        err(ErrClosed());
+        return r;
+    }
+
+    bool ok = check(rd, err);
+    while (ok) {
+        ssize_t n = ::read(sysfd, b.data, b.len);
+        if (n >= 0) {
+            r.nbytes = n;
+            r.eof = n == 0 && len(b) > 0;
+            break;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+
+        if (errno == EAGAIN) {
+            ok = wait(rd, err);
+            continue;
+        }
+
+        err(os::Errno(errno));
+        break;
+    }
+
+    decref();
+    return r;
+}
+
+size FD::write(str data, error err) {
+    size total = 0;
+    if (!incref()) {
+        err(ErrClosed());
+        return total;
+    }
+
+    bool ok = check(wr, err);
+    while (ok && total < len(data)) {
+        ssize_t n = socket ? ::send(sysfd, data.data + total, data.len - total, MSG_NOSIGNAL)
+                           : ::write(sysfd, data.data + total, data.len - total);
+        if (n >= 0) {
+            total += n;
+            continue;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+
+        if (errno == EAGAIN) {
+            ok = wait(wr, err);
+            continue;
+        }
+
+        err(os::Errno(errno));
+        break;
+    }
+
+    decref();
+    return total;
+}
+
+int FD::accept(error err) {
+    if (!incref()) {
+        err(ErrClosed());
+        return -1;
+    }
+
+    int nfd = -1;
+    bool ok = check(rd, err);
+    while (ok) {
+        nfd = ::accept4(sysfd, nil, nil, SOCK_NONBLOCK|SOCK_CLOEXEC);
+        if (nfd != -1) {
+            break;
+        }
+
+        // the peer gave up before we got to it; wait for the next one
+        if (errno == EINTR || errno == ECONNABORTED) {
+            continue;
+        }
+
+        if (errno == EAGAIN) {
+            ok = wait(rd, err);
+            continue;
+        }
+
+        err(os::SyscallError("accept4", errno));
+        break;
+    }
+
+    decref();
+    return nfd;
+}
+
+void FD::connect(const sockaddr *sa, uint32 salen, error err) {
+    if (!incref()) {
+        return err(ErrClosed());
+    }
+
+    int r = ::connect(sysfd, sa, salen);
+    if (r == 0) {
+        decref();
+        return;
+    }
+
+    if (errno != EINPROGRESS && errno != EINTR) {
+        err(os::Errno(errno));
+        decref();
+        return;
+    }
+
+    // The socket may report writable before the connection is established,
+    // so confirm with SO_ERROR and getpeername after each wakeup.
+    for (;;) {
+        if (!check(wr, err) || !wait(wr, err)) {
+            break;
+        }
+
+        int code = 0;
+        socklen_t n = sizeof code;
+        if (getsockopt(sysfd, SOL_SOCKET, SO_ERROR, &code, &n) == -1) {
+            err(os::SyscallError("getsockopt", errno));
+            break;
+        }
+
+        if (code == EINPROGRESS || code == EALREADY || code == EINTR) {
+            continue;
+        }
+
+        if (code != 0) {
+            err(os::Errno(code));
+            break;
+        }
+
+        sockaddr_storage peer;
+        socklen_t peerlen = sizeof peer;
+        if (getpeername(sysfd, (sockaddr*) &peer, &peerlen) == 0) {
+            break;
+        }
+
+        if (errno != ENOTCONN) {
+            err(os::Errno(errno));
+            break;
+        }
+    }
+
+    decref();
+}
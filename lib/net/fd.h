@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+
+#include "lib/base.h"
+#include "lib/io/io.h"
+#include "lib/sync/chan.h"
+#include "lib/time/time.h"
+
+struct sockaddr;
+
+namespace lib::net::internal {
+
+    // Waiter is one direction (read or write) of a pollable fd. A goroutine
+    // whose syscall returned EAGAIN parks in ready.recv(); the netpoller sends
+    // a token when epoll reports readiness, when the deadline passes or when
+    // the fd is closed. The channel holds at most one token, so wakeups that
+    // race with a syscall are never lost, only coalesced.
+    struct Waiter {
+        sync::Chan<int>     ready {1};
+
+        // deadline in time::now() nanoseconds; 0 means no deadline
+        std::atomic<int64>  deadline = 0;
+
+        // deadline currently armed in the poller; guarded by the poller mutex
+        int64               when = 0;
+
+        void notify();
+    } ;
+
+    // FD is a non-blocking descriptor registered with the netpoller, usually a
+    // socket. I/O methods retry on EAGAIN after parking on the matching Waiter.
+    //
+    // Close is safe to call while other threads are blocked in read, write or
+    // accept: they return ErrClosed, and the descriptor is released when the
+    // last of them has returned.
+    struct FD {
+        int    sysfd = -1;
+        uint64 id    = 0;
+
+        // socket is false for other pollable descriptors, such as terminals,
+        // which write with write(2) instead of send(2).
+        bool   socket = true;
+
+        Waiter rd;
+        Waiter wr;
+
+        explicit FD(int sysfd) : sysfd(sysfd) {}
+        FD(FD const&) = delete;
+        FD& operator=(FD const&) = delete;
+        ~FD();
+
+        // init registers the fd with the netpoller.
+        void init(error err);
+
+        io::ReadResult read(buf b, error err);
+        size write(str data, error err);
+
+        // accept returns a new non-blocking, close-on-exec descriptor.
+        int accept(error err);
+
+        // connect starts a non-blocking connect and waits for it to finish.
+        void connect(const sockaddr *sa, uint32 salen, error err);
+
+        void set_deadline(Waiter &w, time::time t);
+
+        void close(error err);
+
+      private:
+        static constexpr uint32 Closing = 1u << 31;
+
+        // low bits count in-flight operations, Closing is set by close()
+        std::atomic<uint32> state = 0;
+        std::atomic<bool>   released = false;
+
+        bool incref();
+        void decref();
+        void release();
+        void deregister();
+
+        // check reports whether an operation on w may proceed.
+        bool check(Waiter &w, error err);
+        // wait parks until w is notified, then repeats check. When check
+        // fails it notifies w again for the next waiter.
+        bool wait(Waiter &w, error err);
+    } ;
+}
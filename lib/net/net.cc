@@ -0,0 +1,540 @@
+#include "net.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+#include "lib/fmt/fmt.h"
+#include "lib/os/error.h"
+#include "lib/str.h"
+#include "lib/strings/strings.h"
+
+using namespace lib;
+using namespace lib::net;
+
+namespace {
+    struct DNSError : ErrorBase<DNSError> {
+        str name;
+        int code;
+
+        DNSError(str name, int code) : name(name), code(code) {}
+        void fmt(io::Writer &out, error err) const override {
+            fmt::fprintf(out, err, "lookup %s: %s", this->name, gai_strerror(this->code));
+        }
+    } ;
+
+    struct AddrError : ErrorBase<AddrError> {
+        str msg;
+        str addr;
+
+        AddrError(str msg, str addr) : msg(msg), addr(addr) {}
+        void fmt(io::Writer &out, error err) const override {
+            fmt::fprintf(out, err, "address %s: %s", this->addr, this->msg);
+        }
+    } ;
+}
+
+void OpError::fmt(io::Writer &out, error err) const {
+    if (len(this->addr) > 0) {
+        fmt::fprintf(out, err, "%s %s %s: %s", this->op, this->net, this->addr, this->err);
+    } else {
+        fmt::fprintf(out, err, "%s %s: %s", this->op, this->net, this->err);
+    }
+}
+
+view<Error*> OpError::unwrap() const {
+    return view<Error*>(&this->err, 1);
+}
+
+int Addr::port() const {
+    switch (sa.ss_family) {
+        case AF_INET:  return ntohs(((const sockaddr_in*) &sa)->sin_port);
+        case AF_INET6: return ntohs(((const sockaddr_in6*) &sa)->sin6_port);
+    }
+    return 0;
+}
+
+void Addr::fmt(io::Writer &out, error err) const {
+    char ip[INET6_ADDRSTRLEN];
+
+    switch (sa.ss_family) {
+    case AF_INET:
+        inet_ntop(AF_INET, &((const sockaddr_in*) &sa)->sin_addr, ip, sizeof ip);
+        fmt::fprintf(out, err, "%s:%d", str(ip, strlen(ip)), port());
+        return;
+
+    case AF_INET6:
+        inet_ntop(AF_INET6, &((const sockaddr_in6*) &sa)->sin6_addr, ip, sizeof ip);
+        fmt::fprintf(out, err, "[%s]:%d", str(ip, strlen(ip)), port());
+        return;
+
+    case AF_UNIX: {
+        const sockaddr_un *un = (const sockaddr_un*) &sa;
+        size n = size(len) - size(offsetof(sockaddr_un, sun_path));
+        if (n <= 0) {
+            return;
+        }
+        if (un->sun_path[0] == '\0') {
+            // abstract socket
+            out.write_byte('@', err);
+            out.write(str(un->sun_path + 1, n - 1), err);
+            return;
+        }
+        out.write(str(un->sun_path, strnlen(un->sun_path, n)), err);
+        return;
+    }
+    }
+}
+
+void net::split_host_port(str hostport, str *host, str *port, error err) {
+    size i = strings::last_index_byte(hostport, ':');
+    if (i == -1) {
+        return err(AddrError("missing port in address", hostport));
+    }
+
+    if (len(hostport) > 0 && hostport[0] == '[') {
+        size end = strings::index_byte(hostport, ']');
+        if (end == -1) {
+            return err(AddrError("missing ']' in address", hostport));
+        }
+        if (end + 1 != i) {
+            return err(AddrError("unexpected character after ']'", hostport));
+        }
+        *host = hostport[1, end];
+    } else {
+        *host = hostport[0, i];
+        if (strings::index_byte(*host, ':') != -1) {
+            return err(AddrError("too many colons in address", hostport));
+        }
+    }
+
+    *port = hostport(i+1);
+}
+
+// parse_network maps the network name to a socket family. The returned name is
+// a literal, so it outlives the caller's argument.
+static bool parse_network(str network, str *name, int *family) {
+    if (network == "tcp") {
+        *name = "tcp";
+        *family = AF_UNSPEC;
+    } else if (network == "tcp4") {
+        *name = "tcp4";
+        *family = AF_INET;
+    } else if (network == "tcp6") {
+        *name = "tcp6";
+        *family = AF_INET6;
+    } else if (network == "unix") {
+        *name = "unix";
+        *family = AF_UNIX;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static std::vector<Addr> resolve(str net, int family, str address, bool passive, error err) {
+    std::vector<Addr> addrs;
+
+    if (family == AF_UNIX) {
+        Addr a;
+        a.network = net;
+        sockaddr_un *un = (sockaddr_un*) &a.sa;
+        un->sun_family = AF_UNIX;
+
+        if (len(address) == 0 || len(address) >= size(sizeof un->sun_path)) {
+            err(AddrError("invalid unix socket path", address));
+            return addrs;
+        }
+
+        memcpy(un->sun_path, address.data, address.len);
+        a.len = uint32(offsetof(sockaddr_un, sun_path) + address.len);
+        if (address[0] == '@') {
+            // Linux abstract namespace: no terminator, leading NUL
+            un->sun_path[0] = '\0';
+        } else {
+            a.len++;
+        }
+
+        addrs.push_back(a);
+        return addrs;
+    }
+
+    str host, port;
+    split_host_port(address, &host, &port, err);
+    if (err) {
+        return addrs;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = family;
+    hints.ai_socktype = SOCK_STREAM;
+    if (passive) {
+        hints.ai_flags = AI_PASSIVE;
+        if (len(host) == 0 && family == AF_UNSPEC) {
+            hints.ai_family = AF_INET;
+        }
+    }
+
+    CString chost = host;
+    CString cport = port;
+    addrinfo *res = nil;
+    int r = getaddrinfo(len(host) > 0 ? (const char*) chost : nil, cport, &hints, &res);
+    if (r != 0) {
+        if (r == EAI_SYSTEM) {
+            err(os::SyscallError("getaddrinfo", errno));
+        } else {
+            err(DNSError(len(host) > 0 ? host : address, r));
+        }
+        return addrs;
+    }
+
+    for (addrinfo *ai = res; ai; ai = ai->ai_next) {
+        Addr a;
+        a.network = net;
+        memcpy(&a.sa, ai->ai_addr, ai->ai_addrlen);
+        a.len = uint32(ai->ai_addrlen);
+        addrs.push_back(a);
+    }
+    freeaddrinfo(res);
+
+    return addrs;
+}
+
+static Addr sockname(int fd, str net, bool peer) {
+    Addr a;
+    a.network = net;
+    socklen_t n = sizeof a.sa;
+    int r = peer ? getpeername(fd, (sockaddr*) &a.sa, &n) : getsockname(fd, (sockaddr*) &a.sa, &n);
+    if (r == 0) {
+        a.len = uint32(n);
+    }
+    return a;
+}
+
+static int new_socket(int family, error err) {
+    int fd = ::socket(family, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        err(os::SyscallError("socket", errno));
+    }
+    return fd;
+}
+
+// setup_conn finishes a connected socket: TCP connections disable Nagle, as
+// writes are already coalesced by the write buffer.
+static void setup_conn(int fd, int family) {
+    if (family == AF_INET || family == AF_INET6) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    }
+}
+
+//
+// Conn
+//
+
+Conn& Conn::operator=(Conn &&other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (this->fd) {
+        this->close(error::ignore);
+    }
+
+    io::Buffered::operator=(std::move(other));
+    this->fd = std::move(other.fd);
+    this->laddr = other.laddr;
+    this->raddr = other.raddr;
+    this->closed = other.closed;
+    return *this;
+}
+
+Conn::~Conn() {
+    if (this->fd && !this->closed) {
+        this->close(error::ignore);
+    }
+}
+
+void Conn::wrap_err(str op, Error const &e, error err) {
+    String addr = fmt::stringify(this->raddr);
+    err(OpError(op, this->raddr.network, addr, e));
+}
+
+io::ReadResult Conn::direct_read(buf b, error err) {
+    if (!this->fd) {
+        err(OpError("read", "", "", ErrClosed()));
+        return {};
+    }
+
+    return this->fd->read(b, [&](Error &e) {
+        wrap_err("read", e, err);
+    });
+}
+
+size Conn::direct_write(str data, error err) {
+    if (!this->fd) {
+        err(OpError("write", "", "", ErrClosed()));
+        return 0;
+    }
+
+    return this->fd->write(data, [&](Error &e) {
+        wrap_err("write", e, err);
+    });
+}
+
+void Conn::close(error err) {
+    if (!this->fd || this->closed) {
+        return err(OpError("close", this->raddr.network, "", ErrClosed()));
+    }
+
+    // flush errors are reported but do not keep the socket open
+    flush(err);
+
+    // The FD itself stays allocated until the destructor, as threads blocked
+    // in read or write may still be returning from it.
+    this->closed = true;
+    this->fd->close([&](Error &e) {
+        wrap_err("close", e, err);
+    });
+}
+
+void Conn::close_write(error err) {
+    if (!this->fd || this->closed) {
+        return err(OpError("close", this->raddr.network, "", ErrClosed()));
+    }
+
+    flush(err);
+    if (err) {
+        return;
+    }
+
+    if (::shutdown(this->fd->sysfd, SHUT_WR) == -1) {
+        wrap_err("close", os::SyscallError("shutdown", errno), err);
+    }
+}
+
+Addr Conn::local_addr() const {
+    return this->laddr;
+}
+
+Addr Conn::remote_addr() const {
+    return this->raddr;
+}
+
+void Conn::set_deadline(time::time t) {
+    set_read_deadline(t);
+    set_write_deadline(t);
+}
+
+void Conn::set_read_deadline(time::time t) {
+    if (this->fd) {
+        this->fd->set_deadline(this->fd->rd, t);
+    }
+}
+
+void Conn::set_write_deadline(time::time t) {
+    if (this->fd) {
+        this->fd->set_deadline(this->fd->wr, t);
+    }
+}
+
+//
+// Listener
+//
+
+Listener& Listener::operator=(Listener &&other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (this->fd) {
+        this->close(error::ignore);
+    }
+
+    this->fd = std::move(other.fd);
+    this->laddr = other.laddr;
+    this->unlink = other.unlink;
+    this->closed = other.closed;
+    return *this;
+}
+
+Listener::~Listener() {
+    if (this->fd && !this->closed) {
+        this->close(error::ignore);
+    }
+}
+
+Conn Listener::accept(error err) {
+    Conn c;
+
+    auto wrap = [&](Error &e) {
+        String addr = fmt::stringify(this->laddr);
+        err(OpError("accept", this->laddr.network, addr, e));
+    };
+
+    if (!this->fd) {
+        err(OpError("accept", "", "", ErrClosed()));
+        return c;
+    }
+
+    int nfd = this->fd->accept(wrap);
+    if (nfd == -1) {
+        return c;
+    }
+
+    auto conn_fd = std::make_unique<internal::FD>(nfd);
+    conn_fd->init(wrap);
+    if (err) {
+        return c;
+    }
+
+    setup_conn(nfd, this->laddr.sa.ss_family);
+    c.laddr = sockname(nfd, this->laddr.network, false);
+    c.raddr = sockname(nfd, this->laddr.network, true);
+    c.fd = std::move(conn_fd);
+    c.resize_readbuf(4096);
+    c.resize_writebuf(4096);
+    return c;
+}
+
+void Listener::close(error err) {
+    if (!this->fd || this->closed) {
+        return err(OpError("close", this->laddr.network, "", ErrClosed()));
+    }
+
+    this->closed = true;
+    this->fd->close([&](Error &e) {
+        String addr = fmt::stringify(this->laddr);
+        err(OpError("close", this->laddr.network, addr, e));
+    });
+
+    if (this->unlink) {
+        const sockaddr_un *un = (const sockaddr_un*) &this->laddr.sa;
+        ::unlink(un->sun_path);
+    }
+}
+
+void Listener::set_deadline(time::time t) {
+    if (this->fd) {
+        this->fd->set_deadline(this->fd->rd, t);
+    }
+}
+
+Listener net::listen(str network, str address, error err) {
+    Listener l;
+
+    str net;
+    int family;
+    if (!parse_network(network, &net, &family)) {
+        err(OpError("listen", network, address, ErrUnknownNetwork()));
+        return l;
+    }
+
+    auto wrap = [&](Error &e) {
+        err(OpError("listen", net, address, e));
+    };
+
+    std::vector<Addr> addrs = resolve(net, family, address, true, wrap);
+    if (err) {
+        return l;
+    }
+
+    Addr const &a = addrs[0];
+    int sysfd = new_socket(a.sa.ss_family, wrap);
+    if (sysfd == -1) {
+        return l;
+    }
+
+    auto fd = std::make_unique<internal::FD>(sysfd);
+
+    if (a.sa.ss_family != AF_UNIX) {
+        // allow restarting a server while old connections are in TIME_WAIT
+        int one = 1;
+        setsockopt(sysfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+    }
+
+    if (::bind(sysfd, (const sockaddr*) &a.sa, a.len) == -1) {
+        err(OpError("listen", net, address, os::SyscallError("bind", errno)));
+        return l;
+    }
+
+    if (::listen(sysfd, SOMAXCONN) == -1) {
+        err(OpError("listen", net, address, os::SyscallError("listen", errno)));
+        return l;
+    }
+
+    fd->init(wrap);
+    if (err) {
+        return l;
+    }
+
+    l.laddr = sockname(sysfd, net, false);
+    l.unlink = family == AF_UNIX && address[0] != '@';
+    l.fd = std::move(fd);
+    return l;
+}
+
+static Conn dial_addr(str net, str address, Addr const &a, error err) {
+    Conn c;
+
+    auto wrap = [&](Error &e) {
+        err(OpError("dial", net, address, e));
+    };
+
+    int sysfd = new_socket(a.sa.ss_family, wrap);
+    if (sysfd == -1) {
+        return c;
+    }
+
+    auto fd = std::make_unique<internal::FD>(sysfd);
+    fd->init(wrap);
+    if (err) {
+        return c;
+    }
+
+    fd->connect((const sockaddr*) &a.sa, a.len, wrap);
+    if (err) {
+        return c;
+    }
+
+    setup_conn(sysfd, a.sa.ss_family);
+    c.laddr = sockname(sysfd, net, false);
+    c.raddr = a;
+    c.fd = std::move(fd);
+    c.resize_readbuf(4096);
+    c.resize_writebuf(4096);
+    return c;
+}
+
+Conn net::dial(str network, str address, error err) {
+    str net;
+    int family;
+    if (!parse_network(network, &net, &family)) {
+        err(OpError("dial", network, address, ErrUnknownNetwork()));
+        return {};
+    }
+
+    std::vector<Addr> addrs = resolve(net, family, address, false, [&](Error &e) {
+        err(OpError("dial", net, address, e));
+    });
+    if (err) {
+        return {};
+    }
+
+    // try each resolved address, reporting only the last failure
+    for (size i = 0; i < size(addrs.size()) - 1; i++) {
+        ErrorRecorder rec;
+        Conn c = dial_addr(net, address, addrs[i], rec);
+        if (!rec) {
+            return c;
+        }
+    }
+
+    return dial_addr(net, address, addrs.back(), err);
+}
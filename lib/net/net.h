@@ -0,0 +1,139 @@
+#pragma once
+
+#include <memory>
+#include <sys/socket.h>
+
+#include "lib/base.h"
+#include "lib/io/io.h"
+#include "lib/time/time.h"
+
+#include "fd.h"
+
+namespace lib::net {
+
+    // ErrClosed is returned by I/O on a connection or listener that has been
+    // closed, including operations that were blocked when close was called.
+    struct ErrClosed : ErrorBase<ErrClosed, "use of closed network connection"> {};
+
+    // ErrDeadlineExceeded is returned when a read or write deadline passes
+    // before the operation could complete.
+    struct ErrDeadlineExceeded : ErrorBase<ErrDeadlineExceeded, "i/o timeout"> {};
+
+    struct ErrUnknownNetwork : ErrorBase<ErrUnknownNetwork, "unknown network"> {};
+
+    // OpError is the error type usually returned by functions in the net
+    // package. It describes the operation, network type, and address of an
+    // error.
+    struct OpError : ErrorBase<OpError> {
+        str op;
+        str net;
+        str addr;
+        Error *err = nil;
+
+        OpError(str op, str net, str addr, Error const &err) : op(op), net(net), addr(addr), err((Error*) &err) {}
+
+        virtual void fmt(io::Writer &out, error err) const override;
+        virtual view<Error*> unwrap() const override;
+    } ;
+
+    // Addr is a socket address: an IP address and port for "tcp", a path for
+    // "unix".
+    struct Addr {
+        str              network;
+        sockaddr_storage sa {};
+        uint32           len = 0;
+
+        // port returns the port number of a tcp address, 0 otherwise.
+        int port() const;
+
+        void fmt(io::Writer &out, error err) const;
+    } ;
+
+    // Conn is a stream-oriented network connection. Reads and writes are
+    // buffered; call flush to push buffered writes to the peer.
+    //
+    // A read or write that would block parks the calling thread until the
+    // netpoller reports the socket ready, so any number of connections can
+    // share one poller thread.
+    struct Conn : io::Buffered {
+        std::unique_ptr<internal::FD> fd;
+        Addr laddr;
+        Addr raddr;
+
+        Conn() = default;
+        Conn(Conn&&) = default;
+        Conn& operator=(Conn &&other);
+        ~Conn();
+
+        io::ReadResult direct_read(buf b, error err) override;
+        size direct_write(str data, error err) override;
+
+        // close flushes buffered writes and closes the connection. Blocked
+        // reads and writes return ErrClosed.
+        void close(error err) override;
+
+        // close_write shuts down the writing side of the connection after
+        // flushing, so the peer reads EOF.
+        void close_write(error err);
+
+        Addr local_addr() const;
+        Addr remote_addr() const;
+
+        // set_deadline sets the read and write deadlines. A zero time means
+        // I/O operations will not time out. Deadlines are absolute times, not
+        // durations, and apply to pending operations as well as future ones.
+        void set_deadline(time::time t);
+        void set_read_deadline(time::time t);
+        void set_write_deadline(time::time t);
+
+      private:
+        bool closed = false;
+
+        void wrap_err(str op, Error const &e, error err);
+    } ;
+
+    // Listener is a stream-oriented listening socket.
+    struct Listener {
+        std::unique_ptr<internal::FD> fd;
+        Addr laddr;
+
+        Listener() = default;
+        Listener(Listener&&) = default;
+        Listener& operator=(Listener &&other);
+        ~Listener();
+
+        // accept waits for and returns the next connection to the listener.
+        Conn accept(error err);
+
+        // close stops listening. A blocked accept returns ErrClosed.
+        void close(error err);
+
+        Addr addr() const { return laddr; }
+
+        // set_deadline sets the deadline for accept.
+        void set_deadline(time::time t);
+
+      private:
+        bool closed = false;
+        bool unlink = false;
+
+        friend Listener listen(str, str, error);
+    } ;
+
+    // listen announces on the local network address. network must be "tcp",
+    // "tcp4", "tcp6" or "unix".
+    //
+    // For TCP, address has the form "host:port"; an empty host listens on all
+    // IPv4 addresses (IPv6 for "tcp6") and port 0 picks a free port, see
+    // Listener::addr.
+    // For unix, address is the socket path; it is removed on close.
+    Listener listen(str network, str address, error err);
+
+    // dial connects to the address on the named network. Address forms are as
+    // for listen; a hostname is resolved and each address is tried in turn.
+    Conn dial(str network, str address, error err);
+
+    // split_host_port splits "host:port", "[host]:port" or "[ipv6]:port" into
+    // host and port.
+    void split_host_port(str hostport, str *host, str *port, error err);
+}
@@ -0,0 +1,325 @@
+#include "net.h"
+
+#include <unistd.h>
+
+#include "lib/fmt/fmt.h"
+#include "lib/sync/chan.h"
+#include "lib/sync/go.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+// echo_server accepts n connections and echoes each one until EOF.
+static void echo_server(T &t, net::Listener &l, int n) {
+    std::deque<sync::go> handlers;
+    for (int i = 0; i < n; i++) {
+        net::Conn c = l.accept([&](Error &e) {
+            t.errorf("accept: %v", e);
+        });
+        if (!c.fd) {
+            return;
+        }
+
+        handlers.emplace_back([&t, c = std::move(c)] mutable {
+            ErrorRecorder err;
+            byte b[1024];
+            for (;;) {
+                io::ReadResult r = c.read(b, err);
+                c.write(str(b, r.nbytes), err);
+                c.flush(err);
+                if (err || r.eof) {
+                    break;
+                }
+            }
+            if (err) {
+                t.errorf("echo: %v", err);
+            }
+            c.close(error::ignore);
+        });
+    }
+}
+
+static void check_echo(T &t, str network, str addr, str msg) {
+    ErrorRecorder err;
+    net::Conn c = net::dial(network, addr, err);
+    if (err) {
+        return t.errorf("dial %s %s: %v", network, addr, err);
+    }
+
+    // write from a second thread so large messages can't deadlock against
+    // the echo filling our receive buffer
+    sync::go writer = [&] {
+        ErrorRecorder werr;
+        c.write(msg, werr);
+        c.close_write(werr);
+        if (werr) {
+            t.errorf("write: %v", werr);
+        }
+    };
+
+    // the server closes after echoing everything it read before our EOF
+    String got;
+    for (;;) {
+        byte b[4096];
+        io::ReadResult r = c.read(b, err);
+        got += str(b, r.nbytes);
+        if (err || r.eof) {
+            break;
+        }
+    }
+    if (err) {
+        t.errorf("read: %v", err);
+    }
+    writer.join();
+    if (got != msg) {
+        t.errorf("echo of %d bytes returned %d bytes", len(msg), len(got));
+    }
+
+    c.close(err);
+}
+
+void test_tcp_echo(T &t) {
+    ErrorRecorder err;
+    net::Listener l = net::listen("tcp", "127.0.0.1:0", err);
+    if (err) {
+        t.fatalf("listen: %v", err);
+    }
+    if (l.addr().port() == 0) {
+        t.errorf("listener did not get a port: %v", l.addr());
+    }
+
+    String addr = fmt::stringify(l.addr());
+
+    // all connections share the one poller thread
+    constexpr int N = 32;
+    sync::go server = [&] { echo_server(t, l, N); };
+
+    std::deque<sync::go> clients;
+    for (int i = 0; i < N; i++) {
+        clients.emplace_back([&, i] {
+            String msg = fmt::sprintf("hello from client %d\n", i);
+            check_echo(t, "tcp", addr, msg);
+        });
+    }
+    for (sync::go &g : clients) {
+        g.join();
+    }
+    server.join();
+
+    l.close(err);
+    if (err) {
+        t.errorf("close: %v", err);
+    }
+}
+
+void test_unix_echo(T &t) {
+    String path = fmt::sprintf("/tmp/baselib-net-test-%d.sock", getpid());
+
+    ErrorRecorder err;
+    net::Listener l = net::listen("unix", path, err);
+    if (err) {
+        t.fatalf("listen: %v", err);
+    }
+
+    String big;
+    for (int i = 0; i < 1<<20; i++) {
+        big += char('a' + i % 26);
+    }
+
+    sync::go server = [&] { echo_server(t, l, 1); };
+    check_echo(t, "unix", path, big);
+    server.join();
+
+    l.close(err);
+    if (err) {
+        t.errorf("close: %v", err);
+    }
+    if (access(CString(path), F_OK) == 0) {
+        t.errorf("socket %s still exists after close", path);
+    }
+}
+
+void test_read_deadline(T &t) {
+    ErrorRecorder err;
+    net::Listener l = net::listen("tcp", "127.0.0.1:0", err);
+    if (err) {
+        t.fatalf("listen: %v", err);
+    }
+    String addr = fmt::stringify(l.addr());
+
+    net::Conn c = net::dial("tcp", addr, err);
+    if (err) {
+        t.fatalf("dial: %v", err);
+    }
+    // the peer never writes
+    net::Conn peer = l.accept(err);
+
+    time::monotime start = time::clock();
+    c.set_read_deadline(time::time{time::now().nsecs + (50*time::millisecond).nsecs});
+
+    bool timed_out = false;
+    byte b[16];
+    c.read(b, [&](Error &e) {
+        timed_out = e.is<net::ErrDeadlineExceeded>();
+        if (!timed_out) {
+            t.errorf("read: %v; want i/o timeout", e);
+        }
+    });
+    if (!timed_out) {
+        t.errorf("read returned without timing out");
+    }
+
+    time::duration elapsed = time::clock().sub(start);
+    if (elapsed < 50*time::millisecond) {
+        t.errorf("read timed out after %v; want at least 50ms", elapsed.seconds());
+    }
+
+    // clearing the deadline makes the connection usable again
+    c.set_read_deadline({});
+    peer.write("x", err);
+    peer.flush(err);
+    io::ReadResult r = c.read(b, err);
+    if (err || r.nbytes != 1) {
+        t.errorf("read after clearing deadline: n=%d %v", r.nbytes, err);
+    }
+}
+
+void test_close_unblocks(T &t) {
+    ErrorRecorder err;
+    net::Listener l = net::listen("tcp", "127.0.0.1:0", err);
+    if (err) {
+        t.fatalf("listen: %v", err);
+    }
+    String addr = fmt::stringify(l.addr());
+
+    net::Conn c = net::dial("tcp", addr, err);
+    net::Conn peer = l.accept(err);
+    if (err) {
+        t.fatalf("setup: %v", err);
+    }
+
+    sync::Chan<bool> done(2);
+    sync::go reader = [&] {
+        byte b[16];
+        bool closed = false;
+        c.read(b, [&](Error &e) {
+            closed = e.is<net::ErrClosed>();
+        });
+        done.send(closed);
+    };
+    sync::go acceptor = [&] {
+        bool closed = false;
+        l.accept([&](Error &e) {
+            closed = e.is<net::ErrClosed>();
+        });
+        done.send(closed);
+    };
+
+    time::sleep(20*time::millisecond);
+    c.close(err);
+    l.close(err);
+    if (err) {
+        t.errorf("close: %v", err);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (!done.recv()) {
+            t.errorf("blocked operation did not return ErrClosed");
+        }
+    }
+    reader.join();
+    acceptor.join();
+
+    c.close([&](Error &e) {
+        if (!e.is<net::ErrClosed>()) {
+            t.errorf("second close: %v", e);
+        }
+    });
+}
+
+// close wakes every thread parked on the listener, not just the first
+void test_close_unblocks_all(T &t) {
+    ErrorRecorder err;
+    net::Listener l = net::listen("tcp", "127.0.0.1:0", err);
+    if (err) {
+        t.fatalf("listen: %v", err);
+    }
+
+    sync::Chan<bool> done(2);
+    std::deque<sync::go> acceptors;
+    for (int i = 0; i < 2; i++) {
+        acceptors.emplace_back([&] {
+            bool closed = false;
+            l.accept([&](Error &e) {
+                closed = e.is<net::ErrClosed>();
+            });
+            done.send(closed);
+        });
+    }
+
+    time::sleep(20*time::millisecond);
+    l.close(err);
+    if (err) {
+        t.errorf("close: %v", err);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (!done.recv()) {
+            t.errorf("blocked accept did not return ErrClosed");
+        }
+    }
+    for (sync::go &g : acceptors) {
+        g.join();
+    }
+}
+
+void test_dial_refused(T &t) {
+    ErrorRecorder err;
+    net::Listener l = net::listen("tcp", "127.0.0.1:0", err);
+    String addr = fmt::stringify(l.addr());
+    l.close(err);
+
+    net::dial("tcp", addr, err);
+    if (!err) {
+        t.errorf("dial to closed port succeeded");
+    }
+
+    ErrorRecorder err2;
+    net::dial("udp", addr, err2);
+    if (!err2.is<net::OpError>()) {
+        t.errorf("dial udp: got %v; want unknown network", err2);
+    }
+}
+
+void test_split_host_port(T &t) {
+    struct {
+        str in;
+        str host;
+        str port;
+        bool ok;
+    } tests[] = {
+        {"localhost:80", "localhost", "80", true},
+        {"127.0.0.1:0", "127.0.0.1", "0", true},
+        {":8080", "", "8080", true},
+        {"[::1]:443", "::1", "443", true},
+        {"[fe80::1%lo]:80", "fe80::1%lo", "80", true},
+        {"localhost", "", "", false},
+        {"::1:80", "", "", false},
+        {"[::1:80", "", "", false},
+        {"[::1]x:80", "", "", false},
+    };
+
+    for (auto &test : tests) {
+        str host, port;
+        ErrorRecorder err;
+        net::split_host_port(test.in, &host, &port, err);
+        if (bool(err) == test.ok) {
+            t.errorf("split_host_port(%q): err = %v", test.in, err);
+            continue;
+        }
+        if (test.ok && (host != test.host || port != test.port)) {
+            t.errorf("split_host_port(%q) = %q, %q; want %q, %q", test.in, host, port, test.host, test.port);
+        }
+    }
+}
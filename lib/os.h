@@ -3,3 +3,5 @@
 #include "os/pipe.h"
 #include "os/error.h"
 #include "os/stat.h"
+#include "os/dir.h"
+#include "os/mmap.h"
@@ -0,0 +1,310 @@
+#include "dir.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "file.h"
+#include "lib/filepath/path.h"
+#include "lib/io/pool.h"
+
+using namespace lib;
+using namespace os;
+
+using fs::FileMode;
+
+static FileMode type_from_dtype(byte t) {
+    switch (t) {
+        case DT_REG:  return FileMode();
+        case DT_DIR:  return fs::ModeDir;
+        case DT_LNK:  return fs::ModeSymlink;
+        case DT_FIFO: return fs::ModeNamedPipe;
+        case DT_SOCK: return fs::ModeSocket;
+        case DT_BLK:  return fs::ModeDevice;
+        case DT_CHR:  return fs::ModeDevice | fs::ModeCharDevice;
+    }
+    return fs::ModeIrregular;
+}
+
+static FileMode type_from_mode(mode_t m) {
+    switch (m & S_IFMT) {
+        case S_IFREG:  return FileMode();
+        case S_IFDIR:  return fs::ModeDir;
+        case S_IFLNK:  return fs::ModeSymlink;
+        case S_IFIFO:  return fs::ModeNamedPipe;
+        case S_IFSOCK: return fs::ModeSocket;
+        case S_IFBLK:  return fs::ModeDevice;
+        case S_IFCHR:  return fs::ModeDevice | fs::ModeCharDevice;
+    }
+    return fs::ModeIrregular;
+}
+
+Dir::Dir(Dir &&other) : fd(other.fd), name(std::move(other.name)), buf(other.buf), pos(other.pos), end(other.end), eof(other.eof) {
+    other.fd = -1;
+    other.buf = nil;
+}
+
+Dir& Dir::operator=(Dir &&other) {
+    if (this == &other) {
+        return *this;
+    }
+
+    if (this->fd != -1) {
+        this->close(error::ignore);
+    }
+    release_buf();
+
+    this->fd = other.fd;
+    this->name = std::move(other.name);
+    this->buf = other.buf;
+    this->pos = other.pos;
+    this->end = other.end;
+    this->eof = other.eof;
+    other.fd = -1;
+    other.buf = nil;
+    return *this;
+}
+
+Dir::~Dir() {
+    release_buf();
+    if (this->fd != -1) {
+        this->close(error::ignore);
+    }
+}
+
+void Dir::release_buf() {
+    io::pool::put(this->buf, BufSize);
+    this->buf = nil;
+}
+
+bool Dir::next(str *name, FileMode *type, error err) {
+    for (;;) {
+        if (this->pos >= this->end) {
+            if (this->eof) {
+                return false;
+            }
+            if (!this->buf) {
+                this->buf = io::pool::get(BufSize);
+            }
+
+        retry:
+            ssize_t n = getdents64(this->fd, this->buf, BufSize);
+            if (n == -1) {
+                if (errno == EINTR) {
+                    goto retry;
+                }
+                err(PathError("readdirent", this->name, Errno(errno)));
+                release_buf();
+                return false;
+            }
+
+            if (n == 0) {
+                // the buffer goes back to the pool as soon as we are done, so
+                // a walk can keep many directories open without holding one
+                // buffer each
+                this->eof = true;
+                release_buf();
+                return false;
+            }
+
+            this->pos = 0;
+            this->end = int32(n);
+        }
+
+        dirent64 *d = (dirent64*) (this->buf + this->pos);
+        this->pos += d->d_reclen;
+
+        if (d->d_ino == 0) {
+            continue;
+        }
+
+        str n(d->d_name, strlen(d->d_name));
+        if (n == "." || n == "..") {
+            continue;
+        }
+
+        if (d->d_type == DT_UNKNOWN) {
+            struct stat st;
+            if (fstatat(this->fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1) {
+                // removed since the directory was read
+                if (errno == ENOENT) {
+                    continue;
+                }
+                err(PathError("lstat", n, Errno(errno)));
+                return false;
+            }
+            *type = type_from_mode(st.st_mode);
+        } else {
+            *type = type_from_dtype(d->d_type);
+        }
+
+        *name = n;
+        return true;
+    }
+}
+
+void Dir::close(error err) {
+    int fd = this->fd;
+    if (fd == -1) {
+        return err(PathError("close", this->name, ErrClosed()));
+    }
+
+    this->fd = -1;
+    release_buf();
+
+    // Linux releases the descriptor even when close fails, so never retry
+    if (::close(fd) == -1 && errno != EINTR) {
+        err(PathError("close", this->name, Errno(errno)));
+    }
+}
+
+static Dir open_dir_flags(int dirfd, str name, int flags, error err) {
+    Dir d;
+    d.name = name;
+
+    CString cname = name;
+retry:
+    int fd = ::openat(dirfd, cname, O_RDONLY|O_DIRECTORY|O_CLOEXEC|flags);
+    if (fd == -1) {
+        if (errno == EINTR) {
+            goto retry;
+        }
+        err(PathError("open", name, Errno(errno)));
+        return d;
+    }
+
+    d.fd = fd;
+    return d;
+}
+
+Dir os::open_dir(str name, error err) {
+    return open_dir_flags(AT_FDCWD, name, 0, err);
+}
+
+Dir os::open_dir_at(int dirfd, str name, error err) {
+    return open_dir_flags(dirfd, name, O_NOFOLLOW, err);
+}
+
+std::vector<fs::DirEntry> os::read_dir(str name, error err) {
+    std::vector<fs::DirEntry> entries;
+
+    Dir d = open_dir(name, err);
+    if (err) {
+        return entries;
+    }
+
+    str entry;
+    FileMode type;
+    while (d.next(&entry, &type, err)) {
+        entries.push_back(fs::DirEntry{entry, type});
+    }
+
+    std::sort(entries.begin(), entries.end(), [](fs::DirEntry const &a, fs::DirEntry const &b) {
+        return str(a.name) < str(b.name);
+    });
+    return entries;
+}
+
+namespace {
+    // DirFile is a File opened from a DirFS.
+    struct DirFile : fs::File {
+        os::File f;
+
+        explicit DirFile(os::File &&f) : f(std::move(f)) {}
+
+        io::ReadResult direct_read(buf b, error err) override {
+            return f.direct_read(b, err);
+        }
+
+        fs::FileInfo stat(error err) override {
+            return f.stat(err);
+        }
+
+        void close(error err) override {
+            f.close(err);
+        }
+    } ;
+}
+
+// rename_err reports e, an error for the OS path, against name instead.
+static void rename_err(str name, lib::Error &e, error err) {
+    if (const fs::PathError *pe = e.as<fs::PathError>()) {
+        return err(fs::PathError(pe->op, name, *pe->err));
+    }
+    err(e);
+}
+
+bool DirFS::path(str op, str name, String *out, error err) {
+    if (!fs::valid_path(name)) {
+        err(fs::PathError(op, name, fs::ErrInvalid()));
+        return false;
+    }
+
+    *out = root;
+    if (name != ".") {
+        *out += '/';
+        *out += name;
+    }
+    return true;
+}
+
+std::unique_ptr<fs::File> DirFS::open(str name, error err) {
+    String p;
+    if (!path("open", name, &p, err)) {
+        return nil;
+    }
+
+    bool failed = false;
+    File f = os::open(p, [&](lib::Error &e) {
+        failed = true;
+        rename_err(name, e, err);
+    });
+    if (failed) {
+        return nil;
+    }
+    return std::make_unique<DirFile>(std::move(f));
+}
+
+fs::FileInfo DirFS::stat(str name, error err) {
+    String p;
+    if (!path("stat", name, &p, err)) {
+        return {};
+    }
+
+    fs::FileInfo fi = os::stat(p, [&](lib::Error &e) {
+        rename_err(name, e, err);
+    });
+    fi.name = filepath::base(name);
+    return fi;
+}
+
+std::vector<fs::DirEntry> DirFS::read_dir(str name, error err) {
+    String p;
+    if (!path("readdir", name, &p, err)) {
+        return {};
+    }
+
+    return os::read_dir(p, [&](lib::Error &e) {
+        rename_err(name, e, err);
+    });
+}
+
+String DirFS::read_file(str name, error err) {
+    String p;
+    if (!path("readfile", name, &p, err)) {
+        return "";
+    }
+
+    return os::read_file(p, [&](lib::Error &e) {
+        rename_err(name, e, err);
+    });
+}
+
+DirFS os::dir_fs(str root) {
+    return DirFS(root);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+#include "lib/base.h"
+#include "lib/fs/fs.h"
+
+namespace lib::os {
+
+    // Dir is an open directory. Entries are read with getdents64 into a
+    // pooled buffer, many per syscall, and their type comes from d_type so
+    // listing a directory needs no stat per entry.
+    struct Dir {
+        int    fd = -1;
+        String name;
+
+        Dir() = default;
+        explicit Dir(int fd) : fd(fd) {}
+        Dir(Dir const&) = delete;
+        Dir(Dir &&other);
+        Dir& operator=(Dir const&) = delete;
+        Dir& operator=(Dir &&other);
+        ~Dir();
+
+        // next advances to the next entry, skipping "." and "..". It returns
+        // false at the end of the directory or on error. name is valid until
+        // the following call to next.
+        //
+        // On filesystems that don't report d_type the type is filled in with
+        // an fstatat of the entry.
+        bool next(str *name, fs::FileMode *type, error err);
+
+        void close(error err);
+
+      private:
+        static constexpr size BufSize = 64 << 10;
+
+        byte *buf = nil;
+        int32 pos = 0;
+        int32 end = 0;
+        bool  eof = false;
+
+        void release_buf();
+    } ;
+
+    // open_dir opens the named directory for reading.
+    Dir open_dir(str name, error err);
+
+    // open_dir_at opens the directory name relative to the open directory
+    // dirfd. Symbolic links are not followed.
+    Dir open_dir_at(int dirfd, str name, error err);
+
+    // read_dir reads the named directory, returning all its directory entries
+    // sorted by filename.
+    std::vector<fs::DirEntry> read_dir(str name, error err);
+
+    // DirFS is an fs::FS for the tree of files rooted at the directory root.
+    // Names are checked with fs::valid_path, so a name can't escape root
+    // with "..", but symbolic links inside the tree are followed wherever
+    // they point. Errors report the name, not the path under root.
+    struct DirFS : fs::FS {
+        String root;
+
+        explicit DirFS(str root) : root(root) {}
+
+        std::unique_ptr<fs::File> open(str name, error err) override;
+        fs::FileInfo stat(str name, error err) override;
+        std::vector<fs::DirEntry> read_dir(str name, error err) override;
+        String read_file(str name, error err) override;
+
+      private:
+        // path returns the OS path of name, or reports an invalid name.
+        bool path(str op, str name, String *out, error err);
+    } ;
+
+    // dir_fs returns a file system for the tree of files rooted at the
+    // directory root.
+    DirFS dir_fs(str root);
+}
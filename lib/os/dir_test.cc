@@ -0,0 +1,136 @@
+#include "dir.h"
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+static int remove_entry(const char *path, const struct stat *, int, struct FTW *) {
+    return ::remove(path);
+}
+
+static String join(str dir, str name) {
+    String p = dir;
+    p += '/';
+    p += name;
+    return p;
+}
+
+void test_read_dir(T &t) {
+    char tmpl[] = "/tmp/baselib-dir-test-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        t.fatalf("mkdtemp failed");
+    }
+    String dir = str(tmpl, strlen(tmpl));
+
+    ErrorRecorder err;
+    os::write_file(join(dir, "b.txt"), "b", err);
+    os::write_file(join(dir, "a.txt"), "a", err);
+    mkdir(CString(join(dir, "sub")), 0755);
+    symlink("a.txt", CString(join(dir, "link")));
+    if (err) {
+        t.fatalf("setup: %v", err);
+    }
+
+    std::vector<fs::DirEntry> entries = os::read_dir(dir, err);
+    if (err) {
+        t.fatalf("read_dir: %v", err);
+    }
+
+    struct {
+        str  name;
+        bool dir;
+        bool symlink;
+    } want[] = {
+        {"a.txt", false, false},
+        {"b.txt", false, false},
+        {"link",  false, true},
+        {"sub",   true,  false},
+    };
+
+    if (entries.size() != std::size(want)) {
+        t.fatalf("read_dir returned %d entries; want %d", int(entries.size()), int(std::size(want)));
+    }
+    for (size i = 0; i < size(std::size(want)); i++) {
+        fs::DirEntry const &e = entries[i];
+        if (e.name != want[i].name) {
+            t.errorf("entry %d = %q; want %q", i, e.name, want[i].name);
+        }
+        if (e.is_dir() != want[i].dir) {
+            t.errorf("%s: is_dir = %v", e.name, e.is_dir());
+        }
+        if (((e.type.value & fs::ModeSymlink.value) != 0) != want[i].symlink) {
+            t.errorf("%s: type = %#x", e.name, e.type.value);
+        }
+    }
+
+    os::read_dir(join(dir, "missing"), err);
+    if (!err) {
+        t.errorf("read_dir of missing directory succeeded");
+    }
+
+    nftw(tmpl, remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+}
+
+void test_dir_fs(T &t) {
+    char tmpl[] = "/tmp/baselib-dirfs-test-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        t.fatalf("mkdtemp failed");
+    }
+    String dir = str(tmpl, strlen(tmpl));
+
+    ErrorRecorder err;
+    mkdir(CString(join(dir, "sub")), 0755);
+    os::write_file(join(dir, "sub/file.txt"), "contents", err);
+    if (err) {
+        t.fatalf("setup: %v", err);
+    }
+
+    os::DirFS fsys = os::dir_fs(dir);
+    fs::FS &f = fsys;
+
+    String data = f.read_file("sub/file.txt", err);
+    if (err || data != "contents") {
+        t.errorf("read_file = %q, %v", data, err);
+    }
+
+    fs::FileInfo fi = f.stat("sub/file.txt", err);
+    if (err || fi.name != "file.txt" || fi.size != 8) {
+        t.errorf("stat = {%q %d}, %v", fi.name, fi.size, err);
+    }
+
+    std::vector<fs::DirEntry> entries = f.read_dir(".", err);
+    if (err || entries.size() != 1 || entries[0].name != "sub") {
+        t.errorf("read_dir(.) returned %d entries, %v", int(entries.size()), err);
+    }
+
+    std::unique_ptr<fs::File> file = f.open("sub/file.txt", err);
+    byte b[32];
+    io::ReadResult r = file->read(b, err);
+    if (err || str(b, r.nbytes) != "contents") {
+        t.errorf("read = %q, %v", str(b, r.nbytes), err);
+    }
+
+    // names can't escape the root, and errors name the file, not the path
+    bool invalid = false;
+    f.open("../etc/passwd", [&](Error &e) {
+        invalid = e.is<fs::ErrInvalid>();
+    });
+    if (!invalid) {
+        t.errorf("open(../etc/passwd) did not fail with ErrInvalid");
+    }
+    f.stat("missing", [&](Error &e) {
+        fs::PathError const *pe = e.as<fs::PathError>();
+        if (!pe || pe->path != "missing") {
+            t.errorf("stat error = %v; want a PathError for %q", e, "missing");
+        }
+    });
+
+    nftw(tmpl, remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+}
@@ -37,6 +37,8 @@ namespace lib::os {
     using fs::ErrPermission;
     using fs::ErrExist;
     using fs::ErrClosed;
+
+    struct ErrNegativeOffset : ErrorBase<ErrNegativeOffset, "negative offset"> {};
     
     // extern Error ErrPERM;
     // extern Error ErrNOENT;
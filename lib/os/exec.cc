@@ -0,0 +1,328 @@
+#include "exec.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "pipe.h"
+#include "stdio.h"
+#include "lib/fmt/fmt.h"
+
+extern char **environ;
+
+using namespace lib;
+using namespace lib::os;
+using namespace lib::os::exec;
+
+void ExecError::fmt(io::Writer &out, error err) const {
+    fmt::fprintf(out, err, "exec: %q: %s", this->name, this->err);
+}
+
+view<lib::Error*> ExecError::unwrap() const {
+    return view<lib::Error*>(&this->err, 1);
+}
+
+int ExitError::exit_code() const {
+    if (WIFEXITED(this->status)) {
+        return WEXITSTATUS(this->status);
+    }
+    return -1;
+}
+
+void ExitError::fmt(io::Writer &out, error err) const {
+    if (WIFSIGNALED(this->status)) {
+        fmt::fprintf(out, err, "signal: %s", str::from_c_str(strsignal(WTERMSIG(this->status))));
+        return;
+    }
+    fmt::fprintf(out, err, "exit status %d", this->exit_code());
+}
+
+// is_executable reports whether path is an executable regular file. If not,
+// errno says why.
+static bool is_executable(str path) {
+    CString cpath = path;
+    struct ::stat st;
+    if (::stat(cpath, &st) == -1) {
+        return false;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        errno = EACCES;
+        return false;
+    }
+    return ::access(cpath, X_OK) == 0;
+}
+
+String os::exec::look_path(str file, error err) {
+    for (size i = 0; i < len(file); i++) {
+        if (file[i] == '/') {
+            if (is_executable(file)) {
+                return file;
+            }
+            err(ExecError(file, Errno(errno)));
+            return "";
+        }
+    }
+
+    const char *env = ::getenv("PATH");
+    str path = env ? str::from_c_str(env) : str();
+
+    while (true) {
+        size i = 0;
+        while (i < len(path) && path[i] != ':') {
+            i++;
+        }
+
+        // an empty element means the current directory
+        String candidate = i == 0 ? String(".") : String(path[0, i]);
+        candidate += '/';
+        candidate += file;
+        if (is_executable(candidate)) {
+            return candidate;
+        }
+
+        if (i == len(path)) {
+            break;
+        }
+        path = path(i + 1);
+    }
+
+    err(ExecError(file, ErrNotFound()));
+    return "";
+}
+
+// stdio_fd returns the descriptor the child should use for rw.
+int Command::stdio_fd(io::ReaderWriter *rw, bool input, error err) {
+    if (!rw) {
+        File null = open_file("/dev/null", input ? O_RDONLY : O_WRONLY, 0, err);
+        int fd = null.fd;
+        child_ends.push_back(std::move(null));
+        return fd;
+    }
+
+    if (File *f = dynamic_cast<File*>(rw); f && f->fd != -1) {
+        // keep the order of anything the parent has already buffered
+        if (!input) {
+            f->flush(err);
+        }
+        return f->fd;
+    }
+
+    if (StdStream *s = dynamic_cast<StdStream*>(rw)) {
+        if (!input) {
+            s->sync(err);
+        }
+        return s->fd;
+    }
+
+    FilePair p = pipe(err);
+    if (err) {
+        return -1;
+    }
+
+    Copy &c = copies.emplace_back();
+    c.rw = rw;
+    c.input = input;
+    if (input) {
+        c.pipe = std::move(p.writer);
+        child_ends.push_back(std::move(p.reader));
+    } else {
+        c.pipe = std::move(p.reader);
+        child_ends.push_back(std::move(p.writer));
+    }
+    return child_ends.back().fd;
+}
+
+static void copy_in(io::ReaderWriter &from, File &to, error err) {
+    // a command that exits without reading all its input is not an error,
+    // so a broken pipe must not kill the process
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, nil);
+
+    byte b[32 * 1024];
+    for (;;) {
+        io::ReadResult r = from.read(buf(b, sizeof b), err);
+        if (r.nbytes > 0) {
+            ErrorRecorder werr;
+            to.direct_write(str(b, r.nbytes), werr);
+            if (werr) {
+                break;
+            }
+        }
+        if (err || r.eof) {
+            break;
+        }
+    }
+    to.close(error::ignore);
+}
+
+static void copy_out(File &from, io::ReaderWriter &to, error err) {
+    byte b[32 * 1024];
+    for (;;) {
+        io::ReadResult r = from.direct_read(buf(b, sizeof b), err);
+        if (r.nbytes > 0) {
+            to.write(str(b, r.nbytes), err);
+        }
+        if (err || r.eof) {
+            break;
+        }
+    }
+}
+
+void Command::start(error err) {
+    if (pid != -1) {
+        return err("exec: already started");
+    }
+
+    String resolved = look_path(path, err);
+    if (err) {
+        return;
+    }
+
+    int fds[3];
+    fds[0] = stdio_fd(in, true, err);
+    fds[1] = stdio_fd(out, false, err);
+    // sharing one descriptor keeps combined output in order and avoids
+    // two threads writing into the same writer
+    fds[2] = errout == out ? fds[1] : stdio_fd(errout, false, err);
+    if (err) {
+        child_ends.clear();
+        copies.clear();
+        return;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    for (int i = 0; i < 3; i++) {
+        // dup2 onto the same number clears close-on-exec
+        posix_spawn_file_actions_adddup2(&actions, fds[i], i);
+    }
+    CString cdir(dir);
+    if (len(dir) > 0) {
+        posix_spawn_file_actions_addchdir_np(&actions, cdir);
+    }
+
+    // give the child a clean signal state: nothing blocked and nothing
+    // ignored, whatever this process has set up
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t mask, defaults;
+    sigemptyset(&mask);
+    sigfillset(&defaults);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK|POSIX_SPAWN_SETSIGDEF);
+
+    std::vector<CString> cargs(args.begin(), args.end());
+    std::vector<char*> argv;
+    for (CString &a : cargs) {
+        argv.push_back((char *) (const char *) a);
+    }
+    argv.push_back(nil);
+
+    std::vector<CString> cenv;
+    std::vector<char*> envp;
+    if (env) {
+        cenv.assign(env->begin(), env->end());
+        for (CString &e : cenv) {
+            envp.push_back((char *) (const char *) e);
+        }
+        envp.push_back(nil);
+    }
+
+    CString cpath(resolved);
+    int code = posix_spawn(&pid, cpath, &actions, &attr, argv.data(), env ? envp.data() : environ);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    // the child has its own copies now
+    child_ends.clear();
+
+    if (code != 0) {
+        pid = -1;
+        copies.clear();
+        return err(ExecError(path, Errno(code)));
+    }
+
+    for (Copy &c : copies) {
+        copiers.emplace_back([&c] {
+            if (c.input) {
+                copy_in(*c.rw, c.pipe, c.err);
+            } else {
+                copy_out(c.pipe, *c.rw, c.err);
+            }
+        });
+    }
+}
+
+void Command::wait(error err) {
+    if (pid == -1) {
+        return err("exec: not started");
+    }
+
+    int status = 0;
+    while (::waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            err(SyscallError("waitpid", errno));
+            break;
+        }
+    }
+
+    for (sync::go &g : copiers) {
+        g.join();
+    }
+    copiers.clear();
+
+    if (status != 0) {
+        err(ExitError(status));
+    }
+    for (Copy &c : copies) {
+        if (c.err) {
+            err(c.err.to_error());
+        }
+    }
+    copies.clear();
+}
+
+void Command::run(error err) {
+    start(err);
+    if (err) {
+        return;
+    }
+    wait(err);
+}
+
+String Command::output(error err) {
+    if (out) {
+        err("exec: out already set");
+        return "";
+    }
+
+    io::Buffer b;
+    out = &b;
+    run(err);
+    out = nil;
+    return b.to_string();
+}
+
+String Command::combined_output(error err) {
+    if (out || errout) {
+        err("exec: out or errout already set");
+        return "";
+    }
+
+    io::Buffer b;
+    out = &b;
+    errout = &b;
+    run(err);
+    out = nil;
+    errout = nil;
+    return b.to_string();
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <deque>
+#include <optional>
+#include <vector>
+
+#include "lib/base.h"
+#include "lib/io.h"
+#include "lib/sync/go.h"
+#include "file.h"
+
+namespace lib::os::exec {
+
+    struct ErrNotFound : ErrorBase<ErrNotFound, "executable file not found in $PATH"> {};
+
+    // ExecError is reported when a command could not be started: name could
+    // not be found or executed.
+    struct ExecError : ErrorBase<ExecError> {
+        str         name;
+        lib::Error *err = nil;
+
+        ExecError(str name, lib::Error const &err) : name(name), err((lib::Error*) &err) {}
+
+        virtual void fmt(io::Writer &out, error err) const override;
+        virtual view<lib::Error*> unwrap() const override;
+    } ;
+
+    // ExitError is reported by wait when the command ran but did not exit
+    // successfully.
+    struct ExitError : ErrorBase<ExitError> {
+        int status = 0;  // the wait status
+
+        ExitError(int status) : status(status) {}
+
+        // exit_code returns the exit code of the command, or -1 if it was
+        // killed by a signal.
+        int exit_code() const;
+
+        virtual void fmt(io::Writer &out, error err) const override;
+    } ;
+
+    // look_path searches for an executable named file in the directories
+    // named by the PATH environment variable. If file contains a slash, it
+    // is tried directly and PATH is not consulted.
+    String look_path(str file, error err);
+
+    // Command is an external command being prepared or run. It is spawned
+    // with posix_spawn, which uses vfork-style cloning, so the cost of
+    // starting a command does not depend on the size of the parent process.
+    struct Command {
+        // path is the command to run. If it contains no slash, it is looked
+        // up in PATH when the command is started.
+        String path;
+
+        // args holds the command line arguments, including the command as
+        // args[0].
+        std::vector<String> args;
+
+        // env holds "KEY=value" entries for the command's environment. If
+        // unset, the command inherits the environment of this process.
+        std::optional<std::vector<String>> env;
+
+        // dir is the working directory of the command. If empty, the command
+        // runs in the current directory of this process.
+        String dir;
+
+        // in, out and errout are the command's standard input, output and
+        // error. If one is an os::File, os::stdout or os::stderr, the
+        // command uses its descriptor directly. Otherwise the data is
+        // copied through a pipe by a thread that wait waits for. If nil, it
+        // is connected to /dev/null.
+        io::ReaderWriter *in     = nil;
+        io::ReaderWriter *out    = nil;
+        io::ReaderWriter *errout = nil;
+
+        // pid is the process id once the command has started, -1 before.
+        int pid = -1;
+
+        Command() = default;
+        Command(Command const&) = delete;
+        Command(Command&&) = default;
+
+        // start starts the command but does not wait for it to complete.
+        // After a successful start, wait must be called to release the
+        // associated resources.
+        void start(error err);
+
+        // wait waits for the command to exit and for the copying to or from
+        // in, out and errout to finish. If the command fails, the error is
+        // an ExitError.
+        void wait(error err);
+
+        // run starts the command and waits for it to complete.
+        void run(error err);
+
+        // output runs the command and returns its standard output. out must
+        // not be set.
+        String output(error err);
+
+        // combined_output runs the command and returns its standard output
+        // and standard error combined. out and errout must not be set.
+        String combined_output(error err);
+
+      private:
+        struct Copy {
+            io::ReaderWriter *rw = nil;
+            File              pipe;   // the parent's end
+            bool              input = false;
+            ErrorRecorder     err;
+        } ;
+
+        std::vector<File>    child_ends;  // closed once the child has started
+        std::deque<Copy>     copies;
+        std::deque<sync::go> copiers;
+
+        int stdio_fd(io::ReaderWriter *rw, bool input, error err);
+    } ;
+
+    // command returns a Command to run name with the given arguments.
+    template <typename ...Args>
+    Command command(str name, Args const &...args) {
+        Command c;
+        c.path = name;
+        c.args = {String(name), String(args)...};
+        return c;
+    }
+}
@@ -0,0 +1,73 @@
+#include "exec.h"
+
+#include "lib/testing/benchmark.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+void test_command_output(T &t) {
+    ErrorRecorder err;
+    String out = os::exec::command("echo", "hello", "world").output(err);
+    if (err || out != "hello world\n") {
+        t.errorf("echo output = %q, err %v; want %q", out, err, "hello world\n");
+    }
+
+    os::exec::Command sh = os::exec::command("sh", "-c", "echo out; echo err >&2");
+    out = sh.combined_output(err);
+    if (err || out != "out\nerr\n") {
+        t.errorf("combined_output = %q, err %v", out, err);
+    }
+
+    // stdin from a reader, stdout to a buffer
+    io::Str in("line one\nline two\n");
+    io::Buffer b;
+    os::exec::Command cat = os::exec::command("cat");
+    cat.in = &in;
+    cat.out = &b;
+    cat.run(err);
+    if (err || b.str() != "line one\nline two\n") {
+        t.errorf("cat copied %q, err %v", b.str(), err);
+    }
+
+    os::exec::Command env = os::exec::command("sh", "-c", "echo $GREETING; pwd");
+    env.env = std::vector<String>{"GREETING=hi", "PATH=/usr/bin:/bin"};
+    env.dir = "/";
+    out = env.output(err);
+    if (err || out != "hi\n/\n") {
+        t.errorf("env and dir: output %q, err %v", out, err);
+    }
+}
+
+void test_command_errors(T &t) {
+    int code = 0;
+    os::exec::command("sh", "-c", "exit 3").run([&](Error &e) {
+        if (const os::exec::ExitError *x = e.as<os::exec::ExitError>()) {
+            code = x->exit_code();
+        }
+    });
+    if (code != 3) {
+        t.errorf("exit code = %d; want 3", code);
+    }
+
+    bool not_found = false;
+    os::exec::command("baselib-no-such-command").run([&](Error &e) {
+        not_found = e.is<os::exec::ErrNotFound>();
+    });
+    if (!not_found) {
+        t.errorf("running a missing command did not report ErrNotFound");
+    }
+
+    ErrorRecorder err;
+    os::exec::Command c = os::exec::command("true");
+    c.wait(err);
+    if (!err) {
+        t.errorf("wait before start succeeded");
+    }
+}
+
+void benchmark_command_run(B &b) {
+    for (int i = 0; i < b.n; i++) {
+        os::exec::command("true").run(error::panic);
+    }
+}
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <atomic>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
@@ -91,40 +93,15 @@ retry:
     return f;
 }
 
-static void fill_file_info_from_sys(FileInfo *fi, str name) {
-    fi->name = filepath::base(name);
-    fi->size = fi->stat.st_size;
-    fi->mod_time = time::unix(fi->stat.st_mtim);
-    fi->mode = FileMode(fi->stat.st_mode & 0777);
-
-    switch (fi->stat.st_mode & S_IFMT) {
-        case S_IFBLK: fi->mode |= ModeDevice; break;
-        case S_IFCHR: fi->mode |= ModeDevice | ModeCharDevice; break;
-        case S_IFDIR: fi->mode |= ModeDir; break;
-        case S_IFIFO: fi->mode |= ModeNamedPipe; break;
-        case S_IFLNK: fi->mode |= ModeSymlink; break;
-        case S_IFREG: /* do nothing */; break;
-        case S_IFSOCK: fi->mode |= ModeSocket; break;
-    }
-
-    if (fi->stat.st_mode & S_ISGID) {
-        fi->mode |= ModeSetgid;
-    }
-
-    if (fi->stat.st_mode & S_ISUID) {
-        fi->mode |= ModeSetuid;
-    }
-
-    if (fi->stat.st_mode & S_ISVTX ) {
-        fi->mode |= ModeSticky;
-    }
+FileInfo File::stat(error err) {
+    return stat(StatAll, err);
 }
 
-FileInfo File::stat(error err) {
+FileInfo File::stat(StatMask mask, error err) {
     FileInfo fi;
 
 retry:
-    int r = ::fstat(fd, &fi.stat);
+    int r = ::statx(fd, "", AT_EMPTY_PATH, mask.value, &fi.sys);
     if (r == -1) {
         if (errno == EINTR) {
             goto retry;
@@ -134,98 +111,224 @@ retry:
         return fi;
     }
 
-    fill_file_info_from_sys(&fi, name);
+    internal::fill_file_info(&fi, name, mask);
 
     return fi;
 }
 
+// sys_open opens name and returns the descriptor, or -1 with errno set.
+static int sys_open(str name, int flag, FileMode perm) {
+    CString cname = name;
+
+retry:
+    int fd = ::open(cname, flag|O_CLOEXEC, syscall_mode(perm));
+    if (fd == -1 && errno == EINTR) {
+        goto retry;
+    }
+    return fd;
+}
+
+// sys_write writes all of data to fd.
+static void sys_write(int fd, str name, str data, error err) {
+    while (len(data) > 0) {
+        ssize_t n = ::write(fd, data.data, data.len);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return err(PathError("write", name, Errno(errno)));
+        }
+        if (n == 0) {
+            return err(PathError("write", name, io::ErrUnexpectedEOF()));
+        }
+        data = data(n);
+    }
+}
+
+static void sys_close(int fd, str name, error err) {
+    // Linux releases the descriptor even when close fails, so EINTR must not
+    // be retried
+    if (::close(fd) == -1 && errno != EINTR) {
+        err(PathError("close", name, Errno(errno)));
+    }
+}
+
 void os::write_file(str name, str data, error err) {
     write_file(name, data, 0666, err);
 }
 
 void os::write_file(str name, str data, FileMode perm, error err) {
-    File f = open_file(name, O_WRONLY|O_CREAT|O_TRUNC, perm, err);
-    if (err) {
-        return;
-    }
-
-    f.direct_write(data, err);
-    if (err) {
-        return;
+    // the data is written with a single write call, so there is no point
+    // in going through a File and its write buffer
+    int fd = sys_open(name, O_WRONLY|O_CREAT|O_TRUNC, perm);
+    if (fd == -1) {
+        return err(PathError("open", name, Errno(errno)));
     }
 
-    f.close(err);
+    sys_write(fd, name, data, err);
+    sys_close(fd, name, err);
 }
 
 String os::read_file(str path, error err) {
-    os::File f = open(path, err);
-    if (err) {
+    int fd = sys_open(path, O_RDONLY, 0);
+    if (fd == -1) {
+        err(PathError("open", path, Errno(errno)));
         return "";
     }
 
-    
-    FileInfo info = f.stat(error::ignore);
-    size file_size = size(info.size);
-    if (file_size != info.size) {
-        file_size = 0;
+    struct ::stat st;
+    size file_size = 0;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && size(st.st_size) == st.st_size) {
+        file_size = size(st.st_size);
     }
-    //file_size++; // one byte for final read at EOF
 
+    // Ask for one byte more than the file's size, so that for a regular
+    // file a single read both fills the String and shows that the file
+    // ended: a short read that has reached the stat'ed size is EOF, and
+    // the buffer never has to grow.
+    //
     // If a file claims a small size, read at least 512 bytes.
-	// In particular, files in Linux's /proc claim size 0 but
-	// then do not work right if read in small pieces,
-	// so an initial read of 1 byte would not work correctly.
-	if (file_size < 512) {
-		file_size = 512;
-	}
-
-    String s;
-    s.ensure(file_size);
-    size bytes_read = 0;
-    
+    // In particular, files in Linux's /proc claim size 0 but
+    // then do not work right if read in small pieces,
+    // so an initial read of 1 byte would not work correctly.
+    String s(std::max(file_size + 1, size(512)));
+
     for (;;) {
-        io::ReadResult r = f.direct_read(s.buffer+bytes_read, err);
-        bytes_read += r.nbytes;
+        if (s.length == s.cap()) {
+            s.ensure(s.cap() + 1);
+        }
 
-        if (err || r.eof) {
+        size want = s.cap() - s.length;
+        ssize_t n = ::read(fd, s.buffer.data + s.length, usize(want));
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            err(PathError("read", path, Errno(errno)));
             break;
         }
 
-        s.ensure(bytes_read+1);
+        if (n == 0) {
+            break;
+        }
+        s.length += n;
+
+        if (file_size > 0 && n < want && s.length >= file_size) {
+            break;
+        }
     }
 
-    s.expand(bytes_read);
+    sys_close(fd, path, error::ignore);
     return s;
+}
 
-        
-    // }
-    // size size = info.size;
+// split_dir returns the directory part of name, or "." if it has none.
+static str split_dir(str name) {
+    for (size i = len(name) - 1; i >= 0; i--) {
+        if (name[i] == '/') {
+            return i == 0 ? str("/") : name[0, i];
+        }
+    }
+    return ".";
+}
 
-    // if (!staterr) {
-    //     sz = info.size;
-    // }
+static std::atomic<uint32> temp_seq;
+
+// write_temp writes data to a new temporary file in the directory of name
+// and returns its path. On failure the temporary file is removed and an
+// empty String is returned.
+static String write_temp(str name, str data, AtomicWriteOptions const &opts, error err) {
+    str dir = split_dir(name);
+    str base = filepath::base(name);
+
+    String tmp;
+    int fd = -1;
+    for (int attempt = 0; fd == -1; attempt++) {
+        tmp = fmt::sprintf("%s/.%s.%d-%d.tmp", dir, base, getpid(), temp_seq++);
+        fd = sys_open(tmp, O_WRONLY|O_CREAT|O_EXCL, opts.perm);
+        if (fd == -1 && (errno != EEXIST || attempt >= 100)) {
+            err(PathError("open", tmp, Errno(errno)));
+            return "";
+        }
+    }
 
-    // if (sz < 512) {
-    //     sz = 512;
-    // }
+    sys_write(fd, tmp, data, err);
+    if (!err && opts.sync && ::fdatasync(fd) == -1) {
+        err(PathError("sync", tmp, Errno(errno)));
+    }
+    sys_close(fd, tmp, err);
 
-    // String s(sz);
-    
-    // for (;;) {
-    //     size n = f.direct_read(s.buffer[len(s), len(s.buffer)], err);
-    //     s.length += n;
-    //     if (err) {
-    //         if (err == io::EOF) {
-    //             err = {};
-    //         }
-    //         return s;
-    //     }
-
-    //     if (len(s) >= len(s.buffer)) {
-    //         s.buffer.resize(len(s.buffer)*2);
-    //     }
-    // } 
+    if (err) {
+        ::unlink(CString(tmp));
+        return "";
+    }
+    return tmp;
+}
+
+static void sync_dir(str dir, error err) {
+    int fd = sys_open(dir, O_RDONLY|O_DIRECTORY, 0);
+    if (fd == -1) {
+        return err(PathError("open", dir, Errno(errno)));
+    }
+    if (::fsync(fd) == -1) {
+        err(PathError("sync", dir, Errno(errno)));
+    }
+    sys_close(fd, dir, error::ignore);
+}
 
+void os::write_file_atomic(str name, str data, error err) {
+    write_file_atomic(name, data, AtomicWriteOptions{}, err);
+}
+
+void os::write_file_atomic(str name, str data, AtomicWriteOptions const &opts, error err) {
+    AtomicWrite w = {name, data};
+    write_files_atomic(view<AtomicWrite>(&w, 1), opts, err);
+}
+
+void os::write_files_atomic(view<AtomicWrite> files, error err) {
+    write_files_atomic(files, AtomicWriteOptions{}, err);
+}
+
+void os::write_files_atomic(view<AtomicWrite> files, AtomicWriteOptions const &opts, error err) {
+    // Write and sync every temporary file before renaming any of them, then
+    // sync each directory once rather than once per file.
+    std::vector<String> temps;
+    temps.reserve(len(files));
+
+    for (AtomicWrite const &f : files) {
+        String tmp = write_temp(f.name, f.data, opts, err);
+        if (err) {
+            break;
+        }
+        temps.push_back(std::move(tmp));
+    }
+
+    std::vector<str> dirs;
+    for (size i = 0; i < size(temps.size()); i++) {
+        str name = files[i].name;
+        if (err) {
+            // an earlier file failed: leave all targets untouched
+            ::unlink(CString(temps[i]));
+            continue;
+        }
+
+        if (::rename(CString(temps[i]), CString(name)) == -1) {
+            err(PathError("rename", name, Errno(errno)));
+            ::unlink(CString(temps[i]));
+            continue;
+        }
+
+        str dir = split_dir(name);
+        if (std::find(dirs.begin(), dirs.end(), dir) == dirs.end()) {
+            dirs.push_back(dir);
+        }
+    }
+
+    if (opts.sync && !err) {
+        for (str dir : dirs) {
+            sync_dir(dir, err);
+        }
+    }
 }
 
 io::ReadResult os::File::direct_read(buf b, error err) {
@@ -281,6 +384,60 @@ io::ReadResult os::File::direct_read(buf b, error err) {
 //     return total;
 // }
 
+io::ReadResult os::File::read_at(buf b, int64 off, error err) {
+    io::ReadResult r;
+    if (off < 0) {
+        err(PathError("readat", this->name, ErrNegativeOffset()));
+        return r;
+    }
+
+    while (r.nbytes < len(b)) {
+        ssize_t n = ::pread(fd, b.data + r.nbytes, b.len - r.nbytes, off + r.nbytes);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            err(PathError("read", this->name, Errno(errno)));
+            return r;
+        }
+
+        if (n == 0) {
+            r.eof = true;
+            break;
+        }
+        r.nbytes += n;
+    }
+
+    return r;
+}
+
+size os::File::write_at(str data, int64 off, error err) {
+    if (off < 0) {
+        err(PathError("writeat", this->name, ErrNegativeOffset()));
+        return 0;
+    }
+
+    size total = 0;
+    while (total < len(data)) {
+        ssize_t n = ::pwrite(fd, data.data + total, data.len - total, off + total);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            wrap_err("write", Errno(errno), err);
+            return total;
+        }
+
+        if (n == 0) {
+            wrap_err("write", io::ErrUnexpectedEOF(), err);
+            return total;
+        }
+        total += n;
+    }
+
+    return total;
+}
+
 size os::File::direct_write(str data, error err) {
     //printf("DIRECT WRITE %d\n", int(len(data)));
     size total = 0;
@@ -9,7 +9,7 @@
 
 namespace lib::os {
 
-    struct File : io::Buffered {
+    struct File : io::Buffered, io::ReaderAt, io::WriterAt {
         int fd = -1;
         CString name;
         //int efd = -1;
@@ -19,13 +19,27 @@ namespace lib::os {
         File(File const&) = delete;
         File(File&& other);
 
+        // stat returns a FileInfo describing the file. The name in the
+        // result is a view into the File's name.
         FileInfo stat(error err);
+        FileInfo stat(StatMask mask, error err);
         
         // read reads up to len(b) bytes into b and returns the number of bytes read. At end of 
         // file, 0 is returned.
         io::ReadResult direct_read(buf b, error err) override;
 
         size direct_write(str data, error err) override;
+
+        // read_at reads len(b) bytes from the file starting at byte offset
+        // off, using pread. It neither uses nor moves the file offset or the
+        // read buffer, so several threads may call it at once. eof is set if
+        // the file ended before b was filled.
+        io::ReadResult read_at(buf b, int64 off, error err) override;
+
+        // write_at writes data to the file starting at byte offset off,
+        // using pwrite. It bypasses the write buffer. On a file opened with
+        // O_APPEND, Linux appends the data regardless of off.
+        size write_at(str data, int64 off, error err) override;
         
         File& operator= (File const&) = delete;
         File& operator= (File&& other);
@@ -68,7 +82,41 @@ namespace lib::os {
     void write_file(str name, str data, FileMode perm, error err);
     void write_file(str name, str data, error err);
 
+    // read_file reads the named file and returns its contents. The String is
+    // sized from the file's size up front, so for a regular file it is
+    // allocated once and filled by a single read. For very large files that
+    // are only read, map_file avoids the copy altogether.
     String read_file(str name, error err);
 
+    struct AtomicWriteOptions {
+        FileMode perm = 0666;
+
+        // sync flushes each file's data to disk before it is renamed into
+        // place, and its directory afterwards, so that after a crash the
+        // name refers to either the old or the complete new contents. Without
+        // it, the replacement is atomic only for readers on a running system.
+        bool sync = true;
+    } ;
+
+    // write_file_atomic replaces the named file with data, so that readers
+    // see either the old or the new contents but never a partial write. It
+    // writes to a temporary file in the same directory and renames it over
+    // name.
+    void write_file_atomic(str name, str data, AtomicWriteOptions const &opts, error err);
+    void write_file_atomic(str name, str data, error err);
+
+    struct AtomicWrite {
+        str name;
+        str data;
+    } ;
+
+    // write_files_atomic replaces several files like write_file_atomic. All
+    // temporary files are written before any is renamed and each directory
+    // is synced once for the whole batch. If writing any file fails, none
+    // is replaced; a failed rename stops the batch, leaving the files
+    // renamed before it replaced.
+    void write_files_atomic(view<AtomicWrite> files, AtomicWriteOptions const &opts, error err);
+    void write_files_atomic(view<AtomicWrite> files, error err);
+
 }
 
@@ -0,0 +1,199 @@
+#include "file.h"
+
+#include <deque>
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dir.h"
+#include "mmap.h"
+#include "lib/fmt/fmt.h"
+#include "lib/io/section.h"
+#include "lib/io/util.h"
+#include "lib/sync/go.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+static int remove_entry(const char *path, const struct stat *, int, struct FTW *) {
+    return ::remove(path);
+}
+
+static String join(str dir, str name) {
+    String p = dir;
+    p += '/';
+    p += name;
+    return p;
+}
+
+void test_read_write_at(T &t) {
+    char tmpl[] = "/tmp/baselib-file-test-XXXXXX";
+    int fd = mkstemp(tmpl);
+    if (fd == -1) {
+        t.fatalf("mkstemp failed");
+    }
+    ::close(fd);
+
+    os::File f = os::open_file(str(tmpl, strlen(tmpl)), O_RDWR, 0, error::panic);
+
+    // 64 blocks of 4K, each filled with its index
+    const int nblocks = 64;
+    const int block = 4096;
+    String block_data;
+    for (int i = 0; i < nblocks; i++) {
+        block_data.length = 0;
+        for (int j = 0; j < block; j++) {
+            block_data += char(i);
+        }
+        f.write_at(block_data, int64(i) * block, error::panic);
+    }
+
+    // concurrent random reads on the one fd
+    std::atomic<int> bad = 0;
+    std::deque<sync::go> threads;
+    for (int g = 0; g < 8; g++) {
+        threads.emplace_back([&, g] {
+            Array<byte, block> b;
+            for (int k = 0; k < 200; k++) {
+                int i = (g * 37 + k * 11) % nblocks;
+                io::ReadResult r = f.read_at(b, int64(i) * block, error::panic);
+                if (r.nbytes != block || b[0] != byte(i) || b[block-1] != byte(i)) {
+                    bad++;
+                }
+            }
+        });
+    }
+    for (sync::go &g : threads) {
+        g.join();
+    }
+    if (bad != 0) {
+        t.errorf("%d concurrent read_at calls returned wrong data", bad.load());
+    }
+
+    // reading past the end sets eof
+    Array<byte, 100> b;
+    io::ReadResult r = f.read_at(b, int64(nblocks) * block - 10, error::panic);
+    if (r.nbytes != 10 || !r.eof) {
+        t.errorf("read_at at end = %d bytes, eof %v; want 10, true", r.nbytes, r.eof);
+    }
+
+    ErrorRecorder err;
+    f.read_at(b, -1, err);
+    if (!err.is<os::ErrNegativeOffset>()) {
+        t.errorf("read_at(-1) err = %v; want negative offset", err);
+    }
+
+    // a section of the file read as a stream
+    io::SectionReader s(f, 5 * block - 2, 4);
+    Array<byte, 8> sb;
+    size n = io::read_full(s, sb, error::ignore);
+    if (n != 4 || sb[0] != 4 || sb[1] != 4 || sb[2] != 5 || sb[3] != 5) {
+        t.errorf("SectionReader read %d bytes: % x", n, str(sb)[0, n]);
+    }
+
+    f.close(error::panic);
+    unlink(tmpl);
+}
+
+void test_read_file(T &t) {
+    char tmpl[] = "/tmp/baselib-file-test-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        t.fatalf("mkdtemp failed");
+    }
+    String dir = str(tmpl, strlen(tmpl));
+    String name = join(dir, "data");
+
+    for (int n : {0, 1, 511, 512, 513, 4096, 100000}) {
+        String want;
+        for (int i = 0; i < n; i++) {
+            want += char('a' + i % 26);
+        }
+        os::write_file(name, want, error::panic);
+
+        ErrorRecorder err;
+        String got = os::read_file(name, err);
+        if (err || got != want) {
+            t.errorf("read_file of %d bytes: got %d bytes, err %v", n, len(got), err);
+        }
+        // one allocation sized from the file
+        if (got.cap() != std::max(n + 1, 512)) {
+            t.errorf("read_file of %d bytes: cap %d", n, got.cap());
+        }
+
+        os::MappedFile m = os::map_file(name, err);
+        if (err || m.data != want) {
+            t.errorf("map_file of %d bytes: got %d bytes, err %v", n, len(m.data), err);
+        }
+    }
+
+    // files in /proc claim size 0
+    String status = os::read_file("/proc/self/status", error::panic);
+    if (len(status) == 0) {
+        t.errorf("read_file(/proc/self/status) is empty");
+    }
+
+    ErrorRecorder err;
+    os::read_file(join(dir, "missing"), err);
+    if (!err) {
+        t.errorf("read_file of missing file succeeded");
+    }
+
+    nftw(tmpl, remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+}
+
+void test_write_file_atomic(T &t) {
+    char tmpl[] = "/tmp/baselib-file-test-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        t.fatalf("mkdtemp failed");
+    }
+    String dir = str(tmpl, strlen(tmpl));
+    String name = join(dir, "config");
+
+    os::write_file(name, "old contents", error::panic);
+    os::write_file_atomic(name, "new", error::panic);
+    if (os::read_file(name, error::panic) != "new") {
+        t.errorf("write_file_atomic did not replace the file");
+    }
+
+    std::vector<String> names;
+    std::vector<String> datas;
+    for (int i = 0; i < 50; i++) {
+        names.push_back(join(dir, String(fmt::sprintf("f%d", i))));
+        datas.push_back(fmt::sprintf("data %d", i));
+    }
+    std::vector<os::AtomicWrite> batch;
+    for (int i = 0; i < 50; i++) {
+        batch.push_back({names[i], datas[i]});
+    }
+    os::write_files_atomic(batch, {.perm = 0600}, error::panic);
+
+    for (int i = 0; i < 50; i++) {
+        String got = os::read_file(names[i], error::panic);
+        if (got != datas[i]) {
+            t.errorf("%s = %q; want %q", names[i], got, datas[i]);
+        }
+    }
+
+    // a write into a missing directory fails the whole batch
+    String bad = join(dir, "missing/x");
+    batch[0].data = "changed";
+    batch.push_back({bad, "x"});
+    ErrorRecorder err;
+    os::write_files_atomic(batch, err);
+    if (!err) {
+        t.errorf("write_files_atomic into missing directory succeeded");
+    }
+    if (os::read_file(names[0], error::panic) != datas[0]) {
+        t.errorf("failed batch replaced %s", names[0]);
+    }
+
+    // no temporary files are left behind
+    std::vector<fs::DirEntry> entries = os::read_dir(dir, error::panic);
+    if (entries.size() != 51) {
+        t.errorf("directory has %d entries; want 51", int(entries.size()));
+    }
+
+    nftw(tmpl, remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+}
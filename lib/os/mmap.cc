@@ -0,0 +1,66 @@
+#include "mmap.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace lib;
+using namespace os;
+
+os::MappedFile::MappedFile(MappedFile &&other) : data(other.data) {
+    other.data = {};
+}
+
+MappedFile& os::MappedFile::operator=(MappedFile &&other) {
+    if (this != &other) {
+        this->~MappedFile();
+        data = other.data;
+        other.data = {};
+    }
+    return *this;
+}
+
+os::MappedFile::~MappedFile() {
+    if (len(data) > 0) {
+        munmap((void *) data.data, usize(data.len));
+    }
+    data = {};
+}
+
+MappedFile os::map_file(str name, error err) {
+    MappedFile m;
+
+retry:
+    int fd = ::open(CString(name), O_RDONLY|O_CLOEXEC);
+    if (fd == -1) {
+        if (errno == EINTR) {
+            goto retry;
+        }
+        err(PathError("open", name, Errno(errno)));
+        return m;
+    }
+
+    struct ::stat st;
+    if (::fstat(fd, &st) == -1) {
+        err(PathError("stat", name, Errno(errno)));
+        ::close(fd);
+        return m;
+    }
+
+    // mmap rejects a zero length; an empty file maps to an empty str
+    if (st.st_size > 0) {
+        void *p = ::mmap(nil, usize(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            err(PathError("mmap", name, Errno(errno)));
+        } else {
+            // the whole file is usually read front to back
+            ::madvise(p, usize(st.st_size), MADV_SEQUENTIAL);
+            m.data = str((const char *) p, size(st.st_size));
+        }
+    }
+
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    return m;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "lib/base.h"
+#include "error.h"
+
+namespace lib::os {
+
+    // MappedFile is a read-only mapping of a whole file into memory. The
+    // mapping is removed when the MappedFile is destroyed.
+    struct MappedFile {
+        str data;
+
+        MappedFile() = default;
+        MappedFile(MappedFile const&) = delete;
+        MappedFile(MappedFile &&other);
+
+        MappedFile& operator=(MappedFile const&) = delete;
+        MappedFile& operator=(MappedFile &&other);
+
+        ~MappedFile();
+    } ;
+
+    // map_file maps the named file into memory for reading. Unlike
+    // read_file, it neither allocates nor copies, so it suits large files
+    // that are read once or only in parts. Pages are read in on first
+    // access. Changes to the file while it is mapped are visible through
+    // data, and truncating it makes accesses past the new end fault.
+    MappedFile map_file(str name, error err);
+}
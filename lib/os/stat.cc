@@ -1,23 +1,154 @@
 #include "stat.h"
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <thread>
 #include <unistd.h>
 
 #include "error.h"
-#include "lib/os/file.h"
+#include "lib/filepath/path.h"
+#include "lib/sync/go.h"
 
 using namespace lib;
 using namespace os;
 
-// FileInfo os::stat(str path, error err) {
-//     FileInfo fi;
+void os::internal::fill_file_info(FileInfo *fi, str name, StatMask mask) {
+    struct statx const &sx = fi->sys;
+    uint32 want = mask.value & sx.stx_mask;
 
-//     int r = ::stat(path.c_str(), &fi.stat);
-//     if (r) {
-//         err(os::from_errno(errno));
-//         return {};
-//     }
+    fi->name = filepath::base(name);
 
-//     return {};
-// }
\ No newline at end of file
+    if (want & STATX_SIZE) {
+        fi->size = int64(sx.stx_size);
+    }
+
+    if (want & STATX_MTIME) {
+        fi->mod_time = time::unix(int64(sx.stx_mtime.tv_sec), int32(sx.stx_mtime.tv_nsec));
+    }
+
+    if (want & STATX_MODE) {
+        fi->mode = FileMode(sx.stx_mode & 0777);
+        if (sx.stx_mode & S_ISGID) {
+            fi->mode = fi->mode | ModeSetgid;
+        }
+        if (sx.stx_mode & S_ISUID) {
+            fi->mode = fi->mode | ModeSetuid;
+        }
+        if (sx.stx_mode & S_ISVTX) {
+            fi->mode = fi->mode | ModeSticky;
+        }
+    }
+
+    if (want & STATX_TYPE) {
+        switch (sx.stx_mode & S_IFMT) {
+            case S_IFBLK:  fi->mode = fi->mode | ModeDevice; break;
+            case S_IFCHR:  fi->mode = fi->mode | ModeDevice | ModeCharDevice; break;
+            case S_IFDIR:  fi->mode = fi->mode | ModeDir; break;
+            case S_IFIFO:  fi->mode = fi->mode | ModeNamedPipe; break;
+            case S_IFLNK:  fi->mode = fi->mode | ModeSymlink; break;
+            case S_IFREG:  /* do nothing */; break;
+            case S_IFSOCK: fi->mode = fi->mode | ModeSocket; break;
+        }
+        fi->is_dir = S_ISDIR(sx.stx_mode);
+    }
+}
+
+// do_statx runs statx on path and returns 0 or the errno.
+static int do_statx(str path, int flags, StatMask mask, FileInfo *fi) {
+    // paths are usually short: avoid the CString allocation
+    char stackbuf[256];
+    CString heapbuf;
+    const char *cpath;
+    if (len(path) < size(sizeof stackbuf)) {
+        memcpy(stackbuf, path.data, path.len);
+        stackbuf[len(path)] = '\0';
+        cpath = stackbuf;
+    } else {
+        heapbuf = path;
+        cpath = heapbuf;
+    }
+
+retry:
+    int r = ::statx(AT_FDCWD, cpath, flags, mask.value, &fi->sys);
+    if (r == -1) {
+        if (errno == EINTR) {
+            goto retry;
+        }
+        return errno;
+    }
+
+    internal::fill_file_info(fi, path, mask);
+    return 0;
+}
+
+FileInfo os::stat(str path, error err) {
+    return stat(path, StatAll, err);
+}
+
+FileInfo os::stat(str path, StatMask mask, error err) {
+    FileInfo fi;
+    int code = do_statx(path, 0, mask, &fi);
+    if (code != 0) {
+        err(PathError("stat", path, Errno(code)));
+    }
+    return fi;
+}
+
+FileInfo os::lstat(str path, error err) {
+    return lstat(path, StatAll, err);
+}
+
+FileInfo os::lstat(str path, StatMask mask, error err) {
+    FileInfo fi;
+    int code = do_statx(path, AT_SYMLINK_NOFOLLOW, mask, &fi);
+    if (code != 0) {
+        err(PathError("lstat", path, Errno(code)));
+    }
+    return fi;
+}
+
+std::vector<StatResult> os::stat_many(view<str> paths) {
+    return stat_many(paths, StatAll);
+}
+
+std::vector<StatResult> os::stat_many(view<str> paths, StatMask mask) {
+    // Below this many paths per thread, starting threads costs more than the
+    // syscalls it would overlap.
+    constexpr size PerThread = 256;
+    // Paths are handed out in chunks so threads don't contend on the counter.
+    constexpr size Chunk = 64;
+
+    std::vector<StatResult> results(len(paths));
+
+    std::atomic<size> next = 0;
+    auto work = [&] {
+        for (;;) {
+            size start = next.fetch_add(Chunk);
+            if (start >= len(paths)) {
+                return;
+            }
+            size end = std::min(start + Chunk, len(paths));
+            for (size i = start; i < end; i++) {
+                results[i].code = do_statx(paths[i], 0, mask, &results[i].info);
+            }
+        }
+    };
+
+    size nthreads = std::min(size(std::thread::hardware_concurrency()), len(paths) / PerThread);
+
+    std::deque<sync::go> threads;
+    for (size i = 1; i < nthreads; i++) {
+        threads.emplace_back(work);
+    }
+    work();
+
+    for (sync::go &g : threads) {
+        g.join();
+    }
+
+    return results;
+}
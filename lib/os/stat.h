@@ -1,9 +1,53 @@
 #pragma once
 
+#include <vector>
+
 #include "types.h"
 #include "lib/fs/fs.h"
 
 
 namespace lib::os {
-    // FileInfo stat(str path, error&);
-}
\ No newline at end of file
+
+    // StatMask selects the fields filled in by stat. Asking only for what is
+    // needed lets the kernel skip work, e.g. attributes that a network
+    // filesystem would otherwise have to fetch. Fields that were not
+    // requested are left zero.
+    struct StatMask : bitflag<uint32> {
+        using bitflag::bitflag;
+    } const
+        StatType    = STATX_TYPE,                // mode type bits and is_dir
+        StatMode    = STATX_TYPE | STATX_MODE,   // full mode
+        StatSize    = STATX_SIZE,                // size
+        StatModTime = STATX_MTIME,               // mod_time
+        StatAll     = STATX_BASIC_STATS;         // everything in struct stat
+
+    // stat returns a FileInfo describing the named file, following symbolic
+    // links. The name in the result is a view into path, so path must outlive
+    // it.
+    FileInfo stat(str path, error err);
+    FileInfo stat(str path, StatMask mask, error err);
+
+    // lstat is like stat, but if the file is a symbolic link the result
+    // describes the link itself.
+    FileInfo lstat(str path, error err);
+    FileInfo lstat(str path, StatMask mask, error err);
+
+    struct StatResult {
+        FileInfo info;
+        int      code = 0;  // errno from statx; 0 on success
+
+        explicit operator bool() const { return code == 0; }
+    } ;
+
+    // stat_many stats every path, running the calls on several threads for
+    // large batches. results[i] describes paths[i]; a path that could not be
+    // stat'ed (typically because it does not exist) has a non-zero code
+    // rather than being reported as an error.
+    std::vector<StatResult> stat_many(view<str> paths, StatMask mask);
+    std::vector<StatResult> stat_many(view<str> paths);
+
+    namespace internal {
+        // fill_file_info fills fi from the fields of fi->sys selected by mask.
+        void fill_file_info(FileInfo *fi, str name, StatMask mask);
+    }
+}
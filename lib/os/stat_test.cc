@@ -0,0 +1,128 @@
+#include "stat.h"
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file.h"
+#include "lib/fmt/fmt.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+static int remove_entry(const char *path, const struct stat *, int, struct FTW *) {
+    return ::remove(path);
+}
+
+static String join(str dir, str name) {
+    String p = dir;
+    p += '/';
+    p += name;
+    return p;
+}
+
+void test_stat(T &t) {
+    char tmpl[] = "/tmp/baselib-stat-test-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        t.fatalf("mkdtemp failed");
+    }
+    String dir = str(tmpl, strlen(tmpl));
+    String file = join(dir, "file.txt");
+    String link = join(dir, "link");
+
+    os::write_file(file, "hello", error::panic);
+    symlink("file.txt", CString(link));
+
+    ErrorRecorder err;
+    os::FileInfo fi = os::stat(file, err);
+    if (err) {
+        t.fatalf("stat: %v", err);
+    }
+    if (fi.name != "file.txt") {
+        t.errorf("name = %q; want %q", fi.name, "file.txt");
+    }
+    if (fi.name.data != str(file).data + len(file) - len(fi.name)) {
+        t.errorf("name is not a view into the path");
+    }
+    if (fi.size != 5) {
+        t.errorf("size = %d; want 5", fi.size);
+    }
+    if (fi.is_dir || fi.mode.value & os::ModeType.value) {
+        t.errorf("regular file has mode %#x", fi.mode.value);
+    }
+    if (fi.mod_time.nsecs == 0) {
+        t.errorf("mod_time not set");
+    }
+
+    // stat follows the link, lstat does not
+    fi = os::stat(link, err);
+    if (err || fi.size != 5) {
+        t.errorf("stat(link): size %d, err %v", fi.size, err);
+    }
+    fi = os::lstat(link, err);
+    if (err || !(fi.mode.value & os::ModeSymlink.value)) {
+        t.errorf("lstat(link): mode %#x, err %v", fi.mode.value, err);
+    }
+
+    fi = os::stat(dir, os::StatType, err);
+    if (err || !fi.is_dir) {
+        t.errorf("stat(dir): is_dir %v, err %v", fi.is_dir, err);
+    }
+
+    // fields that were not asked for stay zero
+    fi = os::stat(file, os::StatType, err);
+    if (fi.size != 0 || fi.mod_time.nsecs != 0) {
+        t.errorf("StatType filled size %d", fi.size);
+    }
+
+    os::stat(join(dir, "missing"), err);
+    if (!err) {
+        t.errorf("stat of missing file succeeded");
+    }
+
+    nftw(tmpl, remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+}
+
+void test_stat_many(T &t) {
+    char tmpl[] = "/tmp/baselib-stat-test-XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        t.fatalf("mkdtemp failed");
+    }
+    String dir = str(tmpl, strlen(tmpl));
+
+    // enough paths to be spread over several threads
+    const int n = 2000;
+    std::vector<String> names;
+    for (int i = 0; i < n; i++) {
+        names.push_back(join(dir, String(fmt::sprintf("f%d", i))));
+        // every third file is missing
+        if (i % 3 != 0) {
+            os::write_file(names.back(), String(fmt::sprintf("%*s", i, "")), error::panic);
+        }
+    }
+
+    std::vector<str> paths(names.begin(), names.end());
+    std::vector<os::StatResult> results = os::stat_many(paths, os::StatSize);
+    if (results.size() != paths.size()) {
+        t.fatalf("stat_many returned %d results; want %d", int(results.size()), n);
+    }
+
+    for (int i = 0; i < n; i++) {
+        os::StatResult const &r = results[i];
+        if (i % 3 == 0) {
+            if (r.code != ENOENT) {
+                t.errorf("%s: code = %d; want ENOENT", paths[i], r.code);
+            }
+            continue;
+        }
+        if (!r) {
+            t.errorf("%s: code = %d", paths[i], r.code);
+        } else if (r.info.size != i) {
+            t.errorf("%s: size = %d; want %d", paths[i], r.info.size, i);
+        }
+    }
+
+    nftw(tmpl, remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+}
@@ -101,14 +101,48 @@
 #undef STRUCT_DECL
 
 namespace lib::os {
+    // BufferMode says when a StdStream passes buffered output on to the
+    // operating system.
+    enum class BufferMode {
+        Auto,   // Line if the stream is a terminal, Block otherwise
+        None,   // every write goes straight through
+        Line,   // the buffer is written out by any write containing a newline
+        Block,  // the buffer is written out when it fills up
+    };
+
+    namespace internal {
+        struct StdBuffer;
+    }
+
     struct StdStream : io::ReaderWriter {
         FILE *file;
         int fd;
+        internal::StdBuffer *out = nil;
   
         constexpr StdStream(FILE* file, int fd) : file(file), fd(fd) {}
+        constexpr StdStream(FILE* file, int fd, internal::StdBuffer *out) : file(file), fd(fd), out(out) {}
   
         io::ReadResult direct_read(buf bytes, error err) override;
         size           direct_write(str data, error err) override;
+
+        // set_buffer_mode sets how output is buffered, writing out anything
+        // already buffered first. A bufsize of 0 keeps the current size,
+        // initially 64 KB. Only os::stdout and os::stderr can be buffered;
+        // by default stdout is Auto and stderr is None. Buffered output is
+        // written out at exit, by panic and on std::terminate, but not if
+        // the program calls abort itself.
+        void set_buffer_mode(BufferMode mode, size bufsize = 0);
+
+        // start_flusher starts a thread that does all writes for the stream,
+        // so that writers only copy into the buffer and wait only when it is
+        // full. The thread writes out whatever has been buffered as soon as
+        // it can, regardless of the mode, so a slow terminal or pipe makes
+        // its writes larger rather than blocking the program.
+        void start_flusher();
+
+        // sync writes out everything buffered and reports any error from an
+        // earlier background write.
+        void sync(error err);
     };
 
     extern os::StdStream stdout;
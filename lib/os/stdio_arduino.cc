@@ -63,4 +63,9 @@ io::ReadResult os::StdStream::direct_read(buf bytes, error err) {
     return len(data);
  }
 
+// Output goes to the serial port unbuffered.
+void os::StdStream::set_buffer_mode(BufferMode, size) {}
+void os::StdStream::start_flusher() {}
+void os::StdStream::sync(error) {}
+
  #endif
\ No newline at end of file
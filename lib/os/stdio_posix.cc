@@ -1,55 +1,276 @@
 // StdStream
 
 #include "stdio.h"
+#include "lib/io/pool.h"
 #include "lib/io/util.h"
+#include "lib/sync/cond.h"
+#include "lib/sync/go.h"
+#include "lib/sync/lock.h"
+#include "lib/sync/mutex.h"
+#include <atomic>
+#include <exception>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 using namespace lib;
 using namespace os;
 
+// StdBuffer is the output buffer of a StdStream. Writers append to data under
+// mtx; the bytes are passed to write(2) either by the writer itself or, once
+// a flusher is running, by the flusher thread, which swaps data with spare so
+// that writers can keep appending while it writes.
+struct os::internal::StdBuffer {
+    sync::Mutex mtx;
+    sync::Cond  work;   // the flusher waits here for output
+    sync::Cond  space;  // writers and sync wait here for the flusher
+
+    BufferMode mode;
+    size       bufsize = 64 * 1024;
+
+    byte *data  = nil;
+    size  len   = 0;
+    byte *spare = nil;
+
+    bool flusher = false;
+    bool writing = false;  // the flusher is writing out spare
+    int  code    = 0;      // errno of a failed background write
+
+    constexpr StdBuffer(BufferMode mode) : mode(mode) {}
+} ;
+
+static internal::StdBuffer stdout_buffer(BufferMode::Auto);
+static internal::StdBuffer stderr_buffer(BufferMode::None);
+
 StdStream os::stdin(::stdin, 0);
-StdStream os::stdout(::stdout, 1);
-StdStream os::stderr(::stderr, 2);
+StdStream os::stdout(::stdout, 1, &stdout_buffer);
+StdStream os::stderr(::stderr, 2, &stderr_buffer);
+
+static str fd_name(int fd) {
+    switch (fd) {
+        case 0:  return "/dev/stdin";
+        case 1:  return "/dev/stdout";
+        case 2:  return "/dev/stderr";
+        default: return "/dev/fd";
+    }
+}
+
+// write_all writes all of data to fd and returns 0 or the errno.
+static int write_all(int fd, str data) {
+    while (len(data) > 0) {
+        ssize_t n = ::write(fd, data.data, data.len);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        data = data(n);
+    }
+    return 0;
+}
+
+static void sync_at_exit() {
+    os::stdout.sync(error::ignore);
+    os::stderr.sync(error::ignore);
+}
+
+// an uncaught exception aborts without running atexit handlers
+static std::terminate_handler next_terminate = nil;
+
+static void sync_at_terminate() {
+    sync_at_exit();
+    if (next_terminate) {
+        next_terminate();
+    }
+    std::abort();
+}
+
+// prepare resolves the Auto mode and allocates the buffer. b.mtx is held.
+static void prepare(internal::StdBuffer &b, int fd) {
+    if (b.mode == BufferMode::Auto) {
+        b.mode = ::isatty(fd) ? BufferMode::Line : BufferMode::Block;
+    }
+    if (b.mode == BufferMode::None || b.data) {
+        return;
+    }
+
+    b.data = io::pool::get(b.bufsize);
+
+    static std::atomic<bool> registered = false;
+    if (!registered.exchange(true)) {
+        std::atexit(sync_at_exit);
+        next_terminate = std::set_terminate(sync_at_terminate);
+    }
+}
+
+// drain writes out the buffer from the calling thread and returns 0 or the
+// errno. b.mtx is held, which keeps the output in order.
+static int drain(internal::StdBuffer &b, int fd) {
+    int code = write_all(fd, str(b.data, b.len));
+    b.len = 0;
+    return code;
+}
+
+static void run_flusher(internal::StdBuffer &b, int fd) {
+    sync::Lock lock(b.mtx);
+    for (;;) {
+        while (b.len == 0) {
+            b.work.wait(b.mtx);
+        }
+
+        // hand the full buffer to this thread and let writers fill the other
+        std::swap(b.data, b.spare);
+        size n = b.len;
+        b.len = 0;
+        b.writing = true;
+        b.space.broadcast();
+        lock.unlock();
+
+        int code = write_all(fd, str(b.spare, n));
+
+        lock.relock();
+        b.writing = false;
+        if (code != 0 && b.code == 0) {
+            b.code = code;
+        }
+        b.space.broadcast();
+    }
+}
 
 io::ReadResult os::StdStream::direct_read(buf bytes, error err) {
     size n = size(::fread(bytes.data, 1, usize(len(bytes)), file));
- 
+
      if (n != len(bytes)) {
          if (::ferror(file)) {
              err(io::ErrIO());
              return {n, false};
          }
- 
+
          if (::feof(file)) {
              return {n, true};
          }
     }
- 
+
     return {n, false};
  }
- 
- size os::StdStream::direct_write(str data, error err) {
-    // ::write(1, "<", 1);
-    size n = ::write(fd, data.data, data.len);
-    // ::write(1, ">", 1);
-    // printf("%ld:", len(data));
-    // size n = size(::fwrite(data.data, 1, usize(len(data)), file));
- 
-     if (n != len(data)) {
-        panic("write error");
-        if (::ferror(file)) {
-            err(io::ErrIO());
-            return n;
+
+size os::StdStream::direct_write(str data, error err) {
+    int code = 0;
+
+    if (!this->out) {
+        code = write_all(fd, data);
+    } else {
+        internal::StdBuffer &b = *this->out;
+        sync::Lock lock(b.mtx);
+        prepare(b, fd);
+
+        if (b.flusher) {
+            // wait until the flusher has made room, or for a write larger
+            // than the buffer, until it is idle and the write can go
+            // straight through
+            while (b.len + len(data) > b.bufsize && (b.len > 0 || b.writing)) {
+                b.space.wait(b.mtx);
+            }
+            if (len(data) > b.bufsize) {
+                code = write_all(fd, data);
+            } else {
+                memcpy(b.data + b.len, data.data, usize(len(data)));
+                b.len += len(data);
+                b.work.signal();
+            }
+        } else if (b.mode == BufferMode::None) {
+            code = write_all(fd, data);
+        } else {
+            if (b.len + len(data) > b.bufsize) {
+                code = drain(b, fd);
+            }
+            if (len(data) >= b.bufsize) {
+                if (code == 0) {
+                    code = write_all(fd, data);
+                }
+            } else {
+                memcpy(b.data + b.len, data.data, usize(len(data)));
+                b.len += len(data);
+
+                if (b.mode == BufferMode::Line && memchr(data.data, '\n', usize(len(data)))) {
+                    code = drain(b, fd);
+                }
+            }
         }
+    }
+
+    // report after unlocking, in case the handler prints
+    if (code != 0) {
+        err(PathError("write", fd_name(fd), Errno(code)));
+        return 0;
+    }
+    return len(data);
+}
 
-        if (::feof(file)) {
-            err(io::ErrUnexpectedEOF());
-            return n;
+void os::StdStream::set_buffer_mode(BufferMode mode, size bufsize) {
+    if (!this->out) {
+        return;
+    }
+    this->sync(error::ignore);
+
+    internal::StdBuffer &b = *this->out;
+    sync::Lock lock(b.mtx);
+    // with a flusher running, the buffers stay in use
+    if (bufsize > 0 && bufsize != b.bufsize && !b.flusher) {
+        if (b.data) {
+            io::pool::put(b.data, b.bufsize);
+            b.data = nil;
         }
+        b.bufsize = bufsize;
+    }
+    b.mode = mode;
+    prepare(b, fd);
+}
 
-        err(io::ErrIO());
-        return n;
+void os::StdStream::start_flusher() {
+    if (!this->out) {
+        return;
     }
- 
-    return n;
- }
+
+    internal::StdBuffer &b = *this->out;
+    sync::Lock lock(b.mtx);
+    if (b.flusher) {
+        return;
+    }
+
+    if (b.mode == BufferMode::None) {
+        b.mode = BufferMode::Block;
+    }
+    prepare(b, fd);
+    b.spare = io::pool::get(b.bufsize);
+    b.flusher = true;
+
+    int fd = this->fd;
+    sync::go([&b, fd] { run_flusher(b, fd); }).detach();
+}
+
+void os::StdStream::sync(error err) {
+    if (!this->out) {
+        return;
+    }
+
+    internal::StdBuffer &b = *this->out;
+    int code = 0;
+    {
+        sync::Lock lock(b.mtx);
+        if (b.flusher) {
+            while (b.len > 0 || b.writing) {
+                b.space.wait(b.mtx);
+            }
+            code = b.code;
+            b.code = 0;
+        } else if (b.len > 0) {
+            code = drain(b, fd);
+        }
+    }
+
+    if (code != 0) {
+        err(PathError("write", fd_name(fd), Errno(code)));
+    }
+}
@@ -0,0 +1,78 @@
+#include "stdio.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+// pending returns what can be read from fd without blocking.
+static String pending(int fd) {
+    String s;
+    char b[4096];
+    for (;;) {
+        ssize_t n = ::read(fd, b, sizeof b);
+        if (n <= 0) {
+            return s;
+        }
+        s += str(b, n);
+    }
+}
+
+void test_stdout_buffering(T &t) {
+    int p[2];
+    if (pipe2(p, O_NONBLOCK) == -1) {
+        t.fatalf("pipe failed");
+    }
+
+    // point fd 1 at the pipe for the duration of the test
+    os::stdout.sync(error::panic);
+    int saved = dup(1);
+    dup2(p[1], 1);
+
+    os::stdout.set_buffer_mode(os::BufferMode::Block, 1024);
+    os::stdout.write("one\n", error::panic);
+    os::stdout.write("two\n", error::panic);
+    String block_before_sync = pending(p[0]);
+    os::stdout.sync(error::panic);
+    String block_after_sync = pending(p[0]);
+
+    os::stdout.set_buffer_mode(os::BufferMode::Line);
+    os::stdout.write("par", error::panic);
+    String line_partial = pending(p[0]);
+    os::stdout.write("tial\n", error::panic);
+    String line_complete = pending(p[0]);
+
+    // a write larger than the buffer goes straight through
+    os::stdout.set_buffer_mode(os::BufferMode::Block);
+    String big;
+    for (int i = 0; i < 2000; i++) {
+        big += 'x';
+    }
+    os::stdout.write(big, error::panic);
+    String big_written = pending(p[0]);
+
+    os::stdout.set_buffer_mode(os::BufferMode::Auto, 64 * 1024);
+    dup2(saved, 1);
+    close(saved);
+    close(p[0]);
+    close(p[1]);
+
+    if (block_before_sync != "") {
+        t.errorf("Block mode wrote %q before sync", block_before_sync);
+    }
+    if (block_after_sync != "one\ntwo\n") {
+        t.errorf("after sync got %q; want %q", block_after_sync, "one\ntwo\n");
+    }
+    if (line_partial != "") {
+        t.errorf("Line mode wrote partial line %q", line_partial);
+    }
+    if (line_complete != "partial\n") {
+        t.errorf("Line mode wrote %q; want %q", line_complete, "partial\n");
+    }
+    if (big_written != big) {
+        t.errorf("large write: got %d bytes; want %d", len(big_written), len(big));
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <fcntl.h>
+#include <sys/stat.h>
 
 #include "lib/fs/fs.h"
 
@@ -11,7 +12,8 @@ namespace lib::os {
     using fs::FileMode;
     
     struct FileInfo : fs::FileInfo {
-        struct ::stat stat;
+        // the raw statx result; only the fields that were asked for are valid
+        struct ::statx sys {};
     };
 
     // The single letters are the abbreviations
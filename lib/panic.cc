@@ -18,18 +18,28 @@
 
 
 #include "lib/panic.h"
+#include "lib/os/stdio.h"
 #include "exceptions.h"
 
 #include <stdio.h>
 
 using namespace lib;
 
+#ifndef __cpp_exceptions
+// abort skips the atexit hook that writes out buffered stdout
+static void sync_stdio() {
+    os::stdout.sync(error::ignore);
+    os::stderr.sync(error::ignore);
+}
+#endif
+
 void lib::panic() {
     #ifdef __cpp_exceptions
         fmt::fprintf(stderr, "call to panic\n");
         throw exceptions::Panic();
     #else
         printf("PANIC\n");
+        sync_stdio();
         abort();
     #endif
 }
@@ -44,6 +54,7 @@ void lib::panic(Error const& e) {
 #else
     //panic(b.str());
     fmt::fprintf(stderr, "panic: %v\n", e);
+    sync_stdio();
     abort();
 #endif
 }
@@ -58,6 +69,7 @@ void lib::panic(str msg) {
     throw ex;
 #else
     fmt::fprintf(stderr, "call to panic with msg %q\n", msg);
+    sync_stdio();
     abort();
 #endif
 }
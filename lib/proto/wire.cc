@@ -0,0 +1,279 @@
+#include "wire.h"
+
+#include "lib/varint/varint.h"
+
+using namespace lib;
+using namespace lib::proto;
+using namespace lib::encoding;
+
+template <typename T>
+bool Decoder::scan_varint(T *v, error err) {
+    if (len(data) == 0) {
+        fail(err, io::ErrUnexpectedEOF());
+        return false;
+    }
+    if (byte(data.data[0]) < 0x80) {
+        *v = byte(data.data[0]);
+        data = data(1);
+        return true;
+    }
+    if (varint::decode_many(&data, std::span<T>(v, 1), err) == 0) {
+        data = {};
+        return false;
+    }
+    return true;
+}
+
+bool Decoder::next(Tag *t, error err) {
+    if (len(data) == 0) {
+        return false;
+    }
+
+    uint64 v = 0;
+    if (!scan_varint(&v, err)) {
+        return false;
+    }
+
+    uint64 num = v >> 3;
+    uint64 type = v & 7;
+    if (num < uint64(MinValidNumber) || num > uint64(MaxValidNumber)) {
+        fail(err, ErrInvalidNumber());
+        return false;
+    }
+    if (type > uint64(Type::Fixed32)) {
+        fail(err, ErrInvalidType());
+        return false;
+    }
+
+    *t = {Number(num), Type(type)};
+    return true;
+}
+
+uint64 Decoder::read_varint(error err) {
+    uint64 v = 0;
+    scan_varint(&v, err);
+    return v;
+}
+
+int64 Decoder::read_sint(error err) {
+    return decode_zigzag(read_varint(err));
+}
+
+uint32 Decoder::read_fixed32(error err) {
+    if (len(data) < 4) {
+        fail(err, io::ErrUnexpectedEOF());
+        return 0;
+    }
+    uint32 v = binary::little_endian::uint32(data);
+    data = data(4);
+    return v;
+}
+
+uint64 Decoder::read_fixed64(error err) {
+    if (len(data) < 8) {
+        fail(err, io::ErrUnexpectedEOF());
+        return 0;
+    }
+    uint64 v = binary::little_endian::uint64(data);
+    data = data(8);
+    return v;
+}
+
+str Decoder::read_bytes(error err) {
+    uint64 n = 0;
+    if (!scan_varint(&n, err)) {
+        return {};
+    }
+    if (n > uint64(len(data))) {
+        fail(err, io::ErrUnexpectedEOF());
+        return {};
+    }
+
+    str b = data.slice(0, size(n));
+    data = data(size(n));
+    return b;
+}
+
+void Decoder::skip(Tag t, error err) {
+    switch (t.type) {
+    case Type::Varint:
+        read_varint(err);
+        break;
+    case Type::Fixed64:
+        read_fixed64(err);
+        break;
+    case Type::Bytes:
+        read_bytes(err);
+        break;
+    case Type::StartGroup:
+        skip_group(t.num, 1, err);
+        break;
+    case Type::EndGroup:
+        fail(err, ErrEndGroup());
+        break;
+    case Type::Fixed32:
+        read_fixed32(err);
+        break;
+    }
+}
+
+void Decoder::skip_group(Number num, int depth, error err) {
+    if (depth > MaxDepth) {
+        fail(err, ErrDepth());
+        return;
+    }
+
+    Tag t;
+    while (next(&t, err)) {
+        if (t.type == Type::EndGroup) {
+            if (t.num != num) {
+                fail(err, ErrEndGroup());
+            }
+            return;
+        }
+        if (t.type == Type::StartGroup) {
+            skip_group(t.num, depth + 1, err);
+        } else {
+            skip(t, err);
+        }
+    }
+
+    if (!err) {
+        // the input ended inside the group
+        fail(err, io::ErrUnexpectedEOF());
+    }
+}
+
+template <typename T>
+void Decoder::read_packed(Tag t, std::vector<T> &out, error err) {
+    if (t.type == Type::Varint) {
+        T v = 0;
+        scan_varint(&v, err);
+        out.push_back(v);
+        return;
+    }
+    if (t.type != Type::Bytes) {
+        fail(err, ErrInvalidType());
+        return;
+    }
+
+    str b = read_bytes(err);
+
+    // each varint ends in the one byte without the continuation bit, so
+    // out can be sized before decoding
+    size n = 0;
+    for (char c : b) {
+        n += byte(c) < 0x80;
+    }
+
+    size k = size(out.size());
+    out.resize(k + n);
+    size m = varint::decode_many(&b, std::span<T>(out).subspan(k), err);
+    out.resize(k + m);
+
+    if (m < n) {
+        // reported by decode_many
+        data = {};
+    } else if (len(b) > 0) {
+        // the last varint is cut off
+        fail(err, io::ErrUnexpectedEOF());
+    }
+}
+
+void Decoder::read_varints(Tag t, std::vector<uint64> &out, error err) {
+    read_packed(t, out, err);
+}
+
+void Decoder::read_varints(Tag t, std::vector<uint32> &out, error err) {
+    read_packed(t, out, err);
+}
+
+void Encoder::tag(Number num, Type type) {
+    put_varint(uint64(num) << 3 | uint64(type));
+}
+
+void Encoder::put_varint(uint64 v) {
+    if (sizing) {
+        total += size_varint(v);
+        return;
+    }
+    varint::write_uint64(*out, v, err);
+}
+
+void Encoder::put_fixed32(uint32 v) {
+    if (sizing) {
+        total += 4;
+        return;
+    }
+    byte b[4];
+    binary::little_endian::put_uint32(b, v);
+    out->write(str(b, 4), err);
+}
+
+void Encoder::put_fixed64(uint64 v) {
+    if (sizing) {
+        total += 8;
+        return;
+    }
+    byte b[8];
+    binary::little_endian::put_uint64(b, v);
+    out->write(str(b, 8), err);
+}
+
+void Encoder::varint(Number num, uint64 v) {
+    tag(num, Type::Varint);
+    put_varint(v);
+}
+
+void Encoder::sint(Number num, int64 v) {
+    varint(num, encode_zigzag(v));
+}
+
+void Encoder::fixed32(Number num, uint32 v) {
+    tag(num, Type::Fixed32);
+    put_fixed32(v);
+}
+
+void Encoder::fixed64(Number num, uint64 v) {
+    tag(num, Type::Fixed64);
+    put_fixed64(v);
+}
+
+void Encoder::bytes(Number num, str v) {
+    tag(num, Type::Bytes);
+    put_varint(uint64(len(v)));
+    if (sizing) {
+        total += len(v);
+        return;
+    }
+    out->write(v, err);
+}
+
+template <typename T>
+void Encoder::packed_varints(Number num, std::span<const T> vs) {
+    if (vs.empty()) {
+        return;
+    }
+
+    if (sizing) {
+        size n = 0;
+        for (T v : vs) {
+            n += size_varint(v);
+        }
+        sizes.push_back(n);
+        total += size_tag(num) + size_bytes(n);
+        return;
+    }
+
+    tag(num, Type::Bytes);
+    put_varint(uint64(sizes[next_size++]));
+    varint::write_many(*out, vs, err);
+}
+
+void Encoder::varints(Number num, std::span<const uint64> vs) {
+    packed_varints(num, vs);
+}
+
+void Encoder::varints(Number num, std::span<const uint32> vs) {
+    packed_varints(num, vs);
+}
@@ -0,0 +1,309 @@
+#pragma once
+
+#include <bit>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "lib/encoding/binary/binary.h"
+#include "lib/io/io.h"
+#include "lib/io/util.h"
+
+// Package proto reads and writes the Protocol Buffers wire format, without
+// schemas or generated code: a message is a sequence of fields, each a tag
+// (field number and wire type) followed by a value.
+//
+// A Decoder reads the fields of a message in memory, returning bytes and
+// submessages as views of the input:
+//
+//     proto::Decoder d(data);
+//     proto::Tag t;
+//     while (d.next(&t, err)) {
+//         if (t.num == 1 && t.type == proto::Type::Varint) {
+//             id = d.read_varint(err);
+//         } else if (t.num == 2 && t.type == proto::Type::Bytes) {
+//             name = d.read_bytes(err);
+//         } else {
+//             d.skip(t, err);
+//         }
+//     }
+//
+// marshal writes a message; see Encoder.
+namespace lib::proto {
+
+    // Number is a field number.
+    using Number = int32;
+
+    const Number MinValidNumber = 1;
+    const Number MaxValidNumber = (1 << 29) - 1;
+
+    // Type is a wire type: how a field's value is encoded.
+    enum class Type : uint8 {
+        Varint     = 0,
+        Fixed64    = 1,
+        Bytes      = 2,
+        StartGroup = 3,
+        EndGroup   = 4,
+        Fixed32    = 5,
+    } ;
+
+    struct Tag {
+        Number num  = 0;
+        Type   type = Type::Varint;
+    } ;
+
+    struct ErrInvalidNumber : ErrorBase<ErrInvalidNumber, "proto: invalid field number"> {};
+    struct ErrInvalidType : ErrorBase<ErrInvalidType, "proto: invalid wire type"> {};
+    struct ErrEndGroup : ErrorBase<ErrEndGroup, "proto: mismatching end group marker"> {};
+    struct ErrDepth : ErrorBase<ErrDepth, "proto: exceeded maximum recursion depth"> {};
+
+    // MaxDepth is the deepest nesting of groups that skip accepts.
+    const int MaxDepth = 100;
+
+    // encode_zigzag and decode_zigzag map signed integers to unsigned ones
+    // so that small magnitudes have short varints, as sint32 and sint64
+    // fields do.
+    inline uint64 encode_zigzag(int64 v) {
+        return uint64(v << 1) ^ uint64(v >> 63);
+    }
+
+    inline int64 decode_zigzag(uint64 v) {
+        return int64(v >> 1) ^ -int64(v & 1);
+    }
+
+    // size_varint, size_tag and size_bytes return the encoded sizes of a
+    // varint, a tag and a length-prefixed value of n bytes.
+    inline size size_varint(uint64 v) {
+        return encoding::binary::uvarint_len(v);
+    }
+
+    inline size size_tag(Number num) {
+        return size_varint(uint64(num) << 3);
+    }
+
+    inline size size_bytes(size n) {
+        return size_varint(uint64(n)) + n;
+    }
+
+    // Decoder reads the fields of an encoded message. Errors are reported
+    // through the err of each call, after which the Decoder has no more
+    // input.
+    //
+    // The read functions don't check the wire type: having read a tag with
+    // next, the caller either reads the value it expects for that type or
+    // skips it.
+    struct Decoder {
+        explicit Decoder(str data) : data(data) {}
+
+        // next reads the tag of the next field into *t. It returns false at
+        // the end of the input or on error.
+        bool next(Tag *t, error err);
+
+        uint64 read_varint(error err);
+        int64  read_sint(error err);
+        uint32 read_fixed32(error err);
+        uint64 read_fixed64(error err);
+
+        // read_bytes reads a length-prefixed value and returns it as a view
+        // of the input.
+        str read_bytes(error err);
+
+        // read_message reads a submessage and returns a Decoder for it.
+        Decoder read_message(error err) {
+            return Decoder(read_bytes(err));
+        }
+
+        // skip skips the value of a field whose tag was t, including a whole
+        // group.
+        void skip(Tag t, error err);
+
+        // read_varints appends the values of a repeated varint field to out,
+        // whether the field is packed, with t.type Bytes, or a single
+        // element. Packed values are decoded with varint::decode_many.
+        void read_varints(Tag t, std::vector<uint64> &out, error err);
+        void read_varints(Tag t, std::vector<uint32> &out, error err);
+
+        // read_fixed appends the values of a repeated fixed32 (for 4-byte T)
+        // or fixed64 (for 8-byte T) field to out. Packed values are copied
+        // with one memcpy on little-endian machines.
+        template <typename T>
+        void read_fixed(Tag t, std::vector<T> &out, error err) {
+            static_assert(sizeof(T) == 4 || sizeof(T) == 8, "proto: fixed values are 4 or 8 bytes");
+
+            if (t.type == (sizeof(T) == 4 ? Type::Fixed32 : Type::Fixed64)) {
+                if constexpr (sizeof(T) == 4) {
+                    out.push_back(std::bit_cast<T>(read_fixed32(err)));
+                } else {
+                    out.push_back(std::bit_cast<T>(read_fixed64(err)));
+                }
+                return;
+            }
+            if (t.type != Type::Bytes) {
+                fail(err, ErrInvalidType());
+                return;
+            }
+
+            str b = read_bytes(err);
+            if (len(b) % size(sizeof(T)) != 0) {
+                fail(err, io::ErrUnexpectedEOF());
+                return;
+            }
+            size k = size(out.size());
+            size n = len(b) / size(sizeof(T));
+            out.resize(k + n);
+            if constexpr (std::endian::native == std::endian::little) {
+                std::memcpy(out.data() + k, b.data, len(b));
+            } else {
+                for (size i = 0; i < n; i++) {
+                    if constexpr (sizeof(T) == 4) {
+                        out[k + i] = std::bit_cast<T>(encoding::binary::little_endian::uint32(b.slice(4*i)));
+                    } else {
+                        out[k + i] = std::bit_cast<T>(encoding::binary::little_endian::uint64(b.slice(8*i)));
+                    }
+                }
+            }
+        }
+
+        // rest returns the unread input.
+        str rest() const {
+            return data;
+        }
+
+      private:
+        str data;
+
+        template <typename E>
+        void fail(error err, E &&e) {
+            data = {};
+            err(e);
+        }
+
+        template <typename T>
+        bool scan_varint(T *v, error err);
+
+        template <typename T>
+        void read_packed(Tag t, std::vector<T> &out, error err);
+
+        void skip_group(Number num, int depth, error err);
+    } ;
+
+    // Encoder writes the fields of a message to out.
+    //
+    // A submessage is written by a function that writes its fields. Its
+    // length comes before it, so marshal calls the message function twice:
+    // first to measure every submessage, in the order they occur, and then
+    // to write them, each with its length known. Nothing is buffered or
+    // moved. The function must write the same fields both times.
+    //
+    //     proto::marshal(out, [&](proto::Encoder &e) {
+    //         e.varint(1, id);
+    //         e.bytes(2, name);
+    //         e.message(3, [&](proto::Encoder &e) {
+    //             e.varints(1, scores);
+    //         });
+    //     }, err);
+    //
+    // Errors are reported through the err given to marshal.
+    struct Encoder {
+        void varint(Number num, uint64 v);
+        void sint(Number num, int64 v);
+        void fixed32(Number num, uint32 v);
+        void fixed64(Number num, uint64 v);
+        void bytes(Number num, str v);
+
+        // varints and fixed write packed repeated fields.
+        void varints(Number num, std::span<const uint64> vs);
+        void varints(Number num, std::span<const uint32> vs);
+
+        template <typename T>
+        void fixed(Number num, std::span<const T> vs) {
+            static_assert(sizeof(T) == 4 || sizeof(T) == 8, "proto: fixed values are 4 or 8 bytes");
+            if (vs.empty()) {
+                return;
+            }
+            size n = size(vs.size() * sizeof(T));
+            tag(num, Type::Bytes);
+            put_varint(uint64(n));
+            if (sizing) {
+                total += n;
+            } else if constexpr (std::endian::native == std::endian::little) {
+                out->write(str((const char*) vs.data(), n), err);
+            } else {
+                for (T v : vs) {
+                    if constexpr (sizeof(T) == 4) {
+                        put_fixed32(std::bit_cast<uint32>(v));
+                    } else {
+                        put_fixed64(std::bit_cast<uint64>(v));
+                    }
+                }
+            }
+        }
+
+        // message writes a submessage whose fields fn(Encoder&) writes.
+        template <typename Fn>
+        void message(Number num, Fn &&fn) {
+            if (sizing) {
+                size i = size(sizes.size());
+                sizes.push_back(0);
+                size start = total;
+                fn(*this);
+                sizes[i] = total - start;
+                total += size_tag(num) + size_varint(uint64(sizes[i]));
+                return;
+            }
+
+            tag(num, Type::Bytes);
+            put_varint(uint64(sizes[next_size++]));
+            fn(*this);
+        }
+
+      private:
+        io::Writer *out;
+        error       err;
+
+        // In the sizing pass nothing is written: total counts the bytes,
+        // and sizes records the size of each submessage and packed varint
+        // field, for the writing pass to take in the same order.
+        bool              sizing = true;
+        size              total  = 0;
+        std::vector<size> sizes;
+        size              next_size = 0;
+
+        Encoder(io::Writer *out, error err) : out(out), err(err) {}
+
+        void tag(Number num, Type type);
+        void put_varint(uint64 v);
+        void put_fixed32(uint32 v);
+        void put_fixed64(uint64 v);
+
+        template <typename T>
+        void packed_varints(Number num, std::span<const T> vs);
+
+        template <typename Fn>
+        friend void marshal(io::Writer &out, Fn &&fn, error err);
+
+        template <typename Fn>
+        friend size encoded_size(Fn &&fn);
+    } ;
+
+    // marshal writes to out the message whose fields fn(Encoder&) writes.
+    template <typename Fn>
+    void marshal(io::Writer &out, Fn &&fn, error err) {
+        Encoder e(&out, err);
+        fn(e);
+
+        e.sizing = false;
+        fn(e);
+    }
+
+    // encoded_size returns the size of the message whose fields
+    // fn(Encoder&) writes.
+    template <typename Fn>
+    size encoded_size(Fn &&fn) {
+        // nothing is reported while sizing
+        IgnoringError ignore = error::ignore;
+        Encoder e(nil, ignore);
+        fn(e);
+        return e.total;
+    }
+}
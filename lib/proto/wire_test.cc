@@ -0,0 +1,278 @@
+#include "wire.h"
+
+#include <vector>
+
+#include "lib/fmt/fmt.h"
+#include "lib/testing/benchmark.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+namespace {
+    struct Inner {
+        uint64              id = 0;
+        std::vector<uint32> scores;
+    } ;
+
+    struct Outer {
+        int64               delta = 0;
+        String              name;
+        uint32              crc = 0;
+        std::vector<float64> weights;
+        std::vector<Inner>  items;
+    } ;
+
+    void write_inner(proto::Encoder &e, Inner const &in) {
+        e.varint(1, in.id);
+        e.varints(2, in.scores);
+    }
+
+    void write_outer(proto::Encoder &e, Outer const &m) {
+        e.sint(1, m.delta);
+        e.bytes(2, m.name);
+        e.fixed32(3, m.crc);
+        e.fixed<float64>(4, m.weights);
+        for (Inner const &in : m.items) {
+            e.message(5, [&](proto::Encoder &e) {
+                write_inner(e, in);
+            });
+        }
+    }
+
+    Inner read_inner(proto::Decoder d, error err) {
+        Inner in;
+        proto::Tag t;
+        while (d.next(&t, err)) {
+            if (t.num == 1 && t.type == proto::Type::Varint) {
+                in.id = d.read_varint(err);
+            } else if (t.num == 2) {
+                d.read_varints(t, in.scores, err);
+            } else {
+                d.skip(t, err);
+            }
+        }
+        return in;
+    }
+
+    Outer read_outer(str data, error err) {
+        Outer m;
+        proto::Decoder d(data);
+        proto::Tag t;
+        while (d.next(&t, err)) {
+            switch (t.num) {
+            case 1:
+                m.delta = d.read_sint(err);
+                break;
+            case 2:
+                m.name = d.read_bytes(err);
+                break;
+            case 3:
+                m.crc = d.read_fixed32(err);
+                break;
+            case 4:
+                d.read_fixed(t, m.weights, err);
+                break;
+            case 5:
+                m.items.push_back(read_inner(d.read_message(err), err));
+                break;
+            default:
+                d.skip(t, err);
+            }
+        }
+        return m;
+    }
+
+    Outer example() {
+        Outer m;
+        m.delta = -300;
+        m.name = "a message";
+        m.crc = 0xDEADBEEF;
+        m.weights = {0.5, -1.25, 1e100};
+        for (uint64 i = 0; i < 20; i++) {
+            Inner in;
+            in.id = i << (i * 3);
+            for (uint32 j = 0; j < i * 7; j++) {
+                in.scores.push_back(j * j * j);
+            }
+            m.items.push_back(in);
+        }
+        return m;
+    }
+}
+
+void test_marshal(T &t) {
+    // the example from the encoding guide: 150 in field 1, "testing" in
+    // field 2 and a submessage holding 150 in field 3
+    io::Buffer out;
+    proto::marshal(out, [&](proto::Encoder &e) {
+        e.varint(1, 150);
+        e.bytes(2, "testing");
+        e.message(3, [&](proto::Encoder &e) {
+            e.varint(1, 150);
+        });
+    }, error::panic);
+
+    str want = "\x08\x96\x01\x12\x07testing\x1a\x03\x08\x96\x01";
+    if (String got = out.to_string(); got != want) {
+        t.errorf("got %q; want %q", got, want);
+    }
+}
+
+void test_round_trip(T &t) {
+    Outer m = example();
+
+    io::Buffer out;
+    proto::marshal(out, [&](proto::Encoder &e) {
+        write_outer(e, m);
+    }, error::panic);
+    String data = out.to_string();
+
+    size n = proto::encoded_size([&](proto::Encoder &e) {
+        write_outer(e, m);
+    });
+    if (n != len(data)) {
+        t.errorf("encoded_size = %d; marshal wrote %d bytes", n, len(data));
+    }
+
+    Outer got = read_outer(data, error::panic);
+    if (got.delta != m.delta || got.name != m.name || got.crc != m.crc || got.weights != m.weights) {
+        t.errorf("got %d %q %#x; want %d %q %#x", got.delta, got.name, got.crc, m.delta, m.name, m.crc);
+    }
+    if (got.items.size() != m.items.size()) {
+        t.fatalf("got %d items; want %d", got.items.size(), m.items.size());
+    }
+    for (usize i = 0; i < m.items.size(); i++) {
+        if (got.items[i].id != m.items[i].id || got.items[i].scores != m.items[i].scores) {
+            t.errorf("item %d: got id %d with %d scores", i, got.items[i].id, got.items[i].scores.size());
+        }
+    }
+}
+
+void test_zero_copy(T &t) {
+    str data = "\x12\x05hello\x1a\x02\x08\x01";
+    proto::Decoder d(data);
+    proto::Tag tag;
+
+    d.next(&tag, error::panic);
+    str s = d.read_bytes(error::panic);
+    if (s != "hello" || s.data != data.data + 2) {
+        t.errorf("read_bytes = %q, copied", s);
+    }
+
+    d.next(&tag, error::panic);
+    proto::Decoder sub = d.read_message(error::panic);
+    if (sub.rest().data != data.data + 9 || len(d.rest()) != 0) {
+        t.errorf("read_message copied its input");
+    }
+}
+
+void test_read_repeated(T &t) {
+    // field 1 packed, then two more elements unpacked, as a parser must
+    // accept
+    str data = "\x0a\x04\x01\x96\x01\x02\x08\x03\x08\x80\x01";
+    proto::Decoder d(data);
+    proto::Tag tag;
+    std::vector<uint64> got;
+    while (d.next(&tag, error::panic)) {
+        d.read_varints(tag, got, error::panic);
+    }
+
+    std::vector<uint64> want = {1, 150, 2, 3, 128};
+    if (got != want) {
+        t.errorf("got %d values; want %d", got.size(), want.size());
+    }
+}
+
+void test_skip(T &t) {
+    // unknown fields of every wire type, including nested groups, around
+    // field 15
+    String data;
+    io::Buffer out;
+    proto::marshal(out, [&](proto::Encoder &e) {
+        e.varint(1, 1ULL << 60);
+        e.fixed64(2, 7);
+        e.bytes(3, "skipped");
+        e.fixed32(4, 7);
+    }, error::panic);
+    data += out.to_string();
+    data += "\x2b\x33\x08\x01\x34\x10\x02\x2c";  // group 5 { group 6 { 1: 1 } 2: 2 }
+    data += "\x78\x2a";                          // 15: 42
+
+    proto::Decoder d(data);
+    proto::Tag tag;
+    uint64 got = 0;
+    while (d.next(&tag, error::panic)) {
+        if (tag.num == 15) {
+            got = d.read_varint(error::panic);
+        } else {
+            d.skip(tag, error::panic);
+        }
+    }
+    if (got != 42) {
+        t.errorf("field 15 = %d; want 42", got);
+    }
+}
+
+void test_decode_errors(T &t) {
+    String deep;
+    for (int i = 0; i < proto::MaxDepth + 1; i++) {
+        deep += "\x0b";
+    }
+
+    struct {
+        str in;
+        str err;
+    } tests[] = {
+        {"\x08", "unexpected EOF"},
+        {"\x08\x80", "unexpected EOF"},
+        {"\x12\x05hell", "unexpected EOF"},
+        {"\x0d\x01\x02", "unexpected EOF"},
+        {"\x00\x01", "proto: invalid field number"},
+        {"\x0e", "proto: invalid wire type"},
+        {"\x0c", "proto: mismatching end group marker"},
+        {"\x0b\x14", "proto: mismatching end group marker"},
+        {"\x0b\x08\x01", "unexpected EOF"},
+        {deep, "proto: exceeded maximum recursion depth"},
+        {"\x08\xff\xff\xff\xff\xff\xff\xff\xff\xff\x7f", "varint overflow"},
+    };
+
+    for (auto const &tt : tests) {
+        proto::Decoder d(tt.in);
+        proto::Tag tag;
+        String got;
+        auto err = [&](Error &e) {
+            got = fmt::sprintf("%v", e);
+        };
+        while (d.next(&tag, err)) {
+            d.skip(tag, err);
+        }
+        if (got != tt.err) {
+            t.errorf("%q: got error %q; want %q", tt.in, got, tt.err);
+        }
+    }
+}
+
+void benchmark_decode(B &b) {
+    Outer m = example();
+    io::Buffer out;
+    proto::marshal(out, [&](proto::Encoder &e) {
+        write_outer(e, m);
+    }, error::panic);
+    String data = out.to_string();
+
+    for (int i = 0; i < b.n; i++) {
+        read_outer(data, error::panic);
+    }
+}
+
+void benchmark_marshal(B &b) {
+    Outer m = example();
+    io::Buffer out;
+    for (int i = 0; i < b.n; i++) {
+        out.reset();
+        proto::marshal(out, [&](proto::Encoder &e) {
+            write_outer(e, m);
+        }, error::panic);
+    }
+}
@@ -1,2 +1,3 @@
 #pragma once
-#include "serial_linux.h"
\ No newline at end of file
+#include "serial_linux.h"
+#include "serial_listener.h"
@@ -1,7 +1,6 @@
 #include "serial_linux.h"
 #include "lib/error.h"
 #include "lib/os/error.h"
-#include "lib/print.h"
 
 #include <fcntl.h>
 #include <unistd.h>
@@ -12,104 +11,230 @@
 using namespace lib;
 using namespace serial;
 
-Port serial::open(str path, error err) {
-    Port port;
+static bool baud_speed(int baud, speed_t *speed) {
+    static const struct {
+        int     baud;
+        speed_t speed;
+    } speeds[] = {
+        {50, B50}, {75, B75}, {110, B110}, {134, B134}, {150, B150},
+        {200, B200}, {300, B300}, {600, B600}, {1200, B1200}, {1800, B1800},
+        {2400, B2400}, {4800, B4800}, {9600, B9600}, {19200, B19200},
+        {38400, B38400}, {57600, B57600}, {115200, B115200}, {230400, B230400},
+        {460800, B460800}, {500000, B500000}, {576000, B576000},
+        {921600, B921600}, {1000000, B1000000}, {1152000, B1152000},
+        {1500000, B1500000}, {2000000, B2000000}, {2500000, B2500000},
+        {3000000, B3000000}, {3500000, B3500000}, {4000000, B4000000},
+    };
+
+    for (auto const &s : speeds) {
+        if (s.baud == baud) {
+            *speed = s.speed;
+            return true;
+        }
+    }
+    return false;
+}
 
-    os::File f = os::open_file(path, O_RDWR | O_NOCTTY | O_NONBLOCK, 0, err);
-    *((os::File*) &port) = std::move(f);
-    if (err) {
-        return port;
+void internal::configure(int fd, str path, Config const &config, error err) {
+    speed_t speed;
+    if (!baud_speed(config.baud, &speed)) {
+        return err(os::PathError("configure", path, ErrUnsupportedBaud()));
+    }
+    if (config.data_bits < 5 || config.data_bits > 8 || (config.stop_bits != 1 && config.stop_bits != 2)) {
+        return err(os::PathError("configure", path, ErrInvalidConfig()));
     }
 
     struct termios tty;
-
-    if (::tcgetattr(port.fd, &tty) != 0) {
-        err(os::SyscallError("tcgetattr", errno));
-        return port;
+    if (::tcgetattr(fd, &tty) != 0) {
+        return err(os::PathError("tcgetattr", path, os::Errno(errno)));
     }
 
-    // Set Baud Rate
-    ::cfsetispeed(&tty, B921600);
-    ::cfsetospeed(&tty, B921600);
-
-    // 8-bit characters
-    tty.c_cflag &= ~CSIZE; 
-    tty.c_cflag |= CS8;
-
-    // No parity bit
-    tty.c_cflag &= ~PARENB;
+    // no echo, no line editing, no signals and no byte translation
+    ::cfmakeraw(&tty);
+    ::cfsetspeed(&tty, speed);
+
+    static const tcflag_t sizes[] = {CS5, CS6, CS7, CS8};
+    tty.c_cflag &= ~CSIZE;
+    tty.c_cflag |= sizes[config.data_bits - 5];
+
+    tty.c_cflag &= ~(PARENB | PARODD);
+    tty.c_iflag &= ~INPCK;
+    if (config.parity != Parity::None) {
+        tty.c_cflag |= PARENB;
+        tty.c_iflag |= INPCK;
+        if (config.parity == Parity::Odd) {
+            tty.c_cflag |= PARODD;
+        }
+    }
 
-    // One stop bit
-    tty.c_cflag &= ~CSTOPB;
+    if (config.stop_bits == 2) {
+        tty.c_cflag |= CSTOPB;
+    } else {
+        tty.c_cflag &= ~CSTOPB;
+    }
 
-    // Disable hardware flow control
     tty.c_cflag &= ~CRTSCTS;
+    tty.c_iflag &= ~(IXON | IXOFF | IXANY);
+    if (config.flow == FlowControl::Hardware) {
+        tty.c_cflag |= CRTSCTS;
+    } else if (config.flow == FlowControl::Software) {
+        tty.c_iflag |= IXON | IXOFF;
+    }
 
     // Turn on READ & ignore ctrl lines (CLOCAL = 1)
     tty.c_cflag |= CREAD | CLOCAL;
 
-    // Disable canonical mode, echo, extended input processing, and signal characters
-    tty.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
+    // With O_NONBLOCK, read never waits for VMIN/VTIME, but poll does: the
+    // port is only reported readable once VMIN bytes are queued.
+    tty.c_cc[VMIN]  = config.vmin;
+    tty.c_cc[VTIME] = config.vtime;
 
-    // Disable output processing
-    tty.c_oflag &= ~OPOST;
+    if (::tcsetattr(fd, TCSANOW, &tty) != 0) {
+        return err(os::PathError("tcsetattr", path, os::Errno(errno)));
+    }
 
-    // Set in/out baud rate
-    ::cfsetspeed(&tty, B921600);
+    if (config.low_latency) {
+        // best effort: pseudo-terminals and many USB adapters reject these
+        struct serial_struct serinfo;
+        if (::ioctl(fd, TIOCGSERIAL, &serinfo) == 0) {
+            serinfo.flags |= ASYNC_LOW_LATENCY;
+            ::ioctl(fd, TIOCSSERIAL, &serinfo);
+        }
+    }
 
-    // Set port to raw mode
-    ::cfmakeraw(&tty);
-    tty.c_cc[VMIN] = 1;    // Minimum number of characters for noncanonical read (MIN).
-    tty.c_cc[VTIME] = 0;  // Timeout in deciseconds for noncanonical read (TIME).
-    
+    // discard anything received or queued under the old settings
+    if (::tcflush(fd, TCIOFLUSH) != 0) {
+        return err(os::PathError("tcflush", path, os::Errno(errno)));
+    }
+}
 
-    // Apply the settings to the port
-    if (::tcsetattr(port.fd, TCSANOW, &tty) != 0) {
-        err(os::PathError("tcsetattr", path, os::Errno(errno)));
-        return port;
+int internal::open_port(str path, Config const &config, error err) {
+    int fd = ::open(CString(path), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1) {
+        err(os::PathError("open", path, os::Errno(errno)));
+        return -1;
     }
 
-    // set low latency
-    struct serial_struct serinfo;
-    if (::ioctl(port.fd, TIOCGSERIAL, &serinfo) < 0) {
-        err(os::PathError("ioctl(TIOCGSERIAL)", path, os::Errno(errno)));
-        return port;
+    bool failed = false;
+    configure(fd, path, config, [&](Error &e) {
+        failed = true;
+        err(e);
+    });
+    if (failed) {
+        ::close(fd);
+        return -1;
     }
 
-    serinfo.flags |= ASYNC_LOW_LATENCY;
+    return fd;
+}
+
+Port serial::open(str path, error err) {
+    return open(path, Config{.baud = 921600}, err);
+}
+
+Port serial::open(str path, Config const &config, error err) {
+    Port port;
+    port.path = path;
 
-    if (::ioctl(port.fd, TIOCSSERIAL, &serinfo) < 0) {
-        err(os::PathError("ioctl(TIOCSSERIAL)", path, os::Errno(errno)));
+    int fd = internal::open_port(path, config, err);
+    if (fd == -1) {
         return port;
     }
 
-    // attempt to discard buffered data
-    if (tcflush(port.fd, TCOFLUSH) < 0) {
-        err(os::PathError("tcflush(TCOFLUSH)", path, os::Errno(errno)));
+    auto pfd = std::make_unique<net::internal::FD>(fd);
+    pfd->socket = false;
+    pfd->init([&](Error &e) {
+        err(os::PathError("open", path, e));
+    });
+    if (pfd->id == 0) {
         return port;
     }
 
-    // discard data
-    byte buf[512];
-    for (;;) {
-        size n = read(port.fd, buf, sizeof buf);
-        if (n <= 0) {
-            break;  
-        }
-        print "serial_linux: discared %d bytes" % n;
+    port.fd = std::move(pfd);
+    port.resize_readbuf(4096);
+    port.resize_writebuf(4096);
+    return port;
+}
+
+Port& Port::operator=(Port &&other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (this->fd) {
+        this->close(error::ignore);
     }
 
-    int flags = fcntl(port.fd, F_GETFL, 0);
-    if (flags == -1) {
-        err(os::PathError("fcntl(F_GETFL)", path, os::Errno(errno)));
-        return port;
+    io::Buffered::operator=(std::move(other));
+    this->fd = std::move(other.fd);
+    this->path = std::move(other.path);
+    this->closed = other.closed;
+    return *this;
+}
+
+Port::~Port() {
+    if (this->fd && !this->closed) {
+        this->close(error::ignore);
     }
-    flags &= ~O_NONBLOCK;
-    if (fcntl(port.fd, F_SETFL, flags) < 0) {
-        err(os::PathError("fcntl(F_SETFL)", path, os::Errno(errno)));
-        return port;
+}
+
+io::ReadResult Port::direct_read(buf b, error err) {
+    if (!this->fd) {
+        err(os::PathError("read", this->path, os::ErrClosed()));
+        return {};
     }
-    
 
-    return port;
-}
\ No newline at end of file
+    return this->fd->read(b, [&](Error &e) {
+        err(os::PathError("read", this->path, e));
+    });
+}
+
+size Port::direct_write(str data, error err) {
+    if (!this->fd) {
+        err(os::PathError("write", this->path, os::ErrClosed()));
+        return 0;
+    }
+
+    return this->fd->write(data, [&](Error &e) {
+        err(os::PathError("write", this->path, e));
+    });
+}
+
+void Port::configure(Config const &config, error err) {
+    if (!this->fd || this->closed) {
+        return err(os::PathError("configure", this->path, os::ErrClosed()));
+    }
+
+    internal::configure(this->fd->sysfd, this->path, config, err);
+}
+
+void Port::close(error err) {
+    if (!this->fd || this->closed) {
+        return err(os::PathError("close", this->path, os::ErrClosed()));
+    }
+
+    flush(err);
+
+    // the FD stays allocated until the destructor, as threads blocked in
+    // read or write may still be returning from it
+    this->closed = true;
+    this->fd->close([&](Error &e) {
+        err(os::PathError("close", this->path, e));
+    });
+}
+
+void Port::set_deadline(time::time t) {
+    set_read_deadline(t);
+    set_write_deadline(t);
+}
+
+void Port::set_read_deadline(time::time t) {
+    if (this->fd) {
+        this->fd->set_deadline(this->fd->rd, t);
+    }
+}
+
+void Port::set_write_deadline(time::time t) {
+    if (this->fd) {
+        this->fd->set_deadline(this->fd->wr, t);
+    }
+}
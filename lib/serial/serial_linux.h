@@ -1,8 +1,99 @@
 #pragma  once
 
-#include "lib/os/file.h"
+#include <memory>
+
+#include "lib/io/io.h"
+#include "lib/net/fd.h"
+#include "lib/time/time.h"
 
 namespace lib::serial {
-    struct Port : lib::os::File {} ;
-    Port open(lib::str path, lib::error err);
-}
\ No newline at end of file
+
+    struct ErrUnsupportedBaud : ErrorBase<ErrUnsupportedBaud, "unsupported baud rate"> {};
+    struct ErrInvalidConfig   : ErrorBase<ErrInvalidConfig, "invalid serial port configuration"> {};
+
+    enum class Parity {
+        None,
+        Odd,
+        Even,
+    } ;
+
+    enum class FlowControl {
+        None,
+        Hardware,  // RTS/CTS
+        Software,  // XON/XOFF
+    } ;
+
+    // Config holds the line settings of a serial port. The port is always put
+    // in raw mode: no echo, no line editing and no translation of bytes.
+    struct Config {
+        int         baud      = 115200;
+        int         data_bits = 8;  // 5 to 8
+        Parity      parity    = Parity::None;
+        int         stop_bits = 1;  // 1 or 2
+        FlowControl flow      = FlowControl::None;
+
+        // vmin and vtime are the termios VMIN and VTIME values. With vtime 0
+        // the port only becomes readable once vmin bytes have arrived; the
+        // default of 1 wakes the reader for every byte.
+        uint8 vmin  = 1;
+        uint8 vtime = 0;
+
+        // low_latency asks the driver to hand received bytes to the tty layer
+        // right away instead of batching them (ASYNC_LOW_LATENCY). It is
+        // skipped for devices that don't support it, such as pseudo-terminals.
+        bool low_latency = true;
+    } ;
+
+    // Port is an open serial port. Reads and writes are buffered; call flush
+    // to push buffered writes to the device.
+    //
+    // The descriptor is non-blocking and registered with the netpoller, like
+    // a net::Conn: a read or write that would block parks the calling thread
+    // until epoll reports the port ready, and close unblocks it.
+    struct Port : io::Buffered {
+        std::unique_ptr<net::internal::FD> fd;
+        String path;
+
+        Port() = default;
+        Port(Port&&) = default;
+        Port& operator=(Port &&other);
+        ~Port();
+
+        io::ReadResult direct_read(buf b, error err) override;
+        size direct_write(str data, error err) override;
+
+        // configure changes the line settings. Pending input and output are
+        // discarded.
+        void configure(Config const &config, error err);
+
+        // close flushes buffered writes and closes the port. Blocked reads
+        // and writes return an error.
+        void close(error err) override;
+
+        // set_deadline sets the read and write deadlines, as for net::Conn.
+        // A zero time means I/O operations will not time out.
+        void set_deadline(time::time t);
+        void set_read_deadline(time::time t);
+        void set_write_deadline(time::time t);
+
+      private:
+        bool closed = false;
+    } ;
+
+    // open opens the serial device at path at 921600 baud, 8N1, as it always
+    // has; the rest of the settings are Config's defaults.
+    Port open(str path, error err);
+
+    // open opens the serial device at path and applies config. Data already
+    // queued by the driver is discarded.
+    Port open(str path, Config const &config, error err);
+
+    namespace internal {
+        // open_port opens path non-blocking, applies config and discards
+        // stale data. It returns the descriptor, or -1 after reporting an
+        // error.
+        int open_port(str path, Config const &config, error err);
+
+        void configure(int fd, str path, Config const &config, error err);
+    }
+}
@@ -0,0 +1,297 @@
+#include "serial_listener.h"
+
+#include <algorithm>
+#include <climits>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "lib/net/fd.h"
+#include "lib/os/error.h"
+#include "lib/sync/lock.h"
+
+using namespace lib;
+using namespace serial;
+
+struct serial::internal::PortConn : Conn {
+    PortListener &l;
+    String        path;
+
+    // fd is replaced by open and close with l.mtx held. Reads and writes
+    // take a reference under l.mtx and do their I/O through it, so a close
+    // from another thread wakes them with an error, and the descriptor is
+    // released only once they have returned.
+    std::shared_ptr<net::internal::FD> fd;
+    int64 next_open = 0;  // time::clock() of the next attempt to reopen
+
+    PortConn(PortListener &l, str path) : l(l), path(path) {}
+
+    str name() const override {
+        return path;
+    }
+
+    bool buffered() const {
+        return readptr < readend;
+    }
+
+    std::shared_ptr<net::internal::FD> file() {
+        sync::Lock lock(l.mtx);
+        return fd;
+    }
+
+    io::ReadResult direct_read(buf b, error err) override;
+    size direct_write(str data, error err) override;
+    void close(error err) override;
+
+    // attach takes over sysfd, freshly opened by open_port, and adds it to
+    // the listener's epoll set. It returns false after reporting an error.
+    // l.mtx is held.
+    bool attach(int sysfd, error err);
+
+    // shut closes the descriptor. l.mtx is held.
+    void shut();
+} ;
+
+io::ReadResult internal::PortConn::direct_read(buf b, error err) {
+    std::shared_ptr<net::internal::FD> f = file();
+    if (!f) {
+        err(os::PathError("read", path, os::ErrClosed()));
+        return {};
+    }
+
+    return f->read(b, [&](Error &e) {
+        err(os::PathError("read", path, e));
+    });
+}
+
+size internal::PortConn::direct_write(str data, error err) {
+    std::shared_ptr<net::internal::FD> f = file();
+    if (!f) {
+        err(os::PathError("write", path, os::ErrClosed()));
+        return 0;
+    }
+
+    return f->write(data, [&](Error &e) {
+        err(os::PathError("write", path, e));
+    });
+}
+
+bool internal::PortConn::attach(int sysfd, error err) {
+    auto f = std::make_shared<net::internal::FD>(sysfd);
+    f->socket = false;
+    f->init([&](Error &e) {
+        err(os::PathError("open", path, e));
+    });
+    if (f->id == 0) {
+        return false;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = this;
+    if (epoll_ctl(l.epfd, EPOLL_CTL_ADD, sysfd, &ev) == -1) {
+        err(os::PathError("epoll_ctl", path, os::Errno(errno)));
+        f->close(error::ignore);
+        return false;
+    }
+
+    fd = std::move(f);
+    return true;
+}
+
+void internal::PortConn::shut() {
+    // the descriptor is still open here, as fd holds a reference, so it
+    // can't have been reused for another device
+    epoll_ctl(l.epfd, EPOLL_CTL_DEL, fd->sysfd, nil);
+    fd->close(error::ignore);
+    fd = nil;
+    next_open = time::clock().nsecs + l.retry.nsecs;
+    reset();
+}
+
+void internal::PortConn::close(error err) {
+    sync::Lock wlock(write_mtx);
+    if (!file()) {
+        return err(os::PathError("close", path, os::ErrClosed()));
+    }
+
+    // flush errors are reported but do not keep the device open
+    flush(err);
+
+    sync::Lock lock(l.mtx);
+    shut();
+
+    // let accept schedule the reopen
+    uint64 one = 1;
+    (void) !::write(l.wake, &one, sizeof one);
+}
+
+PortListener::PortListener(std::vector<String> paths, Config const &config, error err) : config(config) {
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd == -1) {
+        closed = true;
+        err(os::SyscallError("epoll_create1", errno));
+        return;
+    }
+
+    wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake == -1) {
+        closed = true;
+        err(os::SyscallError("eventfd", errno));
+        return;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nil;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, wake, &ev) == -1) {
+        closed = true;
+        err(os::SyscallError("epoll_ctl", errno));
+        return;
+    }
+
+    for (String const &path : paths) {
+        conns.push_back(std::make_unique<internal::PortConn>(*this, path));
+    }
+
+    // devices that fail now are reported, then retried by accept
+    sync::Lock lock(mtx);
+    for (auto &c : conns) {
+        int fd = internal::open_port(c->path, config, err);
+        if (fd != -1 && !c->attach(fd, err)) {
+            c->next_open = time::clock().nsecs + retry.nsecs;
+        }
+    }
+}
+
+PortListener::~PortListener() {
+    if (!closed) {
+        close(error::ignore);
+    }
+    if (epfd != -1) {
+        ::close(epfd);
+    }
+    if (wake != -1) {
+        ::close(wake);
+    }
+}
+
+// reopen tries to reopen the devices whose retry time has come. It returns
+// the epoll_wait timeout until the next attempt.
+int PortListener::reopen() {
+    sync::Lock lock(mtx);
+
+    int64 now = time::clock().nsecs;
+    int64 next = -1;
+    for (auto &c : conns) {
+        if (c->fd) {
+            continue;
+        }
+
+        if (c->next_open <= now) {
+            int fd = internal::open_port(c->path, config, error::ignore);
+            if (fd != -1 && c->attach(fd, error::ignore)) {
+                continue;
+            }
+            c->next_open = now + retry.nsecs;
+        }
+
+        if (next == -1 || c->next_open < next) {
+            next = c->next_open;
+        }
+    }
+
+    if (next == -1) {
+        return -1;
+    }
+    // round up so we never wake just before the deadline
+    int64 d = next - now;
+    return d <= 0 ? 0 : int(std::min<int64>((d + 999'999) / 1'000'000, INT_MAX));
+}
+
+Conn* PortListener::accept(error err) {
+    for (;;) {
+        {
+            sync::Lock lock(mtx);
+            if (closed) {
+                err(os::ErrClosed());
+                return nil;
+            }
+
+            while (ready_pos < ready.size()) {
+                internal::PortConn *c = ready[ready_pos++];
+                if (c->fd) {
+                    return c;
+                }
+            }
+        }
+
+        int timeout = reopen();
+
+        // input already in a conn's buffer doesn't show up in epoll
+        bool buffered = false;
+        {
+            sync::Lock lock(mtx);
+            for (auto &c : conns) {
+                buffered = buffered || (c->fd && c->buffered());
+            }
+        }
+        if (buffered) {
+            timeout = 0;
+        }
+
+        epoll_event events[64];
+        int n = epoll_wait(epfd, events, 64, timeout);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            err(os::SyscallError("epoll_wait", errno));
+            return nil;
+        }
+
+        ready.clear();
+        ready_pos = 0;
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == nil) {
+                uint64 v;
+                (void) !::read(wake, &v, sizeof v);
+                continue;
+            }
+            ready.push_back((internal::PortConn*) events[i].data.ptr);
+        }
+
+        if (buffered) {
+            sync::Lock lock(mtx);
+            for (auto &c : conns) {
+                if (c->fd && c->buffered() &&
+                        std::find(ready.begin(), ready.end(), c.get()) == ready.end()) {
+                    ready.push_back(c.get());
+                }
+            }
+        }
+    }
+}
+
+void PortListener::close(error err) {
+    {
+        sync::Lock lock(mtx);
+        if (closed) {
+            return err(os::ErrClosed());
+        }
+        closed = true;
+    }
+
+    for (auto &c : conns) {
+        sync::Lock wlock(c->write_mtx);
+        c->flush(error::ignore);
+
+        sync::Lock lock(mtx);
+        if (c->fd) {
+            c->shut();
+        }
+    }
+
+    uint64 one = 1;
+    (void) !::write(wake, &one, sizeof one);
+}
@@ -1,15 +1,86 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include "lib/io/io.h"
 #include "lib/sync/mutex.h"
+#include "lib/time/time.h"
+#include "serial_linux.h"
 
 namespace lib::serial {
+
+    // Conn is a connection to a serial device handed out by a Listener. It is
+    // owned by the listener. Reads are done by the thread calling accept;
+    // other threads may write while holding write_mtx.
     struct Conn : io::StaticBuffered<512, 512> {
         sync::Mutex write_mtx;
+
+        // name returns the path of the device.
+        virtual str name() const = 0;
     } ;
 
     struct Listener {
-        virtual Conn& accept(error) = 0;
+        // accept waits until a connection has input to read and returns it.
+        // It returns nil after reporting an error.
+        virtual Conn* accept(error) = 0;
         virtual ~Listener() {}
     } ;
-}
\ No newline at end of file
+
+    namespace internal {
+        struct PortConn;
+    }
+
+    // PortListener serves a set of serial devices from a single thread. The
+    // devices are opened with the given Config and watched with one epoll
+    // set; accept returns the Conn of a device with input, which can then be
+    // consumed without blocking using peek_buffered and skip:
+    //
+    //     for (;;) {
+    //         serial::Conn *c = l.accept(err);
+    //         str data = c->peek_buffered(err);
+    //         ...
+    //         c->skip(len(data), err);
+    //     }
+    //
+    // A Conn is returned again by later calls for as long as it has unread
+    // input. A read that asks for more than is available waits for that
+    // device alone.
+    //
+    // When a read fails, for instance because a USB adapter was unplugged,
+    // close the Conn: the listener reopens the device every retry interval
+    // until it succeeds. Devices that can't be opened at first are retried
+    // the same way.
+    struct PortListener : Listener {
+        time::duration retry = time::second;
+
+        PortListener(std::vector<String> paths, Config const &config, error err);
+        PortListener(PortListener const&) = delete;
+        ~PortListener();
+
+        Conn* accept(error err) override;
+
+        // close closes every Conn and stops the listener. A blocked accept
+        // returns os::ErrClosed, and reads and writes blocked on a Conn
+        // return an error.
+        void close(error err);
+
+      private:
+        Config config;
+        int    epfd = -1;
+        int    wake = -1;  // eventfd written when a conn is closed, or by close
+
+        sync::Mutex mtx;
+        bool        closed = false;
+
+        // only used by accept
+        std::vector<internal::PortConn*> ready;
+        size                             ready_pos = 0;
+
+        std::vector<std::unique_ptr<internal::PortConn>> conns;
+
+        int reopen();
+
+        friend struct internal::PortConn;
+    } ;
+}
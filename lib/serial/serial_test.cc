@@ -0,0 +1,186 @@
+#include "serial.h"
+
+#include <deque>
+#include <map>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "lib/fmt/fmt.h"
+#include "lib/net/net.h"
+#include "lib/os/error.h"
+#include "lib/sync/lock.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+namespace {
+    // Pty is a pseudo-terminal pair: the test drives master, and the code
+    // under test opens the slave by name.
+    struct Pty {
+        int    master = -1;
+        int    slave  = -1;
+        String name;
+
+        Pty(T &t) {
+            char path[256];
+            if (openpty(&master, &slave, path, nil, nil) == -1) {
+                t.fatalf("openpty: %v", os::Errno(errno));
+            }
+            name = str::from_c_str(path);
+        }
+
+        ~Pty() {
+            ::close(master);
+            ::close(slave);
+        }
+    } ;
+}
+
+void test_port(T &t) {
+    Pty pty(t);
+
+    ErrorRecorder err;
+    serial::Port port = serial::open(pty.name, {.baud = 921600}, err);
+    if (err) {
+        t.fatalf("open %s: %v", pty.name, err);
+    }
+
+    if (::write(pty.master, "ping", 4) != 4) {
+        t.fatalf("write to master failed");
+    }
+    byte b[16];
+    io::ReadResult r = port.read(b, err);
+    if (err || str(b, r.nbytes) != "ping") {
+        t.errorf("read %q, err %v; want %q", str(b, r.nbytes), err, "ping");
+    }
+
+    port.write("pong", err);
+    port.flush(err);
+    ssize_t n = ::read(pty.master, b, sizeof b);
+    if (err || n != 4 || str(b, 4) != "pong") {
+        t.errorf("master read %d bytes, err %v; want %q", n, err, "pong");
+    }
+
+    // a read with nothing to read parks on the netpoller until the deadline
+    port.set_read_deadline(time::time{time::now().nsecs + (20*time::millisecond).nsecs});
+    bool timed_out = false;
+    port.read(b, [&](Error &e) {
+        timed_out = e.is<net::ErrDeadlineExceeded>();
+    });
+    if (!timed_out) {
+        t.errorf("read did not time out");
+    }
+
+    port.close(err);
+    if (err) {
+        t.errorf("close: %v", err);
+    }
+
+    bool unsupported = false;
+    serial::open(pty.name, {.baud = 12345}, [&](Error &e) {
+        unsupported = e.is<serial::ErrUnsupportedBaud>();
+    });
+    if (!unsupported) {
+        t.errorf("open with baud 12345 did not report ErrUnsupportedBaud");
+    }
+}
+
+void test_open_default_baud(T &t) {
+    Pty pty(t);
+
+    // the two-argument open has always used 921600 baud
+    ErrorRecorder err;
+    serial::Port port = serial::open(pty.name, err);
+    if (err) {
+        t.fatalf("open %s: %v", pty.name, err);
+    }
+
+    termios tty;
+    if (::tcgetattr(pty.slave, &tty) != 0) {
+        t.fatalf("tcgetattr: %v", os::Errno(errno));
+    }
+    if (::cfgetispeed(&tty) != B921600 || ::cfgetospeed(&tty) != B921600) {
+        t.errorf("speed = %d/%d; want B921600", ::cfgetispeed(&tty), ::cfgetospeed(&tty));
+    }
+
+    port.close(err);
+}
+
+void test_listener(T &t) {
+    constexpr int N = 16;
+    std::deque<Pty> ptys;
+    std::vector<String> paths;
+    for (int i = 0; i < N; i++) {
+        ptys.emplace_back(t);
+        paths.push_back(ptys.back().name);
+    }
+
+    ErrorRecorder err;
+    serial::PortListener l(paths, {}, err);
+    if (err) {
+        t.fatalf("listen: %v", err);
+    }
+
+    for (int i = 0; i < N; i++) {
+        String msg = String(fmt::sprintf("device %d\n", i));
+        str m = msg;
+        if (::write(ptys[i].master, m.data, m.len) != m.len) {
+            t.fatalf("write to master %d failed", i);
+        }
+    }
+
+    // one thread serves every device
+    std::map<String, String> got;
+    int lines = 0;
+    while (lines < N) {
+        serial::Conn *c = l.accept(err);
+        if (err) {
+            t.fatalf("accept: %v", err);
+        }
+        str data = c->peek_buffered(err);
+        got[String(c->name())] += data;
+        for (byte ch : data) {
+            lines += ch == '\n';
+        }
+        c->skip(len(data), err);
+    }
+
+    for (int i = 0; i < N; i++) {
+        String want = String(fmt::sprintf("device %d\n", i));
+        if (got[paths[i]] != want) {
+            t.errorf("%s: got %q; want %q", paths[i], got[paths[i]], want);
+        }
+    }
+
+    // writes go to the device
+    serial::Conn *c = nil;
+    if (::write(ptys[0].master, "x", 1) != 1) {
+        t.fatalf("write to master failed");
+    }
+    c = l.accept(err);
+    c->skip(1, err);
+    {
+        sync::Lock lock(c->write_mtx);
+        c->write("ack", err);
+        c->flush(err);
+    }
+    byte b[8];
+    ssize_t n = ::read(ptys[0].master, b, sizeof b);
+    if (err || n != 3 || str(b, 3) != "ack") {
+        t.errorf("master read %d bytes, err %v; want %q", n, err, "ack");
+    }
+
+    l.close(err);
+    if (err) {
+        t.errorf("close: %v", err);
+    }
+    bool closed = false;
+    l.accept([&](Error &e) {
+        closed = e.is<os::ErrClosed>();
+    });
+    if (!closed) {
+        t.errorf("accept after close did not report ErrClosed");
+    }
+}
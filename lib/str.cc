@@ -60,12 +60,29 @@ struct StringWriter : io::Writer {
 // }
 
 String::String(io::WriterTo const &w) {
-    io::Buffer buffer;
-    w.write_to(buffer, error::ignore);
-    *this = buffer.to_string();
+    size n = w.size_hint();
+    if (n < 0) {
+        io::Buffer buffer;
+        w.write_to(buffer, error::ignore);
+        *this = buffer.to_string();
+        return;
+    }
+
+    // allocate once; the writer still grows the string if the hint was short
+    if (n > 0) {
+        buffer = Buffer(n);
+    }
+    StringWriter sw(*this);
+    w.write_to(sw, error::ignore);
+    sw.finish();
 }
 
 String& String::operator+=(io::WriterTo const &writer_to) {
+    size n = writer_to.size_hint();
+    if (n > 0) {
+        ensure(length + n);
+    }
+
     StringWriter sw(*this);
     writer_to.write_to(sw, error::ignore);
     sw.finish();
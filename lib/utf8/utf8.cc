@@ -3,6 +3,10 @@
 #include "lib/io/io.h"
 #include "lib/math.h"
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 using namespace lib;
 using namespace utf8;
 using namespace lib::utf8::internal;
@@ -427,10 +431,102 @@ size RuneDecoder::eof() {
     return count;
 }
 
+#if defined(__x86_64__)
+
+// ascii_prefix_avx2 returns the length of the ASCII prefix of s, to a
+// multiple of 32 bytes.
+__attribute__((target("avx2")))
+static size ascii_prefix_avx2(str s) {
+    size i = 0;
+    for (; i + 64 <= len(s); i += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i*) (s.data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*) (s.data + i + 32));
+        if (_mm256_movemask_epi8(_mm256_or_si256(a, b)) != 0) {
+            break;
+        }
+    }
+    for (; i + 32 <= len(s); i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*) (s.data + i));
+        if (_mm256_movemask_epi8(a) != 0) {
+            break;
+        }
+    }
+    return i;
+}
+
+static bool has_avx2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}();
+
+#endif
+
+// ascii_prefix returns the length of a prefix of s that is all ASCII. It may
+// stop short of the first non-ASCII byte.
+static size ascii_prefix(str s) {
+    size i = 0;
+#if defined(__x86_64__)
+    if (has_avx2) {
+        i = ascii_prefix_avx2(s);
+    }
+#endif
+    for (; i + 8 <= len(s); i += 8) {
+        uint64 w;
+        memcpy(&w, s.data + i, 8);
+        if (w & 0x8080808080808080) {
+            break;
+        }
+    }
+    return i;
+}
+
 size utf8::rune_count(str s) {
+    // ASCII fast path: every byte below RuneSelf is a rune of its own, so
+    // only the rest of s needs decoding
+    size i = ascii_prefix(s);
+    while (i < len(s) && byte(s.data[i]) < RuneSelf) {
+        i++;
+    }
+    if (i == len(s)) {
+        return i;
+    }
+
     RuneDecoder state;
-    state.count(s);
-    return state.eof();
+    state.count(s.slice(i));
+    return i + state.eof();
+}
+
+bool utf8::valid(str s) {
+    size i = 0;
+    while (i < len(s)) {
+        byte c = s.data[i];
+        if (c < RuneSelf) {
+            // skip runs of ASCII a block at a time
+            i += 1 + ascii_prefix(s.slice(i + 1));
+            continue;
+        }
+
+        uint8 x = first[c];
+        if (x == xx) {
+            return false;
+        }
+        size n = x & 7;
+        if (len(s) - i < n) {
+            return false;
+        }
+        AcceptRange accept = accept_ranges[x >> 4];
+        if (byte c1 = s.data[i+1]; c1 < accept.lo || c1 > accept.hi) {
+            return false;
+        }
+        if (n > 2 && (byte(s.data[i+2]) < locb || byte(s.data[i+2]) > hicb)) {
+            return false;
+        }
+        if (n > 3 && (byte(s.data[i+3]) < locb || byte(s.data[i+3]) > hicb)) {
+            return false;
+        }
+        i += n;
+    }
+    return true;
 }
 
 size utf8::rune_count(io::WriterTo const& writable) {
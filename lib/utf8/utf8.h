@@ -22,6 +22,11 @@ namespace lib::utf8 {
     size rune_count(str s);
     size rune_count(io::WriterTo const&);
     
+    // valid reports whether s consists entirely of valid UTF-8-encoded
+    // runes. Runs of ASCII are checked 32 bytes at a time where the CPU
+    // supports AVX2.
+    bool valid(str s);
+
     // valid_rune reports whether r can be legally encoded as UTF-8.
     // Code points that are out of range or a surrogate half are illegal.
     bool valid_rune(rune r);
@@ -1,10 +1,12 @@
 #include "lib/io/io.h"
 #include "lib/str.h"
+#include "lib/strings/strings.h"
 #include "lib/utf8/decode.h"
 #include "lib/utf8/encode.h"
 #include "utf8.h"
 
 #include "lib/testing.h"
+#include "lib/testing/benchmark.h"
 
 using namespace lib;
 using namespace utf8;
@@ -594,7 +596,10 @@ RuneCountTest runecounttests[] = {
 	{"\xe2\x00", 2},
 	{"\xe2\x80", 2},
 	{"a\xe2\x80", 3},
-    {"\xF0\x9D\x8C", 3}
+    {"\xF0\x9D\x8C", 3},
+	{"0123456789abcdef", 16},
+	{"abcdefghij☺k", 12},
+	{"01234567\xe2\x80", 10},
 };
 
 void test_rune_count(testing::T &t) {
@@ -644,42 +649,71 @@ void test_rune_count(testing::T &t) {
 // 	}
 // }
 
-// type ValidTest struct {
-// 	in  string
-// 	out bool
-// }
+struct ValidTest {
+	str  in;
+	bool out;
+};
 
-// var validTests = []ValidTest{
-// 	{"", true},
-// 	{"a", true},
-// 	{"abc", true},
-// 	{"Ж", true},
-// 	{"ЖЖ", true},
-// 	{"брэд-ЛГТМ", true},
-// 	{"☺☻☹", true},
-// 	{"aa\xe2", false},
-// 	{string([]byte{66, 250}), false},
-// 	{string([]byte{66, 250, 67}), false},
-// 	{"a\uFFFDb", true},
-// 	{string("\xF4\x8F\xBF\xBF"), true},      // U+10FFFF
-// 	{string("\xF4\x90\x80\x80"), false},     // U+10FFFF+1; out of range
-// 	{string("\xF7\xBF\xBF\xBF"), false},     // 0x1FFFFF; out of range
-// 	{string("\xFB\xBF\xBF\xBF\xBF"), false}, // 0x3FFFFFF; out of range
-// 	{string("\xc0\x80"), false},             // U+0000 encoded in two bytes: incorrect
-// 	{string("\xed\xa0\x80"), false},         // U+D800 high surrogate (sic)
-// 	{string("\xed\xbf\xbf"), false},         // U+DFFF low surrogate (sic)
-// }
+ValidTest validtests[] = {
+	{"", true},
+	{"a", true},
+	{"abc", true},
+	{"Ж", true},
+	{"ЖЖ", true},
+	{"брэд-ЛГТМ", true},
+	{"☺☻☹", true},
+	{"aa\xe2", false},
+	{"B\xfa", false},
+	{"B\xfa" "C", false},
+	{"a\uFFFDb", true},
+	{"\xF4\x8F\xBF\xBF", true},      // U+10FFFF
+	{"\xF4\x90\x80\x80", false},     // U+10FFFF+1; out of range
+	{"\xF7\xBF\xBF\xBF", false},     // 0x1FFFFF; out of range
+	{"\xFB\xBF\xBF\xBF\xBF", false}, // 0x3FFFFFF; out of range
+	{"\xc0\x80", false},             // U+0000 encoded in two bytes: incorrect
+	{"\xed\xa0\x80", false},         // U+D800 high surrogate (sic)
+	{"\xed\xbf\xbf", false},         // U+DFFF low surrogate (sic)
+};
 
-// func TestValid(t *testing.T) {
-// 	for _, tt := range validTests {
-// 		if Valid([]byte(tt.in)) != tt.out {
-// 			t.Errorf("Valid(%q) = %v; want %v", tt.in, !tt.out, tt.out)
-// 		}
-// 		if ValidString(tt.in) != tt.out {
-// 			t.Errorf("ValidString(%q) = %v; want %v", tt.in, !tt.out, tt.out)
-// 		}
-// 	}
-// }
+void test_valid(testing::T &t) {
+	for (ValidTest const &tt : validtests) {
+		if (valid(tt.in) != tt.out) {
+			t.errorf("valid(%q) = %v; want %v", tt.in, !tt.out, tt.out);
+		}
+	}
+
+	// errors after and between long runs of ASCII, which are checked a
+	// block at a time
+	String ascii = strings::repeat("x", 100);
+	for (size n : {0, 7, 31, 32, 33, 64, 65, 99}) {
+		String s = String(ascii[0, n]) + "☺" + ascii;
+		if (!valid(s)) {
+			t.errorf("valid(%d ASCII + ☺ + ASCII) = false", n);
+		}
+		s = String(ascii[0, n]) + "\xe2\x98" + ascii;
+		if (valid(s)) {
+			t.errorf("valid(%d ASCII + truncated rune + ASCII) = true", n);
+		}
+		s = ascii + String(ascii[0, n]) + "\xff";
+		if (valid(s)) {
+			t.errorf("valid(%d ASCII + 0xff) = true", 100 + n);
+		}
+	}
+}
+
+void benchmark_valid_ascii(testing::B &b) {
+	String s = strings::repeat("0123456789abcdef", 256);
+	for (int i = 0; i < b.n; i++) {
+		valid(s);
+	}
+}
+
+void benchmark_valid_japanese(testing::B &b) {
+	String s = strings::repeat("日本語日本語日本語日", 100);
+	for (int i = 0; i < b.n; i++) {
+		valid(s);
+	}
+}
 
 // type ValidRuneTest struct {
 // 	r  rune
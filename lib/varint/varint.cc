@@ -1,8 +1,15 @@
 #include "varint.h"
+#include "lib/encoding/binary/binary.h"
 #include "lib/error.h"
 #include "lib/io/io.h"
 #include "lib/io/util.h"
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <array>
+
 using namespace lib;
 
 uint32 varint::read_uint32(io::Reader &in, error  err) {
@@ -75,6 +82,7 @@ void varint::skip(str *data, error err) {
     do {
         if (i >= n) {
             err(io::ErrUnexpectedEOF());
+            return;
         }
         b = (*data)[i];
         i++;
@@ -161,4 +169,306 @@ void varint::write_sint64(io::Writer &out, int64 value, error err) {
     }
     
     return write_uint64(out, zigzagged, err);
-}
\ No newline at end of file
+}
+
+namespace {
+    // scan decodes one varint from the start of b into *v, checking it as
+    // read_uint32 and read_uint64 do. It returns the varint's length, 0 if b
+    // ends first, or -1 if the value overflows.
+    int scan(str b, uint32 *v) {
+        uint32 result = 0;
+        for (int i = 0; i < len(b); i++) {
+            byte c = b.data[i];
+            int bitpos = 7 * i;
+            if (bitpos >= 64) {
+                return -1;
+            }
+            if (bitpos >= 32) {
+                // trailing 0x80 bytes, or the sign extension of a negative int32
+                byte sign_extension = (bitpos < 63) ? 0xFF : 0x01;
+                if ((c & 0x7F) != 0 && !((result >> 31) != 0 && c == sign_extension)) {
+                    return -1;
+                }
+            } else if (bitpos == 28) {
+                if ((c & 0x70) != 0 && (c & 0x78) != 0x78) {
+                    return -1;
+                }
+                result |= uint32(c & 0x0F) << bitpos;
+            } else {
+                result |= uint32(c & 0x7F) << bitpos;
+            }
+            if (c < 0x80) {
+                *v = result;
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+    int scan(str b, uint64 *v) {
+        int n = 0;
+        *v = encoding::binary::uvarint(b, n);
+        return n < 0 ? -1 : n;
+    }
+
+#if defined(__x86_64__)
+
+    // A Pattern decodes the varints that start in an 8-byte window of input,
+    // given which of its bytes have the continuation bit set. shuffle moves
+    // the bytes of up to four varints of up to 4 bytes each into the 32-bit
+    // lanes of a vector.
+    struct Pattern {
+        byte  shuffle[16];
+        uint8 count;   // varints decoded
+        uint8 length;  // bytes consumed
+    } ;
+
+    const std::array<Pattern, 256> patterns = [] {
+        std::array<Pattern, 256> ps = {};
+        for (int mask = 0; mask < 256; mask++) {
+            Pattern &p = ps[mask];
+            for (byte &b : p.shuffle) {
+                b = 0x80;  // zeroes the lane's byte
+            }
+
+            int pos = 0;
+            while (p.count < 4) {
+                int end = pos;
+                while (end < 8 && (mask >> end & 1)) {
+                    end++;
+                }
+                if (end == 8 || end - pos >= 4) {
+                    // the varint runs past the window or is too long for
+                    // the shuffle; the scalar loop decodes it
+                    break;
+                }
+                for (int j = pos; j <= end; j++) {
+                    p.shuffle[4*p.count + j - pos] = byte(j);
+                }
+                p.count++;
+                pos = end + 1;
+            }
+            p.length = uint8(pos);
+        }
+        return ps;
+    }();
+
+    // decode_sse41 decodes varints from [*p, end) into [*o, oend) for as
+    // long as at least 16 bytes of input and 16 slots of output remain and
+    // the next varint is at most 4 bytes long.
+    template <typename T>
+    __attribute__((target("sse4.1")))
+    void decode_sse41(const byte **p, const byte *end, T **o, T *oend) {
+        const byte *in  = *p;
+        T          *out = *o;
+
+        while (end - in >= 16 && oend - out >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*) in);
+            uint32 mask = uint32(_mm_movemask_epi8(v));
+
+            if (mask == 0) {
+                // sixteen one-byte varints
+                for (int i = 0; i < 16; i += 4) {
+                    __m128i x = _mm_cvtepu8_epi32(v);
+                    if constexpr (sizeof(T) == 4) {
+                        _mm_storeu_si128((__m128i*) (out + i), x);
+                    } else {
+                        _mm_storeu_si128((__m128i*) (out + i), _mm_cvtepu32_epi64(x));
+                        _mm_storeu_si128((__m128i*) (out + i + 2), _mm_cvtepu32_epi64(_mm_srli_si128(x, 8)));
+                    }
+                    v = _mm_srli_si128(v, 4);
+                }
+                in  += 16;
+                out += 16;
+                continue;
+            }
+
+            Pattern const &pat = patterns[mask & 0xFF];
+            if (pat.count == 0) {
+                break;
+            }
+
+            __m128i x = _mm_shuffle_epi8(v, _mm_loadu_si128((const __m128i*) pat.shuffle));
+            x = _mm_and_si128(x, _mm_set1_epi8(0x7F));
+
+            // squeeze out the continuation bits: two 7-bit groups into each
+            // 16-bit half, then two 14-bit halves into each 32-bit lane
+            x = _mm_or_si128(_mm_and_si128(x, _mm_set1_epi16(0x007F)),
+                             _mm_and_si128(_mm_srli_epi16(x, 1), _mm_set1_epi16(0x3F80)));
+            x = _mm_or_si128(_mm_and_si128(x, _mm_set1_epi32(0x3FFF)),
+                             _mm_and_si128(_mm_srli_epi32(x, 2), _mm_set1_epi32(0x0FFFC000)));
+
+            if constexpr (sizeof(T) == 4) {
+                _mm_storeu_si128((__m128i*) out, x);
+            } else {
+                _mm_storeu_si128((__m128i*) out, _mm_cvtepu32_epi64(x));
+                _mm_storeu_si128((__m128i*) (out + 2), _mm_cvtepu32_epi64(_mm_srli_si128(x, 8)));
+            }
+            in  += pat.length;
+            out += pat.count;
+        }
+
+        *p = in;
+        *o = out;
+    }
+
+    bool has_sse41 = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.1");
+    }();
+
+#endif
+
+    template <typename T>
+    size decode_many(str *input, std::span<T> out, error err) {
+        const byte *p   = (const byte*) input->data;
+        const byte *end = p + len(*input);
+        T *o    = out.data();
+        T *oend = o + out.size();
+
+        while (o < oend && p < end) {
+#if defined(__x86_64__)
+            if (has_sse41) {
+                decode_sse41(&p, end, &o, oend);
+                if (o == oend || p == end) {
+                    break;
+                }
+            }
+#endif
+            if (*p < 0x80) {
+                *o++ = *p++;
+                continue;
+            }
+
+            int n = scan(str(p, end - p), o);
+            if (n <= 0) {
+                *input = str(p, end - p);
+                if (n == 0) {
+                    err(io::ErrUnexpectedEOF());
+                } else {
+                    err(varint::ErrOverflow());
+                }
+                return o - out.data();
+            }
+            p += n;
+            o++;
+        }
+
+        *input = str(p, end - p);
+        return o - out.data();
+    }
+
+    template <typename T>
+    size encode_many(buf *out, std::span<const T> in) {
+        byte *p   = out->data;
+        byte *end = p + len(*out);
+        size k = 0;
+
+        for (; k < size(in.size()); k++) {
+            T v = in[k];
+            if (v < 0x80 && p < end) {
+                *p++ = byte(v);
+                continue;
+            }
+            if (end - p < encoding::binary::uvarint_len(v)) {
+                break;
+            }
+            p += encoding::binary::put_uvarint(buf(p, end - p), v);
+        }
+
+        *out = buf(p, end - p);
+        return k;
+    }
+
+    template <typename T>
+    size read_many(io::Reader &in, std::span<T> out, error err) {
+        size k = 0;
+        while (k < size(out.size())) {
+            str avail = in.peek_buffered(err);
+            if (err) {
+                return k;
+            }
+
+            // a varint cut off by the end of the buffer isn't an error yet
+            str rest = avail;
+            k += decode_many(&rest, out.subspan(k), error::ignore);
+            in.skip(len(avail) - len(rest), err);
+            if (k == size(out.size())) {
+                break;
+            }
+
+            // the next varint straddles a refill, the reader has no read
+            // buffer or the input is bad: read it a byte at a time
+            if constexpr (sizeof(T) == 4) {
+                out[k] = varint::read_uint32(in, err);
+            } else {
+                out[k] = varint::read_uint64(in, err);
+            }
+            if (err) {
+                return k;
+            }
+            k++;
+        }
+        return k;
+    }
+
+    template <typename T>
+    void write_many(io::Writer &out, std::span<const T> in, error err) {
+        size k = 0;
+        while (k < size(in.size())) {
+            buf space = out.write_space(sizeof(T) == 4 ? varint::MaxLen32 : varint::MaxLen64, err);
+            if (err) {
+                return;
+            }
+            if (len(space) == 0) {
+                // no write buffer
+                if constexpr (sizeof(T) == 4) {
+                    varint::write_uint32(out, in[k], err);
+                } else {
+                    varint::write_uint64(out, in[k], err);
+                }
+                if (err) {
+                    return;
+                }
+                k++;
+                continue;
+            }
+
+            buf rest = space;
+            k += encode_many(&rest, in.subspan(k));
+            out.write_commit(len(space) - len(rest));
+        }
+    }
+}
+
+size varint::decode_many(str *input, std::span<uint32> out, error err) {
+    return ::decode_many(input, out, err);
+}
+
+size varint::decode_many(str *input, std::span<uint64> out, error err) {
+    return ::decode_many(input, out, err);
+}
+
+size varint::encode_many(buf *out, std::span<const uint32> in) {
+    return ::encode_many(out, in);
+}
+
+size varint::encode_many(buf *out, std::span<const uint64> in) {
+    return ::encode_many(out, in);
+}
+
+size varint::read_many(io::Reader &in, std::span<uint32> out, error err) {
+    return ::read_many(in, out, err);
+}
+
+size varint::read_many(io::Reader &in, std::span<uint64> out, error err) {
+    return ::read_many(in, out, err);
+}
+
+void varint::write_many(io::Writer &out, std::span<const uint32> in, error err) {
+    ::write_many(out, in, err);
+}
+
+void varint::write_many(io::Writer &out, std::span<const uint64> in, error err) {
+    ::write_many(out, in, err);
+}
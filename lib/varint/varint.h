@@ -1,10 +1,16 @@
 #pragma once
 
 #include "lib/io/io.h"
+#include <span>
 #include <type_traits>
 
 namespace lib::varint {
     struct ErrOverflow : ErrorBase<ErrOverflow, "varint overflow"> {};
+
+    // MaxLen32 and MaxLen64 are the longest encodings of 32- and 64-bit
+    // values.
+    const int MaxLen32 = 5;
+    const int MaxLen64 = 10;
     
     uint32 read_uint32(io::Reader &in, error err);
     // int decode_uint32(str data, uint32 *out, error err);
@@ -108,4 +114,30 @@ namespace lib::varint {
             static_assert(false, "bad type");
         }
     }
+
+    // decode_many decodes consecutive varints from the start of *input into
+    // out, until out is full or *input is empty, and advances *input past
+    // them. It returns the number decoded. Values are checked as by
+    // read_uint32 and read_uint64.
+    //
+    // On x86-64 CPUs with SSE4.1, runs of varints of up to 4 bytes are
+    // decoded several at a time with a byte shuffle.
+    size decode_many(str *input, std::span<uint32> out, error err);
+    size decode_many(str *input, std::span<uint64> out, error err);
+
+    // encode_many encodes values from in into *out while they fit, advances
+    // *out past them and returns the number encoded.
+    size encode_many(buf *out, std::span<const uint32> in);
+    size encode_many(buf *out, std::span<const uint64> in);
+
+    // read_many reads len(out) varints from in and returns the number read.
+    // They are decoded with decode_many straight from in's read buffer; only
+    // varints that straddle a refill are read a byte at a time.
+    size read_many(io::Reader &in, std::span<uint32> out, error err);
+    size read_many(io::Reader &in, std::span<uint64> out, error err);
+
+    // write_many writes the values of in, encoding them straight into out's
+    // write buffer.
+    void write_many(io::Writer &out, std::span<const uint32> in, error err);
+    void write_many(io::Writer &out, std::span<const uint64> in, error err);
 }
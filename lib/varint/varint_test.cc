@@ -0,0 +1,212 @@
+#include "varint.h"
+
+#include <vector>
+
+#include "lib/fmt/fmt.h"
+#include "lib/io/util.h"
+#include "lib/testing/benchmark.h"
+#include "lib/testing/testing.h"
+
+using namespace lib;
+using namespace lib::testing;
+
+namespace {
+    // Trickle is a buffered reader that returns at most n bytes per read, so
+    // that varints straddle refills of its read buffer.
+    struct Trickle : io::Buffered {
+        str  data;
+        size n;
+
+        Trickle(str data, size n, size bufsize = 16) : data(data), n(n) {
+            resize_readbuf(bufsize);
+        }
+
+        io::ReadResult direct_read(buf b, error) override {
+            size m = copy(b.slice(0, std::min(n, len(b))), data);
+            data = data(m);
+            return {m, len(data) == 0};
+        }
+
+        size direct_write(str, error) override {
+            return 0;
+        }
+    } ;
+
+    // values returns n values of mixed lengths, mostly short, as in a
+    // posting list of deltas.
+    std::vector<uint64> values(int n) {
+        std::vector<uint64> vs;
+        uint64 x = 88172645463325252ULL;
+        for (int i = 0; i < n; i++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            int bits = i % 5 == 0 ? 64 : i % 3 == 0 ? 28 : 7;
+            vs.push_back(x >> (64 - bits));
+        }
+        return vs;
+    }
+
+    String encode(std::span<const uint64> vs) {
+        io::Buffer out;
+        for (uint64 v : vs) {
+            varint::write_uint64(out, v, error::panic);
+        }
+        return out.to_string();
+    }
+}
+
+void test_decode_many(T &t) {
+    std::vector<uint64> want = values(1000);
+    String in = encode(want);
+
+    std::vector<uint64> got(want.size() + 20);
+    str b = in;
+    size n = varint::decode_many(&b, got, error::panic);
+    if (n != size(want.size()) || len(b) != 0) {
+        t.fatalf("decoded %d of %d; %d bytes left", n, want.size(), len(b));
+    }
+    for (size i = 0; i < n; i++) {
+        if (got[i] != want[i]) {
+            t.fatalf("value %d = %d; want %d", i, got[i], want[i]);
+        }
+    }
+
+    // 32-bit values, where the longer ones are cut to 28 bits
+    std::vector<uint64> short_values;
+    for (uint64 v : want) {
+        short_values.push_back(v & 0xFFFFFFF);
+    }
+    in = encode(short_values);
+    std::vector<uint32> got32(short_values.size());
+    b = in;
+    n = varint::decode_many(&b, got32, error::panic);
+    for (size i = 0; i < n; i++) {
+        if (got32[i] != short_values[i]) {
+            t.fatalf("uint32 value %d = %d; want %d", i, got32[i], short_values[i]);
+        }
+    }
+    if (n != size(short_values.size()) || len(b) != 0) {
+        t.errorf("uint32: decoded %d of %d; %d bytes left", n, short_values.size(), len(b));
+    }
+}
+
+void test_decode_many_errors(T &t) {
+    struct {
+        str  in;
+        size n;
+        str  err;
+    } tests[] = {
+        {"\x01\x02\x80", 2, "unexpected EOF"},
+        {"\x01\x80\x80\x80\x80\x10", 1, "varint overflow"},
+        {"\x01\x80\x80\x80\x80\x80\x80\x80\x80\x80\x01", 1, "varint overflow"},
+
+        // a negative int32, sign-extended to 64 bits
+        {"\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01\x05", 2, ""},
+    };
+
+    for (auto const &tt : tests) {
+        uint32 out[4];
+        str b = tt.in;
+        String got;
+        size n = varint::decode_many(&b, out, [&](Error &e) {
+            got = fmt::sprintf("%v", e);
+        });
+        if (n != tt.n || got != tt.err) {
+            t.errorf("%q: decoded %d with error %q; want %d with %q", tt.in, n, got, tt.n, tt.err);
+        }
+    }
+}
+
+void test_encode_many(T &t) {
+    std::vector<uint64> vs = values(300);
+    String want = encode(vs);
+
+    // a small buffer, so that encoding stops and resumes
+    byte space[37];
+    String got;
+    std::span<const uint64> rest = vs;
+    while (!rest.empty()) {
+        buf b = space;
+        size n = varint::encode_many(&b, rest);
+        got += str(space, len(space) - len(b));
+        rest = rest.subspan(n);
+    }
+    if (got != want) {
+        t.errorf("encode_many: got %d bytes, want %d", len(got), len(want));
+    }
+
+    io::Buffer out;
+    varint::write_many(out, vs, error::panic);
+    if (out.to_string() != want) {
+        t.errorf("write_many: got %d bytes, want %d", len(out.to_string()), len(want));
+    }
+}
+
+void test_read_many(T &t) {
+    std::vector<uint64> want = values(500);
+    String in = encode(want);
+
+    for (size n : {1, 3, 16}) {
+        Trickle r(in, n);
+        std::vector<uint64> got(want.size());
+        size k = varint::read_many(r, got, error::panic);
+        if (k != size(want.size()) || got != want) {
+            t.errorf("reads of %d bytes: read %d of %d", n, k, want.size());
+        }
+    }
+
+    // the input ends early
+    Trickle r(str(in).slice(0, len(in) - 1), 7);
+    std::vector<uint64> got(want.size());
+    bool eof = false;
+    size k = varint::read_many(r, got, [&](Error &e) {
+        eof = e.is<io::ErrUnexpectedEOF>();
+    });
+    if (k != size(want.size()) - 1 || !eof) {
+        t.errorf("truncated: read %d, eof %v", k, eof);
+    }
+}
+
+void benchmark_decode_many(B &b) {
+    std::vector<uint64> vs = values(4096);
+    for (uint64 &v : vs) {
+        v &= 0x3FFF;
+    }
+    String in = encode(vs);
+    std::vector<uint32> out(vs.size());
+
+    for (int i = 0; i < b.n; i++) {
+        str s = in;
+        varint::decode_many(&s, out, error::panic);
+    }
+}
+
+void benchmark_read_uint32(B &b) {
+    std::vector<uint64> vs = values(4096);
+    for (uint64 &v : vs) {
+        v &= 0x3FFF;
+    }
+    String in = encode(vs);
+
+    for (int i = 0; i < b.n; i++) {
+        Trickle r(in, 4096, 4096);
+        for (size j = 0; j < size(vs.size()); j++) {
+            varint::read_uint32(r, error::panic);
+        }
+    }
+}
+
+void benchmark_read_many(B &b) {
+    std::vector<uint64> vs = values(4096);
+    for (uint64 &v : vs) {
+        v &= 0x3FFF;
+    }
+    String in = encode(vs);
+    std::vector<uint32> out(vs.size());
+
+    for (int i = 0; i < b.n; i++) {
+        Trickle r(in, 4096, 4096);
+        varint::read_many(r, out, error::panic);
+    }
+}